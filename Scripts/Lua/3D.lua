@@ -59,7 +59,7 @@ math.randomseed(os.time())          -- init seed for math.random
 local N = 0                         -- current grid size (N*N*N cells)
 local DEFAULTN = 30                 -- default grid size
 local MINN = 3                      -- minimum grid size
-local MAXN = 100                    -- maximum grid size (must be even for BusyBoxes)
+local MAXN = 256                    -- maximum grid size (must be even for BusyBoxes)
 local BORDER = 2                    -- space around live cubes
 local MINSIZE = 1+BORDER*2          -- minimum size of empty cells
 local MAXSIZE = 100                 -- maximum size of empty cells
@@ -5623,7 +5623,7 @@ Return the generation count.
 
 <a name="GetGridSize"></a><p><dt><b>GetGridSize()</b></dt>
 <dd>
-Return the current grid size (3 to 100).
+Return the current grid size (3 to 256).
 </dd>
 
 <a name="GetPasteBounds"></a><p><dt><b>GetPasteBounds()</b></dt>
@@ -5818,7 +5818,7 @@ Set the cell type to "cube", "sphere" or "point".
 
 <a name="SetGridSize"></a><p><dt><b>SetGridSize(<i>newsize</i>)</b></dt>
 <dd>
-Change the grid size to the new value (3 to 100).
+Change the grid size to the new value (3 to 256).
 If the <i>newsize</i> is not supplied then the user will be prompted for a value.
 </dd>
 
@@ -6,6 +6,7 @@
 #include "generationsalgo.h"
 #include "ltlalgo.h"
 #include "jvnalgo.h"
+#include "margolusalgo.h"
 #include "ruleloaderalgo.h"
 #include "readpattern.h"
 #include "util.h"
@@ -14,9 +15,18 @@
 #include "writepattern.h"
 #include <stdlib.h>
 #include <iostream>
+#include <fstream>
 #include <cstdio>
 #include <string.h>
 #include <cstdlib>
+#include <string>
+#include <algorithm>
+#ifndef _WIN32
+#include <sys/resource.h>
+#endif
+#ifdef __GLIBC__
+#include <malloc.h>
+#endif
 
 using namespace std ;
 
@@ -52,6 +62,56 @@ public:
 } ;
 nullrender renderer ;
 
+/*
+ *   With --worker each step() runs on a lifeworker while the main thread
+ *   pauses it ten times a second to render, the way the GUI generates.
+ */
+lifeworker stepper ;
+class workerpoll : public lifepoll {
+public:
+   virtual int checkevents() {
+      stepper.park() ;
+      return isInterrupted() ;
+   }
+} ;
+workerpoll workerpoller ;
+/*
+ *   With --layers the pattern is loaded into several universes that
+ *   all step together, the way the GUI generates tiled layers.  The
+ *   first one is imp; the main loop handles its bounded grid.
+ */
+class layertask : public lifetask {
+public:
+   virtual void run() {
+      if (bounded && !la->CreateBorderCells())
+         return ;
+      la->step() ;
+      if (bounded)
+         la->DeleteBorderCells() ;
+   }
+   lifealgo *la ;
+   int bounded ;
+} ;
+vector<layertask> layertasks ;
+vector<lifetask *> layerptrs ;
+void steplayers() {
+   for (size_t i=1; i<layertasks.size(); i++)
+      layertasks[i].la->setIncrement(imp->getIncrement()) ;
+   if (lifeworker::isworker())
+      stepper.runtasks(&layerptrs[0], (int)layerptrs.size()) ;
+   else
+      lifethreads::runexclusive(&layerptrs[0], (int)layerptrs.size()) ;
+}
+class steptask : public lifetask {
+public:
+   virtual void run() {
+      if (layerptrs.size() > 1)
+         steplayers() ;
+      else
+         imp->step() ;
+   }
+} ;
+
 // the RuleLoader algo looks for .rule files in the user_rules directory
 // then in the supplied_rules directory
 char* user_rules = (char *)"";              // can be changed by -s or --search
@@ -122,22 +182,39 @@ struct options {
 bigint maxgen = -1, inc = 0 ;
 int maxmem = 256 ;
 int hyperxxx ;   // renamed hyper to avoid conflict with windows.h
-int render, autofit, quiet, popcount, progress ;
+int render, autofit, quiet, popcount, progress, useworker ;
 int hashlife ;
 char *algoName = 0 ;
 int verbose ;
 int timeline ;
+int timelinebudget ;
+char *timelinestreamname = 0 ;
 int stepthresh, stepfactor ;
 char *liferule = 0 ;
 char *outfilename = 0 ;
 char *renderscale = (char *)"1" ;
 char *testscript = 0 ;
+int numthreads ;
+int incgc ;
+int leafbench ;
+int qlifescale ;
+int ltlscale ;
+int numlayers ;
+int brickcheck ;
+char *suitename = 0 ;
+int suiterepeat = 3 ;
+char *baselinename = 0 ;
+int slowdown = 10 ;
+char *loadcachename = 0 ;
+char *savecachename = 0 ;
 int outputgzip, outputismc ;
 int numberoffset ; // where to insert file name numbers
 options options[] = {
   { "-m", "--generation", "How far to run", 'I', &maxgen },
   { "-i", "--stepsize", "Step size", 'I', &inc },
   { "-M", "--maxmemory", "Max memory to use in megabytes", 'i', &maxmem },
+  { "-j", "--threads", "Number of threads to use", 'i', &numthreads },
+  { "-g", "--incgc", "Use incremental garbage collection", 'b', &incgc },
   { "-T", "--maxtime", "Max duration", 'i', &maxtime },
   { "-b", "--benchmark", "Show timestamps", 'b', &benchmark },
   { "-2", "--exponential", "Use exponentially increasing steps", 'b', &hyperxxx },
@@ -150,10 +227,36 @@ options options[] = {
                                                                &outfilename },
   { "-v", "--verbose", "Verbose", 'b', &verbose },
   { "-t", "--timeline", "Use timeline", 'b', &timeline },
+  { "",   "--timelinebudget", "Evict timeline frames to stay within this many megabytes",
+                                                     'i', &timelinebudget },
+  { "",   "--timelinestream", "Write timeline frames to this .mc file as they are made",
+                                                 's', &timelinestreamname },
   { "",   "--render", "Render (benchmarking)", 'b', &render },
   { "",   "--progress", "Render during progress dialog (debugging)", 'b', &progress },
+  { "",   "--worker", "Step on a worker thread, rendering from the main one", 'b', &useworker },
   { "",   "--popcount", "Popcount (benchmarking)", 'b', &popcount },
+  { "",   "--leafbench", "Time millions of HashLife leaf evaluations (benchmarking)",
+                                                           'i', &leafbench },
+  { "",   "--qlifescale", "Time this many QuickLife gens of a random fill on 1, 2, 4... threads",
+                                                          'i', &qlifescale },
+  { "",   "--layers", "Step this many copies of the pattern side by side (benchmarking)",
+                                                          'i', &numlayers },
+  { "",   "--ltlscale", "Time this many Larger than Life gens at ranges 5, 10, 50 "
+                          "on 1, 2, 4... threads", 'i', &ltlscale },
+  { "",   "--brickcheck", "Check QuickLife's brick kernel on this many random bricks",
+                                                          'i', &brickcheck },
+  { "",   "--suite", "Run the benchmark corpus, writing results to this .json or .csv file",
+                                                          's', &suitename },
+  { "",   "--repeat", "Runs of each benchmark case (default 3)", 'i', &suiterepeat },
+  { "",   "--baseline", "Fail if the suite is slower than this earlier result file",
+                                                       's', &baselinename },
+  { "",   "--slowdown", "Percent slowdown allowed against the baseline (default 10)",
+                                                          'i', &slowdown },
   { "",   "--scale", "Rendering scale", 's', &renderscale },
+  { "",   "--loadcache", "Start with the HashLife results saved in this file",
+                                                       's', &loadcachename },
+  { "",   "--savecache", "Save the HashLife results to this file at the end",
+                                                       's', &savecachename },
 //{ "",   "--stepthreshold", "Stepsize >= gencount/this (default 1)",
 //                                                          'i', &stepthresh },
 //{ "",   "--stepfactor", "How much to scale step by (default 2)",
@@ -324,7 +427,7 @@ struct loadcmd : public cmdbase {
 struct stepcmd : public cmdbase {
    stepcmd() : cmdbase("step", "b") {}
    virtual void doit() {
-      if (imp->unbounded && (imp->gridwd > 0 || imp->gridht > 0)) {
+      if (imp->needsbordercells()) {
          // bounded grid, so must step by 1
          imp->setIncrement(1) ;
          if (!imp->CreateBorderCells()) exit(10) ;
@@ -489,6 +592,407 @@ struct edgescmd : public cmdbase {
    }
 } edges_inst ;
 
+/*
+ *   Run a random fill of size by size cells at half density for gens
+ *   generations with the given algorithm and rule, once with each
+ *   thread count from 1 up to -j (default 4), doubling.  Every run has
+ *   to end with the same cells as the single-threaded one.  A bounded
+ *   grid is filled from its top left corner.
+ */
+void threadscaling(const char *algoname, const char *rule, int size, int gens) {
+   staticAlgoInfo *ai = staticAlgoInfo::byName(algoname) ;
+   int maxthreads = (numthreads > 0 ? numthreads : 4) ;
+   double serial = 0 ;
+   bigint pop0 ;
+   unsigned int sum0 = 0 ;
+   for (int threads=1; ; threads *= 2) {
+      if (threads > maxthreads)
+         threads = maxthreads ;
+      lifethreads::setthreadcount(threads) ;
+      lifealgo *la = (ai->creator)() ;
+      la->setMaxMemory(maxmem) ;
+      const char *err = la->setrule(rule) ;
+      if (err) lifefatal(err) ;
+      int x0 = 0, y0 = 0 ;
+      if (la->gridwd > 0 || la->gridht > 0) {
+         x0 = la->gridleft.toint() ;
+         y0 = la->gridtop.toint() ;
+      }
+      unsigned int seed = 12345 ;
+      for (int y=0; y<size; y++)
+         for (int x=0; x<size; x++) {
+            seed = seed * 1103515245 + 12345 ;
+            if (seed & 0x40000000)
+               la->setcell(x0 + x, y0 + y, 1) ;
+         }
+      la->endofpattern() ;
+      double t = gollySecondCount() ;
+      for (int g=0; g<gens; g++)
+         la->step() ;
+      t = gollySecondCount() - t ;
+      bigint pop = la->getPopulation() ;
+      unsigned int sum = 0 ;
+      bigint top, left, bottom, right ;
+      if (!la->isEmpty()) {
+         la->findedges(&top, &left, &bottom, &right) ;
+         for (int y=top.toint(); y<=bottom.toint(); y++)
+            for (int x=left.toint(); x<=right.toint(); x++) {
+               int v = 0 ;
+               int dx = la->nextcell(x, y, v) ;
+               if (dx < 0)
+                  break ;
+               x += dx ;
+               sum = sum * 31 + (unsigned int)(x * 65599 + y) + v ;
+            }
+      }
+      if (threads == 1) {
+         serial = t ;
+         pop0 = pop ;
+         sum0 = sum ;
+      }
+      cout << threads << " thread" << (threads > 1 ? "s: " : ": ")
+           << t << " s for " << gens << " gens, speedup "
+           << (t > 0 ? serial / t : 0) << ", population "
+           << pop.tostring() << endl ;
+      if (pop != pop0 || sum != sum0)
+         lifefatal("Threaded result differs from the serial one") ;
+      delete la ;
+      if (threads >= maxthreads)
+         break ;
+   }
+}
+
+void qlifescaling(int gens) {
+   threadscaling("QuickLife", liferule ? liferule : "B3/S23", 1024, gens) ;
+}
+
+/*
+ *   Larger than Life at ranges 5, 10 and 50 with the Moore and von
+ *   Neumann neighborhoods, each a majority rule on a 1024 by 1024 torus.
+ */
+const char *ltlscalerules[] = {
+   "R5,C0,M1,S61..121,B61..121,NM:T1024,1024",
+   "R10,C0,M1,S221..441,B221..441,NM:T1024,1024",
+   "R50,C0,M1,S5101..10201,B5101..10201,NM:T1024,1024",
+   "R5,C0,M1,S31..61,B31..61,NN:T1024,1024",
+   "R10,C0,M1,S111..221,B111..221,NN:T1024,1024",
+   "R50,C0,M1,S2551..5101,B2551..5101,NN:T1024,1024",
+   0
+} ;
+
+void ltlscaling(int gens) {
+   for (int i=0; ltlscalerules[i]; i++) {
+      cout << ltlscalerules[i] << endl ;
+      threadscaling("Larger than Life", ltlscalerules[i], 1024, gens) ;
+   }
+}
+
+/*
+ *   The benchmark suite.  Each case runs a pattern from Patterns/ for a
+ *   fixed number of generations with one algorithm, and is timed
+ *   --repeat times from a fresh load; we keep the best and median
+ *   times, and the counters the algorithm reports after the last run.
+ *   Peak RSS is reset before each case (after the previous universe is
+ *   freed), so it is that case's own high-water mark; where it can't be
+ *   reset (anything but Linux) it is reported as 0.  Results are
+ *   written as JSON or CSV (by the file suffix; "-" is CSV on stdout),
+ *   and either can be given back later with --baseline to fail on any
+ *   case that got more than --slowdown percent slower or that ends
+ *   with a different population.
+ */
+struct suitecase {
+   const char *algo ;
+   const char *pattern ;
+   const char *gens ;
+   const char *step ;
+} ;
+suitecase suitecases[] = {
+   { "QuickLife", "Life/Breeders/breeder.lif", "4000", "1" },
+   { "QuickLife", "Life-Like/Day-and-Night-gun-and-antigun.rle", "20000", "1" },
+   { "HashLife", "Life/Breeders/breeder.lif", "16777216", "1024" },
+   { "HashLife", "HashLife/gotts-dots.mc", "268435456", "268435456" },
+   { "HashLife", "Life/Bounded-Grids/huge-torus.rle", "4294967296", "16777216" },
+   { "Generations", "Generations/Lava.mcl", "500", "1" },
+   { "Larger than Life", "Larger-than-Life/Globe.mcl", "1000", "1" },
+   { "Larger than Life", "Larger-than-Life/Bosco.mcl", "100000", "1" },
+   { "JvN", "Self-Rep/JvN/N-compressed-replicator.rle", "16384", "256" },
+   { "Margolus", "Margolus/BBM-native.rle", "1048576", "1024" },
+   { "RuleLoader", "Loops/Evoloop.rle", "2000", "1" },
+   { "RuleLoader", "WireWorld/clocks.mcl", "65536", "256" },
+   { 0, 0, 0, 0 }
+} ;
+const char *suitedir = "Patterns/" ;
+struct suiteresult {
+   string name ;
+   string population ;
+   const suitecase *sc ;
+   double best, median, genspersec, peakrss ;
+   lifestats stats ;
+} ;
+struct suitebaseline {
+   string name ;
+   string population ;
+   double genspersec ;
+} ;
+
+/*
+ *   The process's peak RSS in KB.  On Linux this is VmHWM, which
+ *   resetpeakrss() can set back to the current RSS.
+ */
+double peakrsskb() {
+#ifdef _WIN32
+   return 0 ;
+#else
+#ifdef __linux__
+   FILE *f = fopen("/proc/self/status", "r") ;
+   if (f) {
+      char line[256] ;
+      double kb = -1 ;
+      while (kb < 0 && fgets(line, sizeof(line), f) != 0)
+         if (strncmp(line, "VmHWM:", 6) == 0)
+            kb = atof(line + 6) ;
+      fclose(f) ;
+      if (kb >= 0)
+         return kb ;
+   }
+#endif
+   struct rusage ru ;
+   getrusage(RUSAGE_SELF, &ru) ;
+#ifdef __APPLE__
+   return ru.ru_maxrss / 1024.0 ;
+#else
+   return (double)ru.ru_maxrss ;
+#endif
+#endif
+}
+
+/*
+ *   Reset the peak RSS to the current RSS; returns false if we can't.
+ *   Freed memory the allocator is still holding is given back first.
+ */
+bool resetpeakrss() {
+#ifdef __GLIBC__
+   malloc_trim(0) ;
+#endif
+#ifdef __linux__
+   FILE *f = fopen("/proc/self/clear_refs", "w") ;
+   if (f == 0)
+      return false ;
+   bool ok = (fputs("5", f) >= 0) ;
+   if (fclose(f) != 0)
+      ok = false ;
+   return ok ;
+#else
+   return false ;
+#endif
+}
+
+void runsuitecase(const suitecase &sc, suiteresult &r) {
+   staticAlgoInfo *ai = staticAlgoInfo::byName(sc.algo) ;
+   string path = string(suitedir) + sc.pattern ;
+   vector<double> times ;
+   double gensdone = 0 ;
+   if (imp != 0)
+      delete imp ;
+   imp = 0 ;
+   bool rssreset = resetpeakrss() ;
+   for (int rep=0; rep<suiterepeat; rep++) {
+      if (imp != 0)
+         delete imp ;
+      imp = (ai->creator)() ;
+      if (imp == 0)
+         lifefatal("Could not create universe") ;
+      imp->setMaxMemory(maxmem) ;
+      const char *err = readpattern(path.c_str(), *imp) ;
+      if (err) lifefatal(err) ;
+      bool boundedgrid = imp->needsbordercells() ;
+      bigint step(sc.step) ;
+      if (boundedgrid)
+         step = 1 ;
+      imp->setIncrement(step) ;
+      bigint gen0 = imp->getGeneration() ;
+      bigint target = gen0 ;
+      target += bigint(sc.gens) ;
+      double t = gollySecondCount() ;
+      while (imp->getGeneration() < target) {
+         if (boundedgrid && !imp->CreateBorderCells())
+            break ;
+         imp->step() ;
+         if (boundedgrid && !imp->DeleteBorderCells())
+            break ;
+      }
+      t = gollySecondCount() - t ;
+      times.push_back(t) ;
+      bigint done = imp->getGeneration() ;
+      done -= gen0 ;
+      gensdone = done.todouble() ;
+   }
+   sort(times.begin(), times.end()) ;
+   r.sc = &sc ;
+   r.name = string(sc.algo) + ":" + sc.pattern ;
+   r.best = times[0] ;
+   r.median = times[times.size() / 2] ;
+   r.genspersec = (r.best > 0 ? gensdone / r.best : 0) ;
+   r.population = imp->getPopulation().tostring(0) ;
+   imp->getstats(r.stats) ;
+   r.peakrss = (rssreset ? peakrsskb() : 0) ;
+}
+
+void writesuite(FILE *f, int json, vector<suiteresult> &results) {
+   if (json)
+      fprintf(f, "{\n  \"bgolly\": \"%s\",\n  \"threads\": %d,\n"
+                 "  \"repeat\": %d,\n  \"cases\": [\n", STRINGIFY(VERSION),
+                 lifethreads::getthreadcount(), suiterepeat) ;
+   else
+      fprintf(f, "case,algorithm,pattern,generations,best_s,median_s,"
+                 "gens_per_s,population,nodes,gcs,gc_pauses,gc_pause_total_s,"
+                 "gc_pause_max_s,hash_load,memory_mb,peak_rss_kb\n") ;
+   for (unsigned int i=0; i<results.size(); i++) {
+      suiteresult &r = results[i] ;
+      lifestats &s = r.stats ;
+      if (json)
+         fprintf(f, "    { \"case\": \"%s\", \"algorithm\": \"%s\", "
+                    "\"pattern\": \"%s\", \"generations\": \"%s\", "
+                    "\"best_s\": %.6f, \"median_s\": %.6f, \"gens_per_s\": %g, "
+                    "\"population\": \"%s\", \"nodes\": %.0f, \"gcs\": %.0f, "
+                    "\"gc_pauses\": %.0f, \"gc_pause_total_s\": %.6f, "
+                    "\"gc_pause_max_s\": %.6f, \"hash_load\": %.4f, "
+                    "\"memory_mb\": %.2f, \"peak_rss_kb\": %.0f }%s\n",
+                 r.name.c_str(), r.sc->algo, r.sc->pattern, r.sc->gens,
+                 r.best, r.median, r.genspersec, r.population.c_str(),
+                 s.nodes, s.gcs, s.gcpauses, s.gcpausetotal, s.gcpausemax,
+                 s.hashload, s.memory / 1048576.0, r.peakrss,
+                 (i + 1 < results.size() ? "," : "")) ;
+      else
+         fprintf(f, "%s,%s,%s,%s,%.6f,%.6f,%g,%s,%.0f,%.0f,%.0f,%.6f,%.6f,"
+                    "%.4f,%.2f,%.0f\n",
+                 r.name.c_str(), r.sc->algo, r.sc->pattern, r.sc->gens,
+                 r.best, r.median, r.genspersec, r.population.c_str(),
+                 s.nodes, s.gcs, s.gcpauses, s.gcpausetotal, s.gcpausemax,
+                 s.hashload, s.memory / 1048576.0, r.peakrss) ;
+   }
+   if (json)
+      fprintf(f, "  ]\n}\n") ;
+}
+
+/*
+ *   Get the string value of "key": "value" or the number after "key": in
+ *   a JSON line; returns 0 if the key is not there.
+ */
+const char *jsonfield(const char *line, const char *key, string &val) {
+   string k = string("\"") + key + "\": " ;
+   const char *p = strstr(line, k.c_str()) ;
+   if (p == 0)
+      return 0 ;
+   p += k.size() ;
+   const char *e ;
+   if (*p == '"')
+      e = strchr(++p, '"') ;
+   else
+      e = p + strcspn(p, ",}\r\n") ;
+   if (e == 0)
+      return 0 ;
+   val.assign(p, e - p) ;
+   return val.c_str() ;
+}
+
+void readbaseline(const char *name, vector<suitebaseline> &base) {
+   FILE *f = fopen(name, "r") ;
+   if (f == 0)
+      lifefatal("Cannot open baseline file") ;
+   linereader lr(f) ;
+   lr.setcloseonfree() ;
+   char line[4096] ;
+   while (lr.fgets(line, sizeof(line)) != 0) {
+      suitebaseline b ;
+      string gps ;
+      if (strstr(line, "\"case\": ") != 0) {
+         if (jsonfield(line, "case", b.name) == 0 ||
+             jsonfield(line, "population", b.population) == 0 ||
+             jsonfield(line, "gens_per_s", gps) == 0)
+            continue ;
+      } else {
+         // case,algorithm,pattern,generations,best_s,median_s,gens_per_s,population
+         vector<string> fields ;
+         const char *p = line ;
+         while (fields.size() < 8) {
+            size_t n = strcspn(p, ",\r\n") ;
+            fields.push_back(string(p, n)) ;
+            if (p[n] != ',')
+               break ;
+            p += n + 1 ;
+         }
+         if (fields.size() < 8 || fields[0] == "case")
+            continue ;
+         b.name = fields[0] ;
+         gps = fields[6] ;
+         b.population = fields[7] ;
+      }
+      b.genspersec = atof(gps.c_str()) ;
+      base.push_back(b) ;
+   }
+}
+
+int runsuite(const char *onlyalgo) {
+   if (suiterepeat < 1)
+      suiterepeat = 1 ;
+   vector<suiteresult> results ;
+   for (staticAlgoInfo *ai=staticAlgoInfo::head; ai; ai=ai->next) {
+      if (onlyalgo && strcmp(onlyalgo, ai->algoName) != 0)
+         continue ;
+      int cases = 0 ;
+      for (int i=0; suitecases[i].algo; i++) {
+         if (strcmp(suitecases[i].algo, ai->algoName) != 0)
+            continue ;
+         suiteresult r ;
+         runsuitecase(suitecases[i], r) ;
+         cerr << r.name << ": " << r.best << " s, " << r.genspersec
+              << " gens/s" << endl ;
+         results.push_back(r) ;
+         cases++ ;
+      }
+      if (cases == 0)
+         cerr << "No benchmark cases for " << ai->algoName << endl ;
+   }
+   FILE *f = stdout ;
+   if (strcmp(suitename, "-") != 0)
+      f = fopen(suitename, "w") ;
+   if (f == 0)
+      lifefatal("Cannot write benchmark results") ;
+   writesuite(f, endswith(suitename, ".json"), results) ;
+   if (f != stdout)
+      fclose(f) ;
+   if (baselinename == 0)
+      return 0 ;
+   vector<suitebaseline> base ;
+   readbaseline(baselinename, base) ;
+   int bad = 0 ;
+   for (unsigned int i=0; i<results.size(); i++) {
+      suiteresult &r = results[i] ;
+      unsigned int j = 0 ;
+      while (j < base.size() && base[j].name != r.name)
+         j++ ;
+      if (j == base.size()) {
+         cerr << r.name << ": not in baseline" << endl ;
+         continue ;
+      }
+      double change = 0 ;
+      if (r.genspersec > 0)
+         change = 100.0 * (base[j].genspersec / r.genspersec - 1) ;
+      if (base[j].population != r.population) {
+         cerr << r.name << ": population " << r.population
+              << ", baseline has " << base[j].population << endl ;
+         bad++ ;
+      } else if (change > slowdown) {
+         cerr << r.name << ": " << change << "% slower than baseline" << endl ;
+         bad++ ;
+      }
+   }
+   cerr << bad << " of " << results.size()
+        << " cases regressed against the baseline" << endl ;
+   return bad ? 1 : 0 ;
+}
+
 void runtestscript(const char *testscript) {
    FILE *cmdfile = 0 ;
    if (strcmp(testscript, "-") != 0)
@@ -523,6 +1027,7 @@ int main(int argc, char *argv[]) {
    generationsalgo::doInitializeAlgoInfo(staticAlgoInfo::tick()) ;
    ltlalgo::doInitializeAlgoInfo(staticAlgoInfo::tick()) ;
    jvnalgo::doInitializeAlgoInfo(staticAlgoInfo::tick()) ;
+   margolusalgo::doInitializeAlgoInfo(staticAlgoInfo::tick()) ;
    ruleloaderalgo::doInitializeAlgoInfo(staticAlgoInfo::tick()) ;
    while (argc > 1 && argv[1][0] == '-') {
       argc-- ;
@@ -565,7 +1070,8 @@ case 's':
       if (!hit)
          usage("Bad option given") ;
    }
-   if (argc < 2 && !testscript)
+   if (argc < 2 && !testscript && !leafbench && !qlifescale && !ltlscale &&
+       !brickcheck && !suitename)
       usage("No pattern argument given") ;
    if (argc > 2)
       usage("Extra stuff after pattern argument") ;
@@ -586,8 +1092,17 @@ case 's':
       if (strlen(outfilename) > 200)
          lifefatal("Output filename too long") ;
    }
+   if (timelinebudget > 0 || timelinestreamname)
+      timeline = 1 ;
    if (timeline && hyperxxx)
       lifefatal("Cannot use both timeline and exponentially increasing steps") ;
+   if (numthreads > 0)
+      lifethreads::setthreadcount(numthreads) ;
+   char *suitealgo = algoName ;
+   if (incgc) {
+      hlifealgo::setIncrementalGC(1) ;
+      ghashbase::setIncrementalGC(1) ;
+   }
    imp = createUniverse() ;
    if (progress)
       lifeerrors::seterrorhandler(&progerrors_instance) ;
@@ -597,7 +1112,35 @@ case 's':
       hlifealgo::setVerbose(1) ;
    }
    imp->setMaxMemory(maxmem) ;
+   if (useworker)
+      imp->setpoll(&workerpoller) ;
    timestamp() ;
+   if (leafbench) {
+      hlifealgo *hl = new hlifealgo() ;
+      const char *err = hl->setrule(liferule ? liferule : "B3/S23") ;
+      if (err) lifefatal(err) ;
+      hl->leafbenchmark(leafbench) ;
+      delete hl ;
+      exit(0) ;
+   }
+   if (brickcheck) {
+      qlifealgo *ql = new qlifealgo() ;
+      const char *err = ql->setrule(liferule ? liferule : "B3/S23") ;
+      if (err) lifefatal(err) ;
+      int bad = ql->brickcheck(brickcheck) ;
+      delete ql ;
+      exit(bad ? 1 : 0) ;
+   }
+   if (qlifescale) {
+      qlifescaling(qlifescale) ;
+      exit(0) ;
+   }
+   if (ltlscale) {
+      ltlscaling(ltlscale) ;
+      exit(0) ;
+   }
+   if (suitename)
+      exit(runsuite(suitealgo)) ;
    if (testscript) {
       if (argc > 1) {
          filename = argv[1] ;
@@ -607,13 +1150,17 @@ case 's':
       runtestscript(testscript) ;
    }
    filename = argv[1] ;
+   double loadtime = gollySecondCount() ;
    const char *err = readpattern(argv[1], *imp) ;
    if (err) lifefatal(err) ;
+   if (benchmark)
+      cout << "Read pattern in " << (gollySecondCount() - loadtime)
+           << " s, peak RSS " << peakrsskb() << " KB" << endl ;
    if (liferule) {
       err = imp->setrule(liferule) ;
       if (err) lifefatal(err) ;
    }
-   bool boundedgrid = imp->unbounded && (imp->gridwd > 0 || imp->gridht > 0) ;
+   bool boundedgrid = imp->needsbordercells() ;
    if (boundedgrid) {
       if (hyperxxx || inc > 1)
          lifewarning("Step size must be 1 for a bounded grid") ;
@@ -622,6 +1169,43 @@ case 's':
    }
    if (inc != 0)
       imp->setIncrement(inc) ;
+   if (numlayers > 1) {
+      layertasks.resize(numlayers) ;
+      layertasks[0].la = imp ;
+      layertasks[0].bounded = 0 ;
+      for (int i=1; i<numlayers; i++) {
+         lifealgo *la = createUniverse() ;
+         err = readpattern(argv[1], *la) ;
+         if (err) lifefatal(err) ;
+         if (liferule) {
+            err = la->setrule(liferule) ;
+            if (err) lifefatal(err) ;
+         }
+         // every universe needs a poller of its own
+         la->setpoll(new workerpoll()) ;
+         layertasks[i].la = la ;
+         layertasks[i].bounded = boundedgrid ;
+      }
+      for (int i=0; i<numlayers; i++)
+         layerptrs.push_back(&layertasks[i]) ;
+   }
+   hlifealgo *hlcache = 0 ;
+   if (loadcachename || savecachename) {
+      if (strcmp(algoName, "HashLife") != 0)
+         lifefatal("Result caches need the HashLife algorithm") ;
+      hlcache = (hlifealgo *)imp ;
+   }
+   int warmcache = 0, firststep = 1 ;
+   if (loadcachename) {
+      double t = gollySecondCount() ;
+      err = hlcache->loadcache(loadcachename) ;
+      if (err)
+         lifewarning(err) ;
+      else {
+         warmcache = 1 ;
+         cout << "Loaded cache in " << (gollySecondCount() - t) << " s" << endl ;
+      }
+   }
    if (timeline) {
       int lowbit = inc.lowbitset() ;
       bigint t = 1 ;
@@ -630,6 +1214,15 @@ case 's':
       if (t != inc)
          lifefatal("Bad increment for timeline") ;
       imp->startrecording(2, lowbit) ;
+      imp->settimelinebudget(timelinebudget) ;
+   }
+   std::ofstream timelinestream ;
+   if (timelinestreamname) {
+      timelinestream.open(timelinestreamname, std::ios::out | std::ios::binary) ;
+      if (!timelinestream)
+         lifefatal("Cannot open the timeline stream file") ;
+      err = imp->streamtimeline(&timelinestream) ;
+      if (err) lifefatal(err) ;
    }
    int fc = 0 ;
    for (;;) {
@@ -667,17 +1260,68 @@ case 's':
          imp->setIncrement(diff) ;
       }
       if (boundedgrid && !imp->CreateBorderCells()) break ;
-      imp->step() ;
+      double steptime = gollySecondCount() ;
+      if (useworker) {
+         steptask t ;
+         stepper.start(&t) ;
+         while (!stepper.wait(100)) {
+            if (render) {
+               int paused = stepper.pause() ;
+               imp->draw(viewport, renderer) ;
+               if (paused)
+                  stepper.resume() ;
+            }
+         }
+      } else if (numlayers > 1)
+         steplayers() ;
+      else
+         imp->step() ;
+      if (hlcache && firststep)
+         cout << "Time to first generation: "
+              << (gollySecondCount() - steptime) << " s ("
+              << (warmcache ? "warm" : "cold") << " cache)" << endl ;
+      firststep = 0 ;
       if (boundedgrid && !imp->DeleteBorderCells()) break ;
       if (timeline) imp->extendtimeline() ;
       if (maxgen < 0 && outfilename != 0)
          writepat(fc++) ;
-      if (timeline && imp->getframecount() + 2 > MAX_FRAME_COUNT)
+      // a stream keeps its spacing, so it just stops when the timeline is full
+      if (timeline && !timelinestreamname &&
+          imp->getframecount() + 2 > MAX_FRAME_COUNT)
          imp->pruneframes() ;
       if (hyperxxx)
          imp->setIncrement(imp->getGeneration()) ;
    }
+   if (timelinestreamname) {
+      imp->streamtimeline(0) ;
+      timelinestream.close() ;
+   }
+   // before saving, which brings back any evicted frames
+   if (timeline && verbose) {
+      double total = imp->measuretimeline(), most = 0 ;
+      int kept = 0 ;
+      for (int i=0; i<imp->getframecount(); i++) {
+         if (imp->isframekept(i))
+            kept++ ;
+         if (imp->getframepinned(i) > most)
+            most = imp->getframepinned(i) ;
+      }
+      cout << "Timeline: " << imp->getframecount() << " frames, " << kept
+           << " kept, " << (total / 1048576.0) << " MB pinned (at most "
+           << (most / 1048576.0) << " MB by one frame)" << endl ;
+   }
+   for (int i=1; i<numlayers; i++) {
+      lifealgo *la = layertasks[i].la ;
+      if (la->getGeneration() != imp->getGeneration() ||
+          la->getPopulation() != imp->getPopulation())
+         lifewarning("A layer did not end up the same as the first one") ;
+   }
    if (maxgen >= 0 && outfilename != 0)
       writepat(-1) ;
+   if (savecachename) {
+      err = hlcache->savecache(savecachename) ;
+      if (err)
+         lifewarning(err) ;
+   }
    exit(0) ;
 }
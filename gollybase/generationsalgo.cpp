@@ -51,6 +51,11 @@ state generationsalgo::slowcalc(state nw, state n, state ne, state w, state c,
    return result ;
 }
 
+void generationsalgo::slowcalcblock(const state *in, int stride, state *out,
+                                    int n) {
+   ghashcalcblock(this, in, stride, out, n) ;
+}
+
 static lifealgo *creator() { return new generationsalgo() ; }
 
 void generationsalgo::doInitializeAlgoInfo(staticAlgoInfo &ai) {
@@ -19,10 +19,14 @@
 #include <string.h>
 using namespace std ;
 /*
- *   Power of two hash sizes work fine.
+ *   Power of two hash sizes work fine.  The table index is taken from
+ *   the middle bits of a multiply of the hash (see resize()).
  */
+static inline g_uintptr_t hashspread(g_uintptr_t h) {
+   return (g_uintptr_t)(((unsigned long long)h * 0x9e3779b97f4a7c15ULL) >> 24) ;
+}
 #ifdef PRIMEMOD
-#define HASHMOD(a) ((a)%hashprime)
+#define HASHMOD(a) (hashspread(a)%hashprime)
 static g_uintptr_t nexthashsize(g_uintptr_t i) {
    g_uintptr_t j ;
    i |= 1 ;
@@ -35,7 +39,7 @@ static g_uintptr_t nexthashsize(g_uintptr_t i) {
    }
 }
 #else
-#define HASHMOD(a) ((a)&(hashmask))
+#define HASHMOD(a) (hashspread(a)&(hashmask))
 static g_uintptr_t nexthashsize(g_uintptr_t i) {
    while ((i & (i - 1)))
       i += (i & (1 + ~i)) ; // i & - i is more idiomatic but generates warning
@@ -55,80 +59,171 @@ g_uintptr_t ghnode_hash(void *a, void *b, void *c, void *d) {
    return r ;
 }
 #endif
-#define ghleaf_hash(a,b,c,d) (65537*(d)+257*(c)+17*(b)+5*(a))
-/*
- *   Resize the hash.  The max load factor defined here does not actually
- *   yield the maximum load factor the hash will see, because when we
- *   do the last resize before exhausting memory, we may find we are
- *   not permitted (while keeping total memory consumption below the
- *   limit) to do the resize, so the actual max load factor may be
- *   somewhat higher.  Conversely, because we double the hash size
- *   each time, the actual final max load factor may be less than this.
- *   Additional code can be added to manage this, but after some
- *   experimentation, it has been found that the impact is tiny, so
- *   we are keeping the code simple.  Nonetheless, this factor can be
- *   tweaked in the case where you absolutely want as many nodes as
- *   possible in memory, and are willing to use a large load factor to
- *   permit this; with the move-to-front heuristic, the code actually
- *   handles a large load factor fairly well.
+static g_uintptr_t ghleaf_hash(const state *c) {
+   unsigned long long a, b ;
+   memcpy(&a, c, 8) ;
+   memcpy(&b, c + 8, 8) ;
+   unsigned long long r = (a * 0xff51afd7ed558ccdULL) ^ b ;
+   r = (r ^ (r >> 32)) * 0xc4ceb9fe1a85ec53ULL ;
+   return (g_uintptr_t)(r ^ (r >> 29)) ;
+}
+/*
+ *   The hash table.  This is the same open addressed table of groups
+ *   of ghnode pointers that hlifealgo uses (see util.h): a lookup
+ *   usually reads one group and, on a hit, the ghnode itself, where a
+ *   chain costs a cache miss for every ghnode we compare against.
+ *   Both the group index and the tag come from a multiply of the hash.
+ *   Entries freed by the incremental sweep leave tombstones, which
+ *   count against the load factor until a full collection or a resize
+ *   clears them out.
+ *
+ *   Resizing allocates the new table and then moves the old entries
+ *   over a few groups at a time as new ghnodes are added, and any
+ *   entry we look up in the old table right away.  Lookups that miss
+ *   in the new table try the old one until it is empty.  Collections
+ *   finish the move before they start.
+ *
+ *   The max load factor defined here does not actually yield the
+ *   maximum load factor the hash will see, because when we do the last
+ *   resize before exhausting memory, we may find we are not permitted
+ *   (while keeping total memory consumption below the limit) to do the
+ *   resize.  In that case we let the table fill to seven eighths, and
+ *   from then on collect garbage instead of growing.  Conversely,
+ *   because we double the hash size each time, the actual final max
+ *   load factor may be less than this.
  */
 double ghashbase::maxloadfactor = 0.7 ;
+const g_uintptr_t MIGRATEGROUPS = 2 ; // old groups moved per insertion
+const hashtagword TAGSUSED = tagsused(GHASHGROUP) ;
+#ifdef PRIMEMOD
+#define OLDHASHMOD(a) (hashspread(a)%oldprime)
+#else
+#define OLDHASHMOD(a) (hashspread(a)&(oldprime-1))
+#endif
+static g_uintptr_t hashof(ghnode *p) {
+   if (is_ghnode(p))
+      return ghnode_hash(p->nw, p->ne, p->sw, p->se) ;
+   return ghleaf_hash(((ghleaf *)p)->c) ;
+}
 void ghashbase::resize() {
+   if (gcphase)
+      finishgc() ; // sweeping leaves tombstones, so get it done first
 #ifndef NOGCBEFORERESIZE
-   if (okaytogc) {
+   else if (okaytogc && !incrementalgc && !hashfull) {
       do_gc(0) ;
    }
 #endif
-   g_uintptr_t i, nhashprime = nexthashsize(2 * hashprime) ;
-   ghnode *p, **nhashtab ;
-   if (hashprime > (totalthings >> 2)) {
-      if (alloced > maxmem ||
-          nhashprime * sizeof(ghnode *) > (maxmem - alloced)) {
-         hashlimit = G_MAX ;
+   finishresize() ;
+   g_uintptr_t slots = hashprime * GHASHGROUP ;
+   if (hashfull && okaytogc) {
+      do_gc(0) ;
+      if (hashpop + hashdead + slots / 16 <= hashlimit)
+         return ;
+   }
+   g_uintptr_t nhashprime = hashprime ;
+   if (hashdead < hashpop) // otherwise just clear out the tombstones
+      nhashprime = nexthashsize(2 * hashprime) ;
+   g_uintptr_t nbytes = nhashprime * sizeof(ghashgroup) ;
+   if (!hashfull && slots > (totalthings >> 2)) {
+      if (alloced > maxmem || nbytes > (maxmem - alloced)) {
+         hashfull = 1 ;
+         hashlimit = slots - slots / 8 ;
          return ;
       }
    }
    if (verbose) {
-     sprintf(statusline, "Resizing hash to %" PRIuPTR "...", nhashprime) ;
+     sprintf(statusline, "Resizing hash to %" PRIuPTR "...",
+             nhashprime * GHASHGROUP) ;
      lifestatus(statusline) ;
    }
-   nhashtab = (ghnode **)calloc(nhashprime, sizeof(ghnode *)) ;
+   ghashgroup *nhashtab = (ghashgroup *)linecalloc(nbytes) ;
    if (nhashtab == 0) {
-     lifewarning("Out of memory; running in a somewhat slower mode; "
-                 "try reducing the hash memory limit after restarting.") ;
-     hashlimit = G_MAX ;
+     if (hashpop + hashdead + slots / 32 > slots)
+       lifefatal("Out of memory; try reducing the hash memory limit.") ;
+     if (!hashfull)
+       lifewarning("Out of memory; running in a somewhat slower mode; "
+                   "try reducing the hash memory limit after restarting.") ;
+     hashfull = 1 ;
+     hashlimit = slots - slots / 32 ;
      return ;
    }
-   alloced += sizeof(ghnode *) * (nhashprime - hashprime) ;
-   g_uintptr_t ohashprime = hashprime ;
+   alloced += nbytes ;
+   oldtab = hashtab ;
+   oldprime = hashprime ;
+   migratecursor = 0 ;
+   hashtab = nhashtab ;
    hashprime = nhashprime ;
 #ifndef PRIMEMOD
    hashmask = hashprime - 1 ;
 #endif
-   for (i=0; i<ohashprime; i++) {
-      for (p=hashtab[i]; p;) {
-         ghnode *np = p->next ;
-         g_uintptr_t h ;
-         if (is_ghnode(p)) {
-            h = ghnode_hash(p->nw, p->ne, p->sw, p->se) ;
-         } else {
-            ghleaf *l = (ghleaf *)p ;
-            h = ghleaf_hash(l->nw, l->ne, l->sw, l->se) ;
-         }
-         h = HASHMOD(h) ;
-         p->next = nhashtab[h] ;
-         nhashtab[h] = p ;
-         p = np ;
+   hashdead = 0 ;
+   hashfull = 0 ;
+   hashlimit = (g_uintptr_t)(maxloadfactor * hashprime * GHASHGROUP) ;
+   if (logcalccache < MAXLOGCALCCACHE &&
+       hashprime * GHASHGROUP > ((g_uintptr_t)CALCCACHERATIO << logcalccache))
+      growcalccache() ;
+}
+/*
+ *   Move the entries of the next few groups of the old table over.
+ */
+void ghashbase::migrate(g_uintptr_t groups) {
+   while (groups-- > 0 && migratecursor < oldprime) {
+      ghashgroup *grp = oldtab + migratecursor++ ;
+      for (hashtagword m = tagfull(grp->tags) ; m ; m &= m - 1) {
+         ghnode *p = grp->slot[tagindex(m)] ;
+         hashinsert(p, hashof(p)) ;
       }
+      grp->tags = tagkill(grp->tags) ;
    }
-   free(hashtab) ;
-   hashtab = nhashtab ;
-   hashlimit = (g_uintptr_t)(maxloadfactor * hashprime) ;
+   if (migratecursor >= oldprime)
+      endresize() ;
+}
+void ghashbase::finishresize() {
+   if (oldtab)
+      migrate(oldprime) ;
+}
+/*
+ *   Drop the old table; everything in it has been moved (or, during a
+ *   collection, will be put back from the ghnode blocks).
+ */
+void ghashbase::endresize() {
+   alloced -= oldprime * sizeof(ghashgroup) ;
+   linefree(oldtab) ;
+   oldtab = 0 ;
    if (verbose) {
-     strcpy(statusline+strlen(statusline), " done.") ;
+     sprintf(statusline, "Resizing hash to %" PRIuPTR "... done.",
+             hashprime * GHASHGROUP) ;
      lifestatus(statusline) ;
    }
 }
+/*
+ *   Put a ghnode in the first free slot of its probe sequence, and
+ *   return the group it went to.  This does not count it in hashpop.
+ */
+g_uintptr_t ghashbase::hashinsert(ghnode *n, g_uintptr_t h) {
+   g_uintptr_t g = HASHMOD(h) ;
+   for (;;) {
+      ghashgroup *grp = hashtab + g ;
+      hashtagword m = tagfree(grp->tags) & TAGSUSED ;
+      if (m) {
+         int i = tagindex(m) ;
+         if (tagat(grp->tags, i) == HASHTAGDEAD)
+            hashdead-- ;
+         grp->tags = tagset(grp->tags, i, hashtag(h)) ;
+         grp->slot[i] = n ;
+         return g ;
+      }
+      if (++g == hashprime)
+         g = 0 ;
+   }
+}
+/*
+ *   Leave a tombstone in the slot of the old table at pp.
+ */
+static void killslot(ghashgroup *tab, ghnode **pp) {
+   ghashgroup *grp = tab + ((char *)pp - (char *)tab) / sizeof(ghashgroup) ;
+   grp->tags = tagset(grp->tags, (int)(pp - grp->slot), HASHTAGDEAD) ;
+}
 /*
  *   These next two routines are (nearly) our only hash table access
  *   routines; we simply look up the passed in information.  If we
@@ -136,20 +231,29 @@ void ghashbase::resize() {
  *   new ghnode and store it in the hash table, and return that.
  */
 ghnode *ghashbase::find_ghnode(ghnode *nw, ghnode *ne, ghnode *sw, ghnode *se) {
-   ghnode *p ;
    g_uintptr_t h = ghnode_hash(nw,ne,sw,se) ;
-   ghnode *pred = 0 ;
-   h = HASHMOD(h) ;
-   for (p=hashtab[h]; p; p = p->next) { /* make sure to compare nw *first* */
-      if (nw == p->nw && ne == p->ne && sw == p->sw && se == p->se) {
-         if (pred) { /* move this one to the front */
-            pred->next = p->next ;
-            p->next = hashtab[h] ;
-            hashtab[h] = p ;
-         }
+   ghnode **pp = probe_ghnode(hashtab, hashprime, HASHMOD(h), hashtag(h),
+                              nw, ne, sw, se) ;
+   if (pp)
+      return save(*pp) ;
+   return find_ghnode_miss(nw, ne, sw, se, h) ;
+}
+/*
+ *   Not in the table; it may still be in the old one if a resize is
+ *   under way.
+ */
+ghnode *ghashbase::find_ghnode_miss(ghnode *nw, ghnode *ne, ghnode *sw,
+                                    ghnode *se, g_uintptr_t h) {
+   ghnode *p ;
+   if (oldtab) {
+      ghnode **pp = probe_ghnode(oldtab, oldprime, OLDHASHMOD(h), hashtag(h),
+                                 nw, ne, sw, se) ;
+      if (pp) {
+         killslot(oldtab, pp) ;
+         p = *pp ;
+         hashinsert(p, h) ;
          return save(p) ;
       }
-      pred = p ;
    }
    p = newghnode() ;
    p->nw = nw ;
@@ -157,46 +261,65 @@ ghnode *ghashbase::find_ghnode(ghnode *nw, ghnode *ne, ghnode *sw, ghnode *se) {
    p->sw = sw ;
    p->se = se ;
    p->res = 0 ;
-   p->next = hashtab[h] ;
-   hashtab[h] = p ;
+   g_uintptr_t g = hashinsert(p, h) ;
+   if (gcphase)
+      gcnewghnode(p, g) ;
    hashpop++ ;
    save(p) ;
-   if (hashpop > hashlimit)
+   if (hashpop + hashdead > hashlimit)
       resize() ;
+   else if (oldtab)
+      migrate(MIGRATEGROUPS) ;
    return p ;
 }
-ghleaf *ghashbase::find_ghleaf(state nw, state ne, state sw, state se) {
+ghleaf *ghashbase::find_ghleaf(const state *c) {
    ghleaf *p ;
-   ghleaf *pred = 0 ;
-   g_uintptr_t h = ghleaf_hash(nw, ne, sw, se) ;
-   h = HASHMOD(h) ;
-   for (p=(ghleaf *)hashtab[h]; p; p = (ghleaf *)p->next) {
-      if (nw == p->nw && ne == p->ne && sw == p->sw && se == p->se &&
-          !is_ghnode(p)) {
-         if (pred) {
-            pred->next = p->next ;
-            p->next = hashtab[h] ;
-            hashtab[h] = (ghnode *)p ;
-         }
+   g_uintptr_t h = ghleaf_hash(c) ;
+   ghnode **pp = probe_ghleaf(hashtab, hashprime, HASHMOD(h), hashtag(h), c) ;
+   if (pp)
+      return (ghleaf *)save(*pp) ;
+   if (oldtab) {
+      pp = probe_ghleaf(oldtab, oldprime, OLDHASHMOD(h), hashtag(h), c) ;
+      if (pp) {
+         killslot(oldtab, pp) ;
+         p = (ghleaf *)*pp ;
+         hashinsert((ghnode *)p, h) ;
          return (ghleaf *)save((ghnode *)p) ;
       }
-      pred = p ;
    }
    p = newghleaf() ;
-   p->nw = nw ;
-   p->ne = ne ;
-   p->sw = sw ;
-   p->se = se ;
-   p->leafpop = bigint((short)((nw != 0) + (ne != 0) + (sw != 0) + (se != 0))) ;
+   memcpy(p->c, c, GLEAFCELLS) ;
+   short pop = 0 ;
+   for (int i=0; i<GLEAFCELLS; i++)
+      pop += (c[i] != 0) ;
+   p->leafpop = bigint(pop) ;
    p->isghnode = 0 ;
-   p->next = hashtab[h] ;
-   hashtab[h] = (ghnode *)p ;
+   g_uintptr_t g = hashinsert((ghnode *)p, h) ;
+   if (gcphase)
+      gcnewghnode((ghnode *)p, g) ;
    hashpop++ ;
    save((ghnode *)p) ;
-   if (hashpop > hashlimit)
+   if (hashpop + hashdead > hashlimit)
       resize() ;
+   else if (oldtab)
+      migrate(MIGRATEGROUPS) ;
    return p ;
 }
+/*
+ *   The leaf made of the inner quadrants of four leaves, that is, the
+ *   center of the 8x8 block they make up.
+ */
+ghleaf *ghashbase::center_ghleaf(ghleaf *nw, ghleaf *ne, ghleaf *sw,
+                                 ghleaf *se) {
+   state c[GLEAFCELLS] ;
+   for (int i=0; i<2; i++) {
+      memcpy(c + 4 * i, nw->c + 4 * i + 10, 2) ;
+      memcpy(c + 4 * i + 2, ne->c + 4 * i + 8, 2) ;
+      memcpy(c + 4 * i + 8, sw->c + 4 * i + 2, 2) ;
+      memcpy(c + 4 * i + 10, se->c + 4 * i, 2) ;
+   }
+   return find_ghleaf(c) ;
+}
 /*
  *   The following routine does the same, but first it checks to see if
  *   the cached result is any good.  If it is, it directly returns that.
@@ -230,13 +353,14 @@ ghnode *ghashbase::getres(ghnode *n, int depth) {
        res = dorecurs(n->nw, n->ne, n->sw, n->se, depth) ;
      } else {
        res = (ghnode *)dorecurs_ghleaf((ghleaf *)n->nw, (ghleaf *)n->ne,
-                                       (ghleaf *)n->sw, (ghleaf *)n->se) ;
+                                       (ghleaf *)n->sw, (ghleaf *)n->se, 2) ;
      }
    } else {
      if (is_ghnode(n->nw)) {
        res = dorecurs_half(n->nw, n->ne, n->sw, n->se, depth) ;
      } else {
-       lifefatal("! can't happen") ;
+       res = (ghnode *)dorecurs_ghleaf((ghleaf *)n->nw, (ghleaf *)n->ne,
+                                       (ghleaf *)n->sw, (ghleaf *)n->se, 1) ;
      }
    }
    pop(sp) ;
@@ -246,6 +370,8 @@ ghnode *ghashbase::getres(ghnode *n, int depth) {
      if (ngens < depth && halvesdone < 1000)
        halvesdone++ ;
      n->res = res ;
+     if (gcphase == 1) // n may already have been scanned
+       shade(res) ;
    }
    return res ;
 }
@@ -259,33 +385,11 @@ void ghashbase::setupprefetch(ghsetup_t &su, ghnode *nw, ghnode *ne, ghnode *sw,
    su.prefetch(hashtab + HASHMOD(su.h)) ;
 }
 ghnode *ghashbase::find_ghnode(ghsetup_t &su) {
-   ghnode *p ;
-   ghnode *pred = 0 ;
-   g_uintptr_t h = HASHMOD(su.h) ;
-   for (p=hashtab[h]; p; p = p->next) { /* make sure to compare nw *first* */
-      if (su.nw == p->nw && su.ne == p->ne && su.sw == p->sw && su.se == p->se) {
-         if (pred) { /* move this one to the front */
-            pred->next = p->next ;
-            p->next = hashtab[h] ;
-            hashtab[h] = p ;
-         }
-         return save(p) ;
-      }
-      pred = p ;
-   }
-   p = newghnode() ;
-   p->nw = su.nw ;
-   p->ne = su.ne ;
-   p->sw = su.sw ;
-   p->se = su.se ;
-   p->res = 0 ;
-   p->next = hashtab[h] ;
-   hashtab[h] = p ;
-   hashpop++ ;
-   save(p) ;
-   if (hashpop > hashlimit)
-      resize() ;
-   return p ;
+   ghnode **pp = probe_ghnode(hashtab, hashprime, HASHMOD(su.h), hashtag(su.h),
+                              su.nw, su.ne, su.sw, su.se) ;
+   if (pp)
+      return save(*pp) ;
+   return find_ghnode_miss(su.nw, su.ne, su.sw, su.se, su.h) ;
 }
 ghnode *ghashbase::dorecurs(ghnode *n, ghnode *ne, ghnode *t, ghnode *e, int depth) {
    int sp = gsp ;
@@ -359,7 +463,7 @@ ghnode *ghashbase::dorecurs(ghnode *n, ghnode *ne, ghnode *t,
 ghnode *ghashbase::dorecurs_half(ghnode *n, ghnode *ne, ghnode *t,
                                ghnode *e, int depth) {
    int sp = gsp ;
-   if (depth > 1) {
+   if (depth > 2) {
       ghnode
       *t00 = find_ghnode(n->nw->se, n->ne->sw, n->sw->ne, n->se->nw),
       *t01 = find_ghnode(n->ne->se, ne->nw->sw, n->se->ne, ne->sw->nw),
@@ -385,47 +489,115 @@ ghnode *ghashbase::dorecurs_half(ghnode *n, ghnode *ne, ghnode *t,
       *t20 = getres(t, depth),
       *t21 = getres(find_ghnode(t->ne, e->nw, t->se, e->sw), depth),
       *t22 = getres(e, depth) ;
-      n = find_ghnode((ghnode *)find_ghleaf(((ghleaf *)t00)->se,
-                                             ((ghleaf *)t01)->sw,
-                                             ((ghleaf *)t10)->ne,
-                                             ((ghleaf *)t11)->nw),
-                    (ghnode *)find_ghleaf(((ghleaf *)t01)->se,
-                                             ((ghleaf *)t02)->sw,
-                                             ((ghleaf *)t11)->ne,
-                                             ((ghleaf *)t12)->nw),
-                    (ghnode *)find_ghleaf(((ghleaf *)t10)->se,
-                                             ((ghleaf *)t11)->sw,
-                                             ((ghleaf *)t20)->ne,
-                                             ((ghleaf *)t21)->nw),
-                    (ghnode *)find_ghleaf(((ghleaf *)t11)->se,
-                                             ((ghleaf *)t12)->sw,
-                                             ((ghleaf *)t21)->ne,
-                                             ((ghleaf *)t22)->nw)) ;
+      n = find_ghnode((ghnode *)center_ghleaf((ghleaf *)t00, (ghleaf *)t01,
+                                              (ghleaf *)t10, (ghleaf *)t11),
+                      (ghnode *)center_ghleaf((ghleaf *)t01, (ghleaf *)t02,
+                                              (ghleaf *)t11, (ghleaf *)t12),
+                      (ghnode *)center_ghleaf((ghleaf *)t10, (ghleaf *)t11,
+                                              (ghleaf *)t20, (ghleaf *)t21),
+                      (ghnode *)center_ghleaf((ghleaf *)t11, (ghleaf *)t12,
+                                              (ghleaf *)t21, (ghleaf *)t22)) ;
    }
    pop(sp) ;
    return save(n) ;
 }
 /*
- *   If the ghnode is a 16-ghnode, then the constituents are leaves, so we
- *   need a very similar but still somewhat different subroutine.  Since
- *   we do not (yet) garbage collect leaves, we don't need all that
- *   save/pop mumbo-jumbo.
+ *   If the ghnode is an 8x8 ghnode, then the constituents are leaves, so
+ *   we need a very similar but still somewhat different subroutine.  We
+ *   copy the leaves into one 8x8 block and run the whole block forward
+ *   one or two generations, giving the 4x4 center, without making any
+ *   of the intermediate ghnodes dorecurs() would.  The block goes
+ *   forward a 2x2 piece at a time, from the 4x4 block around it; these
+ *   repeat so much that we keep the answers for them in calccache and
+ *   only call slowcalcblock() for the ones we don't have.  Since
+ *   nothing here can be collected, we don't need all that save/pop
+ *   mumbo-jumbo.
  */
+void ghashbase::calcwindow(const state *in, int stride, state *out,
+                           int ostride, int phase) {
+   state c[GLEAFCELLS] ;
+   for (int i=0; i<4; i++)
+      memcpy(c + 4 * i, in + i * stride, 4) ;
+   ghcalcentry *e = calccache +
+                    ((ghleaf_hash(c) + phase) & ((1 << logcalccache) - 1)) ;
+   if (e->used != phase + 1 || memcmp(e->c, c, GLEAFCELLS) != 0) {
+      memcpy(e->c, c, GLEAFCELLS) ;
+      calcphase = phase ;
+      slowcalcblock(c, 4, e->res, 2) ;
+      e->used = phase + 1 ;
+   }
+   out[0] = e->res[0] ;
+   out[1] = e->res[1] ;
+   out[ostride] = e->res[2] ;
+   out[ostride+1] = e->res[3] ;
+}
+/*
+ *   When the hash grows, give calccache an entry for every
+ *   CALCCACHERATIO slots in it; the answers in the old table are just
+ *   dropped.
+ */
+void ghashbase::growcalccache() {
+   int newlog = logcalccache ;
+   while (newlog < MAXLOGCALCCACHE &&
+          hashprime * GHASHGROUP > ((g_uintptr_t)CALCCACHERATIO << newlog))
+      newlog++ ;
+   ghcalcentry *newcache = (ghcalcentry *)calloc((size_t)1 << newlog,
+                                                 sizeof(ghcalcentry)) ;
+   if (newcache == 0)
+      return ; // no matter; the one we have still works
+   free(calccache) ;
+   alloced -= sizeof(ghcalcentry) << logcalccache ;
+   calccache = newcache ;
+   logcalccache = newlog ;
+   alloced += sizeof(ghcalcentry) << logcalccache ;
+}
 ghleaf *ghashbase::dorecurs_ghleaf(ghleaf *nw, ghleaf *ne, ghleaf *sw,
-                                   ghleaf *se) {
-   return find_ghleaf(
-             slowcalc(nw->nw, nw->ne, ne->nw,
-                      nw->sw, nw->se, ne->sw,
-                      sw->nw, sw->ne, se->nw),
-             slowcalc(nw->ne, ne->nw, ne->ne,
-                      nw->se, ne->sw, ne->se,
-                      sw->ne, se->nw, se->ne),
-             slowcalc(nw->sw, nw->se, ne->sw,
-                      sw->nw, sw->ne, se->nw,
-                      sw->sw, sw->se, se->sw),
-             slowcalc(nw->se, ne->sw, ne->se,
-                      sw->ne, se->nw, se->ne,
-                      sw->se, se->sw, se->se)) ;
+                                   ghleaf *se, int gens) {
+   state in[64], mid[36], out[GLEAFCELLS] ;
+   int i, j ;
+   for (i=0; i<4; i++) {
+      memcpy(in + 8 * i, nw->c + 4 * i, 4) ;
+      memcpy(in + 8 * i + 4, ne->c + 4 * i, 4) ;
+      memcpy(in + 8 * i + 32, sw->c + 4 * i, 4) ;
+      memcpy(in + 8 * i + 36, se->c + 4 * i, 4) ;
+   }
+   /*
+    *   Leaves start at an even x (and odd y), so the windows on in start
+    *   at even x and those on mid at odd x; every leaf calculation starts
+    *   at a generation with the parity of the one runpattern() began at.
+    */
+   int phase = (phased ? 2 * phaseparity : 0) ;
+   if (gens == 2) {
+      for (i=0; i<3; i++)
+         for (j=0; j<3; j++)
+            calcwindow(in + 16 * i + 2 * j, 8, mid + 12 * i + 2 * j, 6,
+                       phase) ;
+      if (phased)
+         phase = (phase ^ 2) | 1 ;
+      for (i=0; i<2; i++)
+         for (j=0; j<2; j++)
+            calcwindow(mid + 12 * i + 2 * j, 6, out + 8 * i + 2 * j, 4,
+                       phase) ;
+   } else {
+      if (phased)
+         phase |= 1 ;
+      for (i=0; i<2; i++)
+         for (j=0; j<2; j++)
+            calcwindow(in + 9 + 16 * i + 2 * j, 8, out + 8 * i + 2 * j, 4,
+                       phase) ;
+   }
+   return find_ghleaf(out) ;
+}
+void ghashbase::slowcalcblock(const state *in, int stride, state *out,
+                              int n) {
+   for (int y=0; y<n; y++) {
+      const state *a = in + y * stride ;
+      const state *b = a + stride ;
+      const state *c = b + stride ;
+      for (int x=0; x<n; x++, a++, b++, c++)
+         *out++ = slowcalc(a[0], a[1], a[2], b[0], b[1], b[2],
+                           c[0], c[1], c[2]) ;
+   }
 }
 /*
  *   We keep free ghnodes in a linked list for allocation, and we allocate
@@ -433,6 +605,8 @@ ghleaf *ghashbase::dorecurs_ghleaf(ghleaf *nw, ghleaf *ne, ghleaf *sw,
  */
 ghnode *ghashbase::newghnode() {
    ghnode *r ;
+   if (gcphase && okaytogc && --gccountdown <= 0)
+      gcslice() ;
    if (freeghnodes == 0) {
       int i ;
       freeghnodes = (ghnode *)calloc(1001, sizeof(ghnode)) ;
@@ -447,9 +621,16 @@ ghnode *ghashbase::newghnode() {
       }
       totalthings += 1000 ;
    }
-   if (freeghnodes->next == 0 && alloced + 1000 * sizeof(ghnode) > maxmem &&
-       okaytogc) {
-      do_gc(0) ;
+   if (freeghnodes->next == 0 && okaytogc) {
+      if (!incrementalgc) {
+         if (alloced + 1000 * sizeof(ghnode) > maxmem)
+            do_gc(0) ;
+      } else if (gcphase) {
+         if (alloced + 1000 * sizeof(ghnode) > maxmem)
+            gcreclaim() ;
+      } else if (alloced + 1000 * sizeof(ghnode) > maxmem - (maxmem >> 3)) {
+         startgc() ;
+      }
    }
    r = freeghnodes ;
    freeghnodes = freeghnodes->next ;
@@ -476,16 +657,25 @@ ghleaf *ghashbase::newclearedghleaf() {
    return r ;
 }
 ghashbase::ghashbase() {
-   hashprime = nexthashsize(1000) ;
+   hashprime = nexthashsize(1000 / GHASHGROUP) ;
 #ifndef PRIMEMOD
    hashmask = hashprime - 1 ;
 #endif
-   hashlimit = (g_uintptr_t)(maxloadfactor * hashprime) ;
+   hashlimit = (g_uintptr_t)(maxloadfactor * hashprime * GHASHGROUP) ;
    hashpop = 0 ;
-   hashtab = (ghnode **)calloc(hashprime, sizeof(ghnode *)) ;
+   hashdead = 0 ;
+   hashfull = 0 ;
+   hashtab = (ghashgroup *)linecalloc(hashprime * sizeof(ghashgroup)) ;
    if (hashtab == 0)
      lifefatal("Out of memory (1).") ;
-   alloced = hashprime * sizeof(ghnode *) ;
+   alloced = hashprime * sizeof(ghashgroup) ;
+   oldtab = 0 ;
+   logcalccache = MINLOGCALCCACHE ;
+   calccache = (ghcalcentry *)calloc((size_t)1 << logcalccache,
+                                     sizeof(ghcalcentry)) ;
+   if (calccache == 0)
+     lifefatal("Out of memory (1).") ;
+   alloced += sizeof(ghcalcentry) << logcalccache ;
    ngens = 0 ;
    stacksize = 0 ;
    halvesdone = 0 ;
@@ -498,8 +688,9 @@ ghashbase::ghashbase() {
    totalthings = 0 ;
    ghnodeblocks = 0 ;
    zeroghnodea = 0 ;
+   wraproot = 0 ;
 /*
- *   We initialize our universe to be a 16-square.  We are in drawing
+ *   We initialize our universe to be an 8-square.  We are in drawing
  *   mode at this point.
  */
    root = (ghnode *)newclearedghnode() ;
@@ -510,24 +701,35 @@ ghashbase::ghashbase() {
    nonpow2 = 1 ;
    pow2step = 1 ;
    llsize = 0 ;
-   depth = 1 ;
+   depth = 2 ;
    hashed = 0 ;
    popValid = 0 ;
    needPop = 0 ;
    inGC = 0 ;
    cacheinvalid = 0 ;
+   phased = 0 ;
+   calcphase = 0 ;
+   phaseparity = 0 ;
    gccount = 0 ;
    gcstep = 0 ;
    running_hperf.clear() ;
    inc_hperf = running_hperf ;
    step_hperf = running_hperf ;
    softinterrupt = 0 ;
+   gcphase = 0 ;
+   graystack = 0 ;
+   graysp = 0 ;
+   graysize = 0 ;
+   gcpauses.clear() ;
 }
 /**
  *   Destructor frees memory.
  */
 ghashbase::~ghashbase() {
-   free(hashtab) ;
+   releasesnapshots() ;
+   linefree(hashtab) ;
+   linefree(oldtab) ;
+   free(calccache) ;
    while (ghnodeblocks) {
       ghnode *r = ghnodeblocks ;
       ghnodeblocks = ghnodeblocks->next ;
@@ -537,6 +739,8 @@ ghashbase::~ghashbase() {
       free(zeroghnodea) ;
    if (stack)
       free(stack) ;
+   if (graystack)
+      free(graystack) ;
    if (llsize) {
       delete [] llxb ;
       delete [] llyb ;
@@ -624,7 +828,8 @@ void ghashbase::setMaxMemory(int newmemlimit) {
       return ;
    }
    maxmem = newlimit ;
-   hashlimit = (g_uintptr_t)(maxloadfactor * hashprime) ;
+   hashfull = 0 ;
+   hashlimit = (g_uintptr_t)(maxloadfactor * hashprime * GHASHGROUP) ;
 }
 /**
  *   Clear everything.
@@ -657,7 +862,7 @@ void ghashbase::pushroot_1() {
  *   Return the depth of this ghnode (2 is 8x8).
  */
 int ghashbase::ghnode_depth(ghnode *n) {
-   int depth = 0 ;
+   int depth = 1 ;
    while (is_ghnode(n)) {
       depth++ ;
       n = n->nw ;
@@ -680,8 +885,10 @@ ghnode *ghashbase::zeroghnode(int depth) {
          zeroghnodea[nzeros++] = 0 ;
    }
    if (zeroghnodea[depth] == 0) {
-      if (depth == 0) {
-         zeroghnodea[depth] = (ghnode *)find_ghleaf(0, 0, 0, 0) ;
+      if (depth == 1) {
+         state c[GLEAFCELLS] ;
+         memset(c, 0, sizeof(c)) ;
+         zeroghnodea[depth] = (ghnode *)find_ghleaf(c) ;
       } else {
          ghnode *z = zeroghnode(depth-1) ;
          zeroghnodea[depth] = find_ghnode(z, z, z, z) ;
@@ -690,11 +897,28 @@ ghnode *ghashbase::zeroghnode(int depth) {
    return zeroghnodea[depth] ;
 }
 /*
- *   Same, but with hashed ghnodes.
+ *   Same, but with hashed ghnodes.  A leaf (which we can only get as a
+ *   root from a tiny macrocell file) is split into the inner corners of
+ *   four new leaves.
  */
 ghnode *ghashbase::pushroot(ghnode *n) {
    int depth = ghnode_depth(n) ;
    zeroghnode(depth+1) ; // ensure zeros are deep enough
+   if (depth == 1) {
+      ghleaf *l = (ghleaf *)n ;
+      ghleaf *q[4] ;
+      for (int k=0; k<4; k++) {
+         state c[GLEAFCELLS] ;
+         memset(c, 0, sizeof(c)) ;
+         int from = 2 * (k & 1) + 8 * (k >> 1) ;
+         int to = 10 - from ;
+         memcpy(c + to, l->c + from, 2) ;
+         memcpy(c + to + 4, l->c + from + 4, 2) ;
+         q[k] = find_ghleaf(c) ;
+      }
+      return find_ghnode((ghnode *)q[0], (ghnode *)q[1],
+                         (ghnode *)q[2], (ghnode *)q[3]) ;
+   }
    ghnode *z = zeroghnode(depth-1) ;
    return find_ghnode(find_ghnode(z, z, z, n->nw),
                     find_ghnode(z, z, n->ne, z),
@@ -712,35 +936,16 @@ ghnode *ghashbase::pushroot(ghnode *n) {
  *   the ghnodes can be null.  We'll patch this up in due course.
  */
 ghnode *ghashbase::gsetbit(ghnode *n, int x, int y, int newstate, int depth) {
-   if (depth == 0) {
+   if (depth == 1) {
       ghleaf *l = (ghleaf *)n ;
+      int i = (1 - y) * GLEAFSIZE + x + 2 ;
       if (hashed) {
-         state nw = l->nw ;
-         state sw = l->sw ;
-         state ne = l->ne ;
-         state se = l->se ;
-         if (x < 0)
-           if (y < 0)
-             sw = (state)newstate ;
-           else
-             nw = (state)newstate ;
-         else
-           if (y < 0)
-             se = (state)newstate ;
-           else
-             ne = (state)newstate ;
-         return save((ghnode *)find_ghleaf(nw, ne, sw, se)) ;
+         state c[GLEAFCELLS] ;
+         memcpy(c, l->c, GLEAFCELLS) ;
+         c[i] = (state)newstate ;
+         return save((ghnode *)find_ghleaf(c)) ;
       }
-      if (x < 0)
-        if (y < 0)
-          l->sw = (state)newstate ;
-        else
-          l->nw = (state)newstate ;
-      else
-        if (y < 0)
-          l->se = (state)newstate ;
-        else
-          l->ne = (state)newstate ;
+      l->c[i] = (state)newstate ;
       return (ghnode *)l ;
    } else {
       unsigned int w = 0, wh = 0 ;
@@ -780,7 +985,7 @@ ghnode *ghashbase::gsetbit(ghnode *n, int x, int y, int newstate, int depth) {
          }
       }
       if (*nptr == 0) {
-         if (depth == 0)
+         if (depth == 1)
             *nptr = (ghnode *)newclearedghleaf() ;
          else
             *nptr = newclearedghnode() ;
@@ -825,18 +1030,8 @@ int ghashbase::getbit(ghnode *n, int x, int y, int depth) {
       n = &tnode ;
       depth-- ;
    }
-   if (depth == 0) {
-      ghleaf *l = (ghleaf *)n ;
-      if (x < 0)
-         if (y < 0)
-           return l->sw ;
-         else
-           return l->nw ;
-      else
-         if (y < 0)
-           return l->se ;
-         else
-           return l->ne ;
+   if (depth == 1) {
+      return ((ghleaf *)n)->c[(1 - y) * GLEAFSIZE + x + 2] ;
    } else {
       unsigned int w = 0, wh = 0 ;
       if (depth >= 32) {
@@ -873,27 +1068,13 @@ int ghashbase::getbit(ghnode *n, int x, int y, int depth) {
 int ghashbase::nextbit(ghnode *n, int x, int y, int depth, int &v) {
    if (n == 0 || n == zeroghnode(depth))
       return -1 ;
-   if (depth == 0) {
-      ghleaf *l = (ghleaf *)n ;
-      if (y < 0) {
-        if (x < 0 && l->sw) {
-          v = l->sw ;
-          return 0 ;
-        }
-        if (l->se) {
-          v = l->se ;
-          return -x ;
-        }
-      } else {
-        if (x < 0 && l->nw) {
-          v = l->nw ;
-          return 0 ;
-        }
-        if (l->ne) {
-          v = l->ne ;
-          return -x ;
-        }
-      }
+   if (depth == 1) {
+      const state *row = ((ghleaf *)n)->c + (1 - y) * GLEAFSIZE + 2 ;
+      for (int i=x; i<2; i++)
+         if (row[i]) {
+            v = row[i] ;
+            return i - x ;
+         }
       return -1 ; // none found
    } else {
       unsigned int w = 1 << depth ;
@@ -1024,6 +1205,90 @@ int ghashbase::nextcell(int x, int y, int &v) {
    }
    return nextbit(root, x, y, depth, v) ;
 }
+/*
+ *   Runs of live cells in a rectangle, in one pass over the tree, a
+ *   band of rows at a time just as in hlifealgo.  y increases downward
+ *   here.
+ */
+struct ghcellband {
+   ghnode *n ;
+   int x ;     // left edge
+} ;
+void ghashbase::bandruns(const vector<ghcellband> &band, int y, int depth,
+                         int top, int left, int bottom, int right,
+                         vector<cellspan> &spans) {
+   if (depth == 1) {
+      for (int r=0; r<GLEAFSIZE; r++) {
+         if (y + r < top || y + r > bottom)
+            continue ;
+         for (int i=0; i<(int)band.size(); i++) {
+            const state *row = ((ghleaf *)band[i].n)->c + r * GLEAFSIZE ;
+            int x = band[i].x ;
+            for (int j=0; j<GLEAFSIZE; j++) {
+               if (row[j] == 0 || x + j < left || x + j > right)
+                  continue ;
+               if (!spans.empty() && spans.back().y == y + r &&
+                   spans.back().state == row[j] &&
+                   spans.back().x + spans.back().n == x + j) {
+                  spans.back().n++ ;
+               } else {
+                  cellspan s = { x + j, y + r, 1, row[j] } ;
+                  spans.push_back(s) ;
+               }
+            }
+         }
+      }
+      return ;
+   }
+   int half = 1 << depth ;
+   depth-- ;
+   ghnode *z = zeroghnode(depth) ;
+   vector<ghcellband> sub ;
+   for (int s=0; s<2; s++) {
+      int yy = y + s * half ;
+      if (yy > bottom || yy + (half - 1) < top)
+         continue ;
+      sub.clear() ;
+      for (int i=0; i<(int)band.size(); i++) {
+         ghnode *w = s ? band[i].n->sw : band[i].n->nw ;
+         ghnode *e = s ? band[i].n->se : band[i].n->ne ;
+         int x = band[i].x ;
+         if (w && w != z && x <= right && x + (half - 1) >= left) {
+            ghcellband b = { w, x } ;
+            sub.push_back(b) ;
+         }
+         x += half ;
+         if (e && e != z && x <= right && x + (half - 1) >= left) {
+            ghcellband b = { e, x } ;
+            sub.push_back(b) ;
+         }
+      }
+      if (!sub.empty())
+         bandruns(sub, yy, depth, top, left, bottom, right, spans) ;
+   }
+}
+void ghashbase::getcellruns(int top, int left, int bottom, int right,
+                            vector<cellspan> &spans) {
+   if (root == 0 || root == zeroghnode(depth))
+      return ;
+   struct ghnode tghnode = *root ;
+   int mdepth = depth ;
+   while (mdepth > 30) {
+      tghnode.nw = tghnode.nw->se ;
+      tghnode.ne = tghnode.ne->sw ;
+      tghnode.sw = tghnode.sw->ne ;
+      tghnode.se = tghnode.se->nw ;
+      mdepth-- ;
+   }
+   int x = -(1 << mdepth), y = 1 - (1 << mdepth) ;
+   if (top > y + ((1 << mdepth) - 1) * 2 + 1 || bottom < y ||
+       left > x + ((1 << mdepth) - 1) * 2 + 1 || right < x)
+      return ;
+   vector<ghcellband> band ;
+   ghcellband b = { &tghnode, x } ;
+   band.push_back(b) ;
+   bandruns(band, y, mdepth, top, left, bottom, right, spans) ;
+}
 /*
  *   Canonicalize a universe by filling in the null pointers and then
  *   invoking find_ghnode on each ghnode.  Drops the original universe on
@@ -1033,10 +1298,9 @@ ghnode *ghashbase::hashpattern(ghnode *root, int depth) {
    ghnode *r ;
    if (root == 0) {
       r = zeroghnode(depth) ;
-   } else if (depth == 0) {
-      ghleaf *n = (ghleaf *)root ;
-      r = (ghnode *)find_ghleaf(n->nw, n->ne, n->sw, n->se) ;
-      n->next = freeghnodes ;
+   } else if (depth == 1) {
+      r = (ghnode *)find_ghleaf(((ghleaf *)root)->c) ;
+      root->next = freeghnodes ;
       freeghnodes = root ;
    } else {
       depth-- ;
@@ -1069,7 +1333,7 @@ void ghashbase::ensure_hashed() {
  */
 ghnode *ghashbase::popzeros(ghnode *n) {
    int depth = ghnode_depth(n) ;
-   while (depth > 1) {
+   while (depth > 2) {
       ghnode *z = zeroghnode(depth-2) ;
       if (n->nw->nw == z && n->nw->ne == z && n->nw->sw == z &&
           n->ne->nw == z && n->ne->ne == z && n->ne->se == z &&
@@ -1099,47 +1363,59 @@ ghnode *ghashbase::popzeros(ghnode *n) {
  */
 #define marked2(n) (3 & (g_uintptr_t)(n)->res)
 #define mark2(n) ((n)->res = (ghnode *)(1 | (g_uintptr_t)(n)->res))
-#define mark2v(n, v) ((n)->res = (ghnode *)(v | (g_uintptr_t)(n)->res))
 #define clearmark2(n) ((n)->res = (ghnode *)(~3 & (g_uintptr_t)(n)->res))
-void ghashbase::unhash_ghnode(ghnode *n) {
-   ghnode *p ;
-   g_uintptr_t h = ghnode_hash(n->nw,n->ne,n->sw,n->se) ;
-   ghnode *pred = 0 ;
-   h = HASHMOD(h) ;
-   for (p=hashtab[h]; (!is_ghnode(p) || !marked2(p)) && p; p = p->next) {
-      if (p == n) {
-         if (pred)
-            pred->next = p->next ;
-         else
-            hashtab[h] = p->next ;
-         return ;
+/*
+ *   An incremental collection may be under way while we compute the
+ *   population, so next can carry a mark bit.  We park the collector's
+ *   mark in bit 2 of res while next holds the population, and put it
+ *   back afterwards.
+ */
+#define gcmarked2(n) (4 & (g_uintptr_t)(n)->res)
+#define gcmark2(n) ((n)->res = (ghnode *)(4 | (g_uintptr_t)(n)->res))
+#define cleargcmark2(n) ((n)->res = (ghnode *)(~4 & (g_uintptr_t)(n)->res))
+/*
+ *   Find the slot holding the given ghnode or ghleaf, starting from
+ *   group g of the given table (these need the mark macros, so they
+ *   live down here).  While a sweep is under way, unmarked ghnodes in
+ *   groups not yet swept are garbage (their children may already be
+ *   gone), so we skip them.
+ */
+ghnode **ghashbase::probe_ghnode(ghashgroup *tab, g_uintptr_t groups,
+                                 g_uintptr_t g, unsigned int tag,
+                                 ghnode *nw, ghnode *ne, ghnode *sw,
+                                 ghnode *se) {
+   for (;;) {
+      hashtagword t = tab[g].tags ;
+      for (hashtagword m = tagmatch(t, tag) ; m ; m &= m - 1) {
+         ghnode **pp = tab[g].slot + tagindex(m) ;
+         ghnode *p = *pp ;
+         if (nw == p->nw && ne == p->ne && sw == p->sw && se == p->se &&
+             (gcphase != 2 || g < sweepcursor || marked(p)))
+            return pp ;
       }
-      pred = p ;
-   }
-   lifefatal("Didn't find ghnode to unhash") ;
-}
-void ghashbase::unhash_ghnode2(ghnode *n) {
-   ghnode *p ;
-   g_uintptr_t h = ghnode_hash(n->nw,n->ne,n->sw,n->se) ;
-   ghnode *pred = 0 ;
-   h = HASHMOD(h) ;
-   for (p=hashtab[h]; p; p = p->next) {
-      if (p == n) {
-         if (pred)
-            pred->next = p->next ;
-         else
-            hashtab[h] = p->next ;
-         return ;
+      if (tagzero(t) & TAGSUSED)
+         return 0 ;
+      if (++g == groups)
+         g = 0 ;
+   }
+}
+ghnode **ghashbase::probe_ghleaf(ghashgroup *tab, g_uintptr_t groups,
+                                 g_uintptr_t g, unsigned int tag,
+                                 const state *c) {
+   for (;;) {
+      hashtagword t = tab[g].tags ;
+      for (hashtagword m = tagmatch(t, tag) ; m ; m &= m - 1) {
+         ghnode **pp = tab[g].slot + tagindex(m) ;
+         ghleaf *p = (ghleaf *)*pp ;
+         if (!is_ghnode(p) && memcmp(p->c, c, GLEAFCELLS) == 0 &&
+             (gcphase != 2 || g < sweepcursor || marked(p)))
+            return pp ;
       }
-      pred = p ;
+      if (tagzero(t) & TAGSUSED)
+         return 0 ;
+      if (++g == groups)
+         g = 0 ;
    }
-   lifefatal("Didn't find ghnode to unhash") ;
-}
-void ghashbase::rehash_ghnode(ghnode *n) {
-   g_uintptr_t h = ghnode_hash(n->nw,n->ne,n->sw,n->se) ;
-   h = HASHMOD(h) ;
-   n->next = hashtab[h] ;
-   hashtab[h] = n ;
 }
 /*
  *   This recursive routine calculates the population by hanging the
@@ -1148,17 +1424,15 @@ void ghashbase::rehash_ghnode(ghnode *n) {
 const bigint &ghashbase::calcpop(ghnode *root, int depth) {
    if (root == zeroghnode(depth))
       return bigint::zero ;
-   if (depth == 0)
+   if (depth == 1)
       return ((ghleaf *)root)->leafpop ;
    if (marked2(root))
       return *(bigint*)&(root->next) ;
    depth-- ;
-   if (root->next == 0)
-      mark2v(root, 3) ;
-   else {
-      unhash_ghnode(root) ;
-      mark2(root) ;
-   }
+   int gcbit = marked(root) ;
+   mark2(root) ;
+   if (gcbit)
+      gcmark2(root) ;
 /**
  *   We use the memory in root->next as a value bigint.  But we want to
  *   make sure the copy constructor doesn't "clean up" something that
@@ -1170,37 +1444,36 @@ const bigint &ghashbase::calcpop(ghnode *root, int depth) {
    return *(bigint *)&(root->next) ;
 }
 /*
- *   Call this after doing something that unhashes ghnodes in order to
- *   use the next field as a temp pointer.
+ *   Call this after doing something that uses the next field as a
+ *   temp pointer.
  */
 void ghashbase::aftercalcpop2(ghnode *root, int depth) {
-   if (depth == 0 || root == zeroghnode(depth))
+   if (depth == 1 || root == zeroghnode(depth))
       return ;
-   int v = marked2(root) ;
-   if (v) {
+   if (marked2(root)) {
       clearmark2(root) ;
       depth-- ;
-      if (depth > 0) {
+      if (depth > 1) {
          aftercalcpop2(root->nw, depth) ;
          aftercalcpop2(root->ne, depth) ;
          aftercalcpop2(root->sw, depth) ;
          aftercalcpop2(root->se, depth) ;
       }
       ((bigint *)&(root->next))->~bigint() ;
-      if (v == 3)
-         root->next = 0 ;
-      else
-         rehash_ghnode(root) ;
+      int gcbit = gcmarked2(root) ;
+      cleargcmark2(root) ;
+      root->next = 0 ;
+      if (gcbit)
+         mark(root) ;
    }
 }
 /*
- *   Call this after doing something that unhashes ghnodes in order to
- *   use the next field as a temp pointer.
+ *   Call this after writing macrocell.
  */
 void ghashbase::afterwritemc(ghnode *root, int depth) {
    if (root == zeroghnode(depth))
       return ;
-   if (depth == 0) {
+   if (depth == 1) {
       root->nw = 0 ; // all these bigints are guaranteed to be small
       return ;
    }
@@ -1211,7 +1484,7 @@ void ghashbase::afterwritemc(ghnode *root, int depth) {
       afterwritemc(root->ne, depth) ;
       afterwritemc(root->sw, depth) ;
       afterwritemc(root->se, depth) ;
-      rehash_ghnode(root) ;
+      root->next = 0 ;
    }
 }
 /*
@@ -1290,6 +1563,12 @@ void ghashbase::do_gc(int invalidate) {
    int i ;
    g_uintptr_t freed_ghnodes=0 ;
    ghnode *p, *pp ;
+   if (gcphase) {
+      finishgc() ;
+      if (!invalidate)
+         return ;
+   }
+   gcpauses.start() ;
    inGC = 1 ;
    gccount++ ;
    gcstep++ ;
@@ -1312,23 +1591,23 @@ void ghashbase::do_gc(int invalidate) {
       gc_mark((ghnode *)stack[i], invalidate) ;
    }
    for (i=0; i<timeline.framecount; i++)
-      gc_mark((ghnode *)timeline.frames[i], invalidate) ;
+      if (timeline.frames[i])
+         gc_mark((ghnode *)timeline.frames[i], invalidate) ;
+   for (i=0; i<(int)snapshots.roots.size(); i++)
+      if (snapshots.roots[i])
+         gc_mark((ghnode *)snapshots.roots[i], invalidate) ;
    hashpop = 0 ;
-   memset(hashtab, 0, sizeof(ghnode *) * hashprime) ;
+   hashdead = 0 ;
+   if (oldtab)
+      endresize() ;
+   memset(hashtab, 0, sizeof(ghashgroup) * hashprime) ;
    freeghnodes = 0 ;
    for (p=ghnodeblocks; p; p=p->next) {
       poller->poll() ;
       for (pp=p+1, i=1; i<1001; i++, pp++) {
          if (marked(pp)) {
-            g_uintptr_t h = 0 ;
-            if (pp->nw) { /* yes, it's a ghnode */
-               h = HASHMOD(ghnode_hash(pp->nw, pp->ne, pp->sw, pp->se)) ;
-            } else {
-               ghleaf *lp = (ghleaf *)pp ;
-               h = HASHMOD(ghleaf_hash(lp->nw, lp->ne, lp->sw, lp->se)) ;
-            }
-            pp->next = hashtab[h] ;
-            hashtab[h] = pp ;
+            clearmark(pp) ;
+            hashinsert(pp, hashof(pp)) ;
             hashpop++ ;
          } else {
             pp->next = freeghnodes ;
@@ -1338,10 +1617,12 @@ void ghashbase::do_gc(int invalidate) {
       }
    }
    inGC = 0 ;
+   gcpauses.stop() ;
    if (verbose) {
      double perc = (double)freed_ghnodes / (double)totalthings * 100.0 ;
      sprintf(statusline+strlen(statusline), " freed %g percent (%" PRIuPTR ").",
                                                   perc, freed_ghnodes) ;
+     gcpauses.report(statusline, 200) ;
      lifestatus(statusline) ;
    }
    if (needPop) {
@@ -1351,6 +1632,176 @@ void ghashbase::do_gc(int invalidate) {
       poller->updatePop() ;
    }
 }
+/*
+ *   Incremental garbage collection works just as in hlifealgo: a
+ *   tricolor mark driven from newghnode, new ghnodes allocated gray,
+ *   newly cached results shaded by getres, the roots shaded again when
+ *   the gray stack empties, and then a sweep of the hash one group at
+ *   a time during which unmarked ghnodes in unswept groups are dead.
+ */
+int ghashbase::incrementalgc = 0 ;
+const int GCSLICEALLOCS = 128 ;
+void ghashbase::shade(ghnode *n) {
+   if (!marked(n)) {
+      mark(n) ;
+      if (is_ghnode(n)) {
+         if (graysp >= graysize) {
+            g_uintptr_t ngraysize = graysize * 2 + 1000 ;
+            alloced += sizeof(ghnode *) * (ngraysize - graysize) ;
+            graystack = (ghnode **)realloc(graystack,
+                                           ngraysize * sizeof(ghnode *)) ;
+            if (graystack == 0)
+               lifefatal("Out of memory (4).") ;
+            graysize = ngraysize ;
+         }
+         graystack[graysp++] = n ;
+      }
+   }
+}
+void ghashbase::shaderoots() {
+   int i ;
+   for (i=nzeros-1; i>=0; i--)
+      if (zeroghnodea[i] != 0)
+         break ;
+   if (i >= 0)
+      shade(zeroghnodea[i]) ;
+   if (root != 0)
+      shade(root) ;
+   for (i=0; i<gsp; i++)
+      shade(stack[i]) ;
+   for (i=0; i<timeline.framecount; i++)
+      if (timeline.frames[i])
+         shade((ghnode *)timeline.frames[i]) ;
+   for (i=0; i<(int)snapshots.roots.size(); i++)
+      if (snapshots.roots[i])
+         shade((ghnode *)snapshots.roots[i]) ;
+}
+/*
+ *   A ghnode just put in group g while a collection is under way.
+ */
+void ghashbase::gcnewghnode(ghnode *n, g_uintptr_t g) {
+   if (gcphase == 1)
+      shade(n) ;
+   else if (g >= sweepcursor)
+      mark(n) ;
+}
+void ghashbase::startgc() {
+   finishresize() ;
+   gccount++ ;
+   gcstep++ ;
+   if (verbose) {
+     if (gcstep > 1)
+       sprintf(statusline, "GC #%d(%d) started", gccount, gcstep) ;
+     else
+       sprintf(statusline, "GC #%d started", gccount) ;
+     lifestatus(statusline) ;
+   }
+   gcpauses.start() ;
+   gcphase = 1 ;
+   gcfreed = 0 ;
+   graysp = 0 ;
+   sweepcursor = 0 ;
+   shaderoots() ;
+   double headroom = (double)(maxmem >> 3) / sizeof(ghnode) ;
+   double work = 2.0 * hashpop + hashprime ;
+   double perslice = GCSLICEALLOCS * (1 + 2 * work / headroom) ;
+   gcbudget = perslice > 1e8 ? 100000000 : (int)perslice ;
+   gccountdown = GCSLICEALLOCS ;
+   gcpauses.stop() ;
+}
+int ghashbase::gcmark(int budget) {
+   while (budget > 0) {
+      if (graysp == 0) {
+         shaderoots() ;
+         budget -= gsp + timeline.framecount + (int)snapshots.roots.size() ;
+         if (graysp == 0) {
+            gcphase = 2 ;
+            sweepcursor = 0 ;
+            break ;
+         }
+      }
+      ghnode *n = graystack[--graysp] ;
+      shade(n->nw) ;
+      shade(n->ne) ;
+      shade(n->sw) ;
+      shade(n->se) ;
+      if (n->res)
+         shade(n->res) ;
+      budget-- ;
+   }
+   return budget ;
+}
+int ghashbase::gcsweep(int budget) {
+   while (budget > 0 && sweepcursor < hashprime) {
+      ghashgroup *grp = hashtab + sweepcursor++ ;
+      hashtagword t = grp->tags ;
+      budget-- ;
+      for (hashtagword m = tagfull(t) ; m ; m &= m - 1) {
+         int i = tagindex(m) ;
+         ghnode *p = grp->slot[i] ;
+         if (marked(p)) {
+            clearmark(p) ;
+         } else {
+            t = tagset(t, i, HASHTAGDEAD) ;
+            grp->slot[i] = 0 ;
+            p->next = freeghnodes ;
+            freeghnodes = p ;
+            hashpop-- ;
+            hashdead++ ;
+            gcfreed++ ;
+         }
+         budget-- ;
+      }
+      grp->tags = t ;
+   }
+   if (sweepcursor >= hashprime)
+      endgc() ;
+   return budget ;
+}
+void ghashbase::gcslice() {
+   gccountdown = GCSLICEALLOCS ;
+   gcpauses.start() ;
+   int budget = gcbudget ;
+   if (gcphase == 1)
+      budget = gcmark(budget) ;
+   if (gcphase == 2)
+      gcsweep(budget) ;
+   gcpauses.stop() ;
+}
+void ghashbase::gcreclaim() {
+   gcpauses.start() ;
+   while (gcphase == 1)
+      gcmark(1000000000) ;
+   while (gcphase == 2 && freeghnodes->next == 0)
+      gcsweep(gcbudget) ;
+   gcpauses.stop() ;
+}
+void ghashbase::finishgc() {
+   if (gcphase == 0)
+      return ;
+   gcpauses.start() ;
+   while (gcphase == 1)
+      gcmark(1000000000) ;
+   while (gcphase == 2)
+      gcsweep(1000000000) ;
+   gcpauses.stop() ;
+}
+void ghashbase::endgc() {
+   gcphase = 0 ;
+   if (graysize > 1000) {
+      alloced -= sizeof(ghnode *) * graysize ;
+      free(graystack) ;
+      graystack = 0 ;
+      graysize = 0 ;
+   }
+   if (verbose) {
+     double perc = (double)gcfreed / (double)totalthings * 100.0 ;
+     sprintf(statusline, "GC #%d done, freed %g percent (%" PRIuPTR ").",
+             gccount, perc, gcfreed) ;
+     gcpauses.report(statusline, 200) ;
+     lifestatus(statusline) ;
+   }
+}
 /*
  *   Clear the cache bits down to the appropriate level, marking the
  *   ghnodes we've handled.
@@ -1432,6 +1883,8 @@ void ghashbase::new_ngens(int newval) {
    }
 #ifndef NOGCBEFOREINC
    do_gc(0) ;
+#else
+   finishgc() ;
 #endif
    if (verbose) {
      strcpy(statusline, "Changing increment...") ;
@@ -1445,9 +1898,11 @@ void ghashbase::new_ngens(int newval) {
    ngens = newval ;
    inGC = 1 ;
    for (i=0; i<hashprime; i++)
-      for (p=hashtab[i]; p; p=clearmarkbit(p->next))
+      for (hashtagword m = tagfull(hashtab[i].tags) ; m ; m &= m - 1) {
+         p = hashtab[i].slot[tagindex(m)] ;
          if (is_ghnode(p) && !marked(p))
             clearcache(p, ghnode_depth(p), clearto) ;
+      }
    for (p=ghnodeblocks; p; p=p->next) {
       poller->poll() ;
       for (pp=p+1, i=1; i<1001; i++, pp++)
@@ -1499,6 +1954,163 @@ const bigint &ghashbase::getPopulation() {
    }
    return population ;
 }
+/*
+ *   A torus whose sides are powers of two is run by hashlife itself
+ *   rather than a generation at a time with border cells, just as in
+ *   hlifealgo:  four copies of the periodic tiling of the grid at a
+ *   depth where the side is a multiple of both periods make a ghnode
+ *   whose result is the tiling stepped by our increment, and we cut
+ *   the grid back out of that.  The tiling is built from blocks of
+ *   half the shorter side; as tree y is minus the user's y, the grid's
+ *   rows are -wrapht/2+1 up to wrapht/2, so a block at the bottom of
+ *   the grid gets its top row from the grid's top.
+ *
+ *   The first few routines find the ghnode of a given depth with its
+ *   lower left cell at x,y in wraproot.
+ */
+ghnode *ghashbase::centerghnode(ghnode *n) {
+   return find_ghnode(n->nw->se, n->ne->sw, n->sw->ne, n->se->nw) ;
+}
+ghnode *ghashbase::ghnodeat(int d, G_INT64 x, G_INT64 y) {
+   G_INT64 half = (G_INT64)1 << wrapdepth ;
+   if (x < -half || x >= half || y < -half || y >= half)
+      return zeroghnode(d) ;
+   ghnode *n = wraproot ;
+   G_INT64 nx = -half, ny = -half ;
+   for (int nd=wrapdepth; nd>d; nd--) {
+      half >>= 1 ;
+      if (y >= ny + 2 * half) {
+         ny += 2 * half ;
+         if (x >= nx + 2 * half) {
+            nx += 2 * half ;
+            n = n->ne ;
+         } else {
+            n = n->nw ;
+         }
+      } else {
+         if (x >= nx + 2 * half) {
+            nx += 2 * half ;
+            n = n->se ;
+         } else {
+            n = n->sw ;
+         }
+      }
+   }
+   return n ;
+}
+/*
+ *   Clear everything outside the grid.
+ */
+ghnode *ghashbase::cliptogrid(ghnode *n, int d, G_INT64 x, G_INT64 y) {
+   G_INT64 w = (G_INT64)2 << d ;
+   G_INT64 r = wrapleft + wrapwd ;
+   G_INT64 t = wrapbottom + wrapht ;
+   if (x >= wrapleft && x + w <= r && y >= wrapbottom && y + w <= t)
+      return n ;
+   ghnode *z = zeroghnode(d) ;
+   if (n == z || x >= r || x + w <= wrapleft || y >= t || y + w <= wrapbottom)
+      return z ;
+   if (d == 1) {
+      state c[GLEAFCELLS] ;
+      memcpy(c, ((ghleaf *)n)->c, GLEAFCELLS) ;
+      for (int row=0; row<GLEAFSIZE; row++)
+         for (int col=0; col<GLEAFSIZE; col++)
+            if (x + col < wrapleft || x + col >= r ||
+                y + row < wrapbottom || y + row >= t)
+               c[(GLEAFSIZE - 1 - row) * GLEAFSIZE + col] = 0 ;
+      return (ghnode *)find_ghleaf(c) ;
+   }
+   G_INT64 h = w >> 1 ;
+   return find_ghnode(cliptogrid(n->nw, d-1, x, y + h),
+                      cliptogrid(n->ne, d-1, x + h, y + h),
+                      cliptogrid(n->sw, d-1, x, y),
+                      cliptogrid(n->se, d-1, x + h, y)) ;
+}
+/*
+ *   Put together two ghnodes whose live cells never meet.
+ */
+ghnode *ghashbase::mergeghnodes(ghnode *a, ghnode *b, int d) {
+   ghnode *z = zeroghnode(d) ;
+   if (b == z)
+      return a ;
+   if (a == z)
+      return b ;
+   if (d == 1) {
+      state c[GLEAFCELLS] ;
+      for (int i=0; i<GLEAFCELLS; i++)
+         c[i] = (((ghleaf *)a)->c[i] ? ((ghleaf *)a)->c[i] : ((ghleaf *)b)->c[i]) ;
+      return (ghnode *)find_ghleaf(c) ;
+   }
+   return find_ghnode(mergeghnodes(a->nw, b->nw, d-1),
+                      mergeghnodes(a->ne, b->ne, d-1),
+                      mergeghnodes(a->sw, b->sw, d-1),
+                      mergeghnodes(a->se, b->se, d-1)) ;
+}
+/*
+ *   A block of the tiling no bigger than half the shorter side.
+ */
+ghnode *ghashbase::gridblock(int d, G_INT64 x, G_INT64 y) {
+   x = ((x - wrapleft) & (wrapwd - 1)) + wrapleft ;
+   y = ((y - wrapbottom + 1) & (wrapht - 1)) + wrapbottom - 1 ;
+   return mergeghnodes(cliptogrid(ghnodeat(d, x, y), d, x, y),
+                       cliptogrid(ghnodeat(d, x, y + wrapht), d, x, y + wrapht),
+                       d) ;
+}
+/*
+ *   Any square of the tiling; halves a period apart are the same.
+ */
+ghnode *ghashbase::tilegrid(int d, G_INT64 x, G_INT64 y) {
+   G_INT64 h = (G_INT64)1 << d ;
+   G_INT64 shorter = (wrapwd < wrapht ? wrapwd : wrapht) ;
+   if (2 * h <= shorter / 2)
+      return gridblock(d, x, y) ;
+   ghnode *nw = tilegrid(d-1, x, y + h) ;
+   ghnode *ne = (h % wrapwd == 0 ? nw : tilegrid(d-1, x + h, y + h)) ;
+   ghnode *sw = (h % wrapht == 0 ? nw : tilegrid(d-1, x, y)) ;
+   ghnode *se = (h % wrapwd == 0 ? sw :
+                 h % wrapht == 0 ? ne : tilegrid(d-1, x + h, y)) ;
+   return find_ghnode(nw, ne, sw, se) ;
+}
+/*
+ *   Make the ghnode runpattern steps:  four copies of the tiling at a
+ *   depth where its result is the step we want.
+ */
+ghnode *ghashbase::wrapgrid(int &d) {
+   wrapwd = gridwd ;
+   wrapht = gridht ;
+   wrapleft = -wrapwd / 2 ;
+   wrapbottom = 1 - wrapht / 2 ;
+   wrapdepth = log2(gridwd > gridht ? gridwd : gridht) ;
+   // the grid and the row above it fit in a root of that depth
+   wraproot = root ;
+   d = ghnode_depth(wraproot) ;
+   while (d < wrapdepth) {
+      wraproot = pushroot(wraproot) ;
+      d++ ;
+   }
+   while (d > wrapdepth) {
+      wraproot = centerghnode(wraproot) ;
+      d-- ;
+   }
+   ghnode *n = tilegrid(d, -((G_INT64)1 << d), -((G_INT64)1 << d)) ;
+   wraproot = 0 ;
+   while (ngens + 1 > d) {
+      n = find_ghnode(n, n, n, n) ;
+      d++ ;
+   }
+   d++ ;
+   return find_ghnode(n, n, n, n) ;
+}
+/*
+ *   Cut the grid out of a result of the above at the given depth.
+ */
+ghnode *ghashbase::unwrapgrid(ghnode *n, int d) {
+   while (d > wrapdepth) {
+      n = centerghnode(n) ;
+      d-- ;
+   }
+   return cliptogrid(n, d, -((G_INT64)1 << d), -((G_INT64)1 << d)) ;
+}
 /*
  *   Finally, we get to run the pattern.  We first ensure that all
  *   clearspace ghnodes and the input pattern is never garbage
@@ -1511,19 +2123,34 @@ ghnode *ghashbase::runpattern() {
    save(root) ; // do this in case we interrupt generation
    ensure_hashed() ;
    okaytogc = 1 ;
+   if (phased && generation.odd() != phaseparity) {
+      // the results are for the other parity; the calccache entries
+      // carry their phase so they can stay
+      phaseparity = generation.odd() ;
+      if (!cacheinvalid)
+         do_gc(1) ;
+   }
    if (cacheinvalid) {
       do_gc(1) ; // invalidate the entire cache and recalc leaves
+      memset(calccache, 0, sizeof(ghcalcentry) << logcalccache) ;
       cacheinvalid = 0 ;
    }
    int depth = ghnode_depth(n) ;
    ghnode *n2 ;
-   n = pushroot(n) ;
-   depth++ ;
-   n = pushroot(n) ;
-   depth++ ;
-   while (ngens + 2 > depth) {
+   int wrapped = wrapsgrid() ;
+   if (wrapped) {
+      okaytogc = 0 ; // nothing is saved until it is built
+      n = wrapgrid(depth) ;
+      okaytogc = 1 ;
+   } else {
       n = pushroot(n) ;
       depth++ ;
+      n = pushroot(n) ;
+      depth++ ;
+      while (ngens + 2 > depth) {
+         n = pushroot(n) ;
+         depth++ ;
+      }
    }
    save(zeroghnode(nzeros-1)) ;
    save(n) ;
@@ -1536,6 +2163,8 @@ ghnode *ghashbase::runpattern() {
    }
    if (poller->isInterrupted() || softinterrupt)
       return 0 ; // indicate it was interrupted
+   if (wrapped)
+      n2 = unwrapgrid(n2, depth-1) ;
    n = popzeros(n2) ;
    generation += pow2step ;
    return n ;
@@ -1667,12 +2296,38 @@ const char *ghashbase::readmacrocell(char *line) {
          if (d < 1)
             return "Oops; bad depth in readmacrocell." ;
          if (d == 1) {
+           // we keep a 2x2 block in the middle of a leaf until the
+           // line that puts four of them together
            if (nw >= (g_uintptr_t)maxCellStates || ne >= (g_uintptr_t)maxCellStates ||
                sw >= (g_uintptr_t)maxCellStates || se >= (g_uintptr_t)maxCellStates)
               return "Cell state values too high for this algorithm." ;
-           root = ind[i++] = (ghnode *)find_ghleaf((state)nw, (state)ne,
-                                                   (state)sw, (state)se) ;
-           depth = d - 1 ;
+           state c[GLEAFCELLS] ;
+           memset(c, 0, sizeof(c)) ;
+           c[5] = (state)nw ;
+           c[6] = (state)ne ;
+           c[9] = (state)sw ;
+           c[10] = (state)se ;
+           root = ind[i++] = (ghnode *)find_ghleaf(c) ;
+           depth = 1 ;
+         } else if (d == 2) {
+           ind[0] = zeroghnode(1) ;
+           if (nw >= i || ind[nw] == 0 || ne >= i || ind[ne] == 0 ||
+               sw >= i || ind[sw] == 0 || se >= i || ind[se] == 0) {
+             return "Node out of range in readmacrocell." ;
+           }
+           ghleaf *q[4] = { (ghleaf *)ind[nw], (ghleaf *)ind[ne],
+                            (ghleaf *)ind[sw], (ghleaf *)ind[se] } ;
+           state c[GLEAFCELLS] ;
+           for (int k=0; k<4; k++) {
+              if (is_ghnode(q[k]))
+                 return "Bad node depth in readmacrocell." ;
+              int to = 2 * (k & 1) + 8 * (k >> 1) ;
+              memcpy(c + to, q[k]->c + 5, 2) ;
+              memcpy(c + to + 4, q[k]->c + 9, 2) ;
+           }
+           clearstack() ;
+           root = ind[i++] = (ghnode *)find_ghleaf(c) ;
+           depth = 1 ;
          } else {
            ind[0] = zeroghnode(d-2) ; /* allow zeros to work right */
            if (nw >= i || ind[nw] == 0 || ne >= i || ind[ne] == 0 ||
@@ -1701,6 +2356,20 @@ const char *ghashbase::setrule(const char *) {
    clearcache() ;
    return 0 ;
 }
+/**
+ *   The macrocell format is built on 2x2 leaves, so each of our leaves
+ *   goes out as a depth 2 line over four 2x2 blocks, which we number
+ *   and write once each.  This packs block k (nw, ne, sw, se) of a
+ *   leaf into a key for blockcells; 0 is the empty block.
+ */
+static unsigned int leafblock(ghleaf *n, int k) {
+   const state *c = n->c + 2 * (k & 1) + 8 * (k >> 1) ;
+   return c[0] | (c[1] << 8) | (c[4] << 16) | ((unsigned int)c[5] << 24) ;
+}
+static void writeblock(std::ostream &os, unsigned int b) {
+   os << 1 << ' ' << (b & 255) << ' ' << ((b >> 8) & 255)
+           << ' ' << ((b >> 16) & 255) << ' ' << (b >> 24) << '\n' ;
+}
 /**
  *   Write out the native macrocell format.  This is the one we use when
  *   we're not interactive and displaying a progress dialog.
@@ -1709,22 +2378,34 @@ g_uintptr_t ghashbase::writecell(std::ostream &os, ghnode *root, int depth) {
    g_uintptr_t thiscell = 0 ;
    if (root == zeroghnode(depth))
       return 0 ;
-   if (depth == 0) {
+   if (depth == 1) {
       if (root->nw != 0)
          return (g_uintptr_t)(root->nw) ;
    } else {
       if (marked2(root))
          return (g_uintptr_t)(root->next) ;
-      unhash_ghnode2(root) ;
       mark2(root) ;
    }
-   thiscell = ++cellcounter ;
-   if (depth == 0) {
+   if (depth == 1) {
       ghleaf *n = (ghleaf *)root ;
+      g_uintptr_t q[4] ;
+      for (int k=0; k<4; k++) {
+         unsigned int b = leafblock(n, k) ;
+         q[k] = 0 ;
+         if (b) {
+            q[k] = blockcells[b] ;
+            if (q[k] == 0) {
+               q[k] = blockcells[b] = ++cellcounter ;
+               writeblock(os, b) ;
+            }
+         }
+      }
+      thiscell = ++cellcounter ;
       root->nw = (ghnode *)thiscell ;
-      os << 1 << ' ' << int(n->nw) << ' ' << int(n->ne)
-              << ' ' << int(n->sw) << ' ' << int(n->se) << '\n' ;
+      os << 2 << ' ' << q[0] << ' ' << q[1]
+              << ' ' << q[2] << ' ' << q[3] << '\n' ;
    } else {
+      thiscell = ++cellcounter ;
       g_uintptr_t nw = writecell(os, root->nw, depth-1) ;
       g_uintptr_t ne = writecell(os, root->ne, depth-1) ;
       g_uintptr_t sw = writecell(os, root->sw, depth-1) ;
@@ -1744,16 +2425,24 @@ g_uintptr_t ghashbase::writecell_2p1(ghnode *root, int depth) {
    g_uintptr_t thiscell = 0 ;
    if (root == zeroghnode(depth))
       return 0 ;
-   if (depth == 0) {
+   if (depth == 1) {
       if (root->nw != 0)
          return (g_uintptr_t)(root->nw) ;
    } else {
       if (marked2(root))
          return (g_uintptr_t)(root->next) ;
-      unhash_ghnode2(root) ;
       mark2(root) ;
    }
-   if (depth == 0) {
+   if (depth == 1) {
+      ghleaf *n = (ghleaf *)root ;
+      for (int k=0; k<4; k++) {
+         unsigned int b = leafblock(n, k) ;
+         if (b && blockcells.find(b) == blockcells.end()) {
+            blockcells[b] = ++cellcounter ;
+            if ((cellcounter & 4095) == 0)
+               lifeabortprogress(0, "Scanning tree") ;
+         }
+      }
       thiscell = ++cellcounter ;
       // note:  we *must* not abort this prescan
       if ((cellcounter & 4095) == 0)
@@ -1777,23 +2466,38 @@ g_uintptr_t ghashbase::writecell_2p1(ghnode *root, int depth) {
  *   numbered, and displaying a progress dialog.
  */
 static char progressmsg[80] ;
+void ghashbase::writeprogress(std::ostream &os) {
+   if ((cellcounter & 4095) == 0) {
+      std::streampos siz = os.tellp() ;
+      sprintf(progressmsg, "File size: %.2f MB", double(siz) / 1048576.0) ;
+      lifeabortprogress(cellcounter/(double)writecells, progressmsg) ;
+   }
+}
 g_uintptr_t ghashbase::writecell_2p2(std::ostream &os, ghnode *root, int depth) {
    g_uintptr_t thiscell = 0 ;
    if (root == zeroghnode(depth))
       return 0 ;
-   if (depth == 0) {
-      if (cellcounter + 1 != (g_uintptr_t)(root->nw))
+   if (depth == 1) {
+      if ((g_uintptr_t)(root->nw) <= cellcounter)
          return (g_uintptr_t)(root->nw) ;
-      thiscell = ++cellcounter ;
-      if ((cellcounter & 4095) == 0) {
-         std::streampos siz = os.tellp() ;
-         sprintf(progressmsg, "File size: %.2f MB", double(siz) / 1048576.0) ;
-         lifeabortprogress(thiscell/(double)writecells, progressmsg) ;
-      }
       ghleaf *n = (ghleaf *)root ;
-      root->nw = (ghnode *)thiscell ;
-      os << 1 << ' ' << int(n->nw) << ' ' << int(n->ne)
-              << ' ' << int(n->sw) << ' ' << int(n->se) << '\n';
+      g_uintptr_t q[4] ;
+      for (int k=0; k<4; k++) {
+         unsigned int b = leafblock(n, k) ;
+         q[k] = 0 ;
+         if (b) {
+            q[k] = blockcells[b] ;
+            if (q[k] == cellcounter + 1) {
+               ++cellcounter ;
+               writeprogress(os) ;
+               writeblock(os, b) ;
+            }
+         }
+      }
+      thiscell = ++cellcounter ;
+      writeprogress(os) ;
+      os << 2 << ' ' << q[0] << ' ' << q[1]
+              << ' ' << q[2] << ' ' << q[3] << '\n' ;
    } else {
       if (cellcounter + 1 > (g_uintptr_t)(root->next) || isaborted())
          return (g_uintptr_t)(root->next) ;
@@ -1807,25 +2511,38 @@ g_uintptr_t ghashbase::writecell_2p2(std::ostream &os, ghnode *root, int depth)
          return (g_uintptr_t)(root->next) ;
       }
       thiscell = ++cellcounter ;
-      if ((cellcounter & 4095) == 0) {
-         std::streampos siz = os.tellp() ;
-         sprintf(progressmsg, "File size: %.2f MB", double(siz) / 1048576.0) ;
-         lifeabortprogress(thiscell/(double)writecells, progressmsg) ;
-      }
+      writeprogress(os) ;
       root->next = (ghnode *)thiscell ;
       os << depth+1 << ' ' << nw << ' ' << ne
                     << ' ' << sw << ' ' << se << '\n' ;
    }
    return thiscell ;
 }
+void ghashbase::getstats(lifestats &s) {
+   lifealgo::getstats(s) ;
+   s.nodes = running_hperf.nodesCalculated + running_hperf.fastNodeInc ;
+   s.gcs = gccount ;
+   s.gcpauses = gcpauses.count ;
+   s.gcpausetotal = gcpauses.total ;
+   s.gcpausemax = gcpauses.longest ;
+   s.hashload = (double)hashpop / ((double)hashprime * GHASHGROUP) ;
+   s.memory = (double)alloced ;
+}
 #define STRINGIFY(arg) STR2(arg)
 #define STR2(arg) #arg
 const char *ghashbase::writeNativeFormat(std::ostream &os, char *comments) {
+   // evicted frames have to be stepped to before they can be saved
+   int framestosave = 0 ;
+   if (timeline.savetimeline && fillframes())
+      framestosave = timeline.framecount ;
+   finishgc() ;
    int depth = ghnode_depth(root) ;
    os << "[M2] (golly " STRINGIFY(VERSION) ")\n" ;
    
    // AKT: always write out explicit rule
-   os << "#R " << getrule() << '\n' ;
+   // (a snapshot's own, which doesn't need the subclass to be alive)
+   const char *rule = snapshotrule() ;
+   os << "#R " << (rule ? rule : getrule()) << '\n' ;
 
    if (generation > bigint::zero) {
       // write non-zero gen count
@@ -1862,9 +2579,6 @@ const char *ghashbase::writeNativeFormat(std::ostream &os, char *comments) {
    /* this is the new two-pass way */
    cellcounter = 0 ;
    vector<int> depths(timeline.framecount) ;
-   int framestosave = timeline.framecount ;
-   if (timeline.savetimeline == 0)
-     framestosave = 0 ;
    if (framestosave) {
      for (int i=0; i<timeline.framecount; i++) {
        ghnode *frame = (ghnode*)timeline.frames[i] ;
@@ -1898,10 +2612,126 @@ const char *ghashbase::writeNativeFormat(std::ostream &os, char *comments) {
      }
    }
    afterwritemc(root, depth) ;
+   blockcells.clear() ;
    inGC = 0 ;
    return 0 ;
 }
-char ghashbase::statusline[120] ;
+/*
+ *   What each timeline frame pins: the bytes of the ghnodes it keeps
+ *   alive that neither the other roots nor the frames before it do.
+ *   We mark from the other roots without counting, then from each
+ *   frame in turn counting what is newly marked, following results
+ *   the way gc_mark does, and then walk it all again to clear the
+ *   marks.
+ */
+double ghashbase::pinmark(ghnode *n) {
+   if (marked(n))
+      return 0 ;
+   mark(n) ;
+   if (!is_ghnode(n))
+      return sizeof(ghleaf) ;
+   double r = sizeof(ghnode) + pinmark(n->nw) + pinmark(n->ne) +
+                               pinmark(n->sw) + pinmark(n->se) ;
+   if (n->res)
+      r += pinmark(n->res) ;
+   return r ;
+}
+void ghashbase::pinclear(ghnode *n) {
+   if (!marked(n))
+      return ;
+   clearmark(n) ;
+   if (is_ghnode(n)) {
+      pinclear(n->nw) ;
+      pinclear(n->ne) ;
+      pinclear(n->sw) ;
+      pinclear(n->se) ;
+      if (n->res)
+         pinclear(n->res) ;
+   }
+}
+double ghashbase::measureframes(vector<double> &pinned) {
+   int i, z ;
+   finishgc() ;
+   pinned.assign(timeline.framecount, 0) ;
+   for (z=nzeros-1; z>=0; z--)
+      if (zeroghnodea[z] != 0)
+         break ;
+   if (z >= 0)
+      pinmark(zeroghnodea[z]) ;
+   if (root != 0)
+      pinmark(root) ;
+   for (i=0; i<gsp; i++)
+      pinmark(stack[i]) ;
+   for (i=0; i<(int)snapshots.roots.size(); i++)
+      if (snapshots.roots[i])
+         pinmark((ghnode *)snapshots.roots[i]) ;
+   double total = 0 ;
+   for (i=0; i<timeline.framecount; i++)
+      if (timeline.frames[i])
+         total += pinned[i] = pinmark((ghnode *)timeline.frames[i]) ;
+   if (z >= 0)
+      pinclear(zeroghnodea[z]) ;
+   if (root != 0)
+      pinclear(root) ;
+   for (i=0; i<gsp; i++)
+      pinclear(stack[i]) ;
+   for (i=0; i<(int)snapshots.roots.size(); i++)
+      if (snapshots.roots[i])
+         pinclear((ghnode *)snapshots.roots[i]) ;
+   for (i=0; i<timeline.framecount; i++)
+      if (timeline.frames[i])
+         pinclear((ghnode *)timeline.frames[i]) ;
+   return total ;
+}
+/*
+ *   Write one frame to a timeline stream; see framestream in
+ *   lifealgo.h.  Leaves go out as their four 2x2 blocks, as in
+ *   writecell, with the blocks numbered through the stream's leaves.
+ *   The root always gets a line of its own, even if an earlier frame
+ *   was the same.
+ */
+g_uintptr_t ghashbase::streamcell(framestream &fs, ghnode *n, int depth,
+                                  int fresh) {
+   if (!fresh) {
+      if (n == zeroghnode(depth))
+         return 0 ;
+      std::map<void *, g_uintptr_t>::iterator it = fs.known.find(n) ;
+      if (it != fs.known.end())
+         return it->second ;
+   }
+   g_uintptr_t q[4] ;
+   if (depth == 1) {
+      for (int k=0; k<4; k++) {
+         unsigned int b = leafblock((ghleaf *)n, k) ;
+         q[k] = 0 ;
+         if (b) {
+            q[k] = fs.findleaf(b) ;
+            if (q[k] == 0) {
+               q[k] = fs.addleaf(b) ;
+               writeblock(fs.os, b) ;
+            }
+         }
+      }
+   } else {
+      q[0] = streamcell(fs, n->nw, depth-1, 0) ;
+      q[1] = streamcell(fs, n->ne, depth-1, 0) ;
+      q[2] = streamcell(fs, n->sw, depth-1, 0) ;
+      q[3] = streamcell(fs, n->se, depth-1, 0) ;
+   }
+   g_uintptr_t thiscell = fs.addnode(depth+1, q[0], q[1], q[2], q[3], fresh) ;
+   fs.known[n] = thiscell ;
+   return thiscell ;
+}
+const char *ghashbase::writeframe(framestream &fs, void *frame) {
+   ghnode *n = (ghnode *)frame ;
+   finishgc() ;
+   fs.sync(gccount) ;
+   fs.endframe(streamcell(fs, n, ghnode_depth(n), 1)) ;
+   if (fs.os.fail())
+      return "Could not write the timeline stream." ;
+   return 0 ;
+}
+char ghashbase::statusline[200] ;
 void ghashbase::doInitializeAlgoInfo(staticAlgoInfo &ai) {
    ai.setDefaultBaseStep(8) ;
    ai.setDefaultMaxMem(500) ; // MB
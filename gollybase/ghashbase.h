@@ -6,6 +6,7 @@
 #include "lifealgo.h"
 #include "liferules.h"
 #include "util.h"
+#include <map>
 /*
  *   This class forms the basis of all hashlife-type algorithms except
  *   the highly-optimized hlifealgo (which is most appropriate for
@@ -20,24 +21,51 @@ typedef unsigned char state ;
  *   Nodes, like the standard hlifealgo nodes.
  */
 struct ghnode {
-   ghnode *next ;              /* hash link */
+   ghnode *next ;              /* free link, marks */
    ghnode *nw, *ne, *sw, *se ; /* constant; nw != 0 means nonjleaf */
    ghnode *res ;               /* cache */
 } ;
 /*
- *   Leaves, like the standard hlifealgo leaves.
+ *   Leaves, like the standard hlifealgo leaves, hold a 4x4 block of
+ *   cells (a ghnode of depth 1), stored row by row from the north.
+ *   They still fit in the space of a ghnode.
  */
+const int GLEAFSIZE = 4 ;
+const int GLEAFCELLS = GLEAFSIZE * GLEAFSIZE ;
 struct ghleaf {
-   ghnode *next ;              /* hash link */
+   ghnode *next ;              /* free link, marks */
    ghnode *isghnode ;          /* must always be zero for leaves */
-   state nw, ne, sw, se ;      /* constant */
+   state c[GLEAFCELLS] ;       /* constant */
    bigint leafpop ;            /* how many set bits */
 } ;
+/*
+ *   The leaf computations remember the next generation of the center
+ *   of the 4x4 blocks they see, in a direct-mapped table of these.
+ *   The table starts small and grows with the hash table, so a
+ *   small pattern doesn't pay for clearing and missing in a big one.
+ */
+struct ghcalcentry {
+   state c[GLEAFCELLS] ;       /* the block */
+   state res[4] ;              /* its 2x2 center one generation on */
+   int used ;
+} ;
+const int MINLOGCALCCACHE = 10 ;
+const int MAXLOGCALCCACHE = 16 ;
+const int CALCCACHERATIO = 2 ;
 /*
  *   If it is a struct ghnode, this returns a non-zero value, otherwise it
  *   returns a zero value.
  */
 #define is_ghnode(n) (((ghnode *)(n))->nw)
+/*
+ *   The hash table is an array of these, one cache line each; see
+ *   util.h.
+ */
+const int GHASHGROUP = 7 ;
+struct ghashgroup {
+   hashtagword tags ;
+   ghnode *slot[GHASHGROUP] ;
+} ;
 /*
  *   For explicit prefetching we retain some state for our lookup
  *   routines.
@@ -46,9 +74,10 @@ struct ghleaf {
 struct ghsetup_t { 
    g_uintptr_t h ;
    struct ghnode *nw, *ne, *sw, *se ;
-   void prefetch(struct ghnode **addr) const { PREFETCH(addr) ; }
+   void prefetch(const void *addr) const { PREFETCH(addr) ; }
 } ;
 #endif
+struct ghcellband ;
 
 /**
  *   Our ghashbase class.  Note that this is an abstract class; you need
@@ -63,6 +92,13 @@ public:
    //  This should be overridden by a deriving class.
    virtual state slowcalc(state nw, state n, state ne, state w, state c,
                           state e, state sw, state s, state se) = 0 ;
+   //  Compute the next generation of the n by n interior of the
+   //  (n+2) by (n+2) block of cells at in (rows stride apart), into
+   //  out row by row.  The leaves are computed a whole block at a
+   //  time through this; by default it just calls slowcalc() for
+   //  each cell, but a deriving class can do better.
+   virtual void slowcalcblock(const state *in, int stride, state *out,
+                              int n) ;
    // note that for ghashbase, clearall() releases no memory; it retains
    // the full cache information but just sets the current pattern to
    // the empty pattern.
@@ -70,6 +106,8 @@ public:
    virtual int setcell(int x, int y, int newstate) ;
    virtual int getcell(int x, int y) ;
    virtual int nextcell(int x, int y, int &v) ;
+   virtual void getcellruns(int top, int left, int bottom, int right,
+                            vector<cellspan> &spans) ;
    virtual void endofpattern() ;
    virtual void setIncrement(bigint inc) ;
    virtual void setIncrement(int inc) { setIncrement(bigint(inc)) ; }
@@ -82,6 +120,11 @@ public:
    virtual const char *setrule(const char *) ;
    virtual const char *getrule() { return "" ; }
    virtual void step() ;
+   /*
+    *   We step a torus ourselves if its sides are powers of two and
+    *   each half side is a whole number of leaves (see runpattern).
+    */
+   virtual bool wrapsgrid() { return ispow2torus(8) ; }
    virtual void* getcurrentstate() { return root ; }
    virtual void setcurrentstate(void *n) ;
    /*
@@ -95,13 +138,33 @@ public:
    virtual void findedges(bigint *t, bigint *l, bigint *b, bigint *r) ;
    virtual const char *readmacrocell(char *line) ;
    virtual const char *writeNativeFormat(std::ostream &os, char *comments) ;
+   virtual double measureframes(vector<double> &pinned) ;
+   virtual const char *writeframe(framestream &fs, void *frame) ;
+   virtual void getstats(lifestats &s) ;
    static void doInitializeAlgoInfo(staticAlgoInfo &) ;
+   /*
+    *   Collect garbage in small slices as new ghnodes are allocated,
+    *   rather than all at once when memory runs out.
+    */
+   static void setIncrementalGC(int on) { incrementalgc = on ; }
    
+protected:
+/*
+ *   A rule whose next state depends on where a cell is and on which
+ *   generation it is, like the Margolus block rules, sets phased.
+ *   slowcalcblock() can then find both in calcphase:  bit 0 is the
+ *   parity of the x coordinate of the window's top left cell (whose y
+ *   coordinate always has the other parity) and bit 1 the parity of
+ *   the generation being computed.  The cached results are only kept
+ *   for one generation parity, so odd steps cost a cache flush.
+ */
+   int phased ;
+   int calcphase ;
 private:
 /*
  *   Some globals representing our universe.  The root is the
  *   real root of the universe, and the depth is the depth of the
- *   tree where 2 means that root is a ghleaf, and 3 means that the
+ *   tree where 1 means that root is a ghleaf, and 2 means that the
  *   children of root are leaves, and so on.  The center of the
  *   root is always coordinate position (0,0), so at startup the
  *   x and y coordinates range from -4..3; in general,
@@ -114,6 +177,14 @@ private:
    int depth ;
    ghnode **zeroghnodea ;
    int nzeros ;
+/*
+ *   While a torus is being stepped, the root it was cut from (at
+ *   depth wrapdepth) and the grid in tree coordinates:  wrapwd by
+ *   wrapht cells with wrapleft and wrapbottom its lowest x and y.
+ */
+   ghnode *wraproot ;
+   int wrapdepth ;
+   G_INT64 wrapleft, wrapbottom, wrapwd, wrapht ;
 /*
  *   Finally, our gc routine.  We keep a `stack' of all the `roots'
  *   we want to preserve.  Nodes not reachable from here, we allow to
@@ -121,12 +192,17 @@ private:
  */
    ghnode **stack ;
    int stacksize ;
-   g_uintptr_t hashpop, hashlimit, hashprime ;
+   g_uintptr_t hashpop, hashlimit, hashprime, hashdead ;
 #ifndef PRIMEMOD
    g_uintptr_t hashmask ;
 #endif
    static double maxloadfactor ;
-   ghnode **hashtab ;
+   ghashgroup *hashtab ;
+   int hashfull ; // no room to grow; collect instead
+   ghashgroup *oldtab ; // being emptied into hashtab by a resize
+   ghcalcentry *calccache ;
+   int logcalccache ;
+   g_uintptr_t oldprime, migratecursor ;
    int halvesdone ;
    int gsp ;
    g_uintptr_t alloced, maxmem ;
@@ -151,28 +227,54 @@ private:
    char *llxb, *llyb ;
    int hashed ;
    int cacheinvalid ;
+   int phaseparity ; // generation parity the cache is for, if phased
    g_uintptr_t cellcounter ; // used when writing
    g_uintptr_t writecells ; // how many to write
+   // macrocell files keep 2x2 leaves, so we number the 2x2 blocks of
+   // our leaves as we write them
+   std::map<unsigned int, g_uintptr_t> blockcells ;
    int gccount ; // how many gcs total this pattern
    int gcstep ; // how many gcs this step
    hperf running_hperf, step_hperf, inc_hperf ;
    int softinterrupt ;
+   int gcphase ; // 0 idle, 1 marking, 2 sweeping
+   ghnode **graystack ;
+   g_uintptr_t graysp, graysize ;
+   g_uintptr_t sweepcursor ;
+   g_uintptr_t gcfreed ;
+   int gcbudget, gccountdown ;
+   gcpausehist gcpauses ;
+   static int incrementalgc ;
    static char statusline[] ;
 //
    void resize() ;
+   void migrate(g_uintptr_t groups) ;
+   void finishresize() ;
+   void endresize() ;
+   g_uintptr_t hashinsert(ghnode *n, g_uintptr_t h) ;
+   ghnode **probe_ghnode(ghashgroup *tab, g_uintptr_t groups,
+                         g_uintptr_t g, unsigned int tag,
+                         ghnode *nw, ghnode *ne, ghnode *sw, ghnode *se) ;
+   ghnode **probe_ghleaf(ghashgroup *tab, g_uintptr_t groups,
+                         g_uintptr_t g, unsigned int tag,
+                         const state *c) ;
    ghnode *find_ghnode(ghnode *nw, ghnode *ne, ghnode *sw, ghnode *se) ;
+   ghnode *find_ghnode_miss(ghnode *nw, ghnode *ne, ghnode *sw, ghnode *se,
+                            g_uintptr_t h) ;
 #ifdef USEPREFETCH
    ghnode *find_ghnode(ghsetup_t &su) ;
    void setupprefetch(ghsetup_t &su, ghnode *nw, ghnode *ne, ghnode *sw, ghnode *se) ;
 #endif
-   void unhash_ghnode(ghnode *n) ;
-   void unhash_ghnode2(ghnode *n) ;
-   void rehash_ghnode(ghnode *n) ;
-   ghleaf *find_ghleaf(state nw, state ne, state sw, state se) ;
+   ghleaf *find_ghleaf(const state *c) ;
+   ghleaf *center_ghleaf(ghleaf *nw, ghleaf *ne, ghleaf *sw, ghleaf *se) ;
    ghnode *getres(ghnode *n, int depth) ;
    ghnode *dorecurs(ghnode *n, ghnode *ne, ghnode *t, ghnode *e, int depth) ;
    ghnode *dorecurs_half(ghnode *n, ghnode *ne, ghnode *t, ghnode *e, int depth) ;
-   ghleaf *dorecurs_ghleaf(ghleaf *n, ghleaf *ne, ghleaf *t, ghleaf *e) ;
+   ghleaf *dorecurs_ghleaf(ghleaf *n, ghleaf *ne, ghleaf *t, ghleaf *e,
+                           int gens) ;
+   void growcalccache() ;
+   void calcwindow(const state *in, int stride, state *out, int ostride,
+                   int phase) ;
    ghnode *newghnode() ;
    ghleaf *newghleaf() ;
    ghnode *newclearedghnode() ;
@@ -184,8 +286,19 @@ private:
    ghnode *gsetbit(ghnode *n, int x, int y, int newstate, int depth) ;
    int getbit(ghnode *n, int x, int y, int depth) ;
    int nextbit(ghnode *n, int x, int y, int depth, int &v) ;
+   void bandruns(const std::vector<ghcellband> &band, int y, int depth,
+                 int top, int left, int bottom, int right,
+                 vector<cellspan> &spans) ;
    ghnode *hashpattern(ghnode *root, int depth) ;
    ghnode *popzeros(ghnode *n) ;
+   ghnode *centerghnode(ghnode *n) ;
+   ghnode *ghnodeat(int depth, G_INT64 x, G_INT64 y) ;
+   ghnode *cliptogrid(ghnode *n, int depth, G_INT64 x, G_INT64 y) ;
+   ghnode *mergeghnodes(ghnode *a, ghnode *b, int depth) ;
+   ghnode *gridblock(int depth, G_INT64 x, G_INT64 y) ;
+   ghnode *tilegrid(int depth, G_INT64 x, G_INT64 y) ;
+   ghnode *wrapgrid(int &depth) ;
+   ghnode *unwrapgrid(ghnode *n, int depth) ;
    const bigint &calcpop(ghnode *root, int depth) ;
    void aftercalcpop2(ghnode *root, int depth) ;
    void afterwritemc(ghnode *root, int depth) ;
@@ -196,6 +309,16 @@ private:
    void clearcache() ;
    void gc_mark(ghnode *root, int invalidate) ;
    void do_gc(int invalidate) ;
+   void gcnewghnode(ghnode *n, g_uintptr_t g) ;
+   void shade(ghnode *n) ;
+   void shaderoots() ;
+   void startgc() ;
+   int gcmark(int budget) ;
+   int gcsweep(int budget) ;
+   void gcslice() ;
+   void gcreclaim() ;
+   void finishgc() ;
+   void endgc() ;
    void clearcache(ghnode *n, int depth, int clearto) ;
    void clearcache_p1(ghnode *n, int depth, int clearto) ;
    void clearcache_p2(ghnode *n, int depth, int clearto) ;
@@ -209,10 +332,33 @@ private:
    g_uintptr_t writecell(std::ostream &os, ghnode *root, int depth) ;
    g_uintptr_t writecell_2p1(ghnode *root, int depth) ;
    g_uintptr_t writecell_2p2(std::ostream &os, ghnode *root, int depth) ;
+   void writeprogress(std::ostream &os) ;
+   double pinmark(ghnode *n) ;
+   void pinclear(ghnode *n) ;
+   g_uintptr_t streamcell(framestream &fs, ghnode *n, int depth, int fresh) ;
    void drawpixel(int x, int y);
    void draw4x4_1(state sw, state se, state nw, state ne, int llx, int lly) ;
    void draw4x4_1(ghnode *n, ghnode *z, int llx, int lly) ;
    // AKT: set all pixels to background color
    void killpixels();
 } ;
+
+/*
+ *   The leaf kernel for a rule family.  A class R deriving from
+ *   ghashbase overrides slowcalcblock() with a call to this, which
+ *   names R's own slowcalc() rather than going through the vtable, so
+ *   the compiler can inline the rule into the loop over the block.
+ */
+template <class R>
+inline void ghashcalcblock(R *r, const state *in, int stride, state *out,
+                           int n) {
+   for (int y=0; y<n; y++) {
+      const state *a = in + y * stride ;
+      const state *b = a + stride ;
+      const state *c = b + stride ;
+      for (int x=0; x<n; x++, a++, b++, c++)
+         *out++ = r->R::slowcalc(a[0], a[1], a[2], b[0], b[1], b[2],
+                                 c[0], c[1], c[2]) ;
+   }
+}
 #endif
@@ -161,7 +161,7 @@ void ghashbase::drawghnode(ghnode *n, int llx, int lly, int depth, ghnode *z) {
       return ;
    if (n == z) {
       // don't do anything
-   } else if (depth > 0 && sw > 2) {
+   } else if (depth > 1 && sw > 2) {
       z = z->nw ;
       sw >>= 1 ;
       depth-- ;
@@ -177,17 +177,25 @@ void ghashbase::drawghnode(ghnode *n, int llx, int lly, int depth, ghnode *z) {
          drawghnode(n->nw, llx, lly-sw, depth, z) ;
          drawghnode(n->ne, llx-sw, lly-sw, depth, z) ;
       }
-   } else if (depth > 0 && sw == 2) {
+   } else if (depth > 1 && sw == 2) {
       draw4x4_1(n, z->nw, llx, lly) ;
    } else if (sw == 1) {
       drawpixel(-llx, -lly) ;
    } else {
       struct ghleaf *l = (struct ghleaf *)n ;
+      const state *c = l->c ;
       sw >>= 1 ;
       if (sw == 1) {
-         draw4x4_1(l->sw, l->se, l->nw, l->ne, llx, lly) ;
+         // one pixel for each 2x2 quarter of the leaf
+         draw4x4_1((c[8] | c[9] | c[12] | c[13]) != 0,
+                   (c[10] | c[11] | c[14] | c[15]) != 0,
+                   (c[0] | c[1] | c[4] | c[5]) != 0,
+                   (c[2] | c[3] | c[6] | c[7]) != 0, llx, lly) ;
       } else {
-         lifefatal("Can't happen") ;
+         draw4x4_1(c[12], c[13], c[8], c[9], llx, lly) ;
+         draw4x4_1(c[14], c[15], c[10], c[11], llx-sw, lly) ;
+         draw4x4_1(c[4], c[5], c[0], c[1], llx, lly-sw) ;
+         draw4x4_1(c[6], c[7], c[2], c[3], llx-sw, lly-sw) ;
       }
    }
 }
@@ -237,6 +245,8 @@ void ghashbase::draw(viewport &viewarg, liferender &rendererarg) {
    
    ensure_hashed() ;
    renderer = &rendererarg ;
+   if (renderer->retained())
+      renderer->damage(0, 0, viewarg.getwidth(), viewarg.getheight()) ;
 
    if (!renderer->justState()) {
       // AKT: get cell colors and alpha values for dead and live pixels
@@ -301,7 +311,7 @@ void ghashbase::draw(viewport &viewarg, liferender &rendererarg) {
       }
    }
    /*  Find the lowest four we need to examine */
-   while (d > 0 && d - mag >= 0 &&
+   while (d > 1 && d - mag >= 0 &&
           (d - mag > 28 || (1 << (d - mag)) > 2 * maxd)) {
       llx = (llx << 1) + llxb[d] ;
       lly = (lly << 1) + llyb[d] ;
@@ -377,30 +387,23 @@ bail:
 }
 static
 int getbitsfromleaves(const vector<ghnode *> &v) {
-  unsigned short nw=0, ne=0, sw=0, se=0 ;
-  int i;
+  state c[GLEAFCELLS] ;
+  int i, j ;
+  memset(c, 0, sizeof(c)) ;
   for (i=0; i<(int)v.size(); i++) {
     ghleaf *p = (ghleaf *)v[i] ;
-    nw |= p->nw ;
-    ne |= p->ne ;
-    sw |= p->sw ;
-    se |= p->se ;
+    for (j=0; j<GLEAFCELLS; j++)
+      c[j] |= p->c[j] ;
   }
   int r = 0 ;
-  // horizontal bits are least significant ones
-  unsigned short w = nw | sw ;
-  unsigned short e = ne | se ;
-  // vertical bits are next 8
-  unsigned short n = nw | ne ;
-  unsigned short s = sw | se ;
-  if (w)
-    r |= 512 ;
-  if (e)
-    r |= 256 ;
-  if (n)
-    r |= 2 ;
-  if (s)
-    r |= 1 ;
+  for (i=0; i<GLEAFSIZE; i++) {
+    // vertical bits are least significant ones, from the south
+    if (c[4*i] | c[4*i+1] | c[4*i+2] | c[4*i+3])
+      r |= 0x8 >> i ;
+    // horizontal bits are next 8, from the east
+    if (c[i] | c[i+4] | c[i+8] | c[i+12])
+      r |= 0x800 >> i ;
+  }
   return r ;
 }
 
@@ -442,15 +445,15 @@ void ghashbase::findedges(bigint *ptop, bigint *pleft, bigint *pbottom, bigint *
    bottom.push_back(root) ;
    right.push_back(root) ;
    int topbm = 0, bottombm = 0, rightbm = 0, leftbm = 0 ;
-   while (currdepth >= -2) {
+   while (currdepth >= 0) {
       currdepth-- ;
-      if (currdepth == -1) { // we have ghleaf ghnodes; turn them into bitmasks
+      if (currdepth == 0) { // we have ghleaf ghnodes; turn them into bitmasks
          topbm = getbitsfromleaves(top) & 0xff ;
          bottombm = getbitsfromleaves(bottom) & 0xff ;
          leftbm = getbitsfromleaves(left) >> 8 ;
          rightbm = getbitsfromleaves(right) >> 8 ;
       }
-      if (currdepth == -1) {
+      if (currdepth <= 0) {
           int sz = 1 << (currdepth + 2) ;
           int maskhi = (1 << sz) - (1 << (sz >> 1)) ;
           int masklo = (1 << (sz >> 1)) - 1 ;
@@ -476,7 +479,7 @@ void ghashbase::findedges(bigint *ptop, bigint *pleft, bigint *pbottom, bigint *
           } else {
             leftbm >>= (sz >> 1) ;
           }
-      } else if (currdepth >= 0) {
+      } else {
          ghnode *z = 0 ;
          if (hashed)
             z = zeroghnode(currdepth) ;
@@ -583,10 +586,10 @@ void ghashbase::findedges(bigint *ptop, bigint *pleft, bigint *pbottom, bigint *
    xmax >>= 1 ;
    ymin >>= 1 ;
    ymax >>= 1 ;
-   xmin <<= (currdepth + 3) ;
-   ymin <<= (currdepth + 3) ;
-   xmax <<= (currdepth + 3) ;
-   ymax <<= (currdepth + 3) ;
+   xmin <<= (currdepth + 1) ;
+   ymin <<= (currdepth + 1) ;
+   xmax <<= (currdepth + 1) ;
+   ymax <<= (currdepth + 1) ;
    xmax -= 1 ;
    ymax -= 1 ;
    ymin.mul_smallint(-1) ;
@@ -627,13 +630,13 @@ void ghashbase::fit(viewport &view, int force) {
    int topbm = 0, bottombm = 0, rightbm = 0, leftbm = 0 ;
    while (currdepth >= 0) {
       currdepth-- ;
-      if (currdepth == -1) { // we have ghleaf ghnodes; turn them into bitmasks
+      if (currdepth == 0) { // we have ghleaf ghnodes; turn them into bitmasks
          topbm = getbitsfromleaves(top) & 0xff ;
          bottombm = getbitsfromleaves(bottom) & 0xff ;
          leftbm = getbitsfromleaves(left) >> 8 ;
          rightbm = getbitsfromleaves(right) >> 8 ;
       }
-      if (currdepth == -1) {
+      if (currdepth <= 0) {
          int sz = 1 << (currdepth + 2) ;
          int maskhi = (1 << sz) - (1 << (sz >> 1)) ;
          int masklo = (1 << (sz >> 1)) - 1 ;
@@ -665,7 +668,7 @@ void ghashbase::fit(viewport &view, int force) {
          }
          xsize <<= 1 ;
          ysize <<= 1 ;
-      } else if (currdepth >= 0) {
+      } else {
          ghnode *z = 0 ;
          if (hashed)
             z = zeroghnode(currdepth) ;
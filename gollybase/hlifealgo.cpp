@@ -17,13 +17,39 @@
 #include "util.h"
 #include <stdlib.h>
 #include <string.h>
+#include <stddef.h>
 #include <iostream>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#if defined(_WIN32) && !defined(__GNUC__)
+#include <intrin.h>
+#endif
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+#ifdef COMPACTNODES
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
+#endif
 using namespace std ;
 /*
- *   Power of two hash sizes work fine.
+ *   Power of two hash sizes work fine.  The table index is taken from
+ *   the middle bits of a multiply of the hash (see resize()).
  */
+static inline g_uintptr_t hashspread(g_uintptr_t h) {
+   return (g_uintptr_t)(((unsigned long long)h * 0x9e3779b97f4a7c15ULL) >> 24) ;
+}
 #ifdef PRIMEMOD
-#define HASHMOD(a) ((a)%hashprime)
+#define HASHMOD(a) (hashspread(a)%hashprime)
 static g_uintptr_t nexthashsize(g_uintptr_t i) {
    g_uintptr_t j ;
    i |= 1 ;
@@ -36,7 +62,7 @@ static g_uintptr_t nexthashsize(g_uintptr_t i) {
    }
 }
 #else
-#define HASHMOD(a) ((a)&(hashmask))
+#define HASHMOD(a) (hashspread(a)&(hashmask))
 static g_uintptr_t nexthashsize(g_uintptr_t i) {
    while ((i & (i - 1)))
       i += (i & (1 + ~i)) ; // i & - i is more idiomatic but generates warning
@@ -81,27 +107,119 @@ static unsigned char shortpop[65536] ;
        ((t00) << 15) | ((t01) << 13) | (((t02) << 11) & 0x1000) | \
        (((t10) << 7) & 0x880) | ((t11) << 5) | (((t12) << 3) & 0x110) | \
        (((t20) >> 1) & 0x8) | ((t21) >> 3) | ((t22) >> 5)
-void hlifealgo::leafres(leaf *n) {
+static void rulecalc(const char *ruletable,
+                     unsigned short nw, unsigned short ne,
+                     unsigned short sw, unsigned short se,
+                     unsigned short *res1, unsigned short *res2) {
    unsigned short
-   t00 = ruletable[n->nw],
-   t01 = ruletable[((n->nw << 2) & 0xcccc) | ((n->ne >> 2) & 0x3333)],
-   t02 = ruletable[n->ne],
-   t10 = ruletable[((n->nw << 8) & 0xff00) | ((n->sw >> 8) & 0x00ff)],
-   t11 = ruletable[((n->nw << 10) & 0xcc00) | ((n->ne << 6) & 0x3300) |
-                   ((n->sw >> 6) & 0x00cc) | ((n->se >> 10) & 0x0033)],
-   t12 = ruletable[((n->ne << 8) & 0xff00) | ((n->se >> 8) & 0x00ff)],
-   t20 = ruletable[n->sw],
-   t21 = ruletable[((n->sw << 2) & 0xcccc) | ((n->se >> 2) & 0x3333)],
-   t22 = ruletable[n->se] ;
-   n->res1 = combine9(t00,t01,t02,t10,t11,t12,t20,t21,t22) ;
-   n->res2 =
+   t00 = ruletable[nw],
+   t01 = ruletable[((nw << 2) & 0xcccc) | ((ne >> 2) & 0x3333)],
+   t02 = ruletable[ne],
+   t10 = ruletable[((nw << 8) & 0xff00) | ((sw >> 8) & 0x00ff)],
+   t11 = ruletable[((nw << 10) & 0xcc00) | ((ne << 6) & 0x3300) |
+                   ((sw >> 6) & 0x00cc) | ((se >> 10) & 0x0033)],
+   t12 = ruletable[((ne << 8) & 0xff00) | ((se >> 8) & 0x00ff)],
+   t20 = ruletable[sw],
+   t21 = ruletable[((sw << 2) & 0xcccc) | ((se >> 2) & 0x3333)],
+   t22 = ruletable[se] ;
+   *res1 = combine9(t00,t01,t02,t10,t11,t12,t20,t21,t22) ;
+   *res2 =
    (ruletable[(t00 << 10) | (t01 << 8) | (t10 << 2) | t11] << 10) |
    (ruletable[(t01 << 10) | (t02 << 8) | (t11 << 2) | t12] << 8) |
    (ruletable[(t10 << 10) | (t11 << 8) | (t20 << 2) | t21] << 2) |
     ruletable[(t11 << 10) | (t12 << 8) | (t21 << 2) | t22] ;
+}
+/*
+ *   When the leaf kernel below is in use nothing reads res1 and res2,
+ *   so we skip the table work; a rule change recomputes them for every
+ *   leaf (see do_gc()).
+ */
+void hlifealgo::leafres(leaf *n) {
+   if (!leafkernel) {
+      unsigned short r1, r2 ;
+      rulecalc(ruletable, n->nw, n->ne, n->sw, n->se, &r1, &r2) ;
+      n->res1 = r1 ;
+      n->res2 = r2 ;
+   }
+#ifdef COMPACTNODES
+   n->leafpop = (unsigned short)(shortpop[n->nw] + shortpop[n->ne] +
+                                 shortpop[n->sw] + shortpop[n->se]) ;
+#else
    n->leafpop = bigint((short)(shortpop[n->nw] + shortpop[n->ne] +
                                shortpop[n->sw] + shortpop[n->se])) ;
+#endif
+#ifdef NODEMETA
+   setleafmeta(n) ;
+#endif
 }
+#ifdef NODEMETA
+/*
+ *   A leaf sits in a node-sized slot, so its metadata can live where
+ *   a node's does as long as the leaf fields stop short of it.
+ */
+static_assert(sizeof(leaf) <= offsetof(node, meta),
+              "leaf fields overlap the node metadata") ;
+/*
+ *   Fill in the metadata of a new leaf (see nodemeta).  This is called
+ *   from leafres(), before isnode is cleared, so it cannot share the
+ *   is_node() test with setmeta().
+ */
+void hlifealgo::setleafmeta(leaf *l) {
+   nodemeta &m = ((node *)l)->meta ;
+   unsigned int top, bot ;
+   unpack8x8(l->nw, l->ne, l->sw, l->se, &top, &bot) ;
+   m.pop = shortpop[l->nw] + shortpop[l->ne] +
+           shortpop[l->sw] + shortpop[l->se] ;
+   m.depth = 2 ;
+   m.top = m.bottom = m.left = m.right = 8 ;
+   if (m.pop) {
+      unsigned long long rows = ((unsigned long long)top << 32) | bot ;
+      unsigned int cols = top | bot ;
+      cols = (cols | (cols >> 8) | (cols >> 16) | (cols >> 24)) & 255 ;
+      int i ;
+      for (i=0; ((rows >> (56 - 8 * i)) & 255) == 0; i++) ;
+      m.top = (unsigned short)i ;
+      for (i=0; ((rows >> (8 * i)) & 255) == 0; i++) ;
+      m.bottom = (unsigned short)i ;
+      for (i=0; (cols & (128 >> i)) == 0; i++) ;
+      m.left = (unsigned short)i ;
+      for (i=0; (cols & (1 << i)) == 0; i++) ;
+      m.right = (unsigned short)i ;
+   }
+}
+/*
+ *   The same for a new node.  The margins of an empty child are its
+ *   whole side, so the nearer pair of children gives a margin unless
+ *   both are empty.
+ */
+void hlifealgo::setmeta(node *n) {
+   nodemeta &m = n->meta ;
+   const nodemeta &a = n->nw->meta, &b = n->ne->meta,
+                  &c = n->sw->meta, &d = n->se->meta ;
+   int depth = a.depth + 1 ;
+   if (depth > METADEPTH) {
+      m.depth = (unsigned char)(depth > 255 ? 255 : depth) ;
+      m.pop = 0 ;
+      m.top = m.bottom = m.left = m.right = 0 ;
+      return ;
+   }
+   unsigned short half = (unsigned short)(1 << depth) ;
+   m.depth = (unsigned char)depth ;
+   m.pop = a.pop + b.pop + c.pop + d.pop ;
+   m.top = a.top < b.top ? a.top : b.top ;
+   if (m.top == half)
+      m.top = half + (c.top < d.top ? c.top : d.top) ;
+   m.bottom = c.bottom < d.bottom ? c.bottom : d.bottom ;
+   if (m.bottom == half)
+      m.bottom = half + (a.bottom < b.bottom ? a.bottom : b.bottom) ;
+   m.left = a.left < c.left ? a.left : c.left ;
+   if (m.left == half)
+      m.left = half + (b.left < d.left ? b.left : d.left) ;
+   m.right = b.right < d.right ? b.right : d.right ;
+   if (m.right == half)
+      m.right = half + (a.right < c.right ? a.right : c.right) ;
+}
+#endif
 /*
  *   We do now support garbage collection, but there are some routines we
  *   call frequently to help us.
@@ -115,80 +233,243 @@ g_uintptr_t node_hash(void *a, void *b, void *c, void *d) {
    return r ;
 }
 #endif
+/*
+ *   Compact links compare as indexes, without finding the nodes.
+ */
+#ifdef COMPACTNODES
+#define linkeq(a,b) ((a).ix == (b).ix)
+#else
+#define linkeq(a,b) ((a) == (b))
+#endif
 #define leaf_hash(a,b,c,d) (65537*(d)+257*(c)+17*(b)+5*(a))
 /*
- *   Resize the hash.  The max load factor defined here does not actually
- *   yield the maximum load factor the hash will see, because when we
- *   do the last resize before exhausting memory, we may find we are
- *   not permitted (while keeping total memory consumption below the
- *   limit) to do the resize, so the actual max load factor may be
- *   somewhat higher.  Conversely, because we double the hash size
- *   each time, the actual final max load factor may be less than this.
- *   Additional code can be added to manage this, but after some
- *   experimentation, it has been found that the impact is tiny, so
- *   we are keeping the code simple.  Nonetheless, this factor can be
- *   tweaked in the case where you absolutely want as many nodes as
- *   possible in memory, and are willing to use a large load factor to
- *   permit this; with the move-to-front heuristic, the code actually
- *   handles a large load factor fairly well.
+ *   Shared state for multithreaded evaluation; see the comments above
+ *   getres_par() for how it is used.  Each thread that takes part gets
+ *   its own gc stack and its own performance counters.
+ */
+struct hthreadstack {
+   node **stack ;
+   int gsp, stacksize ;
+   hperf perf ;
+} ;
+const int NSTRIPES = 1024 ;
+struct hparallel {
+   hparallel() : active(0), owner(0), stwpending(0) {
+      for (int i=0; i<MAX_THREADS; i++) {
+         ts[i].stack = 0 ;
+         ts[i].gsp = ts[i].stacksize = 0 ;
+         ts[i].perf.clear() ;
+      }
+   }
+   ~hparallel() {
+      for (int i=0; i<MAX_THREADS; i++)
+         if (ts[i].stack)
+            free(ts[i].stack) ;
+   }
+   std::mutex stripes[NSTRIPES] ;  // insertions, by home group
+   std::mutex allocmutex ;         // free list and counters
+   std::mutex mutex ;              // the fields below
+   std::condition_variable cv ;
+   int active ;                    // threads currently touching nodes
+   int owner ;                     // thread index of the caller of step()
+   std::atomic<int> stwpending ;   // someone wants to stop the world
+   hthreadstack ts[MAX_THREADS] ;
+} ;
+/*
+ *   Res fields (and hash slots) may be written by one thread and read
+ *   by another, so we publish them with release/acquire semantics.  On
+ *   x86 these compile to plain moves.  Tag words are claimed with a
+ *   compare and swap.
+ */
+#ifdef COMPACTNODES
+#ifdef __GNUC__
+#define loadlink(f) nodeptr::addr(__atomic_load_n(&((f).ix), __ATOMIC_ACQUIRE))
+#define storelink(f,r) __atomic_store_n(&((f).ix), nodeptr::index(r), __ATOMIC_RELEASE)
+#else
+#define loadlink(f) nodeptr::addr(*(unsigned int volatile *)&((f).ix))
+#define storelink(f,r) (*(unsigned int volatile *)&((f).ix) = nodeptr::index(r))
+#endif
+#else
+#ifdef __GNUC__
+#define loadlink(f) __atomic_load_n(&(f), __ATOMIC_ACQUIRE)
+#define storelink(f,r) __atomic_store_n(&(f), (r), __ATOMIC_RELEASE)
+#else
+#define loadlink(f) (*(node * volatile *)&(f))
+#define storelink(f,r) (*(node * volatile *)&(f) = (r))
+#endif
+#endif
+#define loadres(n) loadlink((n)->res)
+#define storeres(n,r) storelink((n)->res, r)
+#ifdef __GNUC__
+#define loadtags(p) __atomic_load_n(p, __ATOMIC_ACQUIRE)
+#define castags(p,o,n) __atomic_compare_exchange_n(p, &(o), n, false, \
+                                    __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE)
+#else
+#define loadtags(p) (*(hashtagword volatile *)(p))
+#define castags(p,o,n) (_InterlockedCompareExchange64((long long volatile *)(p), \
+                           (long long)(n), (long long)(o)) == (long long)(o))
+#endif
+/*
+ *   The hash table.  Rather than chaining nodes through their next
+ *   fields, we keep an open addressed array of groups of node pointers,
+ *   each group with its own word of tags (see util.h).  A chain costs a
+ *   cache miss for every node we compare against; a lookup here usually
+ *   reads one group and, on a hit, the node itself.  Both the group
+ *   index and the tag come from different bits of a multiply of the
+ *   hash, so the two are nearly independent, and runs of similar
+ *   hashes do not pile up in neighboring groups as they would if we
+ *   used the low bits directly.  Entries freed by the incremental
+ *   sweep leave tombstones, which count against the load factor until
+ *   a full collection or a resize clears them out.
+ *
+ *   Resizing allocates the new table and then moves the old entries
+ *   over a few groups at a time as new nodes are added (and any entry
+ *   we look up in the old table right away), so no single insertion
+ *   pays for rehashing everything.  Lookups that miss in the new
+ *   table try the old one until it is empty.  Collections and the
+ *   multithreaded code finish the move before they start.
+ *
+ *   The max load factor defined here does not actually yield the
+ *   maximum load factor the hash will see, because when we do the last
+ *   resize before exhausting memory, we may find we are not permitted
+ *   (while keeping total memory consumption below the limit) to do the
+ *   resize.  In that case we let the table fill to seven eighths, and
+ *   from then on collect garbage instead of growing.  Conversely,
+ *   because we double the hash size each time, the actual final max
+ *   load factor may be less than this.
  */
 double hlifealgo::maxloadfactor = 0.7 ;
+const g_uintptr_t MIGRATEGROUPS = 2 ; // old groups moved per insertion
+const hashtagword TAGSUSED = tagsused(HASHGROUP) ;
+#ifdef PRIMEMOD
+#define OLDHASHMOD(a) (hashspread(a)%oldprime)
+#else
+#define OLDHASHMOD(a) (hashspread(a)&(oldprime-1))
+#endif
+static g_uintptr_t hashof(node *p) {
+   if (is_node(p))
+      return node_hash(p->nw, p->ne, p->sw, p->se) ;
+   leaf *l = (leaf *)p ;
+   return leaf_hash(l->nw, l->ne, l->sw, l->se) ;
+}
 void hlifealgo::resize() {
+   if (gcphase)
+      finishgc() ; // sweeping leaves tombstones, so get it done first
 #ifndef NOGCBEFORERESIZE
-   if (okaytogc) {
+   else if (okaytogc && !incrementalgc && !hashfull) {
       do_gc(0) ; // faster resizes if we do a gc first
    }
 #endif
-   g_uintptr_t i, nhashprime = nexthashsize(2 * hashprime) ;
-   node *p, **nhashtab ;
-   if (hashprime > (totalthings >> 2)) {
-      if (alloced > maxmem ||
-          nhashprime * sizeof(node *) > (maxmem - alloced)) {
-         hashlimit = G_MAX ;
+   finishresize() ;
+   g_uintptr_t slots = hashprime * HASHGROUP ;
+   if (hashfull && okaytogc) {
+      do_gc(0) ;
+      if (hashpop + hashdead + slots / 16 <= hashlimit)
+         return ;
+   }
+   g_uintptr_t nhashprime = hashprime ;
+   if (hashdead < hashpop) // otherwise just clear out the tombstones
+      nhashprime = nexthashsize(2 * hashprime) ;
+   g_uintptr_t nbytes = nhashprime * sizeof(hashgroup) ;
+   if (!hashfull && slots > (totalthings >> 2)) {
+      if (alloced > maxmem || nbytes > (maxmem - alloced)) {
+         hashfull = 1 ;
+         hashlimit = slots - slots / 8 ;
          return ;
       }
    }
    if (verbose) {
-     sprintf(statusline, "Resizing hash to %" PRIuPTR "...", nhashprime) ;
+     sprintf(statusline, "Resizing hash to %" PRIuPTR "...",
+             nhashprime * HASHGROUP) ;
      lifestatus(statusline) ;
    }
-   nhashtab = (node **)calloc(nhashprime, sizeof(node *)) ;
+   hashgroup *nhashtab = (hashgroup *)linecalloc(nbytes) ;
    if (nhashtab == 0) {
-     lifewarning("Out of memory; running in a somewhat slower mode; "
-                 "try reducing the hash memory limit after restarting.") ;
-     hashlimit = G_MAX ;
+     if (hashpop + hashdead + slots / 32 > slots)
+       lifefatal("Out of memory; try reducing the hash memory limit.") ;
+     if (!hashfull)
+       lifewarning("Out of memory; running in a somewhat slower mode; "
+                   "try reducing the hash memory limit after restarting.") ;
+     hashfull = 1 ;
+     hashlimit = slots - slots / 32 ;
      return ;
    }
-   alloced += sizeof(node *) * (nhashprime - hashprime) ;
-   g_uintptr_t ohashprime = hashprime ;
+   alloced += nbytes ;
+   oldtab = hashtab ;
+   oldprime = hashprime ;
+   migratecursor = 0 ;
+   hashtab = nhashtab ;
    hashprime = nhashprime ;
 #ifndef PRIMEMOD
    hashmask = hashprime - 1 ;
 #endif
-   for (i=0; i<ohashprime; i++) {
-      for (p=hashtab[i]; p;) {
-         node *np = p->next ;
-         g_uintptr_t h ;
-         if (is_node(p)) {
-            h = node_hash(p->nw, p->ne, p->sw, p->se) ;
-         } else {
-            leaf *l = (leaf *)p ;
-            h = leaf_hash(l->nw, l->ne, l->sw, l->se) ;
-         }
-         h = HASHMOD(h) ;
-         p->next = nhashtab[h] ;
-         nhashtab[h] = p ;
-         p = np ;
+   hashdead = 0 ;
+   hashfull = 0 ;
+   hashlimit = (g_uintptr_t)(maxloadfactor * hashprime * HASHGROUP) ;
+   if (parallel)
+      finishresize() ;
+}
+/*
+ *   Move the entries of the next few groups of the old table over.
+ */
+void hlifealgo::migrate(g_uintptr_t groups) {
+   while (groups-- > 0 && migratecursor < oldprime) {
+      hashgroup *grp = oldtab + migratecursor++ ;
+      for (hashtagword m = tagfull(grp->tags) ; m ; m &= m - 1) {
+         node *p = grp->slot[tagindex(m)] ;
+         hashinsert(p, hashof(p)) ;
       }
+      grp->tags = tagkill(grp->tags) ;
    }
-   free(hashtab) ;
-   hashtab = nhashtab ;
-   hashlimit = (g_uintptr_t)(maxloadfactor * hashprime) ;
+   if (migratecursor >= oldprime)
+      endresize() ;
+}
+void hlifealgo::finishresize() {
+   if (oldtab)
+      migrate(oldprime) ;
+}
+/*
+ *   Drop the old table; everything in it has been moved (or, during a
+ *   collection, will be put back from the node blocks).
+ */
+void hlifealgo::endresize() {
+   alloced -= oldprime * sizeof(hashgroup) ;
+   linefree(oldtab) ;
+   oldtab = 0 ;
    if (verbose) {
-     strcpy(statusline+strlen(statusline), " done.") ;
+     sprintf(statusline, "Resizing hash to %" PRIuPTR "... done.",
+             hashprime * HASHGROUP) ;
      lifestatus(statusline) ;
    }
 }
+/*
+ *   Put a node in the first free slot of its probe sequence, and
+ *   return the group it went to.  This does not count it in hashpop.
+ */
+g_uintptr_t hlifealgo::hashinsert(node *n, g_uintptr_t h) {
+   g_uintptr_t g = HASHMOD(h) ;
+   for (;;) {
+      hashgroup *grp = hashtab + g ;
+      hashtagword m = tagfree(grp->tags) & TAGSUSED ;
+      if (m) {
+         int i = tagindex(m) ;
+         if (tagat(grp->tags, i) == HASHTAGDEAD)
+            hashdead-- ;
+         grp->tags = tagset(grp->tags, i, hashtag(h)) ;
+         grp->slot[i] = n ;
+         return g ;
+      }
+      if (++g == hashprime)
+         g = 0 ;
+   }
+}
+/*
+ *   Leave a tombstone in the slot of the old table at pp.
+ */
+static void killslot(hashgroup *tab, nodeptr *pp) {
+   hashgroup *grp = tab + ((char *)pp - (char *)tab) / sizeof(hashgroup) ;
+   grp->tags = tagset(grp->tags, (int)(pp - grp->slot), HASHTAGDEAD) ;
+}
 /*
  *   These next two routines are (nearly) our only hash table access
  *   routines; we simply look up the passed in information.  If we
@@ -196,20 +477,31 @@ void hlifealgo::resize() {
  *   new node and store it in the hash table, and return that.
  */
 node *hlifealgo::find_node(node *nw, node *ne, node *sw, node *se) {
-   node *p ;
+   if (parallel)
+      return find_node_par(nw, ne, sw, se) ;
    g_uintptr_t h = node_hash(nw,ne,sw,se) ;
-   node *pred = 0 ;
-   h = HASHMOD(h) ;
-   for (p=hashtab[h]; p; p = p->next) { /* make sure to compare nw *first* */
-      if (nw == p->nw && ne == p->ne && sw == p->sw && se == p->se) {
-         if (pred) { /* move this one to the front */
-            pred->next = p->next ;
-            p->next = hashtab[h] ;
-            hashtab[h] = p ;
-         }
+   nodeptr *pp = probe_node(hashtab, hashprime, HASHMOD(h), hashtag(h),
+                            nw, ne, sw, se) ;
+   if (pp)
+      return save(*pp) ;
+   return find_node_miss(nw, ne, sw, se, h) ;
+}
+/*
+ *   Not in the table; it may still be in the old one if a resize is
+ *   under way.
+ */
+node *hlifealgo::find_node_miss(node *nw, node *ne, node *sw, node *se,
+                                g_uintptr_t h) {
+   node *p ;
+   if (oldtab) {
+      nodeptr *pp = probe_node(oldtab, oldprime, OLDHASHMOD(h), hashtag(h),
+                               nw, ne, sw, se) ;
+      if (pp) {
+         killslot(oldtab, pp) ;
+         p = *pp ;
+         hashinsert(p, h) ;
          return save(p) ;
       }
-      pred = p ;
    }
    p = newnode() ;
    p->nw = nw ;
@@ -217,31 +509,39 @@ node *hlifealgo::find_node(node *nw, node *ne, node *sw, node *se) {
    p->sw = sw ;
    p->se = se ;
    p->res = 0 ;
-   p->next = hashtab[h] ;
-   hashtab[h] = p ;
+#ifdef NODEMETA
+   setmeta(p) ;
+#endif
+   g_uintptr_t g = hashinsert(p, h) ;
+   if (gcphase)
+      gcnewnode(p, g) ;
    hashpop++ ;
    save(p) ;
-   if (hashpop > hashlimit)
+   if (hashpop + hashdead > hashlimit)
       resize() ;
+   else if (oldtab)
+      migrate(MIGRATEGROUPS) ;
    return p ;
 }
 leaf *hlifealgo::find_leaf(unsigned short nw, unsigned short ne,
                                   unsigned short sw, unsigned short se) {
+   if (parallel)
+      return find_leaf_par(nw, ne, sw, se) ;
    leaf *p ;
-   leaf *pred = 0 ;
    g_uintptr_t h = leaf_hash(nw, ne, sw, se) ;
-   h = HASHMOD(h) ;
-   for (p=(leaf *)hashtab[h]; p; p = (leaf *)p->next) {
-      if (nw == p->nw && ne == p->ne && sw == p->sw && se == p->se &&
-          !is_node(p)) {
-         if (pred) {
-            pred->next = p->next ;
-            p->next = hashtab[h] ;
-            hashtab[h] = (node *)p ;
-         }
+   nodeptr *pp = probe_leaf(hashtab, hashprime, HASHMOD(h), hashtag(h),
+                            nw, ne, sw, se) ;
+   if (pp)
+      return (leaf *)save(*pp) ;
+   if (oldtab) {
+      pp = probe_leaf(oldtab, oldprime, OLDHASHMOD(h), hashtag(h),
+                      nw, ne, sw, se) ;
+      if (pp) {
+         killslot(oldtab, pp) ;
+         p = (leaf *)(node *)*pp ;
+         hashinsert((node *)p, h) ;
          return (leaf *)save((node *)p) ;
       }
-      pred = p ;
    }
    p = newleaf() ;
    p->nw = nw ;
@@ -250,12 +550,15 @@ leaf *hlifealgo::find_leaf(unsigned short nw, unsigned short ne,
    p->se = se ;
    leafres(p) ;
    p->isnode = 0 ;
-   p->next = hashtab[h] ;
-   hashtab[h] = (node *)p ;
+   g_uintptr_t g = hashinsert((node *)p, h) ;
+   if (gcphase)
+      gcnewnode((node *)p, g) ;
    hashpop++ ;
    save((node *)p) ;
-   if (hashpop > hashlimit)
+   if (hashpop + hashdead > hashlimit)
       resize() ;
+   else if (oldtab)
+      migrate(MIGRATEGROUPS) ;
    return p ;
 }
 /*
@@ -267,9 +570,11 @@ leaf *hlifealgo::find_leaf(unsigned short nw, unsigned short ne,
  *   stack pointer and garbage collection stuff.
  */
 node *hlifealgo::getres(node *n, int depth) {
-   if (n->res)
-     return n->res ;
-   node *res = 0 ;
+   node *res = loadres(n) ;
+   if (res)
+     return res ;
+   if (parallel)
+     return getres_par(n, depth) ;
    /**
     *   This routine be the only place we assign to res.  We use
     *   the fact that the poll routine is *sticky* to allow us to
@@ -287,24 +592,7 @@ node *hlifealgo::getres(node *n, int depth) {
    if (running_hperf.fastinc(depth, ngens < depth))
       running_hperf.report(inc_hperf, verbose) ;
    depth-- ;
-   if (ngens >= depth) {
-     if (is_node(n->nw)) {
-       res = dorecurs(n->nw, n->ne, n->sw, n->se, depth) ;
-     } else {
-       res = (node *)dorecurs_leaf((leaf *)n->nw, (leaf *)n->ne,
-                                   (leaf *)n->sw, (leaf *)n->se) ;
-     }
-   } else {
-     if (is_node(n->nw)) {
-       res = dorecurs_half(n->nw, n->ne, n->sw, n->se, depth) ;
-     } else if (ngens == 0) {
-       res = (node *)dorecurs_leaf_quarter((leaf *)n->nw, (leaf *)n->ne,
-                                           (leaf *)n->sw, (leaf *)n->se) ;
-     } else {
-       res = (node *)dorecurs_leaf_half((leaf *)n->nw, (leaf *)n->ne,
-                                        (leaf *)n->sw, (leaf *)n->se) ;
-     }
-   }
+   res = calcres(n, depth) ;
    pop(sp) ;
    if (softinterrupt ||
        poller->isInterrupted()) // don't assign this to the cache field!
@@ -313,9 +601,41 @@ node *hlifealgo::getres(node *n, int depth) {
      if (ngens < depth && halvesdone < 1000)
        halvesdone++ ;
      n->res = res ;
+     if (gcphase == 1) // n may already have been scanned
+       shade(res) ;
    }
    return res ;
 }
+/*
+ *   Pick the right recursion for the children of n, which are at the
+ *   given depth.  Big nodes go to the multithreaded versions if we
+ *   have more than one thread.
+ */
+node *hlifealgo::calcres(node *n, int depth) {
+   int split = (depth >= pardepth && lifethreads::getthreadcount() > 1) ;
+   if (ngens >= depth) {
+     if (is_node(n->nw)) {
+       if (split)
+         return dorecurs_par(n->nw, n->ne, n->sw, n->se, depth) ;
+       return dorecurs(n->nw, n->ne, n->sw, n->se, depth) ;
+     } else {
+       return (node *)dorecurs_leaf((leaf *)(node *)n->nw, (leaf *)(node *)n->ne,
+                                    (leaf *)(node *)n->sw, (leaf *)(node *)n->se) ;
+     }
+   } else {
+     if (is_node(n->nw)) {
+       if (split)
+         return dorecurs_half_par(n->nw, n->ne, n->sw, n->se, depth) ;
+       return dorecurs_half(n->nw, n->ne, n->sw, n->se, depth) ;
+     } else if (ngens == 0) {
+       return (node *)dorecurs_leaf_quarter((leaf *)(node *)n->nw, (leaf *)(node *)n->ne,
+                                            (leaf *)(node *)n->sw, (leaf *)(node *)n->se) ;
+     } else {
+       return (node *)dorecurs_leaf_half((leaf *)(node *)n->nw, (leaf *)(node *)n->ne,
+                                         (leaf *)(node *)n->sw, (leaf *)(node *)n->se) ;
+     }
+   }
+}
 #ifdef USEPREFETCH
 void hlifealgo::setupprefetch(setup_t &su, node *nw, node *ne, node *sw, node *se) {
    su.h = node_hash(nw,ne,sw,se) ;
@@ -326,36 +646,16 @@ void hlifealgo::setupprefetch(setup_t &su, node *nw, node *ne, node *sw, node *s
    su.prefetch(hashtab + HASHMOD(su.h)) ;
 }
 node *hlifealgo::find_node(setup_t &su) {
-   node *p ;
-   node *pred = 0 ;
-   g_uintptr_t h = HASHMOD(su.h) ;
-   for (p=hashtab[h]; p; p = p->next) { /* make sure to compare nw *first* */
-      if (su.nw == p->nw && su.ne == p->ne && su.sw == p->sw && su.se == p->se) {
-         if (pred) { /* move this one to the front */
-            pred->next = p->next ;
-            p->next = hashtab[h] ;
-            hashtab[h] = p ;
-         }
-         return save(p) ;
-      }
-      pred = p ;
-   }
-   p = newnode() ;
-   p->nw = su.nw ;
-   p->ne = su.ne ;
-   p->sw = su.sw ;
-   p->se = su.se ;
-   p->res = 0 ;
-   p->next = hashtab[h] ;
-   hashtab[h] = p ;
-   hashpop++ ;
-   save(p) ;
-   if (hashpop > hashlimit)
-      resize() ;
-   return p ;
+   if (parallel)
+      return find_node_par(su.nw, su.ne, su.sw, su.se) ;
+   nodeptr *pp = probe_node(hashtab, hashprime, HASHMOD(su.h), hashtag(su.h),
+                            su.nw, su.ne, su.sw, su.se) ;
+   if (pp)
+      return save(*pp) ;
+   return find_node_miss(su.nw, su.ne, su.sw, su.se, su.h) ;
 }
 node *hlifealgo::dorecurs(node *n, node *ne, node *t, node *e, int depth) {
-   int sp = gsp ;
+   int sp = stackmark() ;
    setup_t su[5] ;
    setupprefetch(su[2], n->se, ne->sw, t->ne, e->nw) ;
    setupprefetch(su[0], n->ne, ne->nw, n->se, ne->sw) ;
@@ -399,7 +699,7 @@ node *hlifealgo::dorecurs(node *n, node *ne, node *t, node *e, int depth) {
  *   then put these together into a new n/2-square.  Simple, eh?
  */
 node *hlifealgo::dorecurs(node *n, node *ne, node *t, node *e, int depth) {
-   int sp = gsp ;
+   int sp = stackmark() ;
    node
    *t11 = getres(find_node(n->se, ne->sw, t->ne, e->nw), depth),
    *t00 = getres(n, depth),
@@ -424,22 +724,30 @@ node *hlifealgo::dorecurs(node *n, node *ne, node *t, node *e, int depth) {
  */
 node *hlifealgo::dorecurs_half(node *n, node *ne, node *t,
                                node *e, int depth) {
-   int sp = gsp ;
+   int sp = stackmark() ;
+   setup_t su[5] ;
+   setupprefetch(su[0], n->ne, ne->nw, n->se, ne->sw) ;
+   setupprefetch(su[1], n->sw, n->se, t->nw, t->ne) ;
+   setupprefetch(su[2], n->se, ne->sw, t->ne, e->nw) ;
+   setupprefetch(su[3], ne->sw, ne->se, e->nw, e->ne) ;
+   setupprefetch(su[4], t->ne, e->nw, t->se, e->sw) ;
    node
    *t00 = getres(n, depth),
-   *t01 = getres(find_node(n->ne, ne->nw, n->se, ne->sw), depth),
-   *t10 = getres(find_node(n->sw, n->se, t->nw, t->ne), depth),
-   *t11 = getres(find_node(n->se, ne->sw, t->ne, e->nw), depth),
+   *t01 = getres(find_node(su[0]), depth),
+   *t10 = getres(find_node(su[1]), depth),
+   *t11 = getres(find_node(su[2]), depth),
    *t02 = getres(ne, depth),
-   *t12 = getres(find_node(ne->sw, ne->se, e->nw, e->ne), depth),
+   *t12 = getres(find_node(su[3]), depth),
    *t20 = getres(t, depth),
-   *t21 = getres(find_node(t->ne, e->nw, t->se, e->sw), depth),
+   *t21 = getres(find_node(su[4]), depth),
    *t22 = getres(e, depth) ;
    if (depth > 3) {
-      n = find_node(find_node(t00->se, t01->sw, t10->ne, t11->nw),
-                    find_node(t01->se, t02->sw, t11->ne, t12->nw),
-                    find_node(t10->se, t11->sw, t20->ne, t21->nw),
-                    find_node(t11->se, t12->sw, t21->ne, t22->nw)) ;
+      setupprefetch(su[0], t00->se, t01->sw, t10->ne, t11->nw) ;
+      setupprefetch(su[1], t01->se, t02->sw, t11->ne, t12->nw) ;
+      setupprefetch(su[2], t10->se, t11->sw, t20->ne, t21->nw) ;
+      setupprefetch(su[3], t11->se, t12->sw, t21->ne, t22->nw) ;
+      n = find_node(find_node(su[0]), find_node(su[1]),
+                    find_node(su[2]), find_node(su[3])) ;
    } else {
       n = find_node((node *)find_leaf(((leaf *)t00)->se,
                                              ((leaf *)t01)->sw,
@@ -461,6 +769,362 @@ node *hlifealgo::dorecurs_half(node *n, node *ne, node *t,
    pop(sp) ;
    return save(n) ;
 }
+/*
+ *   A direct kernel for the bottom level.  For plain outer-totalistic
+ *   rules on the Moore neighborhood without B0 we skip both the rule
+ *   table and the nine intermediate leaves dorecurs_leaf() would build,
+ *   and run the whole 16-square forward with bit-sliced logic instead.
+ *   Each row is sixteen cells in a 16-bit lane.  The three-cell sums
+ *   along each row are added to those of the rows above and below with
+ *   full adders, giving the nine-cell sum (center included) as four
+ *   bit planes, and the rule is a sum of products over those planes.
+ *   Cells near the edge go wrong a little more each generation, but
+ *   after k generations the center 16-2k square is exact, so for up to
+ *   four generations we can read off the center 8-square.
+ *
+ *   A leaf goes in and out as a 64-bit word with one row per byte,
+ *   the bottom row in the low byte; since the rules are symmetric the
+ *   lanes simply hold the rows bottom to top.  With AVX2 all sixteen
+ *   rows fit in one register, and with SSE2 or NEON we use two.  On
+ *   other machines (where the same logic in plain 64-bit words loses
+ *   to the table) the table is the only path.
+ */
+typedef unsigned long long leafbytes ;
+#if defined(__AVX2__) || defined(__SSE2__) || defined(_M_X64)
+// lanes 0..7 from the rows of the west and east leaves
+static inline __m128i lv_half(leafbytes w, leafbytes e) {
+   return _mm_unpacklo_epi8(_mm_loadl_epi64((const __m128i *)&e),
+                            _mm_loadl_epi64((const __m128i *)&w)) ;
+}
+// the middle eight bits of lanes 4..11 as bytes
+static inline leafbytes lv_center(__m128i lo, __m128i hi) {
+   const __m128i m = _mm_set1_epi16(0xff) ;
+   __m128i b = _mm_packus_epi16(_mm_and_si128(_mm_srli_epi16(lo, 4), m),
+                                _mm_and_si128(_mm_srli_epi16(hi, 4), m)) ;
+   leafbytes r ;
+   _mm_storel_epi64((__m128i *)&r, _mm_srli_si128(b, 4)) ;
+   return r ;
+}
+#endif
+#if defined(__AVX2__)
+#define LEAFKERNELNAME "AVX2"
+struct leafvec { __m256i v ; } ;
+static inline leafvec lv(__m256i v) { leafvec r ; r.v = v ; return r ; }
+static inline leafvec lv_join(leafbytes nw, leafbytes ne,
+                              leafbytes sw, leafbytes se) {
+   return lv(_mm256_inserti128_si256(
+                _mm256_castsi128_si256(lv_half(sw, se)), lv_half(nw, ne), 1)) ;
+}
+static inline leafbytes lv_split(leafvec a) {
+   return lv_center(_mm256_castsi256_si128(a.v),
+                    _mm256_extracti128_si256(a.v, 1)) ;
+}
+static inline leafvec lv_ones() { return lv(_mm256_set1_epi16(-1)) ; }
+static inline leafvec lv_and(leafvec a, leafvec b) {
+   return lv(_mm256_and_si256(a.v, b.v)) ;
+}
+static inline leafvec lv_or(leafvec a, leafvec b) {
+   return lv(_mm256_or_si256(a.v, b.v)) ;
+}
+static inline leafvec lv_xor(leafvec a, leafvec b) {
+   return lv(_mm256_xor_si256(a.v, b.v)) ;
+}
+// a & ~b
+static inline leafvec lv_andnot(leafvec a, leafvec b) {
+   return lv(_mm256_andnot_si256(b.v, a.v)) ;
+}
+static inline leafvec lv_west(leafvec a) {
+   return lv(_mm256_srli_epi16(a.v, 1)) ;
+}
+static inline leafvec lv_east(leafvec a) {
+   return lv(_mm256_slli_epi16(a.v, 1)) ;
+}
+// each row gets the one above it (the top row gets zero)
+static inline leafvec lv_north(leafvec a) {
+   return lv(_mm256_alignr_epi8(a.v,
+                     _mm256_permute2x128_si256(a.v, a.v, 0x08), 14)) ;
+}
+// each row gets the one below it (the bottom row gets zero)
+static inline leafvec lv_south(leafvec a) {
+   return lv(_mm256_alignr_epi8(
+                     _mm256_permute2x128_si256(a.v, a.v, 0x81), a.v, 2)) ;
+}
+#elif defined(__SSE2__) || defined(_M_X64)
+#define LEAFKERNELNAME "SSE2"
+struct leafvec { __m128i lo, hi ; } ;
+static inline leafvec lv(__m128i lo, __m128i hi) {
+   leafvec r ;
+   r.lo = lo ;
+   r.hi = hi ;
+   return r ;
+}
+static inline leafvec lv_join(leafbytes nw, leafbytes ne,
+                              leafbytes sw, leafbytes se) {
+   return lv(lv_half(sw, se), lv_half(nw, ne)) ;
+}
+static inline leafbytes lv_split(leafvec a) { return lv_center(a.lo, a.hi) ; }
+static inline leafvec lv_ones() {
+   return lv(_mm_set1_epi16(-1), _mm_set1_epi16(-1)) ;
+}
+static inline leafvec lv_and(leafvec a, leafvec b) {
+   return lv(_mm_and_si128(a.lo, b.lo), _mm_and_si128(a.hi, b.hi)) ;
+}
+static inline leafvec lv_or(leafvec a, leafvec b) {
+   return lv(_mm_or_si128(a.lo, b.lo), _mm_or_si128(a.hi, b.hi)) ;
+}
+static inline leafvec lv_xor(leafvec a, leafvec b) {
+   return lv(_mm_xor_si128(a.lo, b.lo), _mm_xor_si128(a.hi, b.hi)) ;
+}
+static inline leafvec lv_andnot(leafvec a, leafvec b) {
+   return lv(_mm_andnot_si128(b.lo, a.lo), _mm_andnot_si128(b.hi, a.hi)) ;
+}
+static inline leafvec lv_west(leafvec a) {
+   return lv(_mm_srli_epi16(a.lo, 1), _mm_srli_epi16(a.hi, 1)) ;
+}
+static inline leafvec lv_east(leafvec a) {
+   return lv(_mm_slli_epi16(a.lo, 1), _mm_slli_epi16(a.hi, 1)) ;
+}
+static inline leafvec lv_north(leafvec a) {
+   return lv(_mm_slli_si128(a.lo, 2),
+             _mm_or_si128(_mm_slli_si128(a.hi, 2), _mm_srli_si128(a.lo, 14))) ;
+}
+static inline leafvec lv_south(leafvec a) {
+   return lv(_mm_or_si128(_mm_srli_si128(a.lo, 2), _mm_slli_si128(a.hi, 14)),
+             _mm_srli_si128(a.hi, 2)) ;
+}
+#elif defined(__ARM_NEON)
+#define LEAFKERNELNAME "NEON"
+struct leafvec { uint16x8_t lo, hi ; } ;
+static inline leafvec lv(uint16x8_t lo, uint16x8_t hi) {
+   leafvec r ;
+   r.lo = lo ;
+   r.hi = hi ;
+   return r ;
+}
+static inline uint16x8_t lv_half(leafbytes w, leafbytes e) {
+   uint8x8x2_t z = vzip_u8(vcreate_u8(e), vcreate_u8(w)) ;
+   return vreinterpretq_u16_u8(vcombine_u8(z.val[0], z.val[1])) ;
+}
+static inline leafvec lv_join(leafbytes nw, leafbytes ne,
+                              leafbytes sw, leafbytes se) {
+   return lv(lv_half(sw, se), lv_half(nw, ne)) ;
+}
+static inline leafbytes lv_split(leafvec a) {
+   uint8x8_t c = vext_u8(vshrn_n_u16(a.lo, 4), vshrn_n_u16(a.hi, 4), 4) ;
+   return vget_lane_u64(vreinterpret_u64_u8(c), 0) ;
+}
+static inline leafvec lv_ones() {
+   return lv(vdupq_n_u16(0xffff), vdupq_n_u16(0xffff)) ;
+}
+static inline leafvec lv_and(leafvec a, leafvec b) {
+   return lv(vandq_u16(a.lo, b.lo), vandq_u16(a.hi, b.hi)) ;
+}
+static inline leafvec lv_or(leafvec a, leafvec b) {
+   return lv(vorrq_u16(a.lo, b.lo), vorrq_u16(a.hi, b.hi)) ;
+}
+static inline leafvec lv_xor(leafvec a, leafvec b) {
+   return lv(veorq_u16(a.lo, b.lo), veorq_u16(a.hi, b.hi)) ;
+}
+static inline leafvec lv_andnot(leafvec a, leafvec b) {
+   return lv(vbicq_u16(a.lo, b.lo), vbicq_u16(a.hi, b.hi)) ;
+}
+static inline leafvec lv_west(leafvec a) {
+   return lv(vshrq_n_u16(a.lo, 1), vshrq_n_u16(a.hi, 1)) ;
+}
+static inline leafvec lv_east(leafvec a) {
+   return lv(vshlq_n_u16(a.lo, 1), vshlq_n_u16(a.hi, 1)) ;
+}
+static inline leafvec lv_north(leafvec a) {
+   return lv(vextq_u16(vdupq_n_u16(0), a.lo, 7), vextq_u16(a.lo, a.hi, 7)) ;
+}
+static inline leafvec lv_south(leafvec a) {
+   return lv(vextq_u16(a.lo, a.hi, 1), vextq_u16(a.hi, vdupq_n_u16(0), 1)) ;
+}
+#endif
+#ifdef LEAFKERNELNAME
+static inline leafvec lv_not(leafvec a) { return lv_xor(a, lv_ones()) ; }
+/*
+ *   One generation.  The nine-cell sum comes out as bit planes s3..s0;
+ *   a cell is born if bit sum of rule.born is set and the center is
+ *   dead, and lives on if bit sum of rule.survive is set and the
+ *   center is live (so survive is the survival set shifted up by one).
+ */
+static inline leafvec leafgen(leafvec x, const leafrule &rule) {
+   leafvec w = lv_west(x), e = lv_east(x) ;
+   leafvec wx = lv_xor(w, x) ;
+   leafvec h0 = lv_xor(wx, e) ;
+   leafvec h1 = lv_or(lv_and(w, x), lv_and(wx, e)) ;
+   leafvec n0 = lv_north(h0), n1 = lv_north(h1) ;
+   leafvec d0 = lv_south(h0), d1 = lv_south(h1) ;
+   leafvec t0 = lv_xor(n0, h0) ;
+   leafvec s0 = lv_xor(t0, d0) ;
+   leafvec c0 = lv_or(lv_and(n0, h0), lv_and(t0, d0)) ;
+   leafvec t1 = lv_xor(n1, h1) ;
+   leafvec a1 = lv_xor(t1, d1) ;
+   leafvec c1 = lv_or(lv_and(n1, h1), lv_and(t1, d1)) ;
+   leafvec s1 = lv_xor(a1, c0) ;
+   leafvec c2 = lv_and(a1, c0) ;
+   leafvec s2 = lv_xor(c1, c2) ;
+   leafvec s3 = lv_and(c1, c2) ;
+   leafvec hi[3], lo[4] ;
+   hi[0] = lv_not(lv_or(s2, s3)) ;
+   hi[1] = lv_andnot(s2, s3) ;
+   hi[2] = s3 ;
+   lo[0] = lv_not(lv_or(s1, s0)) ;
+   lo[1] = lv_andnot(s0, s1) ;
+   lo[2] = lv_andnot(s1, s0) ;
+   lo[3] = lv_and(s1, s0) ;
+   leafvec zero = lv_xor(x, x) ;
+   leafvec born = zero, survive = zero ;
+   for (int g=0; g<3; g++) {
+      int bm = (rule.born >> (4 * g)) & 15 ;
+      int sm = (rule.survive >> (4 * g)) & 15 ;
+      if (bm) {
+         leafvec m = zero ;
+         for (int j=0; j<4; j++)
+            if ((bm >> j) & 1)
+               m = lv_or(m, lo[j]) ;
+         born = lv_or(born, lv_and(hi[g], m)) ;
+      }
+      if (sm) {
+         leafvec m = zero ;
+         for (int j=0; j<4; j++)
+            if ((sm >> j) & 1)
+               m = lv_or(m, lo[j]) ;
+         survive = lv_or(survive, lv_and(hi[g], m)) ;
+      }
+   }
+   return lv_or(lv_andnot(born, x), lv_and(survive, x)) ;
+}
+/*
+ *   A 4-square's rows as the low nibbles of four bytes, bottom row
+ *   lowest, and back.
+ */
+static inline unsigned int nibblebytes(unsigned int v) {
+   v = (v | (v << 8)) & 0x00ff00ff ;
+   return (v | (v << 4)) & 0x0f0f0f0f ;
+}
+static inline unsigned short bytesnibble(unsigned int v) {
+   v &= 0x0f0f0f0f ;
+   v = (v | (v >> 4)) & 0x00ff00ff ;
+   return (unsigned short)(v | (v >> 8)) ;
+}
+static inline leafbytes leafrows(const leaf *l) {
+   return ((leafbytes)((nibblebytes(l->nw) << 4) | nibblebytes(l->ne)) << 32) |
+          ((nibblebytes(l->sw) << 4) | nibblebytes(l->se)) ;
+}
+/*
+ *   Advance the 16-square made of the four leaves gens (1, 2 or 4)
+ *   generations and return the center 8-square as the four shorts of
+ *   a leaf.
+ */
+static inline void leafkernel16(const leaf *n, const leaf *ne,
+                                const leaf *t, const leaf *e,
+                                const leafrule &rule, int gens,
+                                unsigned short *res) {
+   leafvec x = lv_join(leafrows(n), leafrows(ne), leafrows(t), leafrows(e)) ;
+   for (int i=0; i<gens; i++)
+      x = leafgen(x, rule) ;
+   leafbytes r = lv_split(x) ;
+   unsigned int top = (unsigned int)(r >> 32), bot = (unsigned int)r ;
+   res[0] = bytesnibble(top >> 4) ;
+   res[1] = bytesnibble(top) ;
+   res[2] = bytesnibble(bot >> 4) ;
+   res[3] = bytesnibble(bot) ;
+}
+#endif
+/*
+ *   The kernel applies only if rule0 is exactly some outer-totalistic
+ *   Moore rule without B0.
+ */
+void hlifealgo::setleafrule() {
+   leafkernel = 0 ;
+   if (hliferules.alternate_rules ||
+       !liferules::mooresums(ruletable, lrule.born, lrule.survive)) {
+      lrule.born = lrule.survive = 0 ;
+      return ;
+   }
+#ifdef LEAFKERNELNAME
+   if ((lrule.born & 1) == 0)
+      leafkernel = 1 ;
+#endif
+}
+/*
+ *   For the benchmark:  what dorecurs_leaf() computes without the
+ *   kernel, less the hashing, counting the res work of all thirteen
+ *   leaves it touches.
+ */
+static void leaftable16(const char *ruletable, const leaf *n,
+                        const leaf *ne, const leaf *t, const leaf *e,
+                        unsigned short *res) {
+   unsigned short r1, t00, t01, t02, t10, t11, t12, t20, t21, t22 ;
+   rulecalc(ruletable, n->nw, n->ne, n->sw, n->se, &r1, &t00) ;
+   rulecalc(ruletable, n->ne, ne->nw, n->se, ne->sw, &r1, &t01) ;
+   rulecalc(ruletable, ne->nw, ne->ne, ne->sw, ne->se, &r1, &t02) ;
+   rulecalc(ruletable, n->sw, n->se, t->nw, t->ne, &r1, &t10) ;
+   rulecalc(ruletable, n->se, ne->sw, t->ne, e->nw, &r1, &t11) ;
+   rulecalc(ruletable, ne->sw, ne->se, e->nw, e->ne, &r1, &t12) ;
+   rulecalc(ruletable, t->nw, t->ne, t->sw, t->se, &r1, &t20) ;
+   rulecalc(ruletable, t->ne, e->nw, t->se, e->sw, &r1, &t21) ;
+   rulecalc(ruletable, e->nw, e->ne, e->sw, e->se, &r1, &t22) ;
+   rulecalc(ruletable, t00, t01, t10, t11, &r1, &res[0]) ;
+   rulecalc(ruletable, t01, t02, t11, t12, &r1, &res[1]) ;
+   rulecalc(ruletable, t10, t11, t20, t21, &r1, &res[2]) ;
+   rulecalc(ruletable, t11, t12, t21, t22, &r1, &res[3]) ;
+}
+void hlifealgo::leafbenchmark(int millions) {
+   const int NLEAVES = 1024 ;
+   leaf *leaves = new leaf[NLEAVES] ;
+   unsigned int seed = 12345 ;
+   for (int i=0; i<NLEAVES; i++) {
+      unsigned short *q = &leaves[i].nw ;
+      for (int j=0; j<4; j++) {
+         seed = seed * 1103515245 + 12345 ;
+         q[j] = (unsigned short)(seed >> 16) ;
+      }
+   }
+   double evals = 1000000.0 * millions ;
+   unsigned int check[2] = { 0, 0 } ;
+   double rate[2] = { 0, 0 } ;
+   for (int pass=0; pass<2; pass++) {
+      if (pass == 0 && !leafkernel)
+         continue ;
+      double start = gollySecondCount() ;
+      unsigned int k = 0, sum = 0 ;
+      for (int m=0; m<millions; m++)
+         for (int i=0; i<1000000; i++) {
+            unsigned short r[4] ;
+            leaf *n = leaves + (k & (NLEAVES-1)) ;
+            leaf *ne = leaves + ((k + 1) & (NLEAVES-1)) ;
+            leaf *t = leaves + ((k + 2) & (NLEAVES-1)) ;
+            leaf *e = leaves + ((k + 3) & (NLEAVES-1)) ;
+            k += 3 ;
+#ifdef LEAFKERNELNAME
+            if (pass == 0)
+               leafkernel16(n, ne, t, e, lrule, 4, r) ;
+            else
+#endif
+               leaftable16(ruletable, n, ne, t, e, r) ;
+            sum = sum * 31 + (r[0] ^ (r[1] << 4) ^ (r[2] << 8) ^ (r[3] << 12)) ;
+         }
+      double secs = gollySecondCount() - start ;
+      check[pass] = sum ;
+      rate[pass] = secs > 0 ? evals / secs : 0 ;
+   }
+   delete [] leaves ;
+#ifdef LEAFKERNELNAME
+   if (leafkernel) {
+      sprintf(statusline,
+              "Leaf kernel (%s): %g evals/s; rule table: %g evals/s%s",
+              LEAFKERNELNAME, rate[0], rate[1],
+              check[0] == check[1] ? "" : " (MISMATCH)") ;
+   } else
+#endif
+      sprintf(statusline,
+              "Leaf kernel not used for this rule; rule table: %g evals/s",
+              rate[1]) ;
+   lifestatus(statusline) ;
+}
 /*
  *   If the node is a 16-node, then the constituents are leaves, so we
  *   need a very similar but still somewhat different subroutine.  Since
@@ -468,6 +1132,13 @@ node *hlifealgo::dorecurs_half(node *n, node *ne, node *t,
  *   save/pop mumbo-jumbo.
  */
 leaf *hlifealgo::dorecurs_leaf(leaf *n, leaf *ne, leaf *t, leaf *e) {
+#ifdef LEAFKERNELNAME
+   if (leafkernel) {
+      unsigned short r[4] ;
+      leafkernel16(n, ne, t, e, lrule, 4, r) ;
+      return find_leaf(r[0], r[1], r[2], r[3]) ;
+   }
+#endif
    unsigned short
    t00 = n->res2,
    t01 = find_leaf(n->ne, ne->nw, n->se, ne->sw)->res2,
@@ -489,6 +1160,13 @@ leaf *hlifealgo::dorecurs_leaf(leaf *n, leaf *ne, leaf *t, leaf *e) {
 #define combine4(t00,t01,t10,t11) (unsigned short)\
 ((((t00)<<10)&0xcc00)|(((t01)<<6)&0x3300)|(((t10)>>6)&0xcc)|(((t11)>>10)&0x33))
 leaf *hlifealgo::dorecurs_leaf_half(leaf *n, leaf *ne, leaf *t, leaf *e) {
+#ifdef LEAFKERNELNAME
+   if (leafkernel) {
+      unsigned short r[4] ;
+      leafkernel16(n, ne, t, e, lrule, 2, r) ;
+      return find_leaf(r[0], r[1], r[2], r[3]) ;
+   }
+#endif
    unsigned short
    t00 = n->res2,
    t01 = find_leaf(n->ne, ne->nw, n->se, ne->sw)->res2,
@@ -509,6 +1187,13 @@ leaf *hlifealgo::dorecurs_leaf_half(leaf *n, leaf *ne, leaf *t, leaf *e) {
  */
 leaf *hlifealgo::dorecurs_leaf_quarter(leaf *n, leaf *ne,
                                    leaf *t, leaf *e) {
+#ifdef LEAFKERNELNAME
+   if (leafkernel) {
+      unsigned short r[4] ;
+      leafkernel16(n, ne, t, e, lrule, 1, r) ;
+      return find_leaf(r[0], r[1], r[2], r[3]) ;
+   }
+#endif
    unsigned short
    t00 = n->res1,
    t01 = find_leaf(n->ne, ne->nw, n->se, ne->sw)->res1,
@@ -524,29 +1209,578 @@ leaf *hlifealgo::dorecurs_leaf_quarter(leaf *n, leaf *ne,
                     combine4(t10, t11, t20, t21),
                     combine4(t11, t12, t21, t22)) ;
 }
+/*
+ *   Multithreaded evaluation.  When the pool in util.h has more than
+ *   one thread, calcres() hands nodes at depth pardepth or more to
+ *   dorecurs_par() or dorecurs_half_par(), which find the nine (and
+ *   then four) independent sub-squares serially and evaluate their
+ *   results as tasks on the pool.  Tasks recurse through getres() as
+ *   usual and split again when they meet another big node.  From the
+ *   first split until the outermost one returns we are "parallel",
+ *   and the shared structures are protected as follows:
+ *
+ *   -  Lookups take no lock.  After a miss we allocate a node, then
+ *      take the striped lock for the key's home group and look again
+ *      before inserting, so two threads never add the same node; if
+ *      another thread inserted it meanwhile we give ours back.  An
+ *      insertion claims an empty slot by a compare and swap on its
+ *      tag word and then publishes the pointer, so readers skip a
+ *      claimed slot whose pointer is still null.  Nothing is removed
+ *      from the table while we are parallel.
+ *   -  The free list, alloced and hashpop have a lock of their own.
+ *   -  Every thread has its own gc stack, and all of them are roots.
+ *   -  Garbage collection and hash resizing stop the world:  the
+ *      thread that needs one waits until every other thread is
+ *      parked (at the top of getres_par, or idle waiting for tasks)
+ *      and then runs the ordinary serial routine.
+ *   -  A res field is published with a release store.  Two threads
+ *      may race to compute the same result, but canonicalization
+ *      means they both store the same node, so the race is benign.
+ *
+ *   Only the thread that called step() polls for events; the others
+ *   just watch the sticky interrupted flag.  The results are the same
+ *   nodes the serial code would build, so patterns evolve identically.
+ */
+int hlifealgo::pardepth = 10 ;
+void hlifealgo::setParallelDepth(int d) {
+   if (d < 5)
+      d = 5 ;
+   pardepth = d ;
+}
+struct htask : public lifetask {
+   hlifealgo *algo ;
+   node *in, **out ;
+   int depth ;
+   virtual void run() { algo->runtask(this) ; }
+} ;
+/*
+ *   Park the current thread until the world is restarted.  Called with
+ *   par->mutex held.
+ */
+static void parkthread(hparallel *par, std::unique_lock<std::mutex> &lk) {
+   par->active-- ;
+   par->cv.notify_all() ;
+   while (par->stwpending)
+      par->cv.wait(lk) ;
+   par->active++ ;
+}
+void hlifealgo::enteractive() {
+   std::unique_lock<std::mutex> lk(par->mutex) ;
+   while (par->stwpending)
+      par->cv.wait(lk) ;
+   par->active++ ;
+}
+void hlifealgo::leaveactive() {
+   std::unique_lock<std::mutex> lk(par->mutex) ;
+   par->active-- ;
+   par->cv.notify_all() ;
+}
+void hlifealgo::safepoint() {
+   std::unique_lock<std::mutex> lk(par->mutex) ;
+   if (par->stwpending)
+      parkthread(par, lk) ;
+}
+/*
+ *   Run a gc (what == 0) or a hash resize (what == 1) with all other
+ *   threads parked.  If someone else got there first we simply park
+ *   and let them do it.
+ */
+void hlifealgo::stopworld(int what) {
+   std::unique_lock<std::mutex> lk(par->mutex) ;
+   if (par->stwpending) {
+      parkthread(par, lk) ;
+      return ;
+   }
+   par->stwpending = 1 ;
+   while (par->active > 1)
+      par->cv.wait(lk) ;
+   lk.unlock() ;
+   if (what == 0) {
+      do_gc(0) ;
+   } else {
+      int full ;
+      {
+         std::lock_guard<std::mutex> alk(par->allocmutex) ;
+         full = (hashpop + hashdead > hashlimit) ;
+      }
+      if (full)
+         resize() ;
+   }
+   lk.lock() ;
+   par->stwpending = 0 ;
+   par->cv.notify_all() ;
+}
+int hlifealgo::beginparallel() {
+   if (parallel)
+      return 0 ;
+   if (gcphase)
+      finishgc() ; // the parallel lookups do not know about mark bits
+   finishresize() ; // nor about the old table
+   if (par == 0)
+      par = new hparallel() ;
+   par->owner = lifethreads::threadindex() ;
+   par->active = 1 ;
+   par->stwpending = 0 ;
+   parallel = 1 ;
+   return 1 ;
+}
+/*
+ *   Fold the per-thread counters back into the running totals so the
+ *   usual performance reports include the work of every thread.
+ */
+void hlifealgo::endparallel() {
+   for (int i=0; i<MAX_THREADS; i++) {
+      hperf &p = par->ts[i].perf ;
+      running_hperf.nodesCalculated += p.fastNodeInc ;
+      running_hperf.halfNodes += p.halfNodes ;
+      running_hperf.depthSum += p.depthSum ;
+      running_hperf.tasks += p.tasks ;
+      p.fastNodeInc = 0 ;
+      p.halfNodes = 0 ;
+      p.depthSum = 0 ;
+      p.tasks = 0 ;
+   }
+   parallel = 0 ;
+}
+int hlifealgo::stackmark() {
+   if (parallel)
+      return par->ts[lifethreads::threadindex()].gsp ;
+   return gsp ;
+}
+node *hlifealgo::save_par(node *n) {
+   hthreadstack &ts = par->ts[lifethreads::threadindex()] ;
+   if (ts.gsp >= ts.stacksize) {
+      int nstacksize = ts.stacksize * 2 + 100 ;
+      {
+         std::lock_guard<std::mutex> lk(par->allocmutex) ;
+         alloced += sizeof(node *)*(nstacksize-ts.stacksize) ;
+      }
+      ts.stack = (node **)realloc(ts.stack, nstacksize * sizeof(node *)) ;
+      if (ts.stack == 0)
+        lifefatal("Out of memory (3).") ;
+      ts.stacksize = nstacksize ;
+   }
+   ts.stack[ts.gsp++] = n ;
+   return n ;
+}
+/*
+ *   Allocate a node for a thread that is about to insert it into the
+ *   hash; we count it in hashpop here, under the allocation lock, and
+ *   set full if that takes the hash past its limit, since hashpop may
+ *   only be read under this lock while we are parallel.
+ */
+node *hlifealgo::newnode_par(int &full) {
+   std::unique_lock<std::mutex> lk(par->allocmutex) ;
+   if (freenodes == 0)
+      newnodeblock() ;
+   if (freenodes->next == 0 && alloced + 1000 * sizeof(node) > maxmem &&
+       okaytogc) {
+      lk.unlock() ;
+      stopworld(0) ;
+      lk.lock() ;
+      if (freenodes == 0)
+         newnodeblock() ;
+   }
+   node *r = freenodes ;
+   freenodes = freenodes->next ;
+   hashpop++ ;
+   full = (hashpop + hashdead > hashlimit) ;
+   return r ;
+}
+void hlifealgo::releasenode_par(node *n) {
+   std::lock_guard<std::mutex> lk(par->allocmutex) ;
+   n->next = freenodes ;
+   freenodes = n ;
+   hashpop-- ;
+}
+node *hlifealgo::probe_node_par(g_uintptr_t g, unsigned int tag,
+                                node *nw, node *ne, node *sw, node *se) {
+   for (;;) {
+      hashgroup *grp = hashtab + g ;
+      hashtagword t = loadtags(&grp->tags) ;
+      for (hashtagword m = tagmatch(t, tag) ; m ; m &= m - 1) {
+         node *p = loadlink(grp->slot[tagindex(m)]) ;
+         if (p && nw == p->nw && ne == p->ne && sw == p->sw && se == p->se)
+            return p ;
+      }
+      if (tagzero(t) & TAGSUSED)
+         return 0 ;
+      if (++g == hashprime)
+         g = 0 ;
+   }
+}
+leaf *hlifealgo::probe_leaf_par(g_uintptr_t g, unsigned int tag,
+                                unsigned short nw, unsigned short ne,
+                                unsigned short sw, unsigned short se) {
+   for (;;) {
+      hashgroup *grp = hashtab + g ;
+      hashtagword t = loadtags(&grp->tags) ;
+      for (hashtagword m = tagmatch(t, tag) ; m ; m &= m - 1) {
+         leaf *p = (leaf *)loadlink(grp->slot[tagindex(m)]) ;
+         if (p && nw == p->nw && ne == p->ne && sw == p->sw && se == p->se &&
+             !is_node(p))
+            return p ;
+      }
+      if (tagzero(t) & TAGSUSED)
+         return 0 ;
+      if (++g == hashprime)
+         g = 0 ;
+   }
+}
+/*
+ *   Called with the stripe lock of the home group held.  We only take
+ *   empty slots, so hashdead stays put.
+ */
+void hlifealgo::hashinsert_par(node *n, g_uintptr_t h) {
+   unsigned int tag = hashtag(h) ;
+   g_uintptr_t g = HASHMOD(h) ;
+   for (;;) {
+      hashgroup *grp = hashtab + g ;
+      hashtagword t = loadtags(&grp->tags) ;
+      hashtagword m = tagzero(t) & TAGSUSED ;
+      if (m == 0) {
+         if (++g == hashprime)
+            g = 0 ;
+      } else {
+         int i = tagindex(m) ;
+         if (castags(&grp->tags, t, tagset(t, i, tag))) {
+            storelink(grp->slot[i], n) ;
+            return ;
+         }
+      }
+   }
+}
+node *hlifealgo::find_node_par(node *nw, node *ne, node *sw, node *se) {
+   g_uintptr_t h = node_hash(nw,ne,sw,se) ;
+   unsigned int tag = hashtag(h) ;
+   node *p = 0, *q = 0 ;
+   int inserted = 0, full = 0 ;
+   for (;;) {
+      g_uintptr_t g = HASHMOD(h) ;
+      p = probe_node_par(g, tag, nw, ne, sw, se) ;
+      if (p)
+         break ;
+      if (q) {
+         std::lock_guard<std::mutex> lk(par->stripes[g & (NSTRIPES-1)]) ;
+         p = probe_node_par(g, tag, nw, ne, sw, se) ;
+         if (p == 0) {
+            hashinsert_par(q, h) ;
+            p = q ;
+            q = 0 ;
+            inserted = 1 ;
+         }
+         break ;
+      }
+      q = newnode_par(full) ; // may stop the world, so we look again afterwards
+      q->nw = nw ;
+      q->ne = ne ;
+      q->sw = sw ;
+      q->se = se ;
+      q->res = 0 ;
+#ifdef NODEMETA
+      setmeta(q) ;
+#endif
+   }
+   if (q)
+      releasenode_par(q) ;
+   save(p) ;
+   if (inserted && full)
+      stopworld(1) ;
+   return p ;
+}
+leaf *hlifealgo::find_leaf_par(unsigned short nw, unsigned short ne,
+                               unsigned short sw, unsigned short se) {
+   g_uintptr_t h = leaf_hash(nw, ne, sw, se) ;
+   unsigned int tag = hashtag(h) ;
+   leaf *p = 0, *q = 0 ;
+   int inserted = 0, full = 0 ;
+   for (;;) {
+      g_uintptr_t g = HASHMOD(h) ;
+      p = probe_leaf_par(g, tag, nw, ne, sw, se) ;
+      if (p)
+         break ;
+      if (q) {
+         std::lock_guard<std::mutex> lk(par->stripes[g & (NSTRIPES-1)]) ;
+         p = probe_leaf_par(g, tag, nw, ne, sw, se) ;
+         if (p == 0) {
+            hashinsert_par((node *)q, h) ;
+            p = q ;
+            q = 0 ;
+            inserted = 1 ;
+         }
+         break ;
+      }
+      q = (leaf *)newnode_par(full) ;
+#ifndef COMPACTNODES
+      new(&(q->leafpop))bigint ;
+#endif
+      q->nw = nw ;
+      q->ne = ne ;
+      q->sw = sw ;
+      q->se = se ;
+      leafres(q) ;
+      q->isnode = 0 ;
+   }
+   if (q)
+      releasenode_par((node *)q) ;
+   save((node *)p) ;
+   if (inserted && full)
+      stopworld(1) ;
+   return p ;
+}
+/*
+ *   The parallel version of getres(), entered only once the cached
+ *   result has been found missing.
+ */
+node *hlifealgo::getres_par(node *n, int depth) {
+   int t = lifethreads::threadindex() ;
+   if (par->stwpending)
+     safepoint() ;
+   if (t == par->owner) {
+     if (poller->poll() || softinterrupt)
+       return zeronode(depth-1) ;
+     if (running_hperf.fastinc(depth, ngens < depth))
+       running_hperf.report(inc_hperf, verbose) ;
+   } else {
+     if (softinterrupt || poller->isInterrupted())
+       return zeronode(depth-1) ;
+     par->ts[t].perf.fastinc(depth, ngens < depth) ;
+   }
+   int sp = stackmark() ;
+   depth-- ;
+   node *res = calcres(n, depth) ;
+   pop(sp) ;
+   if (softinterrupt || poller->isInterrupted())
+     res = zeronode(depth) ;
+   else {
+     if (t == par->owner && ngens < depth && halvesdone < 1000)
+       halvesdone++ ;
+     storeres(n, res) ;
+   }
+   return res ;
+}
+void hlifealgo::runtask(htask *task) {
+   enteractive() ;
+   *(task->out) = getres(task->in, task->depth) ;
+   leaveactive() ;
+}
+/*
+ *   Evaluate the results of the n given nodes, as tasks for the ones
+ *   whose result is not already cached.  The inputs must be reachable
+ *   from our gc stack; the results are then reachable via their res.
+ */
+void hlifealgo::evalpar(node **in, node **out, int n, int depth) {
+   htask tasks[9] ;
+   lifetask *tp[9] ;
+   int ntasks = 0 ;
+   for (int i=0; i<n; i++) {
+      out[i] = loadres(in[i]) ;
+      if (out[i] == 0) {
+         tasks[ntasks].algo = this ;
+         tasks[ntasks].in = in[i] ;
+         tasks[ntasks].out = out + i ;
+         tasks[ntasks].depth = depth ;
+         tp[ntasks] = tasks + ntasks ;
+         ntasks++ ;
+      }
+   }
+   if (ntasks == 0)
+      return ;
+   if (ntasks == 1) {
+      *(tasks[0].out) = getres(tasks[0].in, depth) ;
+      return ;
+   }
+   par->ts[lifethreads::threadindex()].perf.tasks += ntasks ;
+   leaveactive() ;
+   lifethreads::runtasks(tp, ntasks) ;
+   enteractive() ;
+}
+node *hlifealgo::dorecurs_par(node *n, node *ne, node *t, node *e, int depth) {
+   int outer = beginparallel() ;
+   int sp = stackmark() ;
+   node *in[9], *out[9] ;
+   in[0] = n ;
+   in[1] = find_node(n->ne, ne->nw, n->se, ne->sw) ;
+   in[2] = ne ;
+   in[3] = find_node(n->sw, n->se, t->nw, t->ne) ;
+   in[4] = find_node(n->se, ne->sw, t->ne, e->nw) ;
+   in[5] = find_node(ne->sw, ne->se, e->nw, e->ne) ;
+   in[6] = t ;
+   in[7] = find_node(t->ne, e->nw, t->se, e->sw) ;
+   in[8] = e ;
+   evalpar(in, out, 9, depth) ;
+   in[0] = find_node(out[0], out[1], out[3], out[4]) ;
+   in[1] = find_node(out[1], out[2], out[4], out[5]) ;
+   in[2] = find_node(out[3], out[4], out[6], out[7]) ;
+   in[3] = find_node(out[4], out[5], out[7], out[8]) ;
+   evalpar(in, out, 4, depth) ;
+   n = find_node(out[0], out[1], out[2], out[3]) ;
+   pop(sp) ;
+   if (outer)
+      endparallel() ;
+   return save(n) ;
+}
+node *hlifealgo::dorecurs_half_par(node *n, node *ne, node *t, node *e,
+                                   int depth) {
+   int outer = beginparallel() ;
+   int sp = stackmark() ;
+   node *in[9], *o[9] ;
+   in[0] = n ;
+   in[1] = find_node(n->ne, ne->nw, n->se, ne->sw) ;
+   in[2] = ne ;
+   in[3] = find_node(n->sw, n->se, t->nw, t->ne) ;
+   in[4] = find_node(n->se, ne->sw, t->ne, e->nw) ;
+   in[5] = find_node(ne->sw, ne->se, e->nw, e->ne) ;
+   in[6] = t ;
+   in[7] = find_node(t->ne, e->nw, t->se, e->sw) ;
+   in[8] = e ;
+   evalpar(in, o, 9, depth) ;
+   n = find_node(find_node(o[0]->se, o[1]->sw, o[3]->ne, o[4]->nw),
+                 find_node(o[1]->se, o[2]->sw, o[4]->ne, o[5]->nw),
+                 find_node(o[3]->se, o[4]->sw, o[6]->ne, o[7]->nw),
+                 find_node(o[4]->se, o[5]->sw, o[7]->ne, o[8]->nw)) ;
+   pop(sp) ;
+   if (outer)
+      endparallel() ;
+   return save(n) ;
+}
+#ifdef COMPACTNODES
+/*
+ *   The arena for compact nodes.  We reserve address space for as many
+ *   nodes as an index can name (or as much as the system will let us
+ *   have), and commit it in large pieces as blocks are handed out, so
+ *   fresh blocks come to us zeroed.  The mark byte for each node lives
+ *   at the same index in a second reserved range.  When a universe is
+ *   destroyed its blocks go onto a free list for the next one.
+ */
+#ifdef _WIN32
+static char *reservemem(g_uintptr_t size) {
+   return (char *)VirtualAlloc(0, size, MEM_RESERVE, PAGE_NOACCESS) ;
+}
+static int commitmem(char *p, g_uintptr_t size) {
+   return VirtualAlloc(p, size, MEM_COMMIT, PAGE_READWRITE) != 0 ;
+}
+#else
+#ifndef MAP_NORESERVE
+#define MAP_NORESERVE 0
+#endif
+static char *reservemem(g_uintptr_t size) {
+   void *p = mmap(0, size, PROT_NONE,
+                  MAP_PRIVATE | MAP_ANON | MAP_NORESERVE, -1, 0) ;
+   return p == MAP_FAILED ? 0 : (char *)p ;
+}
+static int commitmem(char *p, g_uintptr_t size) {
+   g_uintptr_t pagemask = sysconf(_SC_PAGESIZE) - 1 ;
+   g_uintptr_t lo = (g_uintptr_t)p & ~pagemask ;
+   g_uintptr_t hi = ((g_uintptr_t)p + size + pagemask) & ~pagemask ;
+   return mprotect((void *)lo, hi - lo, PROT_READ | PROT_WRITE) == 0 ;
+}
+#endif
+char *nodeptr::base ;
+static unsigned char *nodeflags ;
+static g_uintptr_t arenanodes ;     // how many nodes we have reserved
+static g_uintptr_t arenacommitted ; // how many of those are usable
+static g_uintptr_t arenatop ;       // next index never handed out
+static node *arenafree ;            // returned blocks, linked by next
+static std::mutex arenamutex ;
+static bigint leafpops[65] ;
+const g_uintptr_t ARENACOMMIT = 1 << 18 ; // nodes committed at a time
+static node *arenablock() {
+   std::lock_guard<std::mutex> lk(arenamutex) ;
+   if (arenafree) {
+      node *r = arenafree ;
+      arenafree = r->next ;
+      memset(r, 0, 1001 * sizeof(node)) ;
+      memset(nodeflags + nodeptr::index(r), 0, 1001) ;
+      return r ;
+   }
+   if (nodeptr::base == 0) {
+      for (arenanodes = (g_uintptr_t)1 << 32 ; arenanodes >= ARENACOMMIT;
+           arenanodes >>= 1) {
+         nodeptr::base = reservemem(arenanodes * sizeof(node)) ;
+         if (nodeptr::base == 0)
+            continue ;
+         nodeflags = (unsigned char *)reservemem(arenanodes) ;
+         if (nodeflags != 0)
+            break ;
+#ifdef _WIN32
+         VirtualFree(nodeptr::base, 0, MEM_RELEASE) ;
+#else
+         munmap(nodeptr::base, arenanodes * sizeof(node)) ;
+#endif
+         nodeptr::base = 0 ;
+      }
+      if (nodeptr::base == 0)
+         return 0 ;
+      arenatop = 1 ; // index 0 is the null link
+   }
+   if (arenatop + 1001 > arenanodes)
+      return 0 ;
+   while (arenatop + 1001 > arenacommitted) {
+      g_uintptr_t n = ARENACOMMIT ;
+      if (arenacommitted + n > arenanodes)
+         n = arenanodes - arenacommitted ;
+      if (!commitmem(nodeptr::base + arenacommitted * sizeof(node),
+                     n * sizeof(node)) ||
+          !commitmem((char *)nodeflags + arenacommitted, n))
+         return 0 ;
+      arenacommitted += n ;
+   }
+   node *r = nodeptr::addr((unsigned int)arenatop) ;
+   arenatop += 1001 ;
+   return r ;
+}
+static void arenarelease(node *block) {
+   std::lock_guard<std::mutex> lk(arenamutex) ;
+   block->next = arenafree ;
+   arenafree = block ;
+}
+#endif
 /*
  *   We keep free nodes in a linked list for allocation, and we allocate
  *   them 1000 at a time.
  */
+void hlifealgo::newnodeblock() {
+   int i ;
+#ifdef COMPACTNODES
+   freenodes = arenablock() ;
+   if (freenodes == 0)
+      lifefatal("Out of memory; try reducing the hash memory limit.") ;
+   alloced += 1001 * (sizeof(node) + 1) ;
+#else
+   freenodes = (node *)calloc(1001, sizeof(node)) ;
+   if (freenodes == 0)
+      lifefatal("Out of memory; try reducing the hash memory limit.") ;
+   alloced += 1001 * sizeof(node) ;
+#endif
+   freenodes->next = nodeblocks ;
+   nodeblocks = freenodes++ ;
+   for (i=0; i<999; i++) {
+      freenodes[1].next = freenodes ;
+      freenodes++ ;
+   }
+   totalthings += 1000 ;
+}
 node *hlifealgo::newnode() {
    node *r ;
-   if (freenodes == 0) {
-      int i ;
-      freenodes = (node *)calloc(1001, sizeof(node)) ;
-      if (freenodes == 0)
-         lifefatal("Out of memory; try reducing the hash memory limit.") ;
-      alloced += 1001 * sizeof(node) ;
-      freenodes->next = nodeblocks ;
-      nodeblocks = freenodes++ ;
-      for (i=0; i<999; i++) {
-         freenodes[1].next = freenodes ;
-         freenodes++ ;
-      }
-      totalthings += 1000 ;
+   if (parallel) {
+      int full ;
+      return newnode_par(full) ;
    }
-   if (freenodes->next == 0 && alloced + 1000 * sizeof(node) > maxmem &&
-       okaytogc) {
-      do_gc(0) ;
+   if (gcphase && okaytogc && --gccountdown <= 0)
+      gcslice() ;
+   if (freenodes == 0)
+      newnodeblock() ;
+   if (freenodes->next == 0 && okaytogc) {
+      if (!incrementalgc) {
+         if (alloced + 1000 * sizeof(node) > maxmem)
+            do_gc(0) ;
+      } else if (gcphase) {
+         if (alloced + 1000 * sizeof(node) > maxmem)
+            gcreclaim() ;
+      } else if (alloced + 1000 * sizeof(node) > maxmem - (maxmem >> 3)) {
+         startgc() ;
+      }
    }
    r = freenodes ;
    freenodes = freenodes->next ;
@@ -557,7 +1791,9 @@ node *hlifealgo::newnode() {
  */
 leaf *hlifealgo::newleaf() {
    leaf *r = (leaf *)newnode() ;
+#ifndef COMPACTNODES
    new(&(r->leafpop))bigint ;
+#endif
    return r ;
 }
 /*
@@ -569,7 +1805,9 @@ node *hlifealgo::newclearednode() {
 }
 leaf *hlifealgo::newclearedleaf() {
    leaf *r = (leaf *)newclearednode() ;
+#ifndef COMPACTNODES
    new(&(r->leafpop))bigint ;
+#endif
    return r ;
 }
 hlifealgo::hlifealgo() {
@@ -583,16 +1821,25 @@ hlifealgo::hlifealgo() {
    if (shortpop[1] == 0)
       for (i=1; i<65536; i++)
          shortpop[i] = shortpop[i & (i - 1)] + 1 ;
-   hashprime = nexthashsize(1000) ;
+#ifdef COMPACTNODES
+   for (i=0; i<65; i++)
+      leafpops[i] = i ;
+#endif
+   hashprime = nexthashsize(1000 / HASHGROUP) ;
 #ifndef PRIMEMOD
    hashmask = hashprime - 1 ;
 #endif
-   hashlimit = (g_uintptr_t)(maxloadfactor * hashprime) ;
+   hashlimit = (g_uintptr_t)(maxloadfactor * hashprime * HASHGROUP) ;
    hashpop = 0 ;
-   hashtab = (node **)calloc(hashprime, sizeof(node *)) ;
+   hashdead = 0 ;
+   hashfull = 0 ;
+   hashtab = (hashgroup *)linecalloc(hashprime * sizeof(hashgroup)) ;
    if (hashtab == 0)
      lifefatal("Out of memory (1).") ;
-   alloced = hashprime * sizeof(node *) ;
+   alloced = hashprime * sizeof(hashgroup) ;
+   oldtab = 0 ;
+   oldprime = 0 ;
+   migratecursor = 0 ;
    ngens = 0 ;
    stacksize = 0 ;
    halvesdone = 0 ;
@@ -605,7 +1852,13 @@ hlifealgo::hlifealgo() {
    totalthings = 0 ;
    nodeblocks = 0 ;
    zeronodea = 0 ;
+   wraproot = 0 ;
    ruletable = hliferules.rule0 ;
+   leafkernel = 0 ;
+   lrule.born = lrule.survive = 0 ;
+   par = 0 ;
+   parallel = 0 ;
+   gcphase = 0 ; // newnode looks at these
 /*
  *   We initialize our universe to be a 16-square.  We are in drawing
  *   mode at this point.
@@ -620,6 +1873,7 @@ hlifealgo::hlifealgo() {
    llsize = 0 ;
    depth = 3 ;
    hashed = 0 ;
+   rowpathtop = 0 ;
    popValid = 0 ;
    needPop = 0 ;
    inGC = 0 ;
@@ -630,21 +1884,34 @@ hlifealgo::hlifealgo() {
    inc_hperf = running_hperf ;
    step_hperf = running_hperf ;
    softinterrupt = 0 ;
+   graystack = 0 ;
+   graysp = 0 ;
+   graysize = 0 ;
+   gcpauses.clear() ;
 }
 /**
  *   Destructor frees memory.
  */
 hlifealgo::~hlifealgo() {
-   free(hashtab) ;
+   releasesnapshots() ;
+   linefree(hashtab) ;
+   linefree(oldtab) ;
+   delete par ;
    while (nodeblocks) {
       node *r = nodeblocks ;
       nodeblocks = nodeblocks->next ;
+#ifdef COMPACTNODES
+      arenarelease(r) ;
+#else
       free(r) ;
+#endif
    }
    if (zeronodea)
       free(zeronodea) ;
    if (stack)
       free(stack) ;
+   if (graystack)
+      free(graystack) ;
    if (llsize) {
       delete [] llxb ;
       delete [] llyb ;
@@ -725,6 +1992,10 @@ void hlifealgo::setMaxMemory(int newmemlimit) {
 #ifndef GOLLY64BIT
    else if (newmemlimit > 4000)
      newmemlimit = 4000 ;
+#endif
+#ifdef COMPACTNODES
+   else if (newmemlimit > 100000) // the most 2**32 nodes can use
+     newmemlimit = 100000 ;
 #endif
    g_uintptr_t newlimit = ((g_uintptr_t)newmemlimit) << 20 ;
    if (alloced > newlimit) {
@@ -732,7 +2003,8 @@ void hlifealgo::setMaxMemory(int newmemlimit) {
       return ;
    }
    maxmem = newlimit ;
-   hashlimit = (g_uintptr_t)(maxloadfactor * hashprime) ;
+   hashfull = 0 ;
+   hashlimit = (g_uintptr_t)(maxloadfactor * hashprime * HASHGROUP) ;
 }
 /**
  *   Clear everything.
@@ -886,7 +2158,7 @@ node *hlifealgo::gsetbit(node *n, int x, int y, int newstate, int depth) {
          wh = 1 << (depth - 1) ;
       }
       depth-- ;
-      node **nptr ;
+      nodeptr *nptr ;
       if (depth+1 == this->depth || depth < 31) {
          if (x < 0) {
             if (y < 0)
@@ -921,10 +2193,10 @@ node *hlifealgo::gsetbit(node *n, int x, int y, int newstate, int depth) {
       node *s = gsetbit(*nptr, (x & (w - 1)) - wh,
                                (y & (w - 1)) - wh, newstate, depth) ;
       if (hashed) {
-         node *nw = (nptr == &(n->nw) ? s : n->nw) ;
-         node *sw = (nptr == &(n->sw) ? s : n->sw) ;
-         node *ne = (nptr == &(n->ne) ? s : n->ne) ;
-         node *se = (nptr == &(n->se) ? s : n->se) ;
+         node *nw = (nptr == &(n->nw) ? s : (node *)n->nw) ;
+         node *sw = (nptr == &(n->sw) ? s : (node *)n->sw) ;
+         node *ne = (nptr == &(n->ne) ? s : (node *)n->ne) ;
+         node *se = (nptr == &(n->se) ? s : (node *)n->se) ;
          n = save(find_node(nw, ne, sw, se)) ;
       } else {
          *nptr = s ;
@@ -1089,6 +2361,148 @@ int hlifealgo::setcell(int x, int y, int newstate) {
    }
    return 0 ;
 }
+/*
+ *   Find the leaf holding a cell while the universe is unhashed,
+ *   expanding the universe and filling in nodes as needed.  Nothing
+ *   moves until the universe is hashed, so we keep the path we took
+ *   last time; a pattern being read in goes left to right and top to
+ *   bottom, so the next leaf is usually under one of the lowest nodes
+ *   on the path and we only walk down the last level or two.
+ */
+leaf *hlifealgo::gleaf(int x, int y) {
+   int sx = x ;
+   int sy = y ;
+   if (depth <= 31) {
+     sx >>= depth ;
+     sy >>= depth ;
+   } else {
+     sx >>= 31 ;
+     sy >>= 31 ;
+   }
+   while (sx > 0 || sx < -1 || sy > 0 || sy < -1) {
+      pushroot_1() ;
+      rowpathtop = 0 ;
+      sx >>= 1 ;
+      sy >>= 1 ;
+   }
+   int ax = x ;
+   int ay = y ;
+   int d = 2 ;
+   while (d < rowpathtop &&
+          (rowpathx[d] != (ax >> (d + 1)) || rowpathy[d] != (ay >> (d + 1))))
+      d++ ;
+   node *n ;
+   if (d < rowpathtop) {
+      if (d == 2)
+         return (leaf *)rowpath[2] ;
+      n = rowpath[d] ;
+      x = (x & (int)((2U << d) - 1)) - (1 << d) ;
+      y = (y & (int)((2U << d) - 1)) - (1 << d) ;
+   } else {
+      n = root ;
+      d = depth ;
+      rowpathtop = (depth < 31 ? depth : 31) ;
+   }
+   while (d > 2) {
+      unsigned int w = 0, wh = 0 ;
+      if (d >= 32) {
+         if (d == 32)
+            wh = 0x80000000 ;
+      } else {
+         w = 1 << d ;
+         wh = 1 << (d - 1) ;
+      }
+      d-- ;
+      nodeptr *nptr ;
+      if (d+1 == depth || d < 31) {
+         if (x < 0) {
+            if (y < 0)
+               nptr = &(n->sw) ;
+            else
+               nptr = &(n->nw) ;
+         } else {
+            if (y < 0)
+               nptr = &(n->se) ;
+            else
+               nptr = &(n->ne) ;
+         }
+      } else {
+         if (x >= 0) {
+            if (y >= 0)
+               nptr = &(n->sw) ;
+            else
+               nptr = &(n->nw) ;
+         } else {
+            if (y >= 0)
+               nptr = &(n->se) ;
+            else
+               nptr = &(n->ne) ;
+         }
+      }
+      if (*nptr == 0) {
+         if (d == 2)
+            *nptr = (node *)newclearedleaf() ;
+         else
+            *nptr = newclearednode() ;
+      }
+      x = (x & (w - 1)) - wh ;
+      y = (y & (w - 1)) - wh ;
+      n = *nptr ;
+      if (d < 31) {
+         rowpath[d] = n ;
+         rowpathx[d] = ax >> (d + 1) ;
+         rowpathy[d] = ay >> (d + 1) ;
+      }
+   }
+   return (leaf *)n ;
+}
+/*
+ *   Set a row of cells a leaf at a time.  Once the universe is hashed
+ *   every change makes new nodes anyway, so then we go cell by cell.
+ */
+int hlifealgo::setcellrow(int y, const cellrun *runs, int nruns) {
+   if (hashed)
+      return lifealgo::setcellrow(y, runs, nruns) ;
+   inGC = 1 ;
+   y = - y ;
+   int sh = 4 * (y & 3) ;
+   leaf *l = 0 ;
+   int lx = 0 ;
+   for (int r=0; r<nruns; r++) {
+      int newstate = runs[r].state ;
+      if (newstate & ~1)
+         return -1 ;
+      int x = runs[r].x ;
+      int n = runs[r].n ;
+      while (n > 0) {
+         int len = 8 - (x & 7) ;
+         if (len > n)
+            len = n ;
+         if (l == 0 || (x >> 3) != lx) {
+            l = gleaf(x, y) ;
+            lx = x >> 3 ;
+         }
+         unsigned short west = 0, east = 0 ;
+         for (int i=x; i<x+len; i++)
+            if (i & 4)
+               east |= 1 << (3 - (i & 3) + sh) ;
+            else
+               west |= 1 << (3 - (i & 3) + sh) ;
+         unsigned short *wp = ((y & 4) ? &l->nw : &l->sw) ;
+         unsigned short *ep = ((y & 4) ? &l->ne : &l->se) ;
+         if (newstate) {
+            *wp |= west ;
+            *ep |= east ;
+         } else {
+            *wp &= ~west ;
+            *ep &= ~east ;
+         }
+         x += len ;
+         n -= len ;
+      }
+   }
+   return 0 ;
+}
 /*
  *   Our nonrecurse top-level bit getting routine.
  */
@@ -1149,6 +2563,97 @@ int hlifealgo::nextcell(int x, int y, int &v) {
    }
    return nextbit(root, x, y, depth) ;
 }
+/*
+ *   Runs of live cells in a rectangle, in one pass over the tree.  We
+ *   go down it a band of rows at a time:  a band is the nodes of one
+ *   depth that meet the rectangle in some stretch of rows, left to
+ *   right, and it splits into the band of their north halves and then
+ *   that of their south halves, until the leaves give up their rows.
+ *   Unlike elsewhere in this file, y here increases downward.
+ */
+struct cellband {
+   node *n ;
+   int x ;     // left edge
+} ;
+static void addrun(vector<cellspan> &spans, int x, int y, int n) {
+   if (!spans.empty() && spans.back().y == y &&
+       spans.back().x + spans.back().n == x) {
+      spans.back().n += n ;
+   } else {
+      cellspan s = { x, y, n, 1 } ;
+      spans.push_back(s) ;
+   }
+}
+void hlifealgo::bandruns(const vector<cellband> &band, int y, int depth,
+                         int top, int left, int bottom, int right,
+                         vector<cellspan> &spans) {
+   if (depth == 2) {
+      for (int r=0; r<8; r++) {
+         if (y + r < top || y + r > bottom)
+            continue ;
+         int sh = 4 * (3 - (r & 3)) ;
+         for (int i=0; i<(int)band.size(); i++) {
+            leaf *l = (leaf *)band[i].n ;
+            int bits = r < 4 ?
+               (((l->nw >> sh) & 15) << 4) | ((l->ne >> sh) & 15) :
+               (((l->sw >> sh) & 15) << 4) | ((l->se >> sh) & 15) ;
+            int x = band[i].x ;
+            for (int j=0; j<8; j++)
+               if ((bits & (128 >> j)) && x + j >= left && x + j <= right)
+                  addrun(spans, x + j, y + r, 1) ;
+         }
+      }
+      return ;
+   }
+   int half = 1 << depth ;
+   depth-- ;
+   node *z = zeronode(depth) ;
+   vector<cellband> sub ;
+   for (int s=0; s<2; s++) {
+      int yy = y + s * half ;
+      if (yy > bottom || yy + (half - 1) < top)
+         continue ;
+      sub.clear() ;
+      for (int i=0; i<(int)band.size(); i++) {
+         node *w = s ? band[i].n->sw : band[i].n->nw ;
+         node *e = s ? band[i].n->se : band[i].n->ne ;
+         int x = band[i].x ;
+         if (w && w != z && x <= right && x + (half - 1) >= left) {
+            cellband b = { w, x } ;
+            sub.push_back(b) ;
+         }
+         x += half ;
+         if (e && e != z && x <= right && x + (half - 1) >= left) {
+            cellband b = { e, x } ;
+            sub.push_back(b) ;
+         }
+      }
+      if (!sub.empty())
+         bandruns(sub, yy, depth, top, left, bottom, right, spans) ;
+   }
+}
+void hlifealgo::getcellruns(int top, int left, int bottom, int right,
+                            vector<cellspan> &spans) {
+   if (root == 0 || root == zeronode(depth))
+      return ;
+   struct node tnode = *root ;
+   int mdepth = depth ;
+   while (mdepth > 30) {
+      tnode.nw = tnode.nw->se ;
+      tnode.ne = tnode.ne->sw ;
+      tnode.sw = tnode.sw->ne ;
+      tnode.se = tnode.se->nw ;
+      mdepth-- ;
+   }
+   int x = -(1 << mdepth), y = 1 - (1 << mdepth) ;
+   if (top > y + ((1 << mdepth) - 1) * 2 + 1 || bottom < y ||
+       left > x + ((1 << mdepth) - 1) * 2 + 1 || right < x)
+      return ;
+   vector<cellband> band ;
+   cellband b = { &tnode, x } ;
+   band.push_back(b) ;
+   bandruns(band, y, mdepth, top, left, bottom, right, spans) ;
+}
 /*
  *   Canonicalize a universe by filling in the null pointers and then
  *   invoking find_node on each node.  Drops the original universe on
@@ -1212,59 +2717,104 @@ node *hlifealgo::popzeros(node *n) {
  *   A lot of the routines from here on down traverse the universe, hanging
  *   information off the nodes.  The way they generally do so is by using
  *   (or abusing) the cache (res) field, and the least significant bit of
- *   the hash next field (as a visited bit).
+ *   the next field (as a visited bit).
+ */
+#ifdef COMPACTNODES
+/*
+ *   With compact nodes the links have no spare bits, so all the marks
+ *   described below live in the byte per node kept beside the arena.
+ *   Bits 0 and 1 stand in for the low bits of res, bit 2 for bit 2 of
+ *   res, and bit 3 for the low bit of next.  Unlike the pointer marks,
+ *   these survive storing a new link, so clearing has to be explicit.
  */
+#define nodeflag(n) (nodeflags[nodeptr::index((node *)(n))])
+#define marked(n) (8 & nodeflag(n))
+#define mark(n) (nodeflag(n) |= 8)
+#define clearmark(n) (nodeflag(n) &= ~8)
+#define clearmarkbit(p) ((node *)(p))
+#define setnext(n,p) ((n)->next = (p))
+#define marked2(n) (3 & nodeflag(n))
+#define mark2(n) (nodeflag(n) |= 1)
+#define clearmark2(n) (nodeflag(n) &= ~3)
+#define gcmarked2(n) (4 & nodeflag(n))
+#define gcmark2(n) (nodeflag(n) |= 4)
+#define cleargcmark2(n) (nodeflag(n) &= ~4)
+/*
+ *   The writers below keep counters in next (and in isnode for leaves).
+ */
+#define linkval(f) ((g_uintptr_t)(f).ix)
+#define setlinkval(f,v) ((f).ix = (unsigned int)(v))
+#else
 #define marked(n) (1 & (g_uintptr_t)(n)->next)
 #define mark(n) ((n)->next = (node *)(1 | (g_uintptr_t)(n)->next))
 #define clearmark(n) ((n)->next = (node *)(~1 & (g_uintptr_t)(n)->next))
 #define clearmarkbit(p) ((node *)(~1 & (g_uintptr_t)(p)))
+#define setnext(n,p) ((n)->next = (node *)((g_uintptr_t)(p) | marked(n)))
 /*
  *   Sometimes we want to use *res* instead of next to mark.  You cannot
  *   do this to leaves, though.
  */
 #define marked2(n) (3 & (g_uintptr_t)(n)->res)
 #define mark2(n) ((n)->res = (node *)(1 | (g_uintptr_t)(n)->res))
-#define mark2v(n,v) ((n)->res = (node *)(v | (g_uintptr_t)(n)->res))
 #define clearmark2(n) ((n)->res = (node *)(~3 & (g_uintptr_t)(n)->res))
-void hlifealgo::unhash_node(node *n) {
-   node *p ;
-   g_uintptr_t h = node_hash(n->nw,n->ne,n->sw,n->se) ;
-   node *pred = 0 ;
-   h = HASHMOD(h) ;
-   for (p=hashtab[h]; (!is_node(p) || !marked2(p)) && p; p = p->next) {
-      if (p == n) {
-         if (pred)
-            pred->next = p->next ;
-         else
-            hashtab[h] = p->next ;
-         return ;
+/*
+ *   An incremental collection may be under way while we compute the
+ *   population, so next can carry a mark bit.  We park the collector's
+ *   mark in bit 2 of res while next holds the population, and put it
+ *   back afterwards.
+ */
+#define gcmarked2(n) (4 & (g_uintptr_t)(n)->res)
+#define gcmark2(n) ((n)->res = (node *)(4 | (g_uintptr_t)(n)->res))
+#define cleargcmark2(n) ((n)->res = (node *)(~4 & (g_uintptr_t)(n)->res))
+#define linkval(f) ((g_uintptr_t)(f))
+#define setlinkval(f,v) ((f) = (node *)(v))
+#endif
+/*
+ *   Find the slot holding the given node or leaf, starting from group
+ *   g of the given table (these need the mark macros, so they live
+ *   down here).  While a sweep is under way, unmarked nodes
+ *   in groups not yet swept are garbage (their children may already
+ *   be gone), so we skip them.
+ */
+nodeptr *hlifealgo::probe_node(hashgroup *tab, g_uintptr_t groups,
+                               g_uintptr_t g, unsigned int tag,
+                               node *nw, node *ne, node *sw, node *se) {
+   nodeptr knw = nw, kne = ne, ksw = sw, kse = se ;
+   for (;;) {
+      hashtagword t = tab[g].tags ;
+      for (hashtagword m = tagmatch(t, tag) ; m ; m &= m - 1) {
+         nodeptr *pp = tab[g].slot + tagindex(m) ;
+         node *p = *pp ;
+         if (linkeq(knw, p->nw) && linkeq(kne, p->ne) &&
+             linkeq(ksw, p->sw) && linkeq(kse, p->se) &&
+             (gcphase != 2 || g < sweepcursor || marked(p)))
+            return pp ;
       }
-      pred = p ;
+      if (tagzero(t) & TAGSUSED)
+         return 0 ;
+      if (++g == groups)
+         g = 0 ;
    }
-   lifefatal("Didn't find node to unhash") ;
 }
-void hlifealgo::unhash_node2(node *n) {
-   node *p ;
-   g_uintptr_t h = node_hash(n->nw,n->ne,n->sw,n->se) ;
-   node *pred = 0 ;
-   h = HASHMOD(h) ;
-   for (p=hashtab[h]; p; p = p->next) {
-      if (p == n) {
-         if (pred)
-            pred->next = p->next ;
-         else
-            hashtab[h] = p->next ;
-         return ;
+nodeptr *hlifealgo::probe_leaf(hashgroup *tab, g_uintptr_t groups,
+                               g_uintptr_t g, unsigned int tag,
+                               unsigned short nw, unsigned short ne,
+                               unsigned short sw, unsigned short se) {
+   for (;;) {
+      hashtagword t = tab[g].tags ;
+      for (hashtagword m = tagmatch(t, tag) ; m ; m &= m - 1) {
+         nodeptr *pp = tab[g].slot + tagindex(m) ;
+         leaf *p = (leaf *)(node *)*pp ;
+         if (nw == p->nw && ne == p->ne && sw == p->sw && se == p->se &&
+             !is_node(p) &&
+             (gcphase != 2 || g < sweepcursor || marked(p)))
+            return pp ;
       }
-      pred = p ;
+      if (tagzero(t) & TAGSUSED)
+         return 0 ;
+      if (++g == groups)
+         g = 0 ;
    }
-   lifefatal("Didn't find node to unhash 2") ;
-}
-void hlifealgo::rehash_node(node *n) {
-   g_uintptr_t h = node_hash(n->nw,n->ne,n->sw,n->se) ;
-   h = HASHMOD(h) ;
-   n->next = hashtab[h] ;
-   hashtab[h] = n ;
 }
 /*
  *   This recursive routine calculates the population by hanging the
@@ -1273,17 +2823,45 @@ void hlifealgo::rehash_node(node *n) {
 const bigint &hlifealgo::calcpop(node *root, int depth) {
    if (root == zeronode(depth))
       return bigint::zero ;
+#ifdef COMPACTNODES
+   if (depth == 2)
+      return leafpops[((leaf *)root)->leafpop] ;
+   if (marked2(root))
+      return popcache[linkval(root->next)] ;
+#else
    if (depth == 2)
       return ((leaf *)root)->leafpop ;
    if (marked2(root))
       return *(bigint*)&(root->next) ;
-   depth-- ;
-   if (root->next == 0)
-      mark2v(root, 3) ;
-   else {
-      unhash_node(root) ;
-      mark2(root) ;
+#endif
+   int gcbit = marked(root) ;
+   mark2(root) ;
+   if (gcbit)
+      gcmark2(root) ;
+#ifdef NODEMETA
+   if (depth <= METADEPTH) {
+#ifdef COMPACTNODES
+      popcache.push_back(bigint((int)root->meta.pop)) ;
+      setlinkval(root->next, popcache.size() - 1) ;
+      return popcache.back() ;
+#else
+      new(&(root->next))bigint((int)root->meta.pop) ;
+      return *(bigint *)&(root->next) ;
+#endif
    }
+#endif
+   depth-- ;
+#ifdef COMPACTNODES
+/**
+ *   A bigint does not fit in a 32-bit link, so we keep it on the side
+ *   and store its index instead.
+ */
+   popcache.push_back(bigint(
+        calcpop(root->nw, depth), calcpop(root->ne, depth),
+        calcpop(root->sw, depth), calcpop(root->se, depth))) ;
+   setlinkval(root->next, popcache.size() - 1) ;
+   return popcache.back() ;
+#else
 /**
  *   We use allocate-in-place bigint constructor here to initialize the
  *   node.  This should compile to a single instruction.
@@ -1292,16 +2870,16 @@ const bigint &hlifealgo::calcpop(node *root, int depth) {
         calcpop(root->nw, depth), calcpop(root->ne, depth),
         calcpop(root->sw, depth), calcpop(root->se, depth)) ;
    return *(bigint *)&(root->next) ;
+#endif
 }
 /*
- *   Call this after doing something that unhashes nodes in order to
- *   use the next field as a temp pointer.
+ *   Call this after doing something that uses the next field as a
+ *   temp pointer.
  */
 void hlifealgo::aftercalcpop2(node *root, int depth) {
    if (depth == 2 || root == zeronode(depth))
       return ;
-   int v = marked2(root) ;
-   if (v) {
+   if (marked2(root)) {
       clearmark2(root) ;
       depth-- ;
       if (depth > 2) {
@@ -1310,11 +2888,14 @@ void hlifealgo::aftercalcpop2(node *root, int depth) {
          aftercalcpop2(root->sw, depth) ;
          aftercalcpop2(root->se, depth) ;
       }
+#ifndef COMPACTNODES
       ((bigint *)&(root->next))->~bigint() ;
-      if (v == 3)
-         root->next = 0 ;
-      else
-         rehash_node(root) ;
+#endif
+      int gcbit = gcmarked2(root) ;
+      cleargcmark2(root) ;
+      root->next = 0 ;
+      if (gcbit)
+         mark(root) ;
    }
 }
 /*
@@ -1334,7 +2915,7 @@ void hlifealgo::afterwritemc(node *root, int depth) {
       afterwritemc(root->ne, depth) ;
       afterwritemc(root->sw, depth) ;
       afterwritemc(root->se, depth) ;
-      rehash_node(root) ;
+      root->next = 0 ;
    }
 }
 /*
@@ -1344,8 +2925,17 @@ void hlifealgo::calcPopulation() {
    int depth ;
    ensure_hashed() ;
    depth = node_depth(root) ;
+#ifdef NODEMETA
+   if (depth <= METADEPTH) {
+      population = bigint((int)root->meta.pop) ;
+      return ;
+   }
+#endif
    population = calcpop(root, depth) ;
    aftercalcpop2(root, depth) ;
+#ifdef COMPACTNODES
+   popcache.clear() ;
+#endif
 }
 /*
  *   Is the universe empty?
@@ -1358,6 +2948,8 @@ int hlifealgo::isEmpty() {
  *   This routine marks a node as needed to be saved.
  */
 node *hlifealgo::save(node *n) {
+   if (parallel)
+      return save_par(n) ;
    if (gsp >= stacksize) {
       int nstacksize = stacksize * 2 + 100 ;
       alloced += sizeof(node *)*(nstacksize-stacksize) ;
@@ -1373,7 +2965,10 @@ node *hlifealgo::save(node *n) {
  *   This routine pops the stack back to a previous depth.
  */
 void hlifealgo::pop(int n) {
-   gsp = n ;
+   if (parallel)
+      par->ts[lifethreads::threadindex()].gsp = n ;
+   else
+      gsp = n ;
 }
 /*
  *   This routine clears the stack altogether.
@@ -1413,6 +3008,12 @@ void hlifealgo::do_gc(int invalidate) {
    int i ;
    g_uintptr_t freed_nodes=0 ;
    node *p, *pp ;
+   if (gcphase) {
+      finishgc() ;
+      if (!invalidate)
+         return ;
+   }
+   gcpauses.start() ;
    inGC = 1 ;
    gccount++ ;
    gcstep++ ;
@@ -1430,30 +3031,37 @@ void hlifealgo::do_gc(int invalidate) {
       gc_mark(zeronodea[i], 0) ; // never invalidate zeronode
    if (root != 0)
       gc_mark(root, invalidate) ; // pick up the root
+   int canpoll = (!parallel || lifethreads::threadindex() == par->owner) ;
    for (i=0; i<gsp; i++) {
-      poller->poll() ;
+      if (canpoll)
+         poller->poll() ;
       gc_mark(stack[i], invalidate) ;
    }
+   if (parallel)
+      for (int t=0; t<MAX_THREADS; t++)
+         for (i=0; i<par->ts[t].gsp; i++)
+            gc_mark(par->ts[t].stack[i], invalidate) ;
    for (i=0; i<timeline.framecount; i++)
-      gc_mark((node *)timeline.frames[i], invalidate) ;
+      if (timeline.frames[i])
+         gc_mark((node *)timeline.frames[i], invalidate) ;
+   for (i=0; i<(int)snapshots.roots.size(); i++)
+      if (snapshots.roots[i])
+         gc_mark((node *)snapshots.roots[i], invalidate) ;
    hashpop = 0 ;
-   memset(hashtab, 0, sizeof(node *) * hashprime) ;
+   hashdead = 0 ;
+   if (oldtab)
+      endresize() ;
+   memset(hashtab, 0, sizeof(hashgroup) * hashprime) ;
    freenodes = 0 ;
    for (p=nodeblocks; p; p=p->next) {
-      poller->poll() ;
+      if (canpoll)
+         poller->poll() ;
       for (pp=p+1, i=1; i<1001; i++, pp++) {
          if (marked(pp)) {
-            g_uintptr_t h = 0 ;
-            if (pp->nw) { /* yes, it's a node */
-               h = HASHMOD(node_hash(pp->nw, pp->ne, pp->sw, pp->se)) ;
-            } else {
-               leaf *lp = (leaf *)pp ;
-               if (invalidate)
-                  leafres(lp) ;
-               h = HASHMOD(leaf_hash(lp->nw, lp->ne, lp->sw, lp->se)) ;
-            }
-            pp->next = hashtab[h] ;
-            hashtab[h] = pp ;
+            if (invalidate && !is_node(pp))
+               leafres((leaf *)pp) ;
+            clearmark(pp) ;
+            hashinsert(pp, hashof(pp)) ;
             hashpop++ ;
          } else {
             pp->next = freenodes ;
@@ -1463,19 +3071,223 @@ void hlifealgo::do_gc(int invalidate) {
       }
    }
    inGC = 0 ;
+   gcpauses.stop() ;
    if (verbose) {
      double perc = (double)freed_nodes / (double)totalthings * 100.0 ;
-     sprintf(statusline+strlen(statusline), " freed %g percent (%" PRIuPTR ").",
-                                                   perc, freed_nodes) ;
+     sprintf(statusline+strlen(statusline),
+             " freed %g percent (%" PRIuPTR "), %g nodes per GB.",
+             perc, freed_nodes, totalthings * 1073741824.0 / alloced) ;
+     gcpauses.report(statusline, 200) ;
      lifestatus(statusline) ;
    }
-   if (needPop) {
+   if (needPop && !parallel) {
       calcPopulation() ;
       popValid = 1 ;
       needPop = 0 ;
       poller->updatePop() ;
    }
 }
+/*
+ *   Incremental garbage collection.  When we get within an eighth of
+ *   the memory limit we start a collection, and from then on every
+ *   GCSLICEALLOCS allocations we do a slice of collector work sized
+ *   so the whole collection should finish well before the limit is
+ *   reached.  If it does not, we finish the marking (and as much of
+ *   the sweep as we need) right away, which is no worse than the
+ *   stop-the-world collection.
+ *
+ *   Marking is a tricolor mark using the usual low bit of the next
+ *   field; gray nodes wait on an explicit stack.  Children never change,
+ *   so the only pointers the calculation can store behind our back are
+ *   new nodes (which we allocate marked and gray) and newly cached
+ *   results (which getres shades).  Everything else the calculation
+ *   holds on to is on the save stack, so when the gray stack runs dry
+ *   we shade the roots again, and we are done once that finds nothing
+ *   new.
+ *
+ *   Sweeping goes through the hash one group of slots at a time,
+ *   freeing unmarked nodes (leaving tombstones in their slots) and
+ *   clearing the marks of the rest.  Lookups in groups not yet swept
+ *   must ignore unmarked nodes, since they are garbage whose children
+ *   may already have been freed; and new nodes put in those groups are
+ *   marked so the sweep keeps them.
+ */
+int hlifealgo::incrementalgc = 0 ;
+const int GCSLICEALLOCS = 128 ;
+void hlifealgo::shade(node *n) {
+   if (!marked(n)) {
+      mark(n) ;
+      if (is_node(n)) {
+         if (graysp >= graysize) {
+            g_uintptr_t ngraysize = graysize * 2 + 1000 ;
+            alloced += sizeof(node *) * (ngraysize - graysize) ;
+            graystack = (node **)realloc(graystack, ngraysize * sizeof(node *)) ;
+            if (graystack == 0)
+               lifefatal("Out of memory (4).") ;
+            graysize = ngraysize ;
+         }
+         graystack[graysp++] = n ;
+      }
+   }
+}
+void hlifealgo::shaderoots() {
+   int i ;
+   for (i=nzeros-1; i>=0; i--)
+      if (zeronodea[i] != 0)
+         break ;
+   if (i >= 0)
+      shade(zeronodea[i]) ;
+   if (root != 0)
+      shade(root) ;
+   for (i=0; i<gsp; i++)
+      shade(stack[i]) ;
+   for (i=0; i<timeline.framecount; i++)
+      if (timeline.frames[i])
+         shade((node *)timeline.frames[i]) ;
+   for (i=0; i<(int)snapshots.roots.size(); i++)
+      if (snapshots.roots[i])
+         shade((node *)snapshots.roots[i]) ;
+}
+/*
+ *   A node just put in group g while a collection is under way.
+ */
+void hlifealgo::gcnewnode(node *n, g_uintptr_t g) {
+   if (gcphase == 1)
+      shade(n) ;
+   else if (g >= sweepcursor) {
+      mark(n) ;
+   }
+}
+void hlifealgo::startgc() {
+   finishresize() ;
+   gccount++ ;
+   gcstep++ ;
+   if (verbose) {
+     if (gcstep > 1)
+       sprintf(statusline, "GC #%d(%d) started", gccount, gcstep) ;
+     else
+       sprintf(statusline, "GC #%d started", gccount) ;
+     lifestatus(statusline) ;
+   }
+   gcpauses.start() ;
+   gcphase = 1 ;
+   gcfreed = 0 ;
+   graysp = 0 ;
+   sweepcursor = 0 ;
+   shaderoots() ;
+   /*
+    *   Marking visits at most everything in the hash and sweeping visits
+    *   every group and everything in it, and we want to get through both
+    *   twice over in the time it takes to allocate our headroom.
+    */
+   double headroom = (double)(maxmem >> 3) / sizeof(node) ;
+   double work = 2.0 * hashpop + hashprime ;
+   double perslice = GCSLICEALLOCS * (1 + 2 * work / headroom) ;
+   gcbudget = perslice > 1e8 ? 100000000 : (int)perslice ;
+   gccountdown = GCSLICEALLOCS ;
+   gcpauses.stop() ;
+}
+/*
+ *   Do up to budget units of marking; return what is left over.
+ */
+int hlifealgo::gcmark(int budget) {
+   while (budget > 0) {
+      if (graysp == 0) {
+         shaderoots() ;
+         budget -= gsp + timeline.framecount + (int)snapshots.roots.size() ;
+         if (graysp == 0) {
+            gcphase = 2 ;
+            sweepcursor = 0 ;
+            break ;
+         }
+      }
+      node *n = graystack[--graysp] ;
+      shade(n->nw) ;
+      shade(n->ne) ;
+      shade(n->sw) ;
+      shade(n->se) ;
+      if (n->res)
+         shade(n->res) ;
+      budget-- ;
+   }
+   return budget ;
+}
+int hlifealgo::gcsweep(int budget) {
+   while (budget > 0 && sweepcursor < hashprime) {
+      hashgroup *grp = hashtab + sweepcursor++ ;
+      hashtagword t = grp->tags ;
+      budget-- ;
+      for (hashtagword m = tagfull(t) ; m ; m &= m - 1) {
+         int i = tagindex(m) ;
+         node *p = grp->slot[i] ;
+         if (marked(p)) {
+            clearmark(p) ;
+         } else {
+            t = tagset(t, i, HASHTAGDEAD) ;
+            grp->slot[i] = 0 ;
+            p->next = freenodes ;
+            freenodes = p ;
+            hashpop-- ;
+            hashdead++ ;
+            gcfreed++ ;
+         }
+         budget-- ;
+      }
+      grp->tags = t ;
+   }
+   if (sweepcursor >= hashprime)
+      endgc() ;
+   return budget ;
+}
+void hlifealgo::gcslice() {
+   gccountdown = GCSLICEALLOCS ;
+   gcpauses.start() ;
+   int budget = gcbudget ;
+   if (gcphase == 1)
+      budget = gcmark(budget) ;
+   if (gcphase == 2)
+      gcsweep(budget) ;
+   gcpauses.stop() ;
+}
+/*
+ *   We hit the memory limit before the collection finished; get some
+ *   nodes back now.
+ */
+void hlifealgo::gcreclaim() {
+   gcpauses.start() ;
+   while (gcphase == 1)
+      gcmark(1000000000) ;
+   while (gcphase == 2 && freenodes->next == 0)
+      gcsweep(gcbudget) ;
+   gcpauses.stop() ;
+}
+void hlifealgo::finishgc() {
+   if (gcphase == 0)
+      return ;
+   gcpauses.start() ;
+   while (gcphase == 1)
+      gcmark(1000000000) ;
+   while (gcphase == 2)
+      gcsweep(1000000000) ;
+   gcpauses.stop() ;
+}
+void hlifealgo::endgc() {
+   gcphase = 0 ;
+   if (graysize > 1000) {
+      alloced -= sizeof(node *) * graysize ;
+      free(graystack) ;
+      graystack = 0 ;
+      graysize = 0 ;
+   }
+   if (verbose) {
+     double perc = (double)gcfreed / (double)totalthings * 100.0 ;
+     sprintf(statusline,
+             "GC #%d done, freed %g percent (%" PRIuPTR "), %g nodes per GB.",
+             gccount, perc, gcfreed, totalthings * 1073741824.0 / alloced) ;
+     gcpauses.report(statusline, 200) ;
+     lifestatus(statusline) ;
+   }
+}
 /*
  *   Clear the cache bits down to the appropriate level, marking the
  *   nodes we've handled.
@@ -1519,7 +3331,10 @@ void hlifealgo::new_ngens(int newval) {
    }
 #ifndef NOGCBEFOREINC
    do_gc(0) ;
+#else
+   finishgc() ;
 #endif
+   finishresize() ;
    if (verbose) {
      strcpy(statusline, "Changing increment...") ;
      lifestatus(statusline) ;
@@ -1532,9 +3347,11 @@ void hlifealgo::new_ngens(int newval) {
    ngens = newval ;
    inGC = 1 ;
    for (i=0; i<hashprime; i++)
-      for (p=hashtab[i]; p; p=clearmarkbit(p->next))
+      for (hashtagword m = tagfull(hashtab[i].tags) ; m ; m &= m - 1) {
+         p = hashtab[i].slot[tagindex(m)] ;
          if (is_node(p) && !marked(p))
             clearcache(p, node_depth(p), clearto) ;
+      }
    for (p=nodeblocks; p; p=p->next) {
       poller->poll() ;
       for (pp=p+1, i=1; i<1001; i++, pp++)
@@ -1586,6 +3403,178 @@ const bigint &hlifealgo::getPopulation() {
    }
    return population ;
 }
+/*
+ *   A torus whose sides are powers of two is run by hashlife itself
+ *   rather than a generation at a time with border cells.  The plane
+ *   tiled with copies of the grid is periodic in both directions, so
+ *   its square around the origin at a depth where the side is a
+ *   multiple of both periods is a node whose four copies, put
+ *   together, are the tiling again; the result of that bigger node is
+ *   the tiling stepped by our increment, and cutting the grid out of
+ *   it gives the new root.  The tiling is built from blocks of half
+ *   the shorter side, so they always line up with the grid; all of
+ *   this costs about as much as the grid's perimeter, and the
+ *   stepping itself gets the full benefit of the cache.
+ *
+ *   Tree y is minus the user's y, so the grid's rows are -wrapht/2+1
+ *   up to wrapht/2 in tree coordinates, one off the blocks:  a block
+ *   at the bottom of the grid gets its top row from the grid's top.
+ *
+ *   The first few routines find the node of a given depth with its
+ *   lower left cell at x,y in wraproot.
+ */
+node *hlifealgo::centernode(node *n) {
+   return find_node(n->nw->se, n->ne->sw, n->sw->ne, n->se->nw) ;
+}
+node *hlifealgo::nodeat(int d, G_INT64 x, G_INT64 y) {
+   G_INT64 half = (G_INT64)1 << wrapdepth ;
+   if (x < -half || x >= half || y < -half || y >= half)
+      return zeronode(d) ;
+   node *n = wraproot ;
+   G_INT64 nx = -half, ny = -half ;
+   for (int nd=wrapdepth; nd>d; nd--) {
+      half >>= 1 ;
+      if (y >= ny + 2 * half) {
+         ny += 2 * half ;
+         if (x >= nx + 2 * half) {
+            nx += 2 * half ;
+            n = n->ne ;
+         } else {
+            n = n->nw ;
+         }
+      } else {
+         if (x >= nx + 2 * half) {
+            nx += 2 * half ;
+            n = n->se ;
+         } else {
+            n = n->sw ;
+         }
+      }
+   }
+   return n ;
+}
+/*
+ *   The bits of a quarter leaf (lower left at x,y) inside the grid.
+ */
+static unsigned short gridbits(G_INT64 x, G_INT64 y, G_INT64 l, G_INT64 b,
+                                G_INT64 r, G_INT64 t) {
+   unsigned short bits = 0 ;
+   for (int row=0; row<4; row++)
+      for (int col=0; col<4; col++)
+         if (x + col >= l && x + col < r && y + row >= b && y + row < t)
+            bits |= 1 << (3 - col + 4 * row) ;
+   return bits ;
+}
+/*
+ *   Clear everything outside the grid.
+ */
+node *hlifealgo::cliptogrid(node *n, int d, G_INT64 x, G_INT64 y) {
+   G_INT64 w = (G_INT64)2 << d ;
+   G_INT64 r = wrapleft + wrapwd ;
+   G_INT64 t = wrapbottom + wrapht ;
+   if (x >= wrapleft && x + w <= r && y >= wrapbottom && y + w <= t)
+      return n ;
+   node *z = zeronode(d) ;
+   if (n == z || x >= r || x + w <= wrapleft || y >= t || y + w <= wrapbottom)
+      return z ;
+   if (d == 2) {
+      leaf *l = (leaf *)n ;
+      return (node *)find_leaf(
+         l->nw & gridbits(x, y + 4, wrapleft, wrapbottom, r, t),
+         l->ne & gridbits(x + 4, y + 4, wrapleft, wrapbottom, r, t),
+         l->sw & gridbits(x, y, wrapleft, wrapbottom, r, t),
+         l->se & gridbits(x + 4, y, wrapleft, wrapbottom, r, t)) ;
+   }
+   G_INT64 h = w >> 1 ;
+   return find_node(cliptogrid(n->nw, d-1, x, y + h),
+                    cliptogrid(n->ne, d-1, x + h, y + h),
+                    cliptogrid(n->sw, d-1, x, y),
+                    cliptogrid(n->se, d-1, x + h, y)) ;
+}
+node *hlifealgo::mergenodes(node *a, node *b, int d) {
+   node *z = zeronode(d) ;
+   if (b == z)
+      return a ;
+   if (a == z)
+      return b ;
+   if (d == 2) {
+      leaf *la = (leaf *)a ;
+      leaf *lb = (leaf *)b ;
+      return (node *)find_leaf(la->nw | lb->nw, la->ne | lb->ne,
+                               la->sw | lb->sw, la->se | lb->se) ;
+   }
+   return find_node(mergenodes(a->nw, b->nw, d-1),
+                    mergenodes(a->ne, b->ne, d-1),
+                    mergenodes(a->sw, b->sw, d-1),
+                    mergenodes(a->se, b->se, d-1)) ;
+}
+/*
+ *   A block of the tiling no bigger than half the shorter side.  Its
+ *   copy in the grid is whole, except when it is the grid's bottom
+ *   block, whose top row is really the top of the grid.
+ */
+node *hlifealgo::gridblock(int d, G_INT64 x, G_INT64 y) {
+   x = ((x - wrapleft) & (wrapwd - 1)) + wrapleft ;
+   y = ((y - wrapbottom + 1) & (wrapht - 1)) + wrapbottom - 1 ;
+   return mergenodes(cliptogrid(nodeat(d, x, y), d, x, y),
+                     cliptogrid(nodeat(d, x, y + wrapht), d, x, y + wrapht),
+                     d) ;
+}
+/*
+ *   Any square of the tiling; halves a period apart are the same.
+ */
+node *hlifealgo::tilegrid(int d, G_INT64 x, G_INT64 y) {
+   G_INT64 h = (G_INT64)1 << d ;
+   G_INT64 shorter = (wrapwd < wrapht ? wrapwd : wrapht) ;
+   if (2 * h <= shorter / 2)
+      return gridblock(d, x, y) ;
+   node *nw = tilegrid(d-1, x, y + h) ;
+   node *ne = (h % wrapwd == 0 ? nw : tilegrid(d-1, x + h, y + h)) ;
+   node *sw = (h % wrapht == 0 ? nw : tilegrid(d-1, x, y)) ;
+   node *se = (h % wrapwd == 0 ? sw :
+               h % wrapht == 0 ? ne : tilegrid(d-1, x + h, y)) ;
+   return find_node(nw, ne, sw, se) ;
+}
+/*
+ *   Make the node runpattern steps:  four copies of the tiling at a
+ *   depth where its result is the step we want.
+ */
+node *hlifealgo::wrapgrid(int &d) {
+   wrapwd = gridwd ;
+   wrapht = gridht ;
+   wrapleft = -wrapwd / 2 ;
+   wrapbottom = 1 - wrapht / 2 ;
+   wrapdepth = log2(gridwd > gridht ? gridwd : gridht) ;
+   // the grid and the row above it fit in a root of that depth
+   wraproot = root ;
+   d = node_depth(wraproot) ;
+   while (d < wrapdepth) {
+      wraproot = pushroot(wraproot) ;
+      d++ ;
+   }
+   while (d > wrapdepth) {
+      wraproot = centernode(wraproot) ;
+      d-- ;
+   }
+   node *n = tilegrid(d, -((G_INT64)1 << d), -((G_INT64)1 << d)) ;
+   wraproot = 0 ;
+   while (ngens + 1 > d) {
+      n = find_node(n, n, n, n) ;
+      d++ ;
+   }
+   d++ ;
+   return find_node(n, n, n, n) ;
+}
+/*
+ *   Cut the grid out of a result of the above at the given depth.
+ */
+node *hlifealgo::unwrapgrid(node *n, int d) {
+   while (d > wrapdepth) {
+      n = centernode(n) ;
+      d-- ;
+   }
+   return cliptogrid(n, d, -((G_INT64)1 << d), -((G_INT64)1 << d)) ;
+}
 /*
  *   Finally, we get to run the pattern.  We first ensure that all
  *   clearspace nodes and the input pattern is never garbage
@@ -1604,13 +3593,20 @@ node *hlifealgo::runpattern() {
    }
    int depth = node_depth(n) ;
    node *n2 ;
-   n = pushroot(n) ;
-   depth++ ;
-   n = pushroot(n) ;
-   depth++ ;
-   while (ngens + 2 > depth) {
+   int wrapped = wrapsgrid() ;
+   if (wrapped) {
+      okaytogc = 0 ; // nothing is saved until it is built
+      n = wrapgrid(depth) ;
+      okaytogc = 1 ;
+   } else {
       n = pushroot(n) ;
       depth++ ;
+      n = pushroot(n) ;
+      depth++ ;
+      while (ngens + 2 > depth) {
+         n = pushroot(n) ;
+         depth++ ;
+      }
    }
    save(zeronode(nzeros-1)) ;
    save(n) ;
@@ -1623,6 +3619,8 @@ node *hlifealgo::runpattern() {
    }
    if (poller->isInterrupted() || softinterrupt)
       return 0 ; // indicate it was interrupted
+   if (wrapped)
+      n2 = unwrapgrid(n2, depth-1) ;
    n = popzeros(n2) ;
    generation += pow2step ;
    return n ;
@@ -1834,6 +3832,7 @@ const char *hlifealgo::setrule(const char *s) {
    if (!(hliferules.isHexagonal() || hliferules.isWolfram())) {
       fliprule(hliferules.rule0);
    }
+   setleafrule() ;
 
    clearcache() ;
    
@@ -1859,6 +3858,27 @@ void hlifealgo::unpack8x8(unsigned short nw, unsigned short ne,
           (((se & 0xf00) | (sw & 0xf0)) << 8) |
           (((se & 0xf0) | (sw & 0xf)) << 4) | (se & 0xf) ;
 }
+/**
+ *   A leaf goes out as rows of . and * separated by $, stopping after
+ *   the last row with a live cell.
+ */
+void hlifealgo::writeleaf(std::ostream &os, leaf *n) {
+   int i, j ;
+   unsigned int top, bot ;
+   unpack8x8(n->nw, n->ne, n->sw, n->se, &top, &bot) ;
+   for (j=7; (top | bot) && j>=0; j--) {
+      int bits = (top >> 24) ;
+      top = (top << 8) | (bot >> 24) ;
+      bot = (bot << 8) ;
+      for (i=0; bits && i<8; i++, bits = (bits << 1) & 255)
+         if (bits & 128)
+            os << '*' ;
+         else
+            os << '.' ;
+      os << '$' ;
+   }
+   os << '\n' ;
+}
 /**
  *   Write out the native macrocell format.  This is the one we use when
  *   we're not interactive and displaying a progress dialog.
@@ -1869,39 +3889,23 @@ g_uintptr_t hlifealgo::writecell(std::ostream &os, node *root, int depth) {
       return 0 ;
    if (depth == 2) {
       if (root->nw != 0)
-         return (g_uintptr_t)(root->nw) ;
+         return linkval(root->nw) ;
    } else {
       if (marked2(root))
-         return (g_uintptr_t)(root->next) ;
-      unhash_node2(root) ;
+         return linkval(root->next) ;
       mark2(root) ;
    }
    if (depth == 2) {
-      int i, j ;
-      unsigned int top, bot ;
-      leaf *n = (leaf *)root ;
       thiscell = ++cellcounter ;
-      root->nw = (node *)thiscell ;
-      unpack8x8(n->nw, n->ne, n->sw, n->se, &top, &bot) ;
-      for (j=7; (top | bot) && j>=0; j--) {
-         int bits = (top >> 24) ;
-         top = (top << 8) | (bot >> 24) ;
-         bot = (bot << 8) ;
-         for (i=0; bits && i<8; i++, bits = (bits << 1) & 255)
-            if (bits & 128)
-               os << '*' ;
-            else
-               os << '.' ;
-         os << '$' ;
-      }
-      os << '\n' ;
+      setlinkval(root->nw, thiscell) ;
+      writeleaf(os, (leaf *)root) ;
    } else {
       g_uintptr_t nw = writecell(os, root->nw, depth-1) ;
       g_uintptr_t ne = writecell(os, root->ne, depth-1) ;
       g_uintptr_t sw = writecell(os, root->sw, depth-1) ;
       g_uintptr_t se = writecell(os, root->se, depth-1) ;
       thiscell = ++cellcounter ;
-      root->next = (node *)thiscell ;
+      setlinkval(root->next, thiscell) ;
       os << depth+1 << ' ' << nw << ' ' << ne << ' ' << sw << ' ' << se << '\n';
    }
    return thiscell ;
@@ -1917,11 +3921,10 @@ g_uintptr_t hlifealgo::writecell_2p1(node *root, int depth) {
       return 0 ;
    if (depth == 2) {
       if (root->nw != 0)
-         return (g_uintptr_t)(root->nw) ;
+         return linkval(root->nw) ;
    } else {
       if (marked2(root))
-         return (g_uintptr_t)(root->next) ;
-      unhash_node2(root) ;
+         return linkval(root->next) ;
       mark2(root) ;
    }
    if (depth == 2) {
@@ -1929,7 +3932,7 @@ g_uintptr_t hlifealgo::writecell_2p1(node *root, int depth) {
       // note:  we *must* not abort this prescan
       if ((cellcounter & 4095) == 0)
          lifeabortprogress(0, "Scanning tree") ;
-      root->nw = (node *)thiscell ;
+      setlinkval(root->nw, thiscell) ;
    } else {
       writecell_2p1(root->nw, depth-1) ;
       writecell_2p1(root->ne, depth-1) ;
@@ -1939,7 +3942,7 @@ g_uintptr_t hlifealgo::writecell_2p1(node *root, int depth) {
       // note:  we *must* not abort this prescan
       if ((cellcounter & 4095) == 0)
          lifeabortprogress(0, "Scanning tree") ;
-      root->next = (node *)thiscell ;
+      setlinkval(root->next, thiscell) ;
    }
    return thiscell ;
 }
@@ -1953,42 +3956,27 @@ g_uintptr_t hlifealgo::writecell_2p2(std::ostream &os, node *root, int depth) {
    if (root == zeronode(depth))
       return 0 ;
    if (depth == 2) {
-      if (cellcounter + 1 != (g_uintptr_t)(root->nw))
-         return (g_uintptr_t)(root->nw) ;
+      if (cellcounter + 1 != linkval(root->nw))
+         return linkval(root->nw) ;
       thiscell = ++cellcounter ;
       if ((cellcounter & 4095) == 0) {
          std::streampos siz = os.tellp();
          sprintf(progressmsg, "File size: %.2f MB", double(siz) / 1048576.0) ;
          lifeabortprogress(thiscell/(double)writecells, progressmsg) ;
       }
-      int i, j ;
-      unsigned int top, bot ;
-      leaf *n = (leaf *)root ;
-      root->nw = (node *)thiscell ;
-      unpack8x8(n->nw, n->ne, n->sw, n->se, &top, &bot) ;
-      for (j=7; (top | bot) && j>=0; j--) {
-         int bits = (top >> 24) ;
-         top = (top << 8) | (bot >> 24) ;
-         bot = (bot << 8) ;
-         for (i=0; bits && i<8; i++, bits = (bits << 1) & 255)
-            if (bits & 128)
-               os << '*' ;
-            else
-               os << '.' ;
-         os << '$' ;
-      }
-      os << '\n' ;
+      setlinkval(root->nw, thiscell) ;
+      writeleaf(os, (leaf *)root) ;
    } else {
-      if (cellcounter + 1 > (g_uintptr_t)(root->next) || isaborted())
-         return (g_uintptr_t)(root->next) ;
+      if (cellcounter + 1 > linkval(root->next) || isaborted())
+         return linkval(root->next) ;
       g_uintptr_t nw = writecell_2p2(os, root->nw, depth-1) ;
       g_uintptr_t ne = writecell_2p2(os, root->ne, depth-1) ;
       g_uintptr_t sw = writecell_2p2(os, root->sw, depth-1) ;
       g_uintptr_t se = writecell_2p2(os, root->se, depth-1) ;
       if (!isaborted() &&
-          cellcounter + 1 != (g_uintptr_t)(root->next)) { // this should never happen
+          cellcounter + 1 != linkval(root->next)) { // this should never happen
          lifefatal("Internal in writecell_2p2") ;
-         return (g_uintptr_t)(root->next) ;
+         return linkval(root->next) ;
       }
       thiscell = ++cellcounter ;
       if ((cellcounter & 4095) == 0) {
@@ -1996,19 +3984,35 @@ g_uintptr_t hlifealgo::writecell_2p2(std::ostream &os, node *root, int depth) {
          sprintf(progressmsg, "File size: %.2f MB", double(siz) / 1048576.0) ;
          lifeabortprogress(thiscell/(double)writecells, progressmsg) ;
       }
-      root->next = (node *)thiscell ;
+      setlinkval(root->next, thiscell) ;
       os << depth+1 << ' ' << nw << ' ' << ne << ' ' << sw << ' ' << se << '\n';
    }
    return thiscell ;
 }
+void hlifealgo::getstats(lifestats &s) {
+   lifealgo::getstats(s) ;
+   s.nodes = running_hperf.nodesCalculated + running_hperf.fastNodeInc ;
+   s.gcs = gccount ;
+   s.gcpauses = gcpauses.count ;
+   s.gcpausetotal = gcpauses.total ;
+   s.gcpausemax = gcpauses.longest ;
+   s.hashload = (double)hashpop / ((double)hashprime * HASHGROUP) ;
+   s.memory = (double)alloced ;
+}
 #define STRINGIFY(arg) STR2(arg)
 #define STR2(arg) #arg
 const char *hlifealgo::writeNativeFormat(std::ostream &os, char *comments) {
+   // evicted frames have to be stepped to before they can be saved
+   int framestosave = 0 ;
+   if (timeline.savetimeline && fillframes())
+      framestosave = timeline.framecount ;
+   finishgc() ;
    int depth = node_depth(root) ;
    os << "[M2] (golly " STRINGIFY(VERSION) ")\n" ;
 
    // AKT: always write out explicit rule
-   os << "#R " << hliferules.getrule() << '\n' ;
+   const char *rule = snapshotrule() ;
+   os << "#R " << (rule ? rule : hliferules.getrule()) << '\n' ;
 
    if (generation > bigint::zero) {
       // write non-zero gen count
@@ -2045,9 +4049,6 @@ const char *hlifealgo::writeNativeFormat(std::ostream &os, char *comments) {
    /* this is the new two-pass way */
    cellcounter = 0 ;
    vector<int> depths(timeline.framecount) ;
-   int framestosave = timeline.framecount ;
-   if (timeline.savetimeline == 0)
-     framestosave = 0 ;
    if (framestosave) {
      for (int i=0; i<timeline.framecount; i++) {
        node *frame = (node*)timeline.frames[i] ;
@@ -2069,7 +4070,7 @@ const char *hlifealgo::writeNativeFormat(std::ostream &os, char *comments) {
      for (int i=0; i<timeline.framecount; i++) {
        node *frame = (node*)timeline.frames[i] ;
        writecell_2p2(os, frame, depths[i]) ;
-       os << "#FRAME " << i << ' ' << (g_uintptr_t)frame->next << '\n' ;
+       os << "#FRAME " << i << ' ' << linkval(frame->next) << '\n' ;
      }
    }
    writecell_2p2(os, root, depth) ;
@@ -2084,6 +4085,400 @@ const char *hlifealgo::writeNativeFormat(std::ostream &os, char *comments) {
    inGC = 0 ;
    return 0 ;
 }
+/*
+ *   What each timeline frame pins: the bytes of the nodes it keeps
+ *   alive that neither the other roots nor the frames before it do.
+ *   We mark from the other roots without counting, then from each
+ *   frame in turn counting what is newly marked, following results
+ *   the way gc_mark does, and then walk it all again to clear the
+ *   marks.
+ */
+double hlifealgo::pinmark(node *n) {
+   if (marked(n))
+      return 0 ;
+   mark(n) ;
+   if (!is_node(n))
+      return sizeof(leaf) ;
+   double r = sizeof(node) + pinmark(n->nw) + pinmark(n->ne) +
+                             pinmark(n->sw) + pinmark(n->se) ;
+   if (n->res)
+      r += pinmark(n->res) ;
+   return r ;
+}
+void hlifealgo::pinclear(node *n) {
+   if (!marked(n))
+      return ;
+   clearmark(n) ;
+   if (is_node(n)) {
+      pinclear(n->nw) ;
+      pinclear(n->ne) ;
+      pinclear(n->sw) ;
+      pinclear(n->se) ;
+      if (n->res)
+         pinclear(n->res) ;
+   }
+}
+double hlifealgo::measureframes(vector<double> &pinned) {
+   int i, z ;
+   finishgc() ;
+   pinned.assign(timeline.framecount, 0) ;
+   for (z=nzeros-1; z>=0; z--)
+      if (zeronodea[z] != 0)
+         break ;
+   if (z >= 0)
+      pinmark(zeronodea[z]) ;
+   if (root != 0)
+      pinmark(root) ;
+   for (i=0; i<gsp; i++)
+      pinmark(stack[i]) ;
+   for (i=0; i<(int)snapshots.roots.size(); i++)
+      if (snapshots.roots[i])
+         pinmark((node *)snapshots.roots[i]) ;
+   double total = 0 ;
+   for (i=0; i<timeline.framecount; i++)
+      if (timeline.frames[i])
+         total += pinned[i] = pinmark((node *)timeline.frames[i]) ;
+   if (z >= 0)
+      pinclear(zeronodea[z]) ;
+   if (root != 0)
+      pinclear(root) ;
+   for (i=0; i<gsp; i++)
+      pinclear(stack[i]) ;
+   for (i=0; i<(int)snapshots.roots.size(); i++)
+      if (snapshots.roots[i])
+         pinclear((node *)snapshots.roots[i]) ;
+   for (i=0; i<timeline.framecount; i++)
+      if (timeline.frames[i])
+         pinclear((node *)timeline.frames[i]) ;
+   return total ;
+}
+/*
+ *   Write one frame to a timeline stream; see framestream in
+ *   lifealgo.h.  The root always gets a line of its own, even if an
+ *   earlier frame was the same.
+ */
+g_uintptr_t hlifealgo::streamcell(framestream &fs, node *n, int depth,
+                                  int fresh) {
+   if (!fresh) {
+      if (n == zeronode(depth))
+         return 0 ;
+      std::map<void *, g_uintptr_t>::iterator it = fs.known.find(n) ;
+      if (it != fs.known.end())
+         return it->second ;
+   }
+   g_uintptr_t thiscell ;
+   if (depth == 2) {
+      leaf *l = (leaf *)n ;
+      unsigned long long key = ((unsigned long long)l->nw << 48) |
+                               ((unsigned long long)l->ne << 32) |
+                               ((unsigned long long)l->sw << 16) | l->se ;
+      thiscell = fresh ? 0 : fs.findleaf(key) ;
+      if (thiscell == 0) {
+         thiscell = fs.addleaf(key) ;
+         writeleaf(fs.os, l) ;
+      }
+   } else {
+      g_uintptr_t nw = streamcell(fs, n->nw, depth-1, 0) ;
+      g_uintptr_t ne = streamcell(fs, n->ne, depth-1, 0) ;
+      g_uintptr_t sw = streamcell(fs, n->sw, depth-1, 0) ;
+      g_uintptr_t se = streamcell(fs, n->se, depth-1, 0) ;
+      thiscell = fs.addnode(depth+1, nw, ne, sw, se, fresh) ;
+   }
+   fs.known[n] = thiscell ;
+   return thiscell ;
+}
+const char *hlifealgo::writeframe(framestream &fs, void *frame) {
+   node *n = (node *)frame ;
+   finishgc() ;
+   fs.sync(gccount) ;
+   int d = node_depth(n) ;
+   g_uintptr_t cell ;
+   if (d == 2 && n == zeronode(2))
+      cell = fs.addnode(4, 0, 0, 0, 0, 1) ; // an empty leaf has no line
+   else
+      cell = streamcell(fs, n, d, 1) ;
+   fs.endframe(cell) ;
+   if (fs.os.fail())
+      return "Could not write the timeline stream." ;
+   return 0 ;
+}
+/*
+ *   The result cache on disk.  Unlike macrocell output this keeps
+ *   every node in the hash, computed results included, so a later run
+ *   of the same rule starts warm.  After a header come the leaves, as
+ *   their four shorts, and then the nodes, as the indices of their
+ *   four children and their result (zero if none), with every node
+ *   after everything it refers to.  Indices count the leaves from one
+ *   and then the nodes.  A checksum of all the records comes last.
+ *
+ *   Results computed for a step size of 2^ngens are only good for the
+ *   same step size above depth ngens+1, so the header records ngens
+ *   and whether such "halved" results were ever stored, and loading
+ *   drops the ones the current state cannot use.
+ */
+static const char cachemagic[8] = { 'H', 'L', 'C', 'A', 'C', 'H', 'E', '1' } ;
+struct cacheheader {
+   char magic[8] ;
+   unsigned int order ; // 0x01020304; the file is in native byte order
+   unsigned int ngens, halvesdone, rulelen ;
+   unsigned long long leaves, nodes ;
+} ;
+const int CACHEBUF = 4096 ; // words
+struct cachefile {
+   FILE *f ;
+   unsigned long long sum ;
+   g_uintptr_t count ;
+   int n ;
+   unsigned int buf[CACHEBUF] ;
+   void add(const unsigned int *w, int cnt) {
+      for (int i=0; i<cnt; i++)
+         sum = (sum ^ w[i]) * 0x100000001b3ULL ;
+   }
+   void put(const unsigned int *w, int cnt) {
+      if (n + cnt > CACHEBUF)
+         flush() ;
+      for (int i=0; i<cnt; i++)
+         buf[n++] = w[i] ;
+      add(w, cnt) ;
+   }
+   void flush() {
+      fwrite(buf, sizeof(unsigned int), n, f) ;
+      n = 0 ;
+   }
+   int get(unsigned int *w, int cnt) {
+      if ((int)fread(w, sizeof(unsigned int), cnt, f) != cnt)
+         return 0 ;
+      add(w, cnt) ;
+      return 1 ;
+   }
+} ;
+/*
+ *   Leaves are all numbered before we start on the nodes, so here we
+ *   only need to number nodes; we mark them with mark2 as the
+ *   macrocell writer does, and keep the number in next.
+ */
+static g_uintptr_t cachewrite(cachefile &cf, node *p) {
+   if (!is_node(p) || marked2(p))
+      return linkval(p->next) ;
+   node *r = p->res ;
+   mark2(p) ;
+   unsigned int rec[5] ;
+   rec[0] = (unsigned int)cachewrite(cf, p->nw) ;
+   rec[1] = (unsigned int)cachewrite(cf, p->ne) ;
+   rec[2] = (unsigned int)cachewrite(cf, p->sw) ;
+   rec[3] = (unsigned int)cachewrite(cf, p->se) ;
+   rec[4] = r ? (unsigned int)cachewrite(cf, r) : 0 ;
+   cf.put(rec, 5) ;
+   setlinkval(p->next, ++cf.count) ;
+   return cf.count ;
+}
+/*
+ *   Bring the table to a quiet state:  hashed, any pending rule change
+ *   applied, and no collection or resize half done.
+ */
+void hlifealgo::settlecache() {
+   ensure_hashed() ;
+   if (cacheinvalid) {
+      do_gc(1) ;
+      cacheinvalid = 0 ;
+   }
+   finishgc() ;
+   finishresize() ;
+}
+const char *hlifealgo::savecache(const char *filename) {
+   poller->bailIfCalculating() ;
+   settlecache() ;
+   cacheheader h ;
+   memcpy(h.magic, cachemagic, sizeof(h.magic)) ;
+   h.order = 0x01020304 ;
+   h.ngens = ngens ;
+   h.halvesdone = halvesdone ;
+   const char *rule = hliferules.getrule() ;
+   h.rulelen = (unsigned int)strlen(rule) ;
+   h.leaves = h.nodes = 0 ;
+   g_uintptr_t i ;
+   for (i=0; i<hashprime; i++)
+      for (hashtagword m = tagfull(hashtab[i].tags) ; m ; m &= m - 1) {
+         if (is_node(hashtab[i].slot[tagindex(m)]))
+            h.nodes++ ;
+         else
+            h.leaves++ ;
+      }
+   if (h.leaves + h.nodes >= 0xffffffffULL)
+      return "Too many nodes for a cache file." ;
+   FILE *f = fopen(filename, "wb") ;
+   if (f == 0)
+      return "Cannot create cache file." ;
+   fwrite(&h, sizeof(h), 1, f) ;
+   fwrite(rule, 1, h.rulelen, f) ;
+   cachefile *cf = new cachefile ;
+   cf->f = f ;
+   cf->sum = 0xcbf29ce484222325ULL ;
+   cf->count = 0 ;
+   cf->n = 0 ;
+   inGC = 1 ;
+   for (i=0; i<hashprime; i++)
+      for (hashtagword m = tagfull(hashtab[i].tags) ; m ; m &= m - 1) {
+         leaf *l = (leaf *)(node *)hashtab[i].slot[tagindex(m)] ;
+         if (!is_node(l)) {
+            unsigned int rec[2] ;
+            rec[0] = l->nw | ((unsigned int)l->ne << 16) ;
+            rec[1] = l->sw | ((unsigned int)l->se << 16) ;
+            cf->put(rec, 2) ;
+            setlinkval(l->next, ++cf->count) ;
+         }
+      }
+   for (i=0; i<hashprime; i++)
+      for (hashtagword m = tagfull(hashtab[i].tags) ; m ; m &= m - 1)
+         cachewrite(*cf, hashtab[i].slot[tagindex(m)]) ;
+   cf->flush() ;
+   fwrite(&cf->sum, sizeof(cf->sum), 1, f) ;
+   for (i=0; i<hashprime; i++)
+      for (hashtagword m = tagfull(hashtab[i].tags) ; m ; m &= m - 1) {
+         node *p = hashtab[i].slot[tagindex(m)] ;
+         if (is_node(p))
+            clearmark2(p) ;
+         p->next = 0 ;
+      }
+   inGC = 0 ;
+   delete cf ;
+   int err = ferror(f) ;
+   if (fclose(f) != 0 || err)
+      return "Error writing cache file." ;
+   if (verbose) {
+      sprintf(statusline, "Saved %llu leaves and %llu nodes to cache.",
+              h.leaves, h.nodes) ;
+      lifestatus(statusline) ;
+   }
+   return 0 ;
+}
+/*
+ *   Nodes go in through find_leaf() and find_node() like those of a
+ *   macrocell file, so they merge with whatever we already have, and
+ *   nothing is collected until the next step.  We check the structure
+ *   as we go; if anything is wrong, including the checksum at the end,
+ *   we throw away every cached result, as a rule change would.  If we
+ *   reach the memory limit we stop adding nodes (what we have is still
+ *   good, since every node comes after what it refers to).
+ */
+const char *hlifealgo::loadcache(const char *filename) {
+   poller->bailIfCalculating() ;
+   FILE *f = fopen(filename, "rb") ;
+   if (f == 0)
+      return "Cannot open cache file." ;
+   cacheheader h ;
+   char rule[MAXRULESIZE+1] ;
+   if (fread(&h, sizeof(h), 1, f) != 1 ||
+       memcmp(h.magic, cachemagic, sizeof(h.magic)) != 0 ||
+       h.order != 0x01020304) {
+      fclose(f) ;
+      return "Not a HashLife cache file." ;
+   }
+   if (h.rulelen > MAXRULESIZE || fread(rule, 1, h.rulelen, f) != h.rulelen ||
+       h.leaves + h.nodes >= 0xffffffffULL) {
+      fclose(f) ;
+      return "Bad header in cache file." ;
+   }
+   rule[h.rulelen] = 0 ;
+   if (strcmp(rule, hliferules.getrule()) != 0) {
+      fclose(f) ;
+      return "Cache file is for a different rule." ;
+   }
+   settlecache() ;
+   /*
+    *   If we have no halved results ourselves we can take on the
+    *   file's step size; otherwise we only keep results that are the
+    *   same for both.
+    */
+   int keepdepth = 1000000000 ;
+   if (h.ngens != (unsigned int)ngens) {
+      if (halvesdone == 0 && h.ngens > (unsigned int)ngens)
+         ngens = h.ngens ;
+      else
+         keepdepth = (h.ngens < (unsigned int)ngens ? h.ngens : ngens) + 1 ;
+   }
+   g_uintptr_t total = (g_uintptr_t)(h.leaves + h.nodes) ;
+   node **ind = (node **)calloc(total + 1, sizeof(node *)) ;
+   unsigned short *depths = (unsigned short *)calloc(total + 1,
+                                                     sizeof(unsigned short)) ;
+   if (ind == 0 || depths == 0) {
+      free(ind) ;
+      free(depths) ;
+      fclose(f) ;
+      return "Not enough memory to load cache file." ;
+   }
+   cachefile *cf = new cachefile ;
+   cf->f = f ;
+   cf->sum = 0xcbf29ce484222325ULL ;
+   const char *err = 0 ;
+   int full = 0, halves = 0 ;
+   g_uintptr_t i, loaded = 0 ;
+   for (i=1; i<=total; i++) {
+      unsigned int rec[5] ;
+      if (i <= h.leaves) {
+         if (!cf->get(rec, 2)) {
+            err = "Cache file is truncated." ;
+            break ;
+         }
+         if (full)
+            continue ;
+         clearstack() ;
+         ind[i] = (node *)find_leaf(rec[0] & 0xffff, rec[0] >> 16,
+                                    rec[1] & 0xffff, rec[1] >> 16) ;
+         depths[i] = 2 ;
+      } else {
+         if (!cf->get(rec, 5)) {
+            err = "Cache file is truncated." ;
+            break ;
+         }
+         if (full)
+            continue ;
+         int j ;
+         for (j=0; j<4; j++)
+            if (rec[j] == 0 || rec[j] >= i || depths[rec[j]] != depths[rec[0]])
+               break ;
+         if (j < 4 || depths[rec[0]] > 60000 || rec[4] >= i ||
+             (rec[4] != 0 && depths[rec[4]] != depths[rec[0]])) {
+            err = "Cache file is corrupt." ;
+            break ;
+         }
+         int d = depths[rec[0]] + 1 ;
+         clearstack() ;
+         node *p = find_node(ind[rec[0]], ind[rec[1]], ind[rec[2]], ind[rec[3]]) ;
+         if (rec[4] != 0 && p->res == 0 && d <= keepdepth) {
+            p->res = ind[rec[4]] ;
+            if (d - 1 > ngens)
+               halves = 1 ;
+         }
+         ind[i] = p ;
+         depths[i] = (unsigned short)d ;
+      }
+      loaded = i ;
+      if (alloced > maxmem)
+         full = 1 ;
+   }
+   unsigned long long sum = cf->sum, filesum = 0 ;
+   if (err == 0 &&
+       (fread(&filesum, sizeof(filesum), 1, f) != 1 || filesum != sum))
+      err = "Cache file checksum does not match." ;
+   clearstack() ;
+   delete cf ;
+   free(ind) ;
+   free(depths) ;
+   fclose(f) ;
+   if (err) {
+      clearcache() ;
+      return err ;
+   }
+   if (halves && halvesdone == 0)
+      halvesdone = 1 ;
+   if (verbose) {
+      sprintf(statusline, "Loaded %" PRIuPTR " of %" PRIuPTR
+              " cached nodes.", loaded, total) ;
+      lifestatus(statusline) ;
+   }
+   return 0 ;
+}
 char hlifealgo::statusline[200] ;
 static lifealgo *creator() { return new hlifealgo() ; }
 void hlifealgo::doInitializeAlgoInfo(staticAlgoInfo &ai) {
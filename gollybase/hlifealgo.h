@@ -6,6 +6,9 @@
 #include "lifealgo.h"
 #include "liferules.h"
 #include "util.h"
+#ifdef COMPACTNODES
+#include <deque>
+#endif
 /*
  *   Into instances of this node structure is where almost all of the
  *   memory allocated by this program goes.  Thus, it is imperative we
@@ -87,15 +90,69 @@
  *
  *   Where do we cache the results?  Well, we cache the results in the
  *   same node structure we are using to store the pointers to the
- *   smaller squares themselves.  And since we're hashing them all
- *   together, we want a next pointer for the hash chain.  Put all of
- *   this together, and you get the following structure for the 16-squares
- *   and larger:
+ *   smaller squares themselves.  We also want a next pointer, which
+ *   links free nodes and holds marks and scratch values for the tree
+ *   walks that need them (the hash table itself is a separate array;
+ *   see below).  Put all of this together, and you get the following
+ *   structure for the 16-squares and larger:
+ */
+#if defined(COMPACTNODES) && !defined(GOLLY64BIT)
+#undef COMPACTNODES // pointers are already 32 bits
+#endif
+#ifdef COMPACTNODES
+/*
+ *   On 64-bit machines the six pointers make a node 48 bytes.  If we
+ *   build with COMPACTNODES, every node and leaf lives in a single
+ *   process-wide arena instead, and the links are 32-bit indexes into
+ *   that arena, so a node takes 24 bytes.  Index 0 is the null link.
+ *   The arena is a reserved range of address space that is committed
+ *   as it fills, so nodes never move and can still be handed around
+ *   as ordinary node pointers; only the links stored inside nodes
+ *   (and the hash table) are compressed.  The cost is a little
+ *   arithmetic on each link followed, and a limit of 2**32 nodes for
+ *   all universes together.
  */
+struct node ;
+class nodeptr {
+public:
+   nodeptr() = default ;
+   nodeptr(node *p) : ix(index(p)) {}
+   operator node *() const { return addr(ix) ; }
+   node *operator->() const { return addr(ix) ; }
+   static node *addr(unsigned int i) ;
+   static unsigned int index(const node *p) ;
+   unsigned int ix ;
+   static char *base ;
+} ;
+#else
+typedef struct node *nodeptr ;
+#endif
+#ifdef NODEMETA
+/*
+ *   If we build with NODEMETA, every node and leaf also carries its
+ *   population and how many empty rows or columns it has along each
+ *   edge, filled in once when it is made.  Then the population and
+ *   the bounding box of the pattern come from a few nodes near the
+ *   top of the tree instead of a walk over all of it, so they stay
+ *   cheap however often they are asked for.  The counts only fit for
+ *   nodes up to METADEPTH (32768 cells on a side); above that the
+ *   walks still happen, but stop there.  This costs 16 bytes per node
+ *   (a third more, or two thirds more with COMPACTNODES).
+ */
+const int METADEPTH = 14 ;
+struct nodemeta {
+   unsigned int pop ;
+   unsigned short top, bottom, left, right ; /* side length if empty */
+   unsigned char depth ;                     /* 255 if deeper */
+} ;
+#endif
 struct node {
-   node *next ;              /* hash link */
-   node *nw, *ne, *sw, *se ; /* constant; nw != 0 means nonleaf */
-   node *res ;               /* cache */
+   nodeptr next ;              /* free link, marks */
+   nodeptr nw, ne, sw, se ;    /* constant; nw != 0 means nonleaf */
+   nodeptr res ;               /* cache */
+#ifdef NODEMETA
+   nodemeta meta ;             /* constant; leaves keep theirs here too */
+#endif
 } ;
 /*
  *   For the 8-squares, we do not have `children', we have actual data
@@ -121,17 +178,41 @@ struct node {
  *   so on.
  */
 struct leaf {
-   node *next ;              /* hash link */
-   node *isnode ;            /* must always be zero for leaves */
+   nodeptr next ;              /* free link, marks */
+   nodeptr isnode ;            /* must always be zero for leaves */
    unsigned short nw, ne, sw, se ;  /* constant */
+#ifdef COMPACTNODES
+   unsigned short res1, res2 ;      /* constant */
+   unsigned short leafpop ;         /* how many set bits */
+#else
    bigint leafpop ;         /* how many set bits */
    unsigned short res1, res2 ;      /* constant */
+#endif
 } ;
 /*
  *   If it is a struct node, this returns a non-zero value, otherwise it
  *   returns a zero value.
  */
+#ifdef COMPACTNODES
+inline node *nodeptr::addr(unsigned int i) {
+   return i ? (node *)(base + (g_uintptr_t)i * sizeof(node)) : 0 ;
+}
+inline unsigned int nodeptr::index(const node *p) {
+   return p ? (unsigned int)(((const char *)p - base) / sizeof(node)) : 0 ;
+}
+#define is_node(n) (((node *)(n))->nw.ix)
+#else
 #define is_node(n) (((node *)(n))->nw)
+#endif
+/*
+ *   The hash table is an array of these; see util.h.  With 64-bit
+ *   pointers a group is exactly one cache line.
+ */
+const int HASHGROUP = sizeof(nodeptr) == 4 ? 8 : 7 ;
+struct hashgroup {
+   hashtagword tags ;
+   nodeptr slot[HASHGROUP] ;
+} ;
 /*
  *   For explicit prefetching we retain some state on our lookup
  *   calculations.
@@ -140,9 +221,56 @@ struct leaf {
 struct setup_t { 
    g_uintptr_t h ;
    struct node *nw, *ne, *sw, *se ;
-   void prefetch(node **addr) const { PREFETCH(addr) ; }
+   void prefetch(const void *addr) const { PREFETCH(addr) ; }
 } ;
 #endif
+/*
+ *   A plain outer-totalistic rule for the leaf kernel, as sets of
+ *   nine-cell sums (center included):  bit i of born is set if a dead
+ *   cell with i live neighbors comes alive, and bit i of survive if a
+ *   live cell with i-1 live neighbors stays alive.
+ */
+struct leafrule {
+   int born, survive ;
+} ;
+/*
+ *   What the drawing code keeps from one draw to the next:  the tiles
+ *   it has rasterized, by node, and where each tile went last time.
+ *   See hlifedraw.cpp.
+ */
+struct drawntile {
+   int used ;                        // the draw that last used it
+   std::vector<unsigned char> pix ;  // what went to pixblit
+} ;
+struct tileplace {
+   int x, y ;                        // where it went, in pixblit terms
+   node *n ;
+   bool operator<(const tileplace &b) const {
+      return y < b.y || (y == b.y && x < b.x) ;
+   }
+} ;
+struct drawcache {
+   drawcache() : count(0), gc(-1), gcphase(0), all(0), tiled(0), who(0),
+                 mag(0), pmag(0), live(0), dead(0), w(0), h(0) {}
+   std::map<node *, drawntile> tiles ;
+   std::vector<std::vector<unsigned char> > spare ; // pix of evicted tiles
+   std::vector<tileplace> places, lastplaces ;
+   int count ;         // draws so far
+   int gc, gcphase ;   // when the tiles were last known good
+   int all ;           // whole view damaged this draw
+   int tiled ;         // last draw was all tiles (places are valid)
+   liferender *who ;   // and went to this retained renderer
+   int mag, pmag ;
+   unsigned int live, dead ;
+   bigint x, y ;
+   int w, h ;
+} ;
+/*
+ *   State for multithreaded evaluation lives in hlifealgo.cpp.
+ */
+struct hparallel ;
+struct htask ;
+struct cellband ;
 /**
  *   Our hlifealgo class.
  */
@@ -155,8 +283,11 @@ public:
    // the empty pattern.
    virtual void clearall() ; // not implemented
    virtual int setcell(int x, int y, int newstate) ;
+   virtual int setcellrow(int y, const cellrun *runs, int nruns) ;
    virtual int getcell(int x, int y) ;
    virtual int nextcell(int x, int y, int &state) ;
+   virtual void getcellruns(int top, int left, int bottom, int right,
+                            vector<cellspan> &spans) ;
    virtual void endofpattern() ;
    virtual void setIncrement(bigint inc) ;
    virtual void setIncrement(int inc) { setIncrement(bigint(inc)) ; }
@@ -169,12 +300,19 @@ public:
    virtual const char *setrule(const char *s) ;
    virtual const char *getrule() { return hliferules.getrule() ; }
    virtual void step() ;
+   /*
+    *   We step a torus ourselves if its sides are powers of two and
+    *   each half side is a whole number of leaves (see runpattern).
+    */
+   virtual bool wrapsgrid() { return ispow2torus(16) ; }
    virtual void* getcurrentstate() { return root ; }
    virtual void setcurrentstate(void *n) ;
    /*
     *   The contract of draw() is that it render every pixel in the
     *   viewport precisely once.  This allows us to eliminate all
-    *   flashing.  Later we'll make this be damage-specific.
+    *   flashing.  For a retained renderer it is damage-specific
+    *   instead:  only the parts that changed since the last draw get
+    *   damaged and redrawn (see liferender.h).
     */
    virtual void draw(viewport &view, liferender &renderer) ;
    virtual void fit(viewport &view, int force) ;
@@ -182,7 +320,34 @@ public:
    virtual void findedges(bigint *t, bigint *l, bigint *b, bigint *r) ;
    virtual const char *readmacrocell(char *line) ;
    virtual const char *writeNativeFormat(std::ostream &os, char *comments) ;
+   virtual double measureframes(vector<double> &pinned) ;
+   virtual const char *writeframe(framestream &fs, void *frame) ;
+   virtual void getstats(lifestats &s) ;
    static void doInitializeAlgoInfo(staticAlgoInfo &) ;
+   /*
+    *   Nodes at this depth or more are split across threads when the
+    *   pool in util.h has more than one thread.
+    */
+   static void setParallelDepth(int d) ;
+   /*
+    *   With incremental garbage collection turned on, collections are
+    *   started a little before memory runs out and done in small slices
+    *   as new nodes are allocated, rather than all at once.
+    */
+   static void setIncrementalGC(int on) { incrementalgc = on ; }
+   /*
+    *   Time the bottom-level evaluation of the current rule on random
+    *   16-squares, with the leaf kernel and with the rule table, and
+    *   report evaluations per second through lifestatus().
+    */
+   void leafbenchmark(int millions) ;
+   /*
+    *   Save every node we have, computed results included, or load a
+    *   file saved earlier for the same rule so its results are reused.
+    *   Both return an error message or null.
+    */
+   const char *savecache(const char *filename) ;
+   const char *loadcache(const char *filename) ;
 private:
 /*
  *   Some globals representing our universe.  The root is the
@@ -200,6 +365,14 @@ private:
    int depth ;
    node **zeronodea ;
    int nzeros ;
+/*
+ *   While a torus is being stepped, the root it was cut from (at
+ *   depth wrapdepth) and the grid in tree coordinates:  wrapwd by
+ *   wrapht cells with wrapleft and wrapbottom its lowest x and y.
+ */
+   node *wraproot ;
+   int wrapdepth ;
+   G_INT64 wrapleft, wrapbottom, wrapwd, wrapht ;
 /*
  *   Finally, our gc routine.  We keep a `stack' of all the `roots'
  *   we want to preserve.  Nodes not reachable from here, we allow to
@@ -207,12 +380,15 @@ private:
  */
    node **stack ;
    int stacksize ;
-   g_uintptr_t hashpop, hashlimit, hashprime ;
+   g_uintptr_t hashpop, hashlimit, hashprime, hashdead ;
 #ifndef PRIMEMOD
    g_uintptr_t hashmask ;
 #endif
    static double maxloadfactor ;
-   node **hashtab ;
+   hashgroup *hashtab ;
+   int hashfull ; // no room to grow; collect instead
+   hashgroup *oldtab ; // being emptied into hashtab by a resize
+   g_uintptr_t oldprime, migratecursor ;
    int halvesdone ;
    int gsp ;
    g_uintptr_t alloced, maxmem ;
@@ -221,6 +397,8 @@ private:
    g_uintptr_t totalthings ;
    node *nodeblocks ;
    char *ruletable ;
+   leafrule lrule ;
+   int leafkernel ; // lrule describes ruletable; use it for leaves
    bigint population ;
    bigint setincrement ;
    bigint pow2step ; // greatest power of two in increment
@@ -236,6 +414,7 @@ private:
    int uviewh, uvieww, viewh, vieww, mag, pmag ;
    int llbits, llsize ;
    char *llxb, *llyb ;
+   drawcache dcache ;
    int hashed ;
    int cacheinvalid ;
    g_uintptr_t cellcounter ; // used when writing
@@ -244,26 +423,77 @@ private:
    int gcstep ; // how many gcs this step
    hperf running_hperf, step_hperf, inc_hperf ;
    int softinterrupt ;
+   hparallel *par ;
+   int parallel ;
+   static int pardepth ;
+   int gcphase ; // 0 idle, 1 marking, 2 sweeping
+   node **graystack ;
+   g_uintptr_t graysp, graysize ;
+   g_uintptr_t sweepcursor ;
+   g_uintptr_t gcfreed ;
+   int gcbudget, gccountdown ;
+   gcpausehist gcpauses ;
+   static int incrementalgc ;
+#ifdef COMPACTNODES
+   std::deque<bigint> popcache ; // calcpop results, indexed by next
+#endif
    static char statusline[] ;
 //
    void leafres(leaf *n) ;
+   void setleafrule() ;
+   void settlecache() ;
    void resize() ;
+   void migrate(g_uintptr_t groups) ;
+   void finishresize() ;
+   void endresize() ;
+   g_uintptr_t hashinsert(node *n, g_uintptr_t h) ;
+   nodeptr *probe_node(hashgroup *tab, g_uintptr_t groups,
+                       g_uintptr_t g, unsigned int tag,
+                       node *nw, node *ne, node *sw, node *se) ;
+   nodeptr *probe_leaf(hashgroup *tab, g_uintptr_t groups,
+                       g_uintptr_t g, unsigned int tag,
+                       unsigned short nw, unsigned short ne,
+                       unsigned short sw, unsigned short se) ;
    node *find_node(node *nw, node *ne, node *sw, node *se) ;
+   node *find_node_miss(node *nw, node *ne, node *sw, node *se, g_uintptr_t h) ;
 #ifdef USEPREFETCH
    node *find_node(setup_t &su) ;
    void setupprefetch(setup_t &su, node *nw, node *ne, node *sw, node *se) ;
 #endif
-   void unhash_node(node *n) ;
-   void unhash_node2(node *n) ;
-   void rehash_node(node *n) ;
    leaf *find_leaf(unsigned short nw, unsigned short ne,
                    unsigned short sw, unsigned short se) ;
    node *getres(node *n, int depth) ;
+   node *calcres(node *n, int depth) ;
    node *dorecurs(node *n, node *ne, node *t, node *e, int depth) ;
    node *dorecurs_half(node *n, node *ne, node *t, node *e, int depth) ;
    leaf *dorecurs_leaf(leaf *n, leaf *ne, leaf *t, leaf *e) ;
    leaf *dorecurs_leaf_half(leaf *n, leaf *ne, leaf *t, leaf *e) ;
    leaf *dorecurs_leaf_quarter(leaf *n, leaf *ne, leaf *t, leaf *e) ;
+   node *getres_par(node *n, int depth) ;
+   node *dorecurs_par(node *n, node *ne, node *t, node *e, int depth) ;
+   node *dorecurs_half_par(node *n, node *ne, node *t, node *e, int depth) ;
+   void evalpar(node **in, node **out, int n, int depth) ;
+   void runtask(htask *task) ;
+   int beginparallel() ;
+   void endparallel() ;
+   void enteractive() ;
+   void leaveactive() ;
+   void safepoint() ;
+   void stopworld(int what) ;
+   node *find_node_par(node *nw, node *ne, node *sw, node *se) ;
+   leaf *find_leaf_par(unsigned short nw, unsigned short ne,
+                       unsigned short sw, unsigned short se) ;
+   node *probe_node_par(g_uintptr_t g, unsigned int tag,
+                        node *nw, node *ne, node *sw, node *se) ;
+   leaf *probe_leaf_par(g_uintptr_t g, unsigned int tag,
+                        unsigned short nw, unsigned short ne,
+                        unsigned short sw, unsigned short se) ;
+   void hashinsert_par(node *n, g_uintptr_t h) ;
+   node *newnode_par(int &full) ;
+   void releasenode_par(node *n) ;
+   node *save_par(node *n) ;
+   int stackmark() ;
+   void newnodeblock() ;
    node *newnode() ;
    leaf *newleaf() ;
    node *newclearednode() ;
@@ -273,10 +503,25 @@ private:
    node *zeronode(int depth) ;
    node *pushroot(node *n) ;
    node *gsetbit(node *n, int x, int y, int newstate, int depth) ;
+   leaf *gleaf(int x, int y) ;
+   node *rowpath[31] ;           // nodes on the last path gleaf took,
+   int rowpathx[31], rowpathy[31] ; // by depth, with their positions
+   int rowpathtop ;              // rowpath is valid below this depth
    int getbit(node *n, int x, int y, int depth) ;
    int nextbit(node *n, int x, int y, int depth) ;
+   void bandruns(const std::vector<cellband> &band, int y, int depth,
+                 int top, int left, int bottom, int right,
+                 vector<cellspan> &spans) ;
    node *hashpattern(node *root, int depth) ;
    node *popzeros(node *n) ;
+   node *centernode(node *n) ;
+   node *nodeat(int depth, G_INT64 x, G_INT64 y) ;
+   node *cliptogrid(node *n, int depth, G_INT64 x, G_INT64 y) ;
+   node *mergenodes(node *a, node *b, int depth) ;
+   node *gridblock(int depth, G_INT64 x, G_INT64 y) ;
+   node *tilegrid(int depth, G_INT64 x, G_INT64 y) ;
+   node *wrapgrid(int &depth) ;
+   node *unwrapgrid(node *n, int depth) ;
    const bigint &calcpop(node *root, int depth) ;
    void aftercalcpop2(node *root, int depth) ;
    void afterwritemc(node *root, int depth) ;
@@ -287,6 +532,16 @@ private:
    void clearcache() ;
    void gc_mark(node *root, int invalidate) ;
    void do_gc(int invalidate) ;
+   void gcnewnode(node *n, g_uintptr_t g) ;
+   void shade(node *n) ;
+   void shaderoots() ;
+   void startgc() ;
+   int gcmark(int budget) ;
+   int gcsweep(int budget) ;
+   void gcslice() ;
+   void gcreclaim() ;
+   void finishgc() ;
+   void endgc() ;
    void clearcache(node *n, int depth, int clearto) ;
    void clearcache_p1(node *n, int depth, int clearto) ;
    void clearcache_p2(node *n, int depth, int clearto) ;
@@ -296,13 +551,26 @@ private:
    void renderbm(int x, int y) ;
    void fill_ll(int d) ;
    void drawnode(node *n, int llx, int lly, int depth, node *z) ;
+   void drawtile(node *n, int llx, int lly, int depth, node *z) ;
+   void begindraw() ;
+   void damageall() ;
+   void enddraw(int tiled) ;
    void ensure_hashed() ;
    g_uintptr_t writecell(std::ostream &os, node *root, int depth) ;
    g_uintptr_t writecell_2p1(node *root, int depth) ;
    g_uintptr_t writecell_2p2(std::ostream &os, node *root, int depth) ;
+   void writeleaf(std::ostream &os, leaf *n) ;
+#ifdef NODEMETA
+   void setleafmeta(leaf *l) ;
+   void setmeta(node *n) ;
+#endif
+   double pinmark(node *n) ;
+   void pinclear(node *n) ;
+   g_uintptr_t streamcell(framestream &fs, node *n, int depth, int fresh) ;
    void unpack8x8(unsigned short nw, unsigned short ne,
                   unsigned short sw, unsigned short se,
                   unsigned int *top, unsigned int *bot) ;
    liferules hliferules ;
+   friend struct htask ;
 } ;
 #endif
@@ -77,24 +77,15 @@ void draw4x4_4(unsigned short bits1, unsigned short bits2, int llx, int lly) {
    p[-3*byteoff] = (unsigned char)(((bits1 >> 8) & 0xf0) + ((bits2 >> 12) & 0xf)) ;
 }
 
-void hlifealgo::renderbm(int x, int y) {
-   // x,y is lower left corner
-   int rx = x ;
-   int ry = y ;
-   int rw = bmsize ;
-   int rh = bmsize ;
-   if (pmag > 1) {
-      rx *= pmag ;
-      ry *= pmag ;
-      rw *= pmag ;
-      rh *= pmag ;
-   }
-   ry = uviewh - ry - rh ;
-   
+/*
+ *   Turn the bitmap in bigbuf into the pixels pixblit or stateblit
+ *   wants, and clear bigbuf for the next one.
+ */
+static void expandbm(unsigned char *pix, int states) {
    unsigned char *bigptr = bigbuf;
-   if (renderer->justState() || pmag > 1) {
+   if (states) {
       // convert each bigbuf byte into 8 bytes of state data
-      unsigned char *pixptr = pixbuf;
+      unsigned char *pixptr = pix;
 
       for (int i = 0; i < ibufsize * 4; i++) {
          unsigned char byte = *bigptr++;
@@ -110,7 +101,7 @@ void hlifealgo::renderbm(int x, int y) {
    } else {
       // convert each bigbuf byte into 32 bytes of pixel data (8 * RGBA)
       // get RGBA view of pixel buffer
-      unsigned int *pixptr = (unsigned int *)pixbuf;
+      unsigned int *pixptr = (unsigned int *)pix;
 
       for (int i = 0; i < ibufsize * 4; i++) {
          unsigned char byte = *bigptr++;
@@ -124,12 +115,188 @@ void hlifealgo::renderbm(int x, int y) {
          *pixptr++ = (byte & 1) ? liveRGBA : deadRGBA;
       }
    }
+   memset(bigbuf, 0, sizeof(ibigbuf)) ;
+}
+
+void hlifealgo::renderbm(int x, int y) {
+   // x,y is lower left corner
+   int rx = x ;
+   int ry = y ;
+   int rw = bmsize ;
+   int rh = bmsize ;
+   if (pmag > 1) {
+      rx *= pmag ;
+      ry *= pmag ;
+      rw *= pmag ;
+      rh *= pmag ;
+   }
+   ry = uviewh - ry - rh ;
+   
+   expandbm(pixbuf, renderer->justState() || pmag > 1) ;
    if (renderer->justState())
       renderer->stateblit(rx, ry, rw, rh, pixbuf) ;
    else
       renderer->pixblit(rx, ry, rw, rh, pixbuf, pmag);
-   
-   memset(bigbuf, 0, sizeof(ibigbuf)) ;
+}
+
+/*
+ *   Once the view is big enough, drawnode() rasterizes one node bmsize
+ *   pixels across at a time.  Nodes are canonical, so those pixels
+ *   depend only on the node and the scale; we keep the tiles of recent
+ *   draws by node and blit the copy when the same node turns up again,
+ *   whether that part of the pattern has not changed or the view has
+ *   been panned.  A node only gets its own copy the second time we see
+ *   it; most tiles of a busy pattern are never seen again, and for those
+ *   the shared pixbuf is faster.  For a retained renderer we also
+ *   remember where each tile went:  the same node in the same place
+ *   needs no blit at all, and places nothing is drawn to any more get
+ *   damaged.
+ *
+ *   The tiles are keyed by address, so they are only good until a
+ *   collection frees nodes.  State renderers (getcells) bypass all of
+ *   this so they do not disturb what the display has built up.
+ */
+void hlifealgo::drawtile(node *n, int llx, int lly, int depth, node *z) {
+   int rw = bmsize * pmag ;
+   int rx = -llx * pmag ;
+   int ry = uviewh + lly * pmag - rw ;
+   drawntile *t = 0 ;
+   if (!renderer->justState()) {
+      if (renderer->retained()) {
+         tileplace p = { rx, ry, n } ;
+         dcache.places.push_back(p) ;
+         if (!dcache.all) {
+            vector<tileplace>::iterator it =
+               lower_bound(dcache.lastplaces.begin(),
+                           dcache.lastplaces.end(), p) ;
+            if (it != dcache.lastplaces.end() && it->x == rx &&
+                it->y == ry && it->n == n)
+               return ;
+            renderer->damage(rx, ry, rw, rw) ;
+         }
+      }
+      t = &dcache.tiles[n] ;
+      int seen = t->used ;
+      t->used = dcache.count ;
+      if (!t->pix.empty()) {
+         renderer->pixblit(rx, ry, rw, rw, &t->pix[0], pmag) ;
+         return ;
+      }
+      if (!seen)
+         t = 0 ;
+   }
+   drawnode(n->sw, 0, 0, depth, z) ;
+   drawnode(n->se, -(bmsize/2), 0, depth, z) ;
+   drawnode(n->nw, 0, -(bmsize/2), depth, z) ;
+   drawnode(n->ne, -(bmsize/2), -(bmsize/2), depth, z) ;
+   if (t == 0) {
+      renderbm(-llx, -lly) ;
+      return ;
+   }
+   if (!dcache.spare.empty()) {
+      t->pix.swap(dcache.spare.back()) ;
+      dcache.spare.pop_back() ;
+   }
+   t->pix.resize(pmag > 1 ? bmsize * bmsize : bmsize * bmsize * 4) ;
+   expandbm(&t->pix[0], pmag > 1) ;
+   renderer->pixblit(rx, ry, rw, rw, &t->pix[0], pmag) ;
+}
+
+/*
+ *   Decide how much of what we kept from the last draw still holds.
+ *   Called once the scale and colors for this draw are known.
+ */
+void hlifealgo::begindraw() {
+   drawcache &dc = dcache ;
+   dc.count++ ;
+   dc.all = 0 ;
+   dc.places.clear() ;
+   if (renderer->justState())
+      return ;
+   if (dc.gc != gccount || dc.gcphase != gcphase || gcphase == 2 ||
+       dc.mag != mag || dc.pmag != pmag ||
+       (pmag == 1 && (dc.live != liveRGBA || dc.dead != deadRGBA))) {
+      for (map<node *, drawntile>::iterator t=dc.tiles.begin();
+           t != dc.tiles.end(); t++) {
+         dc.spare.push_back(vector<unsigned char>()) ;
+         dc.spare.back().swap(t->second.pix) ;
+      }
+      dc.tiles.clear() ;
+      dc.tiled = 0 ;
+      dc.mag = mag ;
+      dc.pmag = pmag ;
+      dc.live = liveRGBA ;
+      dc.dead = deadRGBA ;
+   }
+   if (dc.who != renderer || dc.x != view->x || dc.y != view->y ||
+       dc.w != uvieww || dc.h != uviewh) {
+      dc.tiled = 0 ;
+      dc.x = view->x ;
+      dc.y = view->y ;
+      dc.w = uvieww ;
+      dc.h = uviewh ;
+   }
+   if (!dc.tiled) {
+      dc.lastplaces.clear() ;
+      damageall() ;
+   }
+}
+
+/*
+ *   Anything other than whole tiles gets redrawn from scratch.
+ */
+void hlifealgo::damageall() {
+   if (!dcache.all && !renderer->justState() && renderer->retained())
+      renderer->damage(0, 0, view->getwidth(), view->getheight()) ;
+   dcache.all = 1 ;
+}
+
+/*
+ *   Damage the places we drew to last time but not this time, and
+ *   trim the tiles back to a couple of views' worth.
+ */
+void hlifealgo::enddraw(int tiled) {
+   drawcache &dc = dcache ;
+   if (renderer->justState())
+      return ;
+   sort(dc.places.begin(), dc.places.end()) ;
+   if (!dc.all && renderer->retained()) {
+      int rw = bmsize * pmag ;
+      vector<tileplace>::iterator it = dc.places.begin() ;
+      for (size_t i=0; i<dc.lastplaces.size(); i++) {
+         const tileplace &p = dc.lastplaces[i] ;
+         while (it != dc.places.end() && *it < p)
+            it++ ;
+         if (it == dc.places.end() || it->x != p.x || it->y != p.y)
+            renderer->damage(p.x, p.y, rw, rw) ;
+      }
+   }
+   swap(dc.lastplaces, dc.places) ;
+   dc.places.clear() ;
+   dc.tiled = tiled && renderer->retained() ;
+   dc.who = renderer ;
+   dc.gc = gccount ;
+   dc.gcphase = gcphase ;
+   size_t used = 0 ;
+   vector<pair<int, node *> > old ;
+   for (map<node *, drawntile>::iterator t=dc.tiles.begin();
+        t != dc.tiles.end(); t++)
+      if (t->second.used == dc.count)
+         used++ ;
+      else
+         old.push_back(make_pair(t->second.used, t->first)) ;
+   size_t keep = 2 * used + 16 ;
+   if (dc.tiles.size() > keep) {
+      sort(old.begin(), old.end()) ;
+      for (size_t i=0; i<old.size() && dc.tiles.size() > keep; i++) {
+         map<node *, drawntile>::iterator t = dc.tiles.find(old[i].second) ;
+         dc.spare.push_back(vector<unsigned char>()) ;
+         dc.spare.back().swap(t->second.pix) ;
+         dc.tiles.erase(t) ;
+      }
+   }
+   if (dc.spare.size() > used)
+      dc.spare.resize(used) ;
 }
 
 /*
@@ -149,11 +316,7 @@ void hlifealgo::drawnode(node *n, int llx, int lly, int depth, node *z) {
       sw >>= 1 ;
       depth-- ;
       if (sw == (bmsize >> 1)) {
-         drawnode(n->sw, 0, 0, depth, z) ;
-         drawnode(n->se, -(bmsize/2), 0, depth, z) ;
-         drawnode(n->nw, 0, -(bmsize/2), depth, z) ;
-         drawnode(n->ne, -(bmsize/2), -(bmsize/2), depth, z) ;
-         renderbm(-llx, -lly) ;
+         drawtile(n, llx, lly, depth, z) ;
       } else {
          drawnode(n->sw, llx, lly, depth, z) ;
          drawnode(n->se, llx-sw, lly, depth, z) ;
@@ -282,6 +445,8 @@ void hlifealgo::draw(viewport &viewarg, liferender &rendererarg) {
       viewh = uviewh ;
       vieww = uvieww ;
    }
+   begindraw() ;
+   int tiled = 0 ;
    int d = depth ;
    fill_ll(d) ;
    int maxd = vieww ;
@@ -344,6 +509,7 @@ void hlifealgo::draw(viewport &viewarg, liferender &rendererarg) {
    }
    /* clear the border *around* the universe if necessary */
    if (d + 1 <= mag) {
+      damageall() ;
       node *z = zeronode(d) ;
       if (llx > 0 || lly > 0 || llx + vieww <= 0 || lly + viewh <= 0 ||
           (sw == z && se == z && nw == z && ne == z)) {
@@ -356,6 +522,7 @@ void hlifealgo::draw(viewport &viewarg, liferender &rendererarg) {
       z = zeronode(d) ;
       maxd = 1 << (d - mag + 2) ;
       if (maxd <= bmsize) {
+         damageall() ;
          maxd >>= 1 ;
          drawnode(sw, 0, 0, d, z) ;
          drawnode(se, -maxd, 0, d, z) ;
@@ -363,6 +530,7 @@ void hlifealgo::draw(viewport &viewarg, liferender &rendererarg) {
          drawnode(ne, -maxd, -maxd, d, z) ;
          renderbm(-llx, -lly) ;
       } else {
+         tiled = 1 ;
          maxd >>= 1 ;
          drawnode(sw, llx, lly, d, z) ;
          drawnode(se, llx-maxd, lly, d, z) ;
@@ -371,6 +539,7 @@ void hlifealgo::draw(viewport &viewarg, liferender &rendererarg) {
       }
    }
 bail:
+   enddraw(tiled) ;
    renderer = 0 ;
    view = 0 ;
 }
@@ -442,6 +611,36 @@ void hlifealgo::findedges(bigint *ptop, bigint *pleft, bigint *pbottom, bigint *
    right.push_back(root) ;
    int topbm = 0, bottombm = 0, rightbm = 0, leftbm = 0 ;
    while (currdepth >= 0) {
+#ifdef NODEMETA
+      if (currdepth <= METADEPTH) {
+         // the nodes on each edge know how far in their cells start
+         int mtop = 1 << (currdepth + 1), mbottom = mtop ;
+         int mleft = mtop, mright = mtop ;
+         for (i=0; i<(int)top.size(); i++)
+            if (top[i]->meta.top < mtop)
+               mtop = top[i]->meta.top ;
+         for (i=0; i<(int)bottom.size(); i++)
+            if (bottom[i]->meta.bottom < mbottom)
+               mbottom = bottom[i]->meta.bottom ;
+         for (i=0; i<(int)left.size(); i++)
+            if (left[i]->meta.left < mleft)
+               mleft = left[i]->meta.left ;
+         for (i=0; i<(int)right.size(); i++)
+            if (right[i]->meta.right < mright)
+               mright = right[i]->meta.right ;
+         // now in units of half a cell, as the loop below leaves them
+         ymax <<= (currdepth + 1) ;
+         ymax.add_smallint(-2 * mtop) ;
+         ymin <<= (currdepth + 1) ;
+         ymin.add_smallint(2 * mbottom) ;
+         xmax <<= (currdepth + 1) ;
+         xmax.add_smallint(-2 * mright) ;
+         xmin <<= (currdepth + 1) ;
+         xmin.add_smallint(2 * mleft) ;
+         currdepth = -1 ;
+         break ;
+      }
+#endif
       currdepth-- ;
       if (currdepth == 1) { // we have leaf nodes; turn them into bitmasks
          topbm = getbitsfromleaves(top) & 0xff ;
@@ -2050,6 +2050,10 @@ static unsigned char jvncolors[] = {
     21, 137, 137     // 31    darker
 };
 
+void jvnalgo::slowcalcblock(const state *in, int stride, state *out, int n) {
+   ghashcalcblock(this, in, stride, out, n) ;
+}
+
 static lifealgo *creator() { return new jvnalgo() ; }
 
 void jvnalgo::doInitializeAlgoInfo(staticAlgoInfo &ai) {
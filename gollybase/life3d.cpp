@@ -0,0 +1,700 @@
+// This file is part of Golly.
+// See docs/License.html for the copyright notice.
+
+// Implementation code for the 3D rules used by Scripts/Lua/3D.lua.
+//
+// Each row of cells along the x axis is packed into 64-bit words.  A
+// generation is computed a word (64 cells) at a time: neighbor counts
+// are kept as 5 bit planes (counts go up to 27) and summed with bitwise
+// full adders, then compared with the counts in the rule.  Rows shifted
+// by one cell in x (or, for the Moore rules, the sums of each cell and
+// its two x neighbors) are found in a first pass, so the second pass only
+// has to add whole rows from the planes z-1, z and z+1.  Both passes are
+// split into slabs of z planes that run on the thread pool.
+
+#include "life3d.h"
+#include "util.h"
+#include <stdlib.h>     // for malloc, free, etc
+#include <limits.h>     // for INT_MIN and INT_MAX
+#include <string.h>     // for memset
+
+// -----------------------------------------------------------------------------
+
+enum {
+    SHIFT_ROWS,         // find the shifted rows (or the Moore row sums)
+    COUNT_ROWS,         // count neighbors and compute the next generation
+    FIND_MOVES,         // find where each live cell moves (BusyBoxes)
+    GET_STATS           // find the population and boundary of the live cells
+};
+
+struct life3dslab : public lifetask {
+    life3d* algo;
+    int kind;                   // one of the above
+    int minz, maxz;             // the z planes in this slab
+    life3dstats stats;          // population and boundary of new live cells
+    std::vector<int> moves;     // new keys of the live cells (FIND_MOVES)
+    virtual void run() { algo->run_slab(*this); }
+};
+
+// a grid with fewer cells per slab than this isn't worth splitting
+static const int MINSLABCELLS = 1 << 18;
+
+// -----------------------------------------------------------------------------
+
+static inline int popcount64(cellword3d w)
+{
+#ifdef __GNUC__
+    return __builtin_popcountll(w);
+#else
+    int n = 0;
+    while (w) {
+        w &= w - 1;
+        n++;
+    }
+    return n;
+#endif
+}
+
+// -----------------------------------------------------------------------------
+
+static inline int lowbit(cellword3d w)
+{
+    // return the index of the lowest set bit in a non-zero word
+#ifdef __GNUC__
+    return __builtin_ctzll(w);
+#else
+    int i = 0;
+    while ((w & 1) == 0) {
+        w >>= 1;
+        i++;
+    }
+    return i;
+#endif
+}
+
+// -----------------------------------------------------------------------------
+
+static inline void addbit(cellword3d* s, cellword3d b, int level)
+{
+    // add b to the 5-bit counts in s at the given level (0 adds 1, 1 adds 2)
+    for (int i = level; i < 5; i++) {
+        cellword3d carry = s[i] & b;
+        s[i] ^= b;
+        b = carry;
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+life3d::life3d()
+{
+    N = 0;
+    W = 0;
+    lastmask = 0;
+    cells = NULL;
+    nextcells = NULL;
+    pass1 = NULL;
+    pass2 = NULL;
+    rowlive = NULL;
+    nextlive = NULL;
+    rule = moore3d;
+    for (int i = 0; i < 28; i++) {
+        liveok[i] = false;
+        deadok[i] = false;
+    }
+    numrulecounts = 0;
+    phase = 0;
+    population = 0;
+    minx = maxx = miny = maxy = minz = maxz = 0;
+}
+
+// -----------------------------------------------------------------------------
+
+life3d::~life3d()
+{
+    free_grid();
+}
+
+// -----------------------------------------------------------------------------
+
+void life3d::free_grid()
+{
+    free(cells);
+    free(nextcells);
+    free(pass1);
+    free(pass2);
+    free(rowlive);
+    free(nextlive);
+    cells = NULL;
+    nextcells = NULL;
+    pass1 = NULL;
+    pass2 = NULL;
+    rowlive = NULL;
+    nextlive = NULL;
+    N = 0;
+    W = 0;
+    population = 0;
+}
+
+// -----------------------------------------------------------------------------
+
+bool life3d::setsize(int n)
+{
+    free_grid();
+    if (n < 1) return false;
+
+    const int words = (n + 63) >> 6;
+    const size_t rowwords = (size_t)n * n * words;
+    cells = (cellword3d*)calloc(rowwords, sizeof(cellword3d));
+    nextcells = (cellword3d*)calloc(rowwords, sizeof(cellword3d));
+    pass1 = (cellword3d*)calloc(rowwords, sizeof(cellword3d));
+    pass2 = (cellword3d*)calloc(rowwords, sizeof(cellword3d));
+    rowlive = (unsigned char*)calloc((size_t)n * n, 1);
+    nextlive = (unsigned char*)calloc((size_t)n * n, 1);
+    if (cells == NULL || nextcells == NULL || pass1 == NULL || pass2 == NULL ||
+        rowlive == NULL || nextlive == NULL) {
+        free_grid();
+        return false;
+    }
+
+    N = n;
+    W = words;
+    lastmask = (N & 63) ? ((cellword3d)1 << (N & 63)) - 1 : ~(cellword3d)0;
+    wrapped.resize(N + 8);
+    for (int i = -4; i < N + 4; i++) {
+        wrapped[i + 4] = ((i % N) + N) % N;
+    }
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+void life3d::setrule(life3drule r, const char* survivals, const char* births)
+{
+    rule = r;
+    numrulecounts = 0;
+    for (int v = 0; v < 28; v++) {
+        liveok[v] = false;
+        deadok[v] = false;
+    }
+    if (rule == busyboxes3d || rule == busyboxeswrap3d) return;
+
+    // a dead cell with no live neighbors is never born
+    for (int v = 1; v < 28; v++) {
+        if (rule == moore3d) {
+            // the Moore counts include the cell itself
+            liveok[v] = survivals[v - 1] != 0;
+            deadok[v] = v < 27 && births[v] != 0;
+        } else {
+            liveok[v] = v < 27 && survivals[v] != 0;
+            deadok[v] = v < 27 && births[v] != 0;
+        }
+    }
+    if (rule != moore3d) liveok[0] = survivals[0] != 0;
+
+    for (int v = 0; v < 28; v++) {
+        if (liveok[v] || deadok[v]) rulecounts[numrulecounts++] = v;
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+void life3d::clearall()
+{
+    if (N == 0) return;
+    memset(cells, 0, (size_t)N * N * W * sizeof(cellword3d));
+    memset(rowlive, 0, (size_t)N * N);
+    population = 0;
+}
+
+// -----------------------------------------------------------------------------
+
+void life3d::setcell(int key)
+{
+    const int x = key % N;
+    const int r = key / N;
+    cells[r * W + (x >> 6)] |= (cellword3d)1 << (x & 63);
+}
+
+// -----------------------------------------------------------------------------
+
+void life3d::endofpattern()
+{
+    if (N > 0) run_slabs(GET_STATS);
+}
+
+// -----------------------------------------------------------------------------
+
+void life3d::getbounds(int& x0, int& x1, int& y0, int& y1, int& z0, int& z1)
+{
+    x0 = minx;
+    x1 = maxx;
+    y0 = miny;
+    y1 = maxy;
+    z0 = minz;
+    z1 = maxz;
+}
+
+// -----------------------------------------------------------------------------
+
+void life3d::getcells(std::vector<int>& keys)
+{
+    keys.clear();
+    keys.reserve(population);
+    const int NN = N * N;
+    for (int r = 0; r < NN; r++) {
+        if (!rowlive[r]) continue;
+        const cellword3d* row = cells + r * W;
+        for (int w = 0; w < W; w++) {
+            cellword3d bits = row[w];
+            while (bits) {
+                keys.push_back(N * r + (w << 6) + lowbit(bits));
+                bits &= bits - 1;
+            }
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+void life3d::step(int gencount)
+{
+    if (N == 0 || population == 0) return;
+
+    if (rule == busyboxes3d || rule == busyboxeswrap3d) {
+        phase = gencount % 6;
+        run_slabs(FIND_MOVES);
+        run_slabs(GET_STATS);
+    } else {
+        run_slabs(SHIFT_ROWS);
+        run_slabs(COUNT_ROWS);
+        cellword3d* t = cells;
+        cells = nextcells;
+        nextcells = t;
+        unsigned char* l = rowlive;
+        rowlive = nextlive;
+        nextlive = l;
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+int life3d::slab_count()
+{
+    // return the number of slabs of z planes to split the grid into
+    int nslabs = lifethreads::getthreadcount();
+    const double maxslabs = (double)N * N * N / MINSLABCELLS;
+    if (nslabs > maxslabs) nslabs = (int)maxslabs;
+    if (nslabs > N) nslabs = N;
+    return nslabs < 1 ? 1 : nslabs;
+}
+
+// -----------------------------------------------------------------------------
+
+void life3d::run_slabs(int kind)
+{
+    // process the grid in slabs of z planes
+    const int nslabs = slab_count();
+    std::vector<life3dslab> slabs(nslabs);
+    std::vector<lifetask*> tasks(nslabs);
+    for (int i = 0; i < nslabs; i++) {
+        life3dslab& slab = slabs[i];
+        slab.algo = this;
+        slab.kind = kind;
+        slab.minz = (int)((long long)N * i / nslabs);
+        slab.maxz = (int)((long long)N * (i + 1) / nslabs) - 1;
+        slab.stats.population = 0;
+        slab.stats.miny = INT_MAX;
+        slab.stats.minz = INT_MAX;
+        slab.stats.maxy = INT_MIN;
+        slab.stats.maxz = INT_MIN;
+        slab.stats.xany.assign(W, 0);
+        tasks[i] = &slab;
+    }
+    if (nslabs == 1) {
+        run_slab(slabs[0]);
+    } else {
+        lifethreads::runtasks(&tasks[0], nslabs);
+    }
+
+    if (kind == SHIFT_ROWS) return;
+
+    if (kind == FIND_MOVES) {
+        // put the moved cells into the next grid (cells moving to
+        // the same place merge, as in the original 3D.lua code)
+        memset(nextcells, 0, (size_t)N * N * W * sizeof(cellword3d));
+        for (int i = 0; i < nslabs; i++) {
+            const std::vector<int>& moves = slabs[i].moves;
+            for (size_t j = 0; j < moves.size(); j++) {
+                const int x = moves[j] % N;
+                const int r = moves[j] / N;
+                nextcells[r * W + (x >> 6)] |= (cellword3d)1 << (x & 63);
+            }
+        }
+        cellword3d* t = cells;
+        cells = nextcells;
+        nextcells = t;
+        return;
+    }
+
+    // merge the results
+    population = 0;
+    miny = minz = INT_MAX;
+    maxy = maxz = INT_MIN;
+    std::vector<cellword3d> xany(W, 0);
+    for (int i = 0; i < nslabs; i++) {
+        life3dstats& stats = slabs[i].stats;
+        population += stats.population;
+        if (stats.miny < miny) miny = stats.miny;
+        if (stats.maxy > maxy) maxy = stats.maxy;
+        if (stats.minz < minz) minz = stats.minz;
+        if (stats.maxz > maxz) maxz = stats.maxz;
+        for (int w = 0; w < W; w++) xany[w] |= stats.xany[w];
+    }
+    if (population == 0) {
+        minx = maxx = miny = maxy = minz = maxz = 0;
+        return;
+    }
+    minx = INT_MAX;
+    maxx = INT_MIN;
+    for (int w = 0; w < W; w++) {
+        if (xany[w] == 0) continue;
+        if (minx == INT_MAX) minx = (w << 6) + lowbit(xany[w]);
+        maxx = (w << 6) + 63;
+        while ((xany[w] >> (maxx & 63)) == 0) maxx--;
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+void life3d::run_slab(life3dslab& slab)
+{
+    switch (slab.kind) {
+        case SHIFT_ROWS:
+            shift_rows(slab);
+            break;
+        case COUNT_ROWS:
+            count_rows(slab);
+            break;
+        case FIND_MOVES:
+            find_moves(slab);
+            break;
+        case GET_STATS:
+            get_stats(slab);
+            break;
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+bool life3d::add_row_stats(int y, int z, const cellword3d* row, life3dstats& stats)
+{
+    // add a row's live cells to the slab's stats and return true if there are any
+    int pop = 0;
+    for (int w = 0; w < W; w++) {
+        if (row[w]) {
+            pop += popcount64(row[w]);
+            stats.xany[w] |= row[w];
+        }
+    }
+    if (pop == 0) return false;
+    stats.population += pop;
+    if (y < stats.miny) stats.miny = y;
+    if (y > stats.maxy) stats.maxy = y;
+    if (z < stats.minz) stats.minz = z;
+    if (z > stats.maxz) stats.maxz = z;
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+void life3d::get_stats(life3dslab& slab)
+{
+    for (int z = slab.minz; z <= slab.maxz; z++) {
+        for (int y = 0; y < N; y++) {
+            const int r = y + N * z;
+            rowlive[r] = add_row_stats(y, z, cells + r * W, slab.stats);
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+void life3d::shift_rows(life3dslab& slab)
+{
+    // pass1 gets each row shifted so a cell sees its x+1 neighbor and pass2
+    // the x-1 neighbor, both wrapping around; for the Moore rules they get
+    // the two bits of the sum of those and the cell itself
+    const int lastbit = (N - 1) & 63;
+    for (int z = slab.minz; z <= slab.maxz; z++) {
+        for (int y = 0; y < N; y++) {
+            const int r = y + N * z;
+            const cellword3d* row = cells + r * W;
+            cellword3d* p1 = pass1 + r * W;
+            cellword3d* p2 = pass2 + r * W;
+            if (!rowlive[r]) {
+                memset(p1, 0, W * sizeof(cellword3d));
+                memset(p2, 0, W * sizeof(cellword3d));
+                continue;
+            }
+            const cellword3d firstcell = row[0] & 1;
+            const cellword3d lastcell = (row[W - 1] >> lastbit) & 1;
+            for (int w = 0; w < W; w++) {
+                const cellword3d c = row[w];
+                cellword3d xp = c >> 1;
+                cellword3d xm = c << 1;
+                if (w + 1 < W) {
+                    xp |= row[w + 1] << 63;
+                } else {
+                    xp |= firstcell << lastbit;
+                    xm &= lastmask;
+                }
+                xm |= w > 0 ? row[w - 1] >> 63 : lastcell;
+                if (rule == moore3d) {
+                    p1[w] = xp ^ c ^ xm;
+                    p2[w] = (xp & c) | (xm & (xp ^ c));
+                } else {
+                    p1[w] = xp;
+                    p2[w] = xm;
+                }
+            }
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+inline void life3d::new_cell(cellword3d* newrow, int w, cellword3d cur, const cellword3d* s)
+{
+    // set the new states of 64 cells from their states and neighbor counts
+    cellword3d result = 0;
+    for (int i = 0; i < numrulecounts; i++) {
+        const int v = rulecounts[i];
+        cellword3d match = ~(cellword3d)0;
+        for (int b = 0; b < 5; b++) {
+            match &= ((v >> b) & 1) ? s[b] : ~s[b];
+        }
+        if (liveok[v] && deadok[v]) {
+            result |= match;
+        } else if (liveok[v]) {
+            result |= match & cur;
+        } else {
+            result |= match & ~cur;
+        }
+    }
+    if (w == W - 1) result &= lastmask;
+    newrow[w] = result;
+}
+
+// -----------------------------------------------------------------------------
+
+void life3d::count_rows(life3dslab& slab)
+{
+    // rows holds the offsets of the rows at y+dy, z+dz (dy and dz from -1 to 1)
+    int rows[3][3];
+    const cellword3d* terms[12];
+    for (int z = slab.minz; z <= slab.maxz; z++) {
+        for (int y = 0; y < N; y++) {
+            const int r = y + N * z;
+            cellword3d* newrow = nextcells + r * W;
+            bool nearlive = false;
+            for (int dz = -1; dz <= 1; dz++) {
+                for (int dy = -1; dy <= 1; dy++) {
+                    const int rr = wrapped[y + dy + 4] + N * wrapped[z + dz + 4];
+                    rows[dy + 1][dz + 1] = rr * W;
+                    if (rowlive[rr]) nearlive = true;
+                }
+            }
+            if (!nearlive) {
+                // no cell in this row has a live neighbor
+                memset(newrow, 0, W * sizeof(cellword3d));
+                nextlive[r] = 0;
+                continue;
+            }
+
+            const cellword3d* row = cells + r * W;
+            int nterms = 0;
+            switch (rule) {
+                case face3d:
+                    terms[nterms++] = pass1 + rows[1][1];
+                    terms[nterms++] = pass2 + rows[1][1];
+                    terms[nterms++] = cells + rows[0][1];
+                    terms[nterms++] = cells + rows[2][1];
+                    terms[nterms++] = cells + rows[1][0];
+                    terms[nterms++] = cells + rows[1][2];
+                    break;
+                case corner3d:
+                    for (int dz = 0; dz <= 2; dz += 2) {
+                        for (int dy = 0; dy <= 2; dy += 2) {
+                            terms[nterms++] = pass1 + rows[dy][dz];
+                            terms[nterms++] = pass2 + rows[dy][dz];
+                        }
+                    }
+                    break;
+                case edge3d:
+                    for (int d = 0; d <= 2; d += 2) {
+                        terms[nterms++] = cells + rows[d][0];
+                        terms[nterms++] = cells + rows[d][2];
+                        terms[nterms++] = pass1 + rows[1][d];
+                        terms[nterms++] = pass2 + rows[1][d];
+                        terms[nterms++] = pass1 + rows[d][1];
+                        terms[nterms++] = pass2 + rows[d][1];
+                    }
+                    break;
+                case hexahedral3d:
+                    // the 12 neighbors given on page 872 of
+                    // http://www.complex-systems.com/pdf/01-5-1.pdf
+                    terms[nterms++] = cells + rows[1][0];
+                    terms[nterms++] = cells + rows[1][2];
+                    terms[nterms++] = cells + rows[2][0];
+                    terms[nterms++] = cells + rows[2][1];
+                    terms[nterms++] = cells + rows[0][2];
+                    terms[nterms++] = cells + rows[0][1];
+                    terms[nterms++] = pass1 + rows[1][0];
+                    terms[nterms++] = pass1 + rows[1][1];
+                    terms[nterms++] = pass1 + rows[0][1];
+                    terms[nterms++] = pass2 + rows[1][2];
+                    terms[nterms++] = pass2 + rows[1][1];
+                    terms[nterms++] = pass2 + rows[2][1];
+                    break;
+                default:
+                    break;
+            }
+
+            for (int w = 0; w < W; w++) {
+                cellword3d s[5] = { 0, 0, 0, 0, 0 };
+                if (rule == moore3d) {
+                    // add the 2-bit row sums of the 9 rows around this one
+                    for (int dz = 0; dz <= 2; dz++) {
+                        for (int dy = 0; dy <= 2; dy++) {
+                            addbit(s, pass1[rows[dy][dz] + w], 0);
+                            addbit(s, pass2[rows[dy][dz] + w], 1);
+                        }
+                    }
+                } else {
+                    for (int i = 0; i < nterms; i++) addbit(s, terms[i][w], 0);
+                }
+                new_cell(newrow, w, row[w], s);
+            }
+            nextlive[r] = add_row_stats(y, z, newrow, slab.stats);
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+void life3d::find_moves(life3dslab& slab)
+{
+    // the algorithm used below is a slightly modified (and corrected!)
+    // version of the kernel code in Ready's Salt 3D example
+    // (see Patterns/CellularAutomata/Salt/salt3D_circular330.vti);
+    // it uses a rule based on 28 cells in a 7x7 neighborhood for each live cell
+
+    static const int coords[28][2] = {
+        // 0 to 3 are the coordinates for the 4 potential swap sites:
+        { 1,  1}, {-1,  1}, {-1, -1}, { 1, -1},
+        // 4 to 11 are activators:
+        { 2, -1}, { 2,  1}, { 1,  2}, {-1,  2}, {-2,  1}, {-2, -1}, {-1, -2}, { 1, -2},
+        // 12 to 27 are inhibitors:
+        {-2, -3}, { 0, -3}, { 2, -3}, {-3, -2}, { 3, -2}, { 0, -1},
+        {-3,  0}, {-1,  0}, { 1,  0}, { 3,  0}, { 0,  1}, {-3,  2},
+        { 3,  2}, {-2,  3}, { 0,  3}, { 2,  3}
+    };
+
+    // numbers are indices into the coords array
+    static const int activators[4][2] = {
+        {4,  7}, {6,  9}, {8, 11}, {5, 10}
+    };
+    static const int inhibitors[4][12] = {
+        {17, 24, 21, 26, 19, 27, 6,  9,  8, 11,  5, 10},
+        {17, 23, 18, 26, 20, 25, 4,  7,  8, 11,  5, 10},
+        {15, 22, 13, 18, 12, 20, 4,  7,  6,  9,  5, 10},
+        {19, 14, 13, 21, 16, 22, 4,  7,  6,  9,  8, 11}
+    };
+
+    const bool mirror = rule == busyboxes3d;
+    const int* wrap = &wrapped[4];
+    unsigned char val[28];
+    for (int z = slab.minz; z <= slab.maxz; z++) {
+        for (int y = 0; y < N; y++) {
+            const int r = y + N * z;
+            if (!rowlive[r]) continue;
+            const cellword3d* row = cells + r * W;
+            for (int w = 0; w < W; w++) {
+                cellword3d bits = row[w];
+                while (bits) {
+                    const int x = (w << 6) + lowbit(bits);
+                    bits &= bits - 1;
+                    const int key = x + N * r;
+                    if (((x + y + z) & 1) != (phase & 1)) {
+                        // live cell with wrong parity
+                        slab.moves.push_back(key);
+                        continue;
+                    }
+
+                    // this live cell has the right parity so get values for its 28 neighbors
+                    for (int j = 0; j < 28; j++) {
+                        const int a = coords[j][0];
+                        const int b = coords[j][1];
+                        if (phase == 0 || phase == 3) {
+                            // use XY plane
+                            val[j] = cellat(wrap[x + a], wrap[y + b], z);
+                        } else if (phase == 1 || phase == 4) {
+                            // use YZ plane
+                            val[j] = cellat(x, wrap[y + a], wrap[z + b]);
+                        } else {
+                            // phase == 2 or 5 so use XZ plane
+                            val[j] = cellat(wrap[x + a], y, wrap[z + b]);
+                        }
+                    }
+
+                    // find the potential swaps
+                    int numswaps = 0;
+                    int swapi = 0;
+                    for (int j = 0; j <= 3; j++) {
+                        // if either activator is a live cell then the swap is possible,
+                        // but if any inhibitor is a live cell then the swap is forbidden
+                        if (!(val[activators[j][0]] || val[activators[j][1]])) continue;
+                        bool inhibited = false;
+                        for (int i = 0; i < 12; i++) {
+                            if (val[inhibitors[j][i]]) {
+                                inhibited = true;
+                                break;
+                            }
+                        }
+                        if (inhibited) continue;
+                        numswaps++;
+                        if (numswaps > 1) break;
+                        swapi = j;
+                    }
+
+                    // if only one swap, and only to an empty cell, then do it
+                    if (numswaps != 1 || val[swapi]) {
+                        slab.moves.push_back(key);
+                        continue;
+                    }
+                    int newx = x;
+                    int newy = y;
+                    int newz = z;
+                    if (phase == 0 || phase == 3) {
+                        newx += coords[swapi][0];
+                        newy += coords[swapi][1];
+                    } else if (phase == 1 || phase == 4) {
+                        newy += coords[swapi][0];
+                        newz += coords[swapi][1];
+                    } else {
+                        newx += coords[swapi][0];
+                        newz += coords[swapi][1];
+                    }
+                    if (mirror &&
+                        (newx < 0 || newx >= N || newy < 0 || newy >= N || newz < 0 || newz >= N)) {
+                        // swap position is outside grid so don't do it
+                        slab.moves.push_back(key);
+                    } else {
+                        slab.moves.push_back(wrap[newx] + N * (wrap[newy] + N * wrap[newz]));
+                    }
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,103 @@
+// This file is part of Golly.
+// See docs/License.html for the copyright notice.
+
+// A bit-packed engine for the 3D rules used by Scripts/Lua/3D.lua
+// (the overlay's nextgen3d command calls it).
+
+#ifndef LIFE3D_H
+#define LIFE3D_H
+
+#include <vector>
+
+// the supported 3D rules; the BusyBoxes rules move cells rather than
+// count neighbors (busyboxes3d stops cells moving out of the grid,
+// busyboxeswrap3d lets them wrap around to the opposite face)
+typedef enum {
+    moore3d, face3d, corner3d, edge3d, hexahedral3d, busyboxes3d, busyboxeswrap3d
+} life3drule;
+
+// each row of cells along the x axis is kept in 64-bit words, one bit per cell
+typedef unsigned long long cellword3d;
+
+// the population and bounding box of the live cells found while
+// processing a slab of z planes (see life3dslab in life3d.cpp)
+struct life3dstats {
+    int population;
+    int miny, maxy, minz, maxz;
+    std::vector<cellword3d> xany;       // all the rows or'ed together
+};
+struct life3dslab;
+
+// The grid is an N*N*N torus.  Cell (x,y,z) has key x + N*(y + N*z),
+// the same key the 3D.lua script uses.
+class life3d {
+public:
+    life3d();
+    ~life3d();
+
+    bool setsize(int n);
+    // Set the grid size and clear the grid.  Returns false if there
+    // isn't enough memory (the grid is then left empty with size 0).
+
+    int getsize() { return N; }
+
+    void setrule(life3drule r, const char* survivals, const char* births);
+    // Set the rule.  For the counting rules survivals[i] and births[i]
+    // (0 <= i < 27) say whether a cell with i live neighbors survives
+    // or is born; they are ignored for the BusyBoxes rules.
+
+    void clearall();
+    void setcell(int key);
+    void endofpattern();
+    // Call endofpattern() after setting cells and before stepping.
+
+    void step(int gencount);
+    // Compute the next generation.  The BusyBoxes rules need the
+    // current generation count to find their phase.
+
+    int getpopulation() { return population; }
+    void getbounds(int& minx, int& maxx, int& miny, int& maxy, int& minz, int& maxz);
+    // Return the boundary of the live cells (only valid if the grid isn't empty).
+
+    void getcells(std::vector<int>& keys);
+    // Return the keys of the live cells in ascending order.
+
+    void run_slab(life3dslab& slab);
+
+private:
+    void free_grid();
+    int slab_count();
+    void run_slabs(int kind);
+    void shift_rows(life3dslab& slab);
+    void count_rows(life3dslab& slab);
+    void find_moves(life3dslab& slab);
+    void get_stats(life3dslab& slab);
+    bool add_row_stats(int y, int z, const cellword3d* row, life3dstats& stats);
+    void new_cell(cellword3d* newrow, int w, cellword3d cur, const cellword3d* s);
+    int cellat(int x, int y, int z) {
+        return (int)(cells[(y + N * z) * W + (x >> 6)] >> (x & 63)) & 1;
+    }
+
+    int N;                              // grid edge length
+    int W;                              // words per row
+    cellword3d lastmask;                // the used bits in the last word of a row
+    cellword3d* cells;                  // N*N rows of W words
+    cellword3d* nextcells;              // the next generation
+    cellword3d* pass1;                  // per row values found before counting
+    cellword3d* pass2;
+    unsigned char* rowlive;             // non-zero if a row has live cells
+    unsigned char* nextlive;            // the same for the next generation
+    std::vector<int> wrapped;           // wrapped[i + 4] is i mod N for -4 <= i < N + 4
+
+    life3drule rule;
+    bool liveok[28];                    // live cell survives with this count
+    bool deadok[28];                    // dead cell is born with this count
+    int rulecounts[28];                 // the counts where a cell can be live next
+    int numrulecounts;
+    int phase;                          // BusyBoxes phase (generation mod 6)
+
+    int population;
+    int minx, maxx, miny, maxy, minz, maxz;
+};
+
+#endif
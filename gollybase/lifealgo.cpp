@@ -10,6 +10,39 @@ lifealgo::~lifealgo() {
    maxCellStates = 2 ;
 }
 int lifealgo::verbose ;
+int lifealgo::setcellrow(int y, const cellrun *runs, int nruns) {
+   for (int i=0; i<nruns; i++)
+      for (int j=0; j<runs[i].n; j++)
+         if (setcell(runs[i].x + j, y, runs[i].state) < 0)
+            return -1 ;
+   return 0 ;
+}
+void lifealgo::getcellruns(int top, int left, int bottom, int right,
+                           vector<cellspan> &spans) {
+   for (int y=top; y<=bottom; y++) {
+      int x = left, v ;
+      while (x <= right) {
+         int skip = nextcell(x, y, v) ;
+         if (skip < 0 || skip > right - x)
+            break ;
+         x += skip ;
+         if (!spans.empty() && spans.back().y == y &&
+             spans.back().state == v &&
+             spans.back().x + spans.back().n == x) {
+            spans.back().n++ ;
+         } else {
+            cellspan s = { x, y, 1, v } ;
+            spans.push_back(s) ;
+         }
+         if (x == right)
+            break ;
+         x++ ;
+      }
+   }
+}
+void lifealgo::getstats(lifestats &s) {
+   memset(&s, 0, sizeof(s)) ;
+}
 /*
  *   Right now, the base/expo should match the current increment.
  *   We do not check this.
@@ -48,6 +81,15 @@ void lifealgo::extendtimeline() {
       timeline.framecount++ ;
       timeline.end = timeline.next ;
       timeline.next += timeline.inc ;
+      if (timeline.stream) {
+        const char *err = writeframe(*timeline.stream, now) ;
+        if (err) {
+          streamtimeline(0) ;
+          lifewarning(err) ;
+        }
+      }
+      if (timeline.budget > 0 && timeline.framecount >= timeline.nextcheck)
+        evictframes() ;
     }
   }
 }
@@ -73,23 +115,41 @@ void lifealgo::pruneframes() {
       timeline.next += timeline.inc ;
       if (timeline.base == 2)
          timeline.expo++ ;
+      // the stream cannot change its spacing
+      streamtimeline(0) ;
+      timeline.pinned.clear() ;
+      timeline.nextcheck = 0 ;
    }
 }
 int lifealgo::gotoframe(int i) {
   if (i < 0 || i >= timeline.framecount)
     return 0 ;
-  setcurrentstate(timeline.frames[i]) ;
-  // AKT: avoid mul_smallint(i) crashing with divide-by-zero if i is 0
-  if (i > 0) {
+  // an evicted frame is stepped to from the nearest kept one before it
+  int j = i ;
+  while (timeline.frames[j] == 0)
+    j-- ;
+  setcurrentstate(timeline.frames[j]) ;
+  // AKT: avoid mul_smallint(j) crashing with divide-by-zero if j is 0
+  if (j > 0) {
     generation = timeline.inc ;
-    generation.mul_smallint(i) ;
+    generation.mul_smallint(j) ;
   } else {
     generation = 0;
   }
   generation += timeline.start ;
+  if (j < i) {
+    bigint oldinc = increment ;
+    if (oldinc != timeline.inc)
+      setIncrement(timeline.inc) ;
+    for (; j < i && !poller->isInterrupted(); j++)
+      step() ;
+    if (oldinc != timeline.inc)
+      setIncrement(oldinc) ;
+  }
   return timeline.framecount ;
 }
 void lifealgo::destroytimeline() {
+  streamtimeline(0) ;
   timeline.frames.clear() ;
   timeline.recording = 0 ;
   timeline.framecount = 0 ;
@@ -97,6 +157,246 @@ void lifealgo::destroytimeline() {
   timeline.start = 0 ;
   timeline.inc = 0 ;
   timeline.next = 0 ;
+  timeline.spacing = 0 ;
+  timeline.nextcheck = 0 ;
+  timeline.pinned.clear() ;
+}
+void lifealgo::settimelinebudget(int mb) {
+  timeline.budget = mb > 0 ? mb * 1048576.0 : 0 ;
+  timeline.nextcheck = 0 ;
+}
+int lifealgo::isframekept(int i) {
+  return i >= 0 && i < timeline.framecount && timeline.frames[i] != 0 ;
+}
+double lifealgo::getframepinned(int i) {
+  if (i < 0 || i >= (int)timeline.pinned.size())
+    return 0 ;
+  return timeline.pinned[i] ;
+}
+double lifealgo::measuretimeline() {
+  return measureframes(timeline.pinned) ;
+}
+double lifealgo::measureframes(vector<double> &pinned) {
+  pinned.assign(timeline.framecount, 0) ;
+  return 0 ;
+}
+const char *lifealgo::writeframe(framestream &, void *) {
+  return "This algorithm cannot stream its timeline." ;
+}
+/*
+ *   Whether frame i survives when the frames are thinned with the
+ *   given spacing.  A frame d frames back from the newest is kept if
+ *   its index is a multiple of the largest power of two no more than
+ *   d/spacing, so the kept frames get exponentially sparser going
+ *   back.  As the recording grows or the spacing shrinks, a kept
+ *   frame can only lose its place, so thinning never needs back a
+ *   frame that was evicted before.
+ */
+int lifealgo::keepframe(int i, int spacing) {
+  int last = timeline.framecount - 1 ;
+  if (i == 0 || i == last)
+    return 1 ;
+  int d = (last - i) / spacing ;
+  int step = 1 ;
+  while (step + step <= d)
+    step += step ;
+  return (i & (step - 1)) == 0 ;
+}
+/*
+ *   Measure the frames and, if they pin more than the budget, halve
+ *   the spacing until the frames that would be kept come to no more
+ *   than three quarters of it, and evict the rest.  The estimate only
+ *   counts what the kept frames pin now, which is less than they will
+ *   pin once the frames between them are gone, so the next check may
+ *   thin some more.  Measuring walks every node, so it is done at
+ *   intervals that grow with the recording.
+ */
+void lifealgo::evictframes() {
+  double total = measureframes(timeline.pinned) ;
+  if (total > timeline.budget) {
+    int spacing = timeline.spacing ? timeline.spacing : timeline.framecount ;
+    for (;;) {
+      double kept = 0 ;
+      for (int i=0; i<timeline.framecount; i++)
+        if (timeline.frames[i] && keepframe(i, spacing))
+          kept += timeline.pinned[i] ;
+      if (kept <= 0.75 * timeline.budget || spacing == 1)
+        break ;
+      spacing >>= 1 ;
+    }
+    timeline.spacing = spacing ;
+    for (int i=0; i<timeline.framecount; i++)
+      if (timeline.frames[i] && !keepframe(i, spacing)) {
+        timeline.frames[i] = 0 ;
+        timeline.pinned[i] = 0 ;
+      }
+  }
+  int interval = timeline.framecount / 16 ;
+  if (interval < 16)
+    interval = 16 ;
+  timeline.nextcheck = timeline.framecount + interval ;
+}
+/*
+ *   Bring back every evicted frame, for instance before saving the
+ *   timeline.  The current pattern is kept alive as a snapshot while
+ *   we step.  This can of course take the frames over budget again.
+ */
+int lifealgo::fillframes() {
+  int i ;
+  for (i=0; i<timeline.framecount; i++)
+    if (timeline.frames[i] == 0)
+      break ;
+  if (i == timeline.framecount)
+    return 1 ;
+  int id = takesnapshot() ;
+  if (id == 0)
+    return 0 ;
+  for (; i<timeline.framecount; i++)
+    if (timeline.frames[i] == 0) {
+      gotoframe(i) ;
+      if (poller->isInterrupted())
+        break ;
+      timeline.frames[i] = getcurrentstate() ;
+    }
+  restoresnapshot(id) ;
+  dropsnapshot(id) ;
+  timeline.spacing = 0 ;
+  timeline.nextcheck = 0 ;
+  timeline.pinned.clear() ;
+  return i == timeline.framecount ;
+}
+#define STRINGIFY(arg) STR2(arg)
+#define STR2(arg) #arg
+/*
+ *   The frame count in the FRAMES line is not known yet, but readers
+ *   only check that it is in range, and the FRAME lines say it all.
+ *   Each frame ends with a fresh line for its root (see writeframe),
+ *   so whatever is read last as the current pattern is the last frame.
+ */
+const char *lifealgo::streamtimeline(std::ostream *os) {
+  if (timeline.stream) {
+    timeline.stream->os.flush() ;
+    delete timeline.stream ;
+    timeline.stream = 0 ;
+  }
+  if (os == 0)
+    return 0 ;
+  if (timeline.framecount == 0)
+    return "Start recording before streaming the timeline." ;
+  if (!fillframes())
+    return "Could not step to the evicted frames." ;
+  *os << "[M2] (golly " STRINGIFY(VERSION) ")\n" ;
+  *os << "#R " << getrule() << '\n' ;
+  *os << "#FRAMES 0 " << timeline.start.tostring()
+      << ' ' << timeline.base << '^' << timeline.expo << '\n' ;
+  timeline.stream = new framestream(*os) ;
+  for (int i=0; i<timeline.framecount; i++) {
+    const char *err = writeframe(*timeline.stream, timeline.frames[i]) ;
+    if (err) {
+      streamtimeline(0) ;
+      return err ;
+    }
+  }
+  return 0 ;
+}
+void framestream::sync(int gccount) {
+   if (gccount != gcs) {
+      known.clear() ;
+      gcs = gccount ;
+   }
+}
+g_uintptr_t framestream::findleaf(unsigned long long key) {
+   std::map<unsigned long long, g_uintptr_t>::iterator it = leaves.find(key) ;
+   return it == leaves.end() ? 0 : it->second ;
+}
+g_uintptr_t framestream::addleaf(unsigned long long key) {
+   return leaves[key] = ++cells ;
+}
+g_uintptr_t framestream::addnode(int level, g_uintptr_t nw, g_uintptr_t ne,
+                                 g_uintptr_t sw, g_uintptr_t se, int fresh) {
+   framequad q = { nw, ne, sw, se } ;
+   g_uintptr_t &cell = nodes[q] ;
+   if (cell != 0 && !fresh)
+      return cell ;
+   os << level << ' ' << nw << ' ' << ne << ' ' << sw << ' ' << se << '\n' ;
+   if (cell == 0)
+      cell = cells + 1 ;
+   return ++cells ;
+}
+void framestream::endframe(g_uintptr_t cell) {
+   os << "#FRAME " << frames++ << ' ' << cell << '\n' ;
+}
+int lifealgo::takesnapshot() {
+   void *now = getcurrentstate() ;
+   if (now == 0)
+      return 0 ;
+   int id ;
+   for (id=0; id<(int)snapshots.roots.size(); id++)
+      if (snapshots.roots[id] == 0)
+         break ;
+   if (id == (int)snapshots.roots.size()) {
+      snapshots.roots.push_back(0) ;
+      snapshots.gens.push_back(bigint::zero) ;
+      snapshots.rules.push_back(string()) ;
+   }
+   snapshots.roots[id] = now ;
+   snapshots.gens[id] = generation ;
+   snapshots.rules[id] = getrule() ;
+   snapshots.count++ ;
+   return id + 1 ;
+}
+int lifealgo::restoresnapshot(int id) {
+   if (id <= 0 || id > (int)snapshots.roots.size() || snapshots.roots[id-1] == 0)
+      return 0 ;
+   setcurrentstate(snapshots.roots[id-1]) ;
+   generation = snapshots.gens[id-1] ;
+   return 1 ;
+}
+void lifealgo::dropsnapshot(int id) {
+   if (id <= 0 || id > (int)snapshots.roots.size() || snapshots.roots[id-1] == 0)
+      return ;
+   snapshots.roots[id-1] = 0 ;
+   snapshots.count-- ;
+   // trim free slots off the end so the collector has less to look at
+   while (!snapshots.roots.empty() && snapshots.roots.back() == 0) {
+      snapshots.roots.pop_back() ;
+      snapshots.gens.pop_back() ;
+      snapshots.rules.pop_back() ;
+   }
+}
+/*
+ *   Write a snapshot in the native format without disturbing the
+ *   current pattern (other than forgetting its population).
+ */
+const char *lifealgo::writesnapshot(int id, std::ostream &os) {
+   if (id <= 0 || id > (int)snapshots.roots.size() || snapshots.roots[id-1] == 0)
+      return "No such snapshot." ;
+   void *now = getcurrentstate() ;
+   bigint nowgen = generation ;
+   int savetimeline = timeline.savetimeline ;
+   timeline.savetimeline = 0 ;
+   restoresnapshot(id) ;
+   snapshots.writing = id ;
+   const char *err = writeNativeFormat(os, 0) ;
+   snapshots.writing = 0 ;
+   setcurrentstate(now) ;
+   generation = nowgen ;
+   timeline.savetimeline = savetimeline ;
+   return err ;
+}
+void lifealgo::releasesnapshots() {
+   if (snapshots.count && snapshots.keeper)
+      snapshots.keeper->releasing(this) ;
+   snapshots.roots.clear() ;
+   snapshots.gens.clear() ;
+   snapshots.rules.clear() ;
+   snapshots.count = 0 ;
+   snapshots.keeper = 0 ;
+}
+const char *lifealgo::snapshotrule() {
+   if (snapshots.writing == 0)
+      return 0 ;
+   return snapshots.rules[snapshots.writing-1].c_str() ;
 }
 
 // -----------------------------------------------------------------------------
@@ -303,6 +603,15 @@ const char* lifealgo::canonicalsuffix() {
    }
 }
 
+bool lifealgo::ispow2torus(unsigned int minsize) {
+   if (boundedplane || sphere || htwist || vtwist || hshift != 0 || vshift != 0)
+      return false;
+   // this also rules out an infinite tube (a zero width or height)
+   if (gridwd < minsize || gridht < minsize)
+      return false;
+   return (gridwd & (gridwd - 1)) == 0 && (gridht & (gridht - 1)) == 0;
+}
+
 void lifealgo::JoinTwistedEdges()
 {
     // set grid edges
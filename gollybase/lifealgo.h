@@ -25,26 +25,143 @@
 #endif
 using std::vector;
 #include <iostream>
+#include <map>
+#include <string>
 
 // this must not be increased beyond 32767, because we use a bigint
 // multiply that only supports multiplicands up to that size.
 const int MAX_FRAME_COUNT = 32000 ;
 
+/**
+ *   Recorded frames can go out to a macrocell file as they are made.
+ *   Each distinct node is written once, the first time any frame uses
+ *   it, so the file only grows by what changed since the last frame.
+ *   Nodes are matched by content (leaves by their cells, others by the
+ *   numbers of their children), so sharing survives the collector
+ *   freeing and rebuilding them; known just saves walking unchanged
+ *   subtrees, and the algorithm clears it with sync() whenever a
+ *   collection may have reused a node.
+ */
+struct framequad {
+   g_uintptr_t nw, ne, sw, se ;
+   bool operator<(const framequad &b) const {
+      if (nw != b.nw) return nw < b.nw ;
+      if (ne != b.ne) return ne < b.ne ;
+      if (sw != b.sw) return sw < b.sw ;
+      return se < b.se ;
+   }
+} ;
+class framestream {
+public:
+   framestream(std::ostream &osarg) : os(osarg), cells(0), frames(0),
+                                      gcs(-1) {}
+   void sync(int gccount) ;
+   // 0 if this leaf has not been written yet
+   g_uintptr_t findleaf(unsigned long long key) ;
+   // number a new leaf; the caller writes its line
+   g_uintptr_t addleaf(unsigned long long key) ;
+   // number and write a node line unless the same one was written
+   // (or fresh is set, as it is for the root of each frame)
+   g_uintptr_t addnode(int level, g_uintptr_t nw, g_uintptr_t ne,
+                       g_uintptr_t sw, g_uintptr_t se, int fresh=0) ;
+   void endframe(g_uintptr_t cell) ;
+   std::ostream &os ;
+   g_uintptr_t cells ;
+   int frames, gcs ;
+   std::map<void *, g_uintptr_t> known ;
+   std::map<unsigned long long, g_uintptr_t> leaves ;
+   std::map<framequad, g_uintptr_t> nodes ;
+} ;
+
 /**
  *   Timeline support is pretty generic.
+ *
+ *   Every frame keeps its whole tree alive, so a long recording can
+ *   fill memory.  With a budget set, the timeline now and then asks
+ *   the algorithm how many bytes each frame pins (the nodes it holds
+ *   that the current pattern and earlier frames do not), and if the
+ *   total is over budget it evicts frames, keeping them more sparsely
+ *   the further back they are.  An evicted frame is a zero in frames;
+ *   going to one steps forward from the nearest kept frame before it.
+ *   The first and the newest frames are never evicted.
  */
 class timeline_t {
 public:
    timeline_t() : recording(0), framecount(0), savetimeline(1),
-                  start(0), inc(0), next(0), end(0), frames() {}
+                  start(0), inc(0), next(0), end(0), frames(),
+                  budget(0), spacing(0), nextcheck(0), pinned(),
+                  stream(0) {}
    int recording, framecount, base, expo, savetimeline ;
    bigint start, inc, next, end ;
    vector<void *> frames ;
+   double budget ;          // bytes; 0 for no limit
+   int spacing ;            // see keepframe()
+   int nextcheck ;          // framecount at which to measure again
+   vector<double> pinned ;  // bytes, as of the last measurement
+   framestream *stream ;
+} ;
+
+/**
+ *   Snapshots remember states of the universe in memory, for undo.
+ *   For the hashed algorithms a snapshot is just a root that garbage
+ *   collection keeps alive, like a timeline frame, so taking one is
+ *   cheap and it shares its nodes with the pattern and every other
+ *   snapshot.  Whoever holds snapshots can register a keeper, which
+ *   is told before the universe goes away so it can save the ones it
+ *   still needs.  Each snapshot remembers the rule it was taken under,
+ *   so writesnapshot works even from the base class destructor, after
+ *   the algorithm's own rule data is gone.
+ */
+class lifealgo ;
+class snapshotkeeper {
+public:
+   virtual ~snapshotkeeper() {}
+   virtual void releasing(lifealgo *algo) = 0 ;
+} ;
+class snapshots_t {
+public:
+   snapshots_t() : count(0), writing(0), keeper(0), roots(), gens(),
+                   rules() {}
+   int count ;
+   int writing ;               // id writesnapshot is writing, else 0
+   snapshotkeeper *keeper ;
+   vector<void *> roots ;      // indexed by id-1; zero if free
+   vector<bigint> gens ;
+   vector<std::string> rules ;
+} ;
+
+/**
+ *   A run of n cells in one state starting at x, for setcellrow.
+ */
+struct cellrun {
+   int x, n, state ;
+} ;
+
+/**
+ *   A run of n cells in one state starting at x, y, from getcellruns.
+ */
+struct cellspan {
+   int x, y, n, state ;
+} ;
+
+/**
+ *   Counters for benchmarking, as of the last step.  An algorithm fills
+ *   in what it keeps track of and leaves the rest zero.
+ */
+struct lifestats {
+   double nodes ;          // nodes calculated
+   double gcs ;            // garbage collections
+   double gcpauses ;       // times the calculation waited on the collector
+   double gcpausetotal ;   // seconds
+   double gcpausemax ;     // seconds
+   double hashload ;       // fraction of hash slots in use
+   double memory ;         // bytes allocated for the universe
 } ;
 
 class lifealgo {
 public:
-   lifealgo() : generation(0), increment(0), timeline(), grid_type(SQUARE_GRID)
+   lifealgo() : generation(0), increment(0), timeline(), snapshots(),
+               grid_type(SQUARE_GRID)
       {  poller = &default_poller ;
          gridwd = gridht = 0 ;      // default is an unbounded universe
          unbounded = true ;         // most algorithms use an unbounded universe
@@ -53,8 +170,16 @@ public:
    virtual void clearall() = 0 ;
    // returns <0 if error
    virtual int setcell(int x, int y, int newstate) = 0 ;
+   // sets runs of cells along row y, left to right; the pattern
+   // readers use this so an algorithm can set many cells at once
+   virtual int setcellrow(int y, const cellrun *runs, int nruns) ;
    virtual int getcell(int x, int y) = 0 ;
    virtual int nextcell(int x, int y, int &v) = 0 ;
+   // appends the runs of live cells inside the given rectangle (edges
+   // included) to spans, a row at a time from the top and left to right
+   // within each row; much faster than nextcell over a big area
+   virtual void getcellruns(int top, int left, int bottom, int right,
+                            vector<cellspan> &spans) ;
    void getcells(unsigned char *buf, int x, int y, int w, int h) ;
    // call after setcell/clearcell calls
    virtual void endofpattern() = 0 ;
@@ -79,6 +204,7 @@ public:
    virtual const char *writeNativeFormat(std::ostream &os, char *comments) = 0 ;
    void setpoll(lifepoll *pollerarg) { poller = pollerarg ; }
    virtual const char *readmacrocell(char *) { return "Cannot read macrocell format." ; }
+   virtual void getstats(lifestats &s) ;
    
    // Verbosity crosses algorithms.  We need to embed this sort of option
    // into some global shared thing or something rather than use static.
@@ -108,6 +234,39 @@ public:
    int gotoframe(int i) ;
    void destroytimeline() ;
    void savetimelinewithframe(int yesno) { timeline.savetimeline = yesno ; }
+   // memory budget for the frames in megabytes, or 0 for no limit
+   void settimelinebudget(int mb) ;
+   int gettimelinebudget() { return (int)(timeline.budget / 1048576.0) ; }
+   int isframekept(int i) ;
+   // bytes pinned by frame i as of the last measurement
+   double getframepinned(int i) ;
+   // measure every frame now; returns the total bytes pinned
+   double measuretimeline() ;
+   // step forward to bring back every evicted frame; returns 0 if
+   // that was interrupted
+   int fillframes() ;
+   // write the frames so far and then each new frame to os as a
+   // macrocell file; 0 ends the stream.  Returns an error or null.
+   const char *streamtimeline(std::ostream *os) ;
+   // the algorithm's side of the above; measureframes fills in pinned
+   // for every frame and returns the total
+   virtual double measureframes(vector<double> &pinned) ;
+   virtual const char *writeframe(framestream &fs, void *frame) ;
+
+   // snapshot support; takesnapshot returns 0 if the algorithm cannot
+   // take one, otherwise an id > 0.  Only call it (like startrecording)
+   // once the pattern is complete.
+   int takesnapshot() ;
+   int restoresnapshot(int id) ;    // returns 0 if id is unknown
+   void dropsnapshot(int id) ;
+   const char *writesnapshot(int id, std::ostream &os) ;
+   int getsnapshotcount() { return snapshots.count ; }
+   void setsnapshotkeeper(snapshotkeeper *k) { snapshots.keeper = k ; }
+   // the hashed algorithms' base classes call this in their destructor
+   void releasesnapshots() ;
+   // the rule writeNativeFormat should write while writesnapshot is
+   // running, else 0 (use getrule())
+   const char *snapshotrule() ;
 
    // support for a bounded universe with various topologies:
    // plane, cylinder, torus, Klein bottle, cross-surface, sphere
@@ -128,12 +287,25 @@ public:
    // use in setrule() to return the canonical version of suffix;
    // eg. ":t0020" would be converted to ":T20,0"
 
+   bool ispow2torus(unsigned int minsize) ;
+   // true if the grid is a plain torus (no shift) whose width and
+   // height are powers of two, both at least minsize
+
    bool CreateBorderCells() ;
    bool DeleteBorderCells() ;
    // the above routines can be called around step() to create the
    // illusion of a bounded universe (note that increment must be 1);
    // they return false if the pattern exceeds the editing limits
 
+   virtual bool wrapsgrid() { return false ; }
+   // an algorithm returns true if its step() joins the edges of the
+   // current bounded grid itself, at any increment
+
+   bool needsbordercells() {
+      return unbounded && (gridwd > 0 || gridht > 0) && !wrapsgrid() ;
+   }
+   // true if callers must step by 1 with the border cells above
+
    bool unbounded;
    // algorithms that uses a finite universe should set this flag false
    // so the GUI code won't call CreateBorderCells or DeleteBorderCells
@@ -154,9 +326,12 @@ protected:
    bigint generation ;
    bigint increment ;
    timeline_t timeline ;
+   snapshots_t snapshots ;
    TGridType grid_type ;
 
 private:
+   int keepframe(int i, int spacing) ;
+   void evictframes() ;
    // following are called by CreateBorderCells() to join edges in various ways
    void JoinTwistedEdges() ;
    void JoinTwistedAndShiftedEdges() ;
@@ -3,6 +3,11 @@
 
 #include "lifepoll.h"
 #include "util.h"
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+#include <vector>
 lifepoll::lifepoll() {
   interrupted = 0 ;
   calculating = 0 ;
@@ -35,3 +40,147 @@ void lifepoll::bailIfCalculating() {
 }
 void lifepoll::updatePop() {}
 lifepoll default_poller ;
+/*
+ *   The worker thread is made on the first start() and then lives as
+ *   long as the process, like the pool in util.cpp; it is detached so
+ *   exiting while it is parked for good is harmless.
+ */
+struct lifeworkerstate {
+  std::mutex mtx ;
+  std::condition_variable cv ;
+  std::thread *thread ;
+  lifetask *task ;          // waiting to be picked up
+  std::atomic<int> running ;
+  std::atomic<int> pausereq ;
+  int active ;              // threads working on the task that will poll
+  int parked ;              // how many of those are in park()
+  int paused ;              // pause() has stopped them all
+  int stuck ;               // one is parked for good
+} ;
+static thread_local int onworker ;
+static void workerloop(lifeworkerstate *s) {
+  onworker = 1 ;
+  std::unique_lock<std::mutex> lk(s->mtx) ;
+  for (;;) {
+    s->cv.wait(lk, [s] { return s->task != 0 ; }) ;
+    lifetask *t = s->task ;
+    s->task = 0 ;
+    lk.unlock() ;
+    t->run() ;
+    lk.lock() ;
+    s->running = 0 ;
+    s->active = 0 ;
+    s->cv.notify_all() ;
+  }
+}
+/*
+ *   A thread that is about to work on part of the task joins the
+ *   threads pause() waits for; it must not start while a pause is
+ *   asked for or in force.
+ */
+static void enterworker(lifeworkerstate *s) {
+  std::unique_lock<std::mutex> lk(s->mtx) ;
+  s->cv.wait(lk, [s] { return s->pausereq == 0 ; }) ;
+  s->active++ ;
+}
+static void leaveworker(lifeworkerstate *s) {
+  std::unique_lock<std::mutex> lk(s->mtx) ;
+  s->active-- ;
+  s->cv.notify_all() ;
+}
+class workerpiece : public lifetask {
+public:
+  virtual void run() {
+    int was = onworker ;
+    onworker = 1 ;
+    enterworker(s) ;
+    task->run() ;
+    leaveworker(s) ;
+    onworker = was ;
+  }
+  lifeworkerstate *s ;
+  lifetask *task ;
+} ;
+lifeworker::lifeworker() {
+  s = new lifeworkerstate ;
+  s->thread = 0 ;
+  s->task = 0 ;
+  s->running = 0 ;
+  s->pausereq = 0 ;
+  s->active = 0 ;
+  s->parked = 0 ;
+  s->paused = 0 ;
+  s->stuck = 0 ;
+}
+void lifeworker::start(lifetask *task) {
+  std::unique_lock<std::mutex> lk(s->mtx) ;
+  if (s->running)
+    lifefatal("internal: worker is already busy") ;
+  if (s->thread == 0) {
+    s->thread = new std::thread(workerloop, s) ;
+    s->thread->detach() ;
+  }
+  s->running = 1 ;
+  s->active = 1 ;
+  s->task = task ;
+  s->cv.notify_all() ;
+}
+int lifeworker::busy() {
+  return s->running ;
+}
+int lifeworker::wait(int ms) {
+  std::unique_lock<std::mutex> lk(s->mtx) ;
+  auto done = [this] { return s->running == 0 ; } ;
+  if (ms < 0)
+    s->cv.wait(lk, done) ;
+  else
+    s->cv.wait_for(lk, std::chrono::milliseconds(ms), done) ;
+  return s->running == 0 ;
+}
+int lifeworker::pause() {
+  std::unique_lock<std::mutex> lk(s->mtx) ;
+  if (!s->running || s->paused || s->stuck)
+    return 0 ;
+  s->pausereq = 1 ;
+  s->cv.wait(lk, [this] { return s->parked == s->active || s->running == 0 ; }) ;
+  if (s->running) {
+    s->paused = 1 ;
+    return 1 ;
+  }
+  s->pausereq = 0 ;
+  return 0 ;
+}
+void lifeworker::resume() {
+  std::unique_lock<std::mutex> lk(s->mtx) ;
+  s->paused = 0 ;
+  s->pausereq = 0 ;
+  s->cv.notify_all() ;
+}
+void lifeworker::park(int forever) {
+  if (!s->pausereq && !forever)
+    return ;
+  std::unique_lock<std::mutex> lk(s->mtx) ;
+  if (forever)
+    s->stuck = 1 ;
+  s->parked++ ;
+  s->cv.notify_all() ;
+  s->cv.wait(lk, [this, forever] { return !forever && s->pausereq == 0 ; }) ;
+  s->parked-- ;
+  s->cv.notify_all() ;
+}
+void lifeworker::runtasks(lifetask **tasks, int ntasks) {
+  std::vector<workerpiece> pieces(ntasks) ;
+  std::vector<lifetask *> ptrs(ntasks) ;
+  for (int i=0; i<ntasks; i++) {
+    pieces[i].s = s ;
+    pieces[i].task = tasks[i] ;
+    ptrs[i] = &pieces[i] ;
+  }
+  // while this thread only waits for the pieces it cannot poll
+  leaveworker(s) ;
+  lifethreads::runexclusive(&ptrs[0], ntasks) ;
+  enterworker(s) ;
+}
+int lifeworker::isworker() {
+  return onworker ;
+}
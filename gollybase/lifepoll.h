@@ -10,6 +10,7 @@
  */
 #ifndef LIFEPOLL_H
 #define LIFEPOLL_H
+#include <atomic>
 /**
  *   How frequently to invoke the heavyweight event checker, as a
  *   count of inner-loop polls.
@@ -54,7 +55,7 @@ public:
     *   millions of times a second.
     */
    inline int poll() {
-      return (countdown-- > 0) ? interrupted : inner_poll() ;
+      return (countdown-- > 0) ? isInterrupted() : inner_poll() ;
    }
    int inner_poll() ;
    /**
@@ -80,9 +81,66 @@ public:
     */
    virtual void updatePop() ;
 private:
-   int interrupted ;
+   std::atomic<int> interrupted ;   // may be set from another thread
    int calculating ;
    int countdown ;
 } ;
 extern lifepoll default_poller ;
+/**
+ *   Runs a task (normally a call or two of step()) on a thread of its
+ *   own, so a GUI can go on handling events while a pattern generates
+ *   instead of calling back into its event loop from checkevents().
+ *
+ *   The poller of the algorithm being stepped should call park() from
+ *   checkevents() when isworker() is true.  Another thread can then
+ *   pause() the calculation; it stops at its next poll, which is where
+ *   a GUI used to run its event handlers from, so anything that was
+ *   safe to do there (drawing, asking for the population) is safe
+ *   until resume().  pause() also returns once the task completes, so
+ *   it can take as long as the algorithm goes between polls.
+ *   Interrupt the task with setInterrupted() on the poller as usual.
+ */
+class lifetask ;
+struct lifeworkerstate ;
+class lifeworker {
+public:
+   lifeworker() ;
+   /**
+    *   Start the task; the worker must not be busy.
+    */
+   void start(lifetask *task) ;
+   /**
+    *   Is a task started and not yet finished?
+    */
+   int busy() ;
+   /**
+    *   Wait at most ms milliseconds (forever if negative) for the task
+    *   to finish; returns true if it has.
+    */
+   int wait(int ms) ;
+   /**
+    *   Stop a running task at its next poll.  Returns true if this call
+    *   stopped it, in which case the caller must resume() it; false if
+    *   there was nothing to stop (idle, finished, or already paused).
+    */
+   int pause() ;
+   void resume() ;
+   /**
+    *   Called on the worker thread from checkevents().  With forever
+    *   set the thread stays paused for good; for fatal errors that have
+    *   to be reported by another thread.
+    */
+   void park(int forever = 0) ;
+   /**
+    *   Called by the running task to run independent calculations
+    *   (stepping several universes, say) side by side with
+    *   lifethreads::runexclusive().  Each of them may park(), and
+    *   isworker() is true inside them; pause() waits for all that
+    *   have started and not finished to park.
+    */
+   void runtasks(lifetask **tasks, int ntasks) ;
+   static int isworker() ;
+private:
+   lifeworkerstate *s ;
+} ;
 #endif
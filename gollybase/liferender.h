@@ -37,7 +37,8 @@ public:
    // byte quadruplet contains the RGBA values for the corresponding pixel.
    // If pmscale > 1 then pm data contains (w/pmscale)*(h/pmscale) bytes
    // where each byte is a cell state (0..255).  This allows the rendering
-   // code to display either icons or colors.
+   // code to display either icons or colors.  The pm data belongs to
+   // the caller (it may be a cached copy) so it must not be changed.
    virtual void pixblit(int x, int y, int w, int h, unsigned char* pm, int pmscale) ;
 
    // the drawing code needs access to the current layer's colors,
@@ -47,6 +48,16 @@ public:
    // for state renderers, this just copies the cell state; no scaling is
    // supported.  Only called for juststate renderers.
    virtual void stateblit(int x, int y, int w, int h, unsigned char* pm) ;
+
+   // A renderer that keeps its pixels from one draw to the next returns
+   // nonzero from retained().  The algorithm then calls damage() on each
+   // area whose pixels change, before any blits into it, and skips the
+   // blits for areas that look the same as last time.  A damaged area
+   // that gets no blits has become empty and should show dead cells.
+   // Algorithms that do not track damage just damage the whole view.
+   // damage() is also a convenient place to note dirty rectangles.
+   virtual int retained() { return 0 ; }
+   virtual void damage(int x, int y, int w, int h) {}
 private:
    int juststate ;
 } ;
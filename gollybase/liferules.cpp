@@ -1193,3 +1193,36 @@ const char* liferules::getrule() {
 bool liferules::isRegularLife() {
    return (neighbormask == MOORE && totalistic && rulebits == 0x1808 && wolfram < 0) ;
 }
+
+// Output bits 5, 4, 1 and 0 are the new states of the cells at bits
+// 10, 9, 6 and 5 of the index; we try every entry.
+bool liferules::mooresums(const char *table, int &born, int &survive) {
+   static const int outbit[4] = { 5, 4, 1, 0 } ;
+   static const int cellbit[4] = { 10, 9, 6, 5 } ;
+   int state[2][10] ;
+   for (int i=0; i<10; i++)
+      state[0][i] = state[1][i] = -1 ;
+   born = survive = 0 ;
+   for (int i=0; i<ALL4X4; i++) {
+      for (int c=0; c<4; c++) {
+         int b = cellbit[c] ;
+         int sum = 0 ;
+         for (int dr=-4; dr<=4; dr+=4)
+            for (int dc=-1; dc<=1; dc++)
+               sum += (i >> (b + dr + dc)) & 1 ;
+         int *s = &state[(i >> b) & 1][sum] ;
+         int v = (table[i] >> outbit[c]) & 1 ;
+         if (*s < 0)
+            *s = v ;
+         else if (*s != v)
+            return false ;
+      }
+   }
+   for (int i=0; i<10; i++) {
+      if (state[0][i] > 0)
+         born |= 1 << i ;
+      if (state[1][i] > 0)
+         survive |= 1 << i ;
+   }
+   return true ;
+}
@@ -49,6 +49,12 @@ public:
    bool isVonNeumann() const { return neighbormask == VON_NEUMANN ; }
    bool isWolfram() const { return wolfram >= 0 ; }
 
+   // Does this 4x4 table compute an outer-totalistic Moore rule?  If so,
+   // bit i of born is set if a dead cell with i live neighbors comes
+   // alive, and bit i of survive if a live cell with i-1 live neighbors
+   // stays alive (so both are indexed by the nine-cell sum).
+   static bool mooresums(const char *table, int &born, int &survive) ;
+
 private:
    char canonrule[MAXRULESIZE] ;      // canonical version of valid rule passed into setrule
    neighborhood_masks neighbormask ;  // neighborhood masks in 3x3 table
@@ -10,6 +10,7 @@
 #include <stdlib.h>     // for malloc, free, etc
 #include <limits.h>     // for INT_MIN and INT_MAX
 #include <string.h>     // for memset and strchr
+#include <algorithm>    // for std::sort and std::unique
 
 // -----------------------------------------------------------------------------
 
@@ -25,10 +26,13 @@ static const int MAXNCOLS = 2 * MAXRANGE + 1;
 // maximum number of cells in grid must be < 2^31 so population can't overflow
 #define MAXCELLS 100000000.0
 
-// faster_Neumann_* calls are much slower than fast_Neumann when the
+// faster_Neumann calls are much slower than fast_Neumann when the
 // range is 1 or 2, similar when 5, but much faster when 10 or above
 #define SMALL_NN_RANGE 4
 
+// cell coordinates in an unbounded universe must be within the editing limits
+static const int CELLLIMIT = 1000000000;
+
 // -----------------------------------------------------------------------------
 
 // Create a new empty universe.
@@ -41,6 +45,8 @@ ltlalgo::ltlalgo()
     range = 1;
     ntype = 'M';
     colcounts = NULL;
+    tilesize = 0;
+    logtilesize = 0;
     create_grids(DEFAULTSIZE, DEFAULTSIZE);
     generation = 0;
     increment = 1;
@@ -53,9 +59,9 @@ ltlalgo::ltlalgo()
 
 ltlalgo::~ltlalgo()
 {
-    free(outergrid1);
-    if (outergrid2) free(outergrid2);
-    if (colcounts) free(colcounts);
+    free_grids();
+    clear_tiles();
+    free_windows();
     if (shape) free(shape) ;
 }
 
@@ -67,13 +73,13 @@ void ltlalgo::allocate_colcounts()
     if (colcounts) free(colcounts);
     if (ntype == 'M') {
         colcounts = (int*) malloc(outerbytes * sizeof(int));
-        // if NULL then use fast_Moore, otherwise faster_Moore_*
+        // if NULL then use fast_Moore, otherwise faster_Moore
     } else if (ntype == 'N') {
         if (range <= SMALL_NN_RANGE) {
-            // use fast_Neumann (faster than faster_Neumann_* for small ranges)
+            // use fast_Neumann (faster than faster_Neumann for small ranges)
             colcounts = NULL;
         } else {
-            // additional rows are needed to calculate counts in faster_Neumann_*
+            // additional rows are needed to calculate counts in faster_Neumann
             colcounts = (int*) malloc(outerwd * (outerht + (outerwd-1)/2) * sizeof(int));
             // if NULL then use fast_Neumann
         }
@@ -92,7 +98,7 @@ void ltlalgo::create_grids(int wd, int ht)
     // create a bounded universe of given width and height
     gwd = wd;
     ght = ht;
-    border = range + 1;                 // the extra 1 is needed by faster_Moore_*
+    border = range + 1;                 // the extra 1 is needed by faster_Moore
     outerwd = gwd + border * 2;         // add left and right border
     outerht = ght + border * 2;         // add top and bottom border
     outerbytes = outerwd * outerht;
@@ -143,6 +149,19 @@ void ltlalgo::create_grids(int wd, int ht)
 
 // -----------------------------------------------------------------------------
 
+void ltlalgo::free_grids()
+{
+    free(outergrid1);
+    if (outergrid2) free(outergrid2);
+    if (colcounts) free(colcounts);
+    outergrid1 = outergrid2 = NULL;
+    currgrid = nextgrid = NULL;
+    colcounts = NULL;
+    gwd = ght = 0;
+}
+
+// -----------------------------------------------------------------------------
+
 void ltlalgo::empty_boundaries()
 {
     minx = INT_MAX;
@@ -174,86 +193,13 @@ void ltlalgo::endofpattern()
 
 // -----------------------------------------------------------------------------
 
-const char* ltlalgo::resize_grids(int up, int down, int left, int right)
+static void recycle_tile(ltltile& tile, int tilesize, vector<unsigned char*>& freetiles)
 {
-    // try to resize an unbounded universe by given amounts (possibly -ve)
-    int newwd = gwd + left + right;
-    int newht = ght + up + down;
-    if ((float)newwd * (float)newht > MAXCELLS) {
-        return "Sorry, but the universe can't be expanded that far.";
-    }
-
-    // check if new grid edges would be outside editing limits
-    int newtop = gtop - up;
-    int newleft = gleft - left;
-    int newbottom = newtop + newht - 1;
-    int newright = newleft + newwd - 1;
-    if (newtop <   -1000000000 || newleft < -1000000000 ||
-        newbottom > 1000000000 || newright > 1000000000) {
-        return "Sorry, but the grid edges can't be outside the editing limits.";
-    }
-    
-    int newbytes = newwd * newht;
-    unsigned char* newcurr = (unsigned char*) calloc(newbytes, sizeof(unsigned char));
-    unsigned char* newnext = (unsigned char*) calloc(newbytes, sizeof(unsigned char));
-    if (newcurr == NULL || newnext == NULL) {
-        if (newcurr) free(newcurr);
-        if (newnext) free(newnext);
-        return "Not enough memory to resize universe!";
-    }
-    
-    // resize succeeded so copy pattern from currgrid into newcurr
-    if (population > 0) {
-        unsigned char* src = currgrid + miny * outerwd + minx;
-        unsigned char* dest = newcurr + (miny + up) * newwd + minx + left;
-        int xbytes = maxx - minx + 1;
-        for (int row = miny; row <= maxy; row++) {
-            memcpy(dest, src, xbytes);
-            src += outerwd;
-            dest += newwd;
-        }
-        // shift pattern boundaries
-        minx += left;
-        maxx += left;
-        miny += up;
-        maxy += up;
-    }
-    
-    free(outergrid1);
-    if (outergrid2) free(outergrid2);
-    outergrid1 = currgrid = newcurr;
-    outergrid2 = nextgrid = newnext;
-
-    outerwd = gwd = newwd;
-    outerht = ght = newht;
-    outerbytes = newbytes;
-    
-    // set grid coordinates of cell at bottom right corner of grid
-    gwdm1 = gwd - 1;
-    ghtm1 = ght - 1;
-
-    // adjust cell coordinates of grid edges
-    gtop -= up;
-    gleft -= left;
-    gbottom = gtop + ghtm1;
-    gright = gleft + gwdm1;
-    
-    // set bigint versions of grid edges (used by GUI code)
-    gridtop = gtop;
-    gridleft = gleft;
-    gridbottom = gbottom;
-    gridright = gright;
-
-    allocate_colcounts();
-
-    if (colcounts) {
-        // faster_* calls don't use outergrid2
-        free(outergrid2);
-        outergrid2 = NULL;
-        nextgrid = NULL;
+    // kill the tile's cells and put them in the pool
+    for (int y = tile.miny; y <= tile.maxy; y++) {
+        memset(tile.cells + y * tilesize + tile.minx, 0, tile.maxx - tile.minx + 1);
     }
-
-    return NULL;    // success
+    freetiles.push_back(tile.cells);
 }
 
 // -----------------------------------------------------------------------------
@@ -265,43 +211,44 @@ int ltlalgo::setcell(int x, int y, int newstate)
     if (newstate < 0 || newstate >= maxCellStates) return -1;
     
     if (unbounded) {
-        // check if universe needs to be expanded
-        if (x < gleft || x > gright || y < gtop || y > gbottom) {
-            if (population == 0) {
-                // no need to resize empty grids;
-                // just adjust grid edges so that x,y is in middle of grid
-                gtop = y - int(ght / 2);
-                gleft = x - int(gwd / 2);
-                gbottom = gtop + ghtm1;
-                gright = gleft + gwdm1;
-                // set bigint versions of grid edges (used by GUI code)
-                gridtop = gtop;
-                gridleft = gleft;
-                gridbottom = gbottom;
-                gridright = gright;
-            } else {
-                int up = y < gtop ? gtop - y : 0;
-                int down = y > gbottom ? y - gbottom : 0;
-                int left = x < gleft ? gleft - x : 0;
-                int right = x > gright ? x - gright : 0;
-                
-                // if the down or right amount is 1 then it's likely a pattern file
-                // is being loaded, so increase the amount to reduce the number of
-                // resize_grids calls and speed up the loading time
-                if (down == 1) down = 10;
-                if (right == 1) right = 10;
-                
-                const char* errmsg = resize_grids(up, down, left, right);
-                if (errmsg) {
-                    if (show_warning) lifewarning(errmsg);
-                    // prevent further warning messages until endofpattern is called
-                    // (this avoids user having to close thousands of dialog boxes
-                    // if they attempted to paste a large pattern)
-                    show_warning = false;
-                    return -1;
-                }
+        if (x < -CELLLIMIT || x > CELLLIMIT || y < -CELLLIMIT || y > CELLLIMIT) {
+            if (show_warning) lifewarning("Sorry, but cells can't be set outside the editing limits.");
+            // prevent further warning messages until endofpattern is called
+            // (this avoids user having to close thousands of dialog boxes
+            // if they attempted to paste a large pattern)
+            show_warning = false;
+            return -1;
+        }
+        
+        // set x,y cell in its tile
+        int tx = x >> logtilesize;
+        int ty = y >> logtilesize;
+        ltltile* tile = newstate > 0 ? &get_tile(tx, ty) : find_tile(tx, ty);
+        if (tile == NULL) return 0;     // cell is already dead
+        int lx = x & (tilesize - 1);
+        int ly = y & (tilesize - 1);
+        unsigned char* cellptr = tile->cells + ly * tilesize + lx;
+        int oldstate = *cellptr;
+        if (newstate != oldstate) {
+            *cellptr = (unsigned char)newstate;
+            if (oldstate == 0 && newstate > 0) {
+                population++;
+                tile->population++;
+                if (lx < tile->minx) tile->minx = lx;
+                if (lx > tile->maxx) tile->maxx = lx;
+                if (ly < tile->miny) tile->miny = ly;
+                if (ly > tile->maxy) tile->maxy = ly;
+            } else if (oldstate > 0 && newstate == 0) {
+                population--;
+                tile->population--;
             }
         }
+        if (tile->population == 0) {
+            // put the empty tile back in the pool
+            recycle_tile(*tile, tilesize, freetiles);
+            tiles.erase(std::make_pair(ty, tx));
+        }
+        return 0;
     } else {
         // check if x,y is outside bounded universe
         if (x < gleft || x > gright) return -1;
@@ -338,9 +285,10 @@ int ltlalgo::setcell(int x, int y, int newstate)
 int ltlalgo::getcell(int x, int y)
 {
     if (unbounded) {
-        // cell outside grid is dead
-        if (x < gleft || x > gright) return 0;
-        if (y < gtop || y > gbottom) return 0;
+        // cell in a missing tile is dead
+        ltltile* tile = find_tile(x >> logtilesize, y >> logtilesize);
+        if (tile == NULL) return 0;
+        return tile->cells[(y & (tilesize - 1)) * tilesize + (x & (tilesize - 1))];
     } else {
         // error if x,y is outside bounded universe
         if (x < gleft || x > gright) return -1;
@@ -360,6 +308,26 @@ int ltlalgo::getcell(int x, int y)
 int ltlalgo::nextcell(int x, int y, int& v)
 {
     if (population == 0) return -1;
+    
+    if (unbounded) {
+        // look for the cell in the tiles that intersect row y, starting with x's tile
+        int ty = y >> logtilesize;
+        int ly = y & (tilesize - 1);
+        std::map< std::pair<int,int>, ltltile >::iterator it;
+        it = tiles.lower_bound(std::make_pair(ty, x >> logtilesize));
+        for ( ; it != tiles.end() && it->first.first == ty; it++) {
+            ltltile& tile = it->second;
+            if (ly < tile.miny || ly > tile.maxy) continue;
+            int left = it->first.second * tilesize;
+            int lx = x - left > tile.minx ? x - left : tile.minx;
+            unsigned char* row = tile.cells + ly * tilesize;
+            for ( ; lx <= tile.maxx; lx++) {
+                v = row[lx];
+                if (v > 0) return left + lx - x;
+            }
+        }
+        return -1;
+    }
 
     // check if y is outside grid
     if (y < gtop || y > gbottom) return -1;
@@ -394,6 +362,83 @@ int ltlalgo::nextcell(int x, int y, int& v)
 
 // -----------------------------------------------------------------------------
 
+// Append the runs of non-zero cells in a row of n cells starting at x,y.
+
+static void addrowruns(const unsigned char* row, int n, int x, int y,
+                       vector<cellspan>& spans)
+{
+    for (int i = 0; i < n; i++) {
+        int v = row[i];
+        if (v == 0) continue;
+        if (!spans.empty() && spans.back().y == y && spans.back().state == v &&
+            spans.back().x + spans.back().n == x + i) {
+            spans.back().n++;
+        } else {
+            cellspan s = { x + i, y, 1, v };
+            spans.push_back(s);
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+// Return the runs of non-zero cells in the given rectangle, in row order.
+// In an unbounded universe we only look at the tiles overlapping the
+// rectangle, one row of tiles at a time.
+
+void ltlalgo::getcellruns(int top, int left, int bottom, int right,
+                          vector<cellspan>& spans)
+{
+    if (population == 0 || top > bottom || left > right) return;
+
+    if (unbounded) {
+        int tx0 = left >> logtilesize, tx1 = right >> logtilesize;
+        vector<std::map< std::pair<int,int>, ltltile >::iterator> row;
+        for (int ty = top >> logtilesize; ty <= (bottom >> logtilesize); ty++) {
+            row.clear();
+            std::map< std::pair<int,int>, ltltile >::iterator it;
+            it = tiles.lower_bound(std::make_pair(ty, tx0));
+            for ( ; it != tiles.end() && it->first.first == ty &&
+                    it->first.second <= tx1; it++) row.push_back(it);
+            if (row.empty()) {
+                if (ty == (bottom >> logtilesize)) break;
+                continue;
+            }
+            int tiletop = ty * tilesize;
+            for (int ly = 0; ly < tilesize; ly++) {
+                int y = tiletop + ly;
+                if (y < top || y > bottom) continue;
+                for (size_t i = 0; i < row.size(); i++) {
+                    ltltile& tile = row[i]->second;
+                    if (ly < tile.miny || ly > tile.maxy) continue;
+                    int tileleft = row[i]->first.second * tilesize;
+                    int lx0 = tile.minx, lx1 = tile.maxx;
+                    if (tileleft + lx0 < left) lx0 = left - tileleft;
+                    if (tileleft + lx1 > right) lx1 = right - tileleft;
+                    if (lx0 > lx1) continue;
+                    addrowruns(tile.cells + ly * tilesize + lx0, lx1 - lx0 + 1,
+                               tileleft + lx0, y, spans);
+                }
+            }
+            // avoid overflow when bottom is in the last row of tiles
+            if (ty == (bottom >> logtilesize)) break;
+        }
+        return;
+    }
+
+    // clip the rectangle to the grid
+    if (top < gtop) top = gtop;
+    if (bottom > gbottom) bottom = gbottom;
+    if (left < gleft) left = gleft;
+    if (right > gright) right = gright;
+    for (int y = top; y <= bottom && left <= right; y++) {
+        addrowruns(currgrid + (y - gtop) * outerwd + (left - gleft),
+                   right - left + 1, left, y, spans);
+    }
+}
+
+// -----------------------------------------------------------------------------
+
 static bigint bigpop;
 
 const bigint& ltlalgo::getPopulation()
@@ -411,7 +456,7 @@ int ltlalgo::isEmpty()
 
 // -----------------------------------------------------------------------------
 
-void ltlalgo::update_current_grid(unsigned char &state, int ncount)
+void ltlalgo::update_current_grid(unsigned char &state, int ncount, ltlstats &stats)
 {
     // return the state of the cell based on the neighbor count
     if (state == 0) {
@@ -419,7 +464,7 @@ void ltlalgo::update_current_grid(unsigned char &state, int ncount)
         if (ncount >= minB && ncount <= maxB) {
             // new cell is born
             state = 1;
-            population++;
+            stats.popdelta++;
         }
     } else if (state == 1) {
         // this cell is alive
@@ -431,8 +476,7 @@ void ltlalgo::update_current_grid(unsigned char &state, int ncount)
             } else {
                 // cell dies
                 state = 0;
-                population--;
-                if (population == 0) empty_boundaries();
+                stats.popdelta--;
             }
         }
     } else {
@@ -442,15 +486,14 @@ void ltlalgo::update_current_grid(unsigned char &state, int ncount)
         } else {
             // cell dies
             state = 0;
-            population--;
-            if (population == 0) empty_boundaries();
+            stats.popdelta--;
         }
     }
 }
 
 // -----------------------------------------------------------------------------
 
-void ltlalgo::update_next_grid(int x, int y, int xyoffset, int ncount)
+void ltlalgo::update_next_grid(int x, int y, int xyoffset, int ncount, ltlstats &stats)
 {
     // x,y cell in nextgrid might change based on the given neighborhood count
     unsigned char state = *(currgrid + xyoffset);
@@ -460,11 +503,11 @@ void ltlalgo::update_next_grid(int x, int y, int xyoffset, int ncount)
             // new cell is born in nextgrid
             unsigned char* nextcell = nextgrid + xyoffset;
             *nextcell = 1;
-            population++;
-            if (x < minx) minx = x;
-            if (x > maxx) maxx = x;
-            if (y < miny) miny = y;
-            if (y > maxy) maxy = y;
+            stats.popdelta++;
+            if (x < stats.minx) stats.minx = x;
+            if (x > stats.maxx) stats.maxx = x;
+            if (y < stats.miny) stats.miny = y;
+            if (y > stats.maxy) stats.maxy = y;
         }
     } else if (state == 1) {
         // this cell is alive
@@ -473,23 +516,22 @@ void ltlalgo::update_next_grid(int x, int y, int xyoffset, int ncount)
             unsigned char* nextcell = nextgrid + xyoffset;
             *nextcell = 1;
             // population doesn't change but pattern limits in nextgrid might
-            if (x < minx) minx = x;
-            if (x > maxx) maxx = x;
-            if (y < miny) miny = y;
-            if (y > maxy) maxy = y;
+            if (x < stats.minx) stats.minx = x;
+            if (x > stats.maxx) stats.maxx = x;
+            if (y < stats.miny) stats.miny = y;
+            if (y > stats.maxy) stats.maxy = y;
         } else if (maxCellStates > 2) {
             // cell decays to state 2
             unsigned char* nextcell = nextgrid + xyoffset;
             *nextcell = 2;
             // population doesn't change but pattern limits in nextgrid might
-            if (x < minx) minx = x;
-            if (x > maxx) maxx = x;
-            if (y < miny) miny = y;
-            if (y > maxy) maxy = y;
+            if (x < stats.minx) stats.minx = x;
+            if (x > stats.maxx) stats.maxx = x;
+            if (y < stats.miny) stats.miny = y;
+            if (y > stats.maxy) stats.maxy = y;
         } else {
             // cell dies
-            population--;
-            if (population == 0) empty_boundaries();
+            stats.popdelta--;
         }
     } else {
         // state is > 1 so this cell will eventually die
@@ -497,881 +539,486 @@ void ltlalgo::update_next_grid(int x, int y, int xyoffset, int ncount)
             unsigned char* nextcell = nextgrid + xyoffset;
             *nextcell = state + 1;
             // population doesn't change but pattern limits in nextgrid might
-            if (x < minx) minx = x;
-            if (x > maxx) maxx = x;
-            if (y < miny) miny = y;
-            if (y > maxy) maxy = y;
+            if (x < stats.minx) stats.minx = x;
+            if (x > stats.maxx) stats.maxx = x;
+            if (y < stats.miny) stats.miny = y;
+            if (y > stats.maxy) stats.maxy = y;
         } else {
             // cell dies
-            population--;
-            if (population == 0) empty_boundaries();
+            stats.popdelta--;
         }
     }
 }
 
 // -----------------------------------------------------------------------------
 
-void ltlalgo::faster_Moore_bounded(int mincol, int minrow, int maxcol, int maxrow)
+// A generation can be split into bands of rows that are processed at the same
+// time by the threads in lifethreads.  Each band counts its own births and deaths
+// and finds the boundary of its own live cells, and these are merged when all the
+// bands have finished, so the result doesn't depend on the number of bands.
+
+enum {
+    MOORE_COUNTS,       // cumulative counts of the rows in a band (faster_Moore)
+    MOORE_CARRY,        // add the counts from the bands above (faster_Moore)
+    MOORE_ROWS,         // final counts and new states (faster_Moore)
+    NEUMANN_ROWS,       // final counts and new states (faster_Neumann)
+    FAST_MOORE,         // fast_Moore
+    FAST_NEUMANN,       // fast_Neumann
+    FAST_SHAPED         // fast_Shaped
+};
+
+struct ltlband : public lifetask {
+    ltlalgo* algo;
+    int kind;                   // one of the above
+    int minrow, maxrow;         // the rows in this band
+    int mincol, maxcol;         // the columns to process
+    int rowoffset, coloffset;   // extra values used by some kinds of band
+    ltlstats stats;             // births, deaths and limits of live cells
+    virtual void run() { algo->run_band(*this); }
+};
+
+// a region with fewer cells per band than this isn't worth splitting
+static const int MINBANDCELLS = 16384;
+
+// -----------------------------------------------------------------------------
+
+static int band_start(int minrow, int maxrow, int band, int nbands)
 {
-    // use Adam P. Goucher's algorithm to calculate Moore neighborhood counts
-    // in a bounded universe; note that currgrid is surrounded by a border that
-    // might contain live cells (the border is range+1 cells thick and the
-    // outermost cells are always dead)
-    
-    // the given limits are relative to currgrid so we need to add border
-    // so they are relative to outergrid1, and then expand them by range
-    int bmr = border - range;
-    int bpr = border + range;
-    minrow += bmr;
-    mincol += bmr;
-    maxrow += bpr;
-    maxcol += bpr;
+    // return the first row of the given band
+    return minrow + (int)((long long)(maxrow - minrow + 1) * band / nbands);
+}
 
-    // calculate cumulative counts for each column and store in colcounts
+// -----------------------------------------------------------------------------
 
-    unsigned char* cellptr = outergrid1 + minrow * outerwd + mincol;
-    int* ccptr = colcounts + minrow * outerwd + mincol;
-    int *prevptr = NULL;
-    int width = (maxcol - mincol + 1);
-    int nextrow = outerwd - width;
-    int rowcount = 0;
+int ltlalgo::band_count(int rows, int cols)
+{
+    // return the number of bands to use for a region of the given size
+    int nbands = lifethreads::getthreadcount();
+    double maxbands = (double)rows * (double)cols / MINBANDCELLS;
+    if (nbands > maxbands) nbands = (int)maxbands;
+    if (nbands > rows) nbands = rows;
+    return nbands < 1 ? 1 : nbands;
+}
 
-    for (int j = mincol; j <= maxcol; j++) {
-        if (*cellptr == 1) rowcount++;
-        *ccptr = rowcount;
-        cellptr++;
-        ccptr++;
-    }
-    cellptr += nextrow;
-    ccptr += nextrow;
-    prevptr = ccptr - outerwd;
-    for (int i = minrow + 1; i <= maxrow; i++) {
-        rowcount = 0;
-        for (int j = mincol; j <= maxcol; j++) {
-            if (*cellptr == 1) rowcount++;
-            *ccptr = *prevptr + rowcount;
-            cellptr++;
-            ccptr++;
-            prevptr++;
-        }
-        cellptr += nextrow;
-        ccptr += nextrow;
-        prevptr += nextrow;
-    }
-    
-    // restore given limits (necessary for update_current_grid calls)
-    minrow -= bmr;
-    mincol -= bmr;
-    maxrow -= bpr;
-    maxcol -= bpr;
+// -----------------------------------------------------------------------------
 
-    // calculate final neighborhood counts using values in colcounts
-    // and update the corresponding cells in current grid
-    
-    int* colptr = colcounts + (minrow + bpr) * outerwd;
-    ccptr = colptr + mincol + bpr;
-    unsigned char* stateptr = currgrid + minrow*outerwd+mincol;
-    unsigned char state = *stateptr;
-    update_current_grid(state, *ccptr);
-    *stateptr = state;
-    if (state) {
-        if (mincol < minx) minx = mincol;
-        if (mincol > maxx) maxx = mincol;
-        if (minrow < miny) miny = minrow;
-        if (minrow > maxy) maxy = minrow;
+void ltlalgo::run_bands(int kind, int nbands, int minrow, int maxrow, int mincol, int maxcol,
+                        int rowoffset, int coloffset)
+{
+    // process the given region in nbands bands of rows
+    vector<ltlband> bands(nbands);
+    vector<lifetask*> tasks(nbands);
+    for (int i = 0; i < nbands; i++) {
+        ltlband& band = bands[i];
+        band.algo = this;
+        band.kind = kind;
+        band.minrow = band_start(minrow, maxrow, i, nbands);
+        band.maxrow = band_start(minrow, maxrow, i + 1, nbands) - 1;
+        band.mincol = mincol;
+        band.maxcol = maxcol;
+        band.rowoffset = rowoffset;
+        band.coloffset = coloffset;
+        band.stats.popdelta = 0;
+        band.stats.minx = INT_MAX;
+        band.stats.miny = INT_MAX;
+        band.stats.maxx = INT_MIN;
+        band.stats.maxy = INT_MIN;
+        tasks[i] = &band;
+    }
+    if (nbands == 1) {
+        run_band(bands[0]);
+    } else {
+        lifethreads::runtasks(&tasks[0], nbands);
     }
 
-    bool rowchanged = false;
-    int bmrm1 = border - range - 1;
-    stateptr = currgrid + minrow*outerwd + mincol+1;
-    for (int j = mincol+1; j <= maxcol; j++) {
-        // do i == minrow
-        int* ccptr1 = colptr + (j + bpr);
-        int* ccptr2 = colptr + (j + bmrm1);
-        state = *stateptr;
-        update_current_grid(state, *ccptr1 - *ccptr2);
-        *stateptr++ = state;
-        if (state) {
-            if (j < minx) minx = j;
-            if (j > maxx) maxx = j;
-            rowchanged = true;
-        }
-    }
-    if (rowchanged) {
-        if (minrow < miny) miny = minrow;
-        if (minrow > maxy) maxy = minrow;
-    }
-    
-    bool colchanged = false;
-    colptr = colcounts + mincol + bpr;
-    stateptr = currgrid + (minrow+1)*outerwd + mincol;
-    for (int i = minrow+1; i <= maxrow; i++) {
-        // do j == mincol
-        int* ccptr1 = colptr + (i + bpr) * outerwd;
-        int* ccptr2 = colptr + (i + bmrm1) * outerwd;
-        state = *stateptr;
-        update_current_grid(state, *ccptr1 - *ccptr2);
-        *stateptr = state;
-        stateptr += outerwd;
-        if (state) {
-            if (i < miny) miny = i;
-            if (i > maxy) maxy = i;
-            colchanged = true;
-        }
-    }
-    if (colchanged) {
-        if (mincol < minx) minx = mincol;
-        if (mincol > maxx) maxx = mincol;
-    }
-    
-    rowchanged = false;
-    for (int i = minrow+1; i <= maxrow; i++) {
-        int* ipr = colcounts + (i + bpr) * outerwd;
-        int* imrm1 = colcounts + (i + bmrm1) * outerwd;
-        stateptr = currgrid + i*outerwd + mincol+1;
-        for (int j = mincol+1; j <= maxcol; j++) {
-            int jpr = j + bpr;
-            int jmrm1 = j + bmrm1;
-            int* ccptr1 = ipr + jpr;
-            int* ccptr2 = imrm1 + jmrm1;
-            int* ccptr3 = ipr + jmrm1;
-            int* ccptr4 = imrm1 + jpr;
-            state = *stateptr;
-            update_current_grid(state, *ccptr1 + *ccptr2 - *ccptr3 - *ccptr4);
-            *stateptr++ = state;
-            if (state) {
-                if (j < minx) minx = j;
-                if (j > maxx) maxx = j;
-                rowchanged = true;
-            }
-        }
-        if (rowchanged) {
-            if (i < miny) miny = i;
-            if (i > maxy) maxy = i;
-            rowchanged = false;
-        }
+    // merge the results
+    for (int i = 0; i < nbands; i++) {
+        ltlstats& stats = bands[i].stats;
+        population += stats.popdelta;
+        if (stats.minx < minx) minx = stats.minx;
+        if (stats.maxx > maxx) maxx = stats.maxx;
+        if (stats.miny < miny) miny = stats.miny;
+        if (stats.maxy > maxy) maxy = stats.maxy;
     }
+    if (population == 0) empty_boundaries();
 }
 
 // -----------------------------------------------------------------------------
 
-void ltlalgo::faster_Moore_bounded2(int mincol, int minrow, int maxcol, int maxrow)
+void ltlalgo::run_band(ltlband &band)
 {
-    // use Adam P. Goucher's algorithm to calculate Moore neighborhood counts
-    // in a bounded universe; note that currgrid is surrounded by a border that
-    // might contain live cells (the border is range+1 cells thick and the
-    // outermost cells are always dead)
-    
-    // the given limits are relative to currgrid so we need to add border
-    // so they are relative to outergrid1, and then expand them by range
-    int bmr = border - range;
-    int bpr = border + range;
-    minrow += bmr;
-    mincol += bmr;
-    maxrow += bpr;
-    maxcol += bpr;
-
-    // calculate cumulative counts for each column and store in colcounts
-
-    unsigned char* cellptr = outergrid1 + minrow * outerwd + mincol;
-    int* ccptr = colcounts + minrow * outerwd + mincol;
-    int *prevptr = NULL;
-    int width = (maxcol - mincol + 1);
-    int nextrow = outerwd - width;
-    int rowcount = 0;
-
-    // compute 4 cell offset
-    int offset = (4 - ((g_uintptr_t)cellptr & 3)) & 3;
-    if (offset > width) offset = width;
-
-    // process in 4 cell chunks
-    int chunks = (width - offset) >> 2;
-    int remainder = (width - offset) - (chunks << 2);
-    int j = 0;
-
-    // process cells in the first row
-
-    // process cells up to the first 4 cell chunk
-    for (j = 0; j < offset; j++) {
-        rowcount += *cellptr++;
-        *ccptr++ = rowcount;
-    }
-
-    // process any 4 cell chunks
-    unsigned int *lcellptr = (unsigned int*)cellptr;
-    for (j = 0; j < chunks; j++) {
-        if (*lcellptr++) {
-            rowcount += *cellptr++;
-            *ccptr++ = rowcount;
-            rowcount += *cellptr++;
-            *ccptr++ = rowcount;
-            rowcount += *cellptr++;
-            *ccptr++ = rowcount;
-            rowcount += *cellptr++;
-            *ccptr++ = rowcount;
-        } else {
-            *ccptr++ = rowcount;
-            *ccptr++ = rowcount;
-            *ccptr++ = rowcount;
-            *ccptr++ = rowcount;
-            cellptr += 4;
-        }
+    switch (band.kind) {
+        case MOORE_COUNTS:
+            Moore_counts(band);
+            break;
+        case MOORE_CARRY:
+            Moore_carry(band);
+            break;
+        case MOORE_ROWS:
+            Moore_rows(band);
+            break;
+        case NEUMANN_ROWS:
+            Neumann_rows(band);
+            break;
+        case FAST_MOORE:
+            fast_Moore(band.mincol, band.minrow, band.maxcol, band.maxrow, band.stats);
+            break;
+        case FAST_NEUMANN:
+            fast_Neumann(band.mincol, band.minrow, band.maxcol, band.maxrow, band.stats);
+            break;
+        case FAST_SHAPED:
+            fast_Shaped(band.mincol, band.minrow, band.maxcol, band.maxrow, band.stats);
+            break;
     }
+}
 
-    // process any remaining cells
-    for (j = 0; j < remainder; j++) {
-        rowcount += *cellptr++;
-        *ccptr++ = rowcount;
-    }
-    cellptr += nextrow;
-    ccptr += nextrow;
-    prevptr = ccptr - outerwd;
-
-    // process the remaining rows of cells
+// -----------------------------------------------------------------------------
 
-    for (int i = minrow + 1; i <= maxrow; i++) {
-        rowcount = 0;
+// The row kernels used by faster_Moore.  With gcc or clang they do 8 cells at
+// a time using the compiler's vector extensions, and on x86 an AVX2 version is
+// chosen at run time if the processor has it; otherwise they do 1 cell at a time.
 
-        // compute 4 cell offset
-        offset = (4 - ((g_uintptr_t)cellptr & 3)) & 3;
-        if (offset > width) offset = width;
+#if (defined(__clang__) || (defined(__GNUC__) && __GNUC__ >= 9)) && \
+    defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define LTLVECTORS
+#endif
 
-        // process in 4 cell chunks
-        chunks = (width - offset) >> 2;
-        remainder = (width - offset) - (chunks << 2);
+static const unsigned long long LOWBYTES = 0x0101010101010101ULL;
 
-        // process cells up to the first 4 cell chunk
-        for (j = 0; j < offset; j++) {
-            rowcount += *cellptr++;
-            *ccptr++ = *prevptr++ + rowcount;
-        }
-        lcellptr = (unsigned int*)cellptr;
-
-        // process any 4 cell chunks
-        for (j = 0; j < chunks; j++) {
-            // check if any of the cells are alive
-            if (*lcellptr++) {
-                rowcount += *cellptr++;
-                *ccptr++ = *prevptr++ + rowcount;
-                rowcount += *cellptr++;
-                *ccptr++ = *prevptr++ + rowcount;
-                rowcount += *cellptr++;
-                *ccptr++ = *prevptr++ + rowcount;
-                rowcount += *cellptr++;
-                *ccptr++ = *prevptr++ + rowcount;
-           } else {
-                *ccptr++ = *prevptr++ + rowcount;
-                *ccptr++ = *prevptr++ + rowcount;
-                *ccptr++ = *prevptr++ + rowcount;
-                *ccptr++ = *prevptr++ + rowcount;
-                cellptr += 4;
-            }
-        }
+typedef void (*countrowfunc)(const unsigned char* cells, const int* prev, int* counts,
+                             int width, int multistate);
+typedef int (*rulerowfunc)(unsigned char* cells, const int* a, const int* b,
+                           int width, int span, const int* limits, int& lo, int& hi);
+static countrowfunc countrow;
+static rulerowfunc rulerow;
+static const char* ltlkernelname;
 
-        // process any remaining cells
-        for (j = 0; j < remainder; j++) {
-            rowcount += *cellptr++;
-            *ccptr++ = *prevptr++ + rowcount;
-        }
-        // next row
-        cellptr += nextrow;
-        ccptr += nextrow;
-        prevptr += nextrow;
-    }
-    
-    // restore given limits (necessary for update_current_grid calls)
-    minrow -= bmr;
-    mincol -= bmr;
-    maxrow -= bpr;
-    maxcol -= bpr;
+static inline int rule2(int state, int ncount, const int* limits)
+{
+    // return the new state of a cell in a two-state rule;
+    // limits holds minB, maxB, minS, maxS
+    if (state) return ncount >= limits[2] && ncount <= limits[3];
+    return ncount >= limits[0] && ncount <= limits[1];
+}
 
-    // calculate final neighborhood counts using values in colcounts
-    // and update the corresponding cells in current grid
-    
-    int* colptr = colcounts + (minrow + bpr) * outerwd;
-    ccptr = colptr + mincol + bpr;
-    unsigned char* stateptr = currgrid + minrow*outerwd+mincol;
-    int ncount = *ccptr;
-    if (*stateptr == 0) {
-        if (ncount >= minB && ncount <= maxB) {
-            *stateptr = 1;
-            population++;
-            minx = mincol;
-            maxx = mincol;
-            miny = minrow;
-            maxy = minrow;
-        }
-    } else {
-        if (ncount < minS || ncount > maxS) {
-            *stateptr = 0;
-            population--;
-        }
-        else {
-            minx = mincol;
-            maxx = maxcol;
-            miny = minrow;
-            maxy = maxrow;
-        }
-    }
+// -----------------------------------------------------------------------------
 
-    bool rowchanged = false;
-    int bmrm1 = border - range - 1;
-    stateptr = currgrid + minrow*outerwd + mincol+1;
-    int* ccptr1 = colptr + (mincol+1 + bpr);
-    int* ccptr2 = colptr + (mincol+1 + bmrm1);
-    for (j = mincol+1; j <= maxcol; j++) {
-        // do i == minrow
-        ncount = *ccptr1++ - *ccptr2++;
-        if (*stateptr == 0) {
-            if (ncount >= minB && ncount <= maxB) {
-                *stateptr = 1;
-                population++;
-                if (j < minx) minx = j;
-                if (j > maxx) maxx = j;
-                rowchanged = true;
-            }
-        } else {
-            if (ncount < minS || ncount > maxS) {
-                *stateptr = 0;
-                population--;
-            }
-            else {
-                if (j < minx) minx = j;
-                if (j > maxx) maxx = j;
-                rowchanged = true;
-            }
-        }
-        stateptr++;
-    }
-    if (rowchanged) {
-        if (minrow < miny) miny = minrow;
-        if (minrow > maxy) maxy = minrow;
-    }
-    
-    bool colchanged = false;
-    colptr = colcounts + mincol + bpr;
-    stateptr = currgrid + (minrow+1)*outerwd + mincol;
-    ccptr1 = colptr + (minrow+1 + bpr) * outerwd;
-    ccptr2 = colptr + (minrow+1 + bmrm1) * outerwd;
-    for (int i = minrow+1; i <= maxrow; i++) {
-        // do j == mincol
-        ncount = *ccptr1 - *ccptr2;
-        if (*stateptr == 0) {
-            if (ncount >= minB && ncount <= maxB) {
-                *stateptr = 1;
-                population++;
-                if (i < miny) miny = i;
-                if (i > maxy) maxy = i;
-                colchanged = true;
-            }
-        } else {
-            if (ncount < minS || ncount > maxS) {
-                *stateptr = 0;
-                population--;
-            }
-            else {
-                if (i < miny) miny = i;
-                if (i > maxy) maxy = i;
-                colchanged = true;
-            }
-        }
-        stateptr += outerwd;
-        ccptr1 += outerwd;
-        ccptr2 += outerwd;
-    }
-    if (colchanged) {
-        if (mincol < minx) minx = mincol;
-        if (mincol > maxx) maxx = mincol;
-    }
-    
-    rowchanged = false;
-    for (int i = minrow+1; i <= maxrow; i++) {
-        int* ipr = colcounts + (i + bpr) * outerwd;
-        int* imrm1 = colcounts + (i + bmrm1) * outerwd;
-        int jpr = mincol+1 + bpr;
-        int jmrm1 = mincol+1 + bmrm1;
-        ccptr1 = ipr + jpr;
-        ccptr2 = imrm1 + jmrm1;
-        int* ccptr3 = ipr + jmrm1;
-        int* ccptr4 = imrm1 + jpr;
-        stateptr = currgrid + i*outerwd + mincol+1;
-        for (j = mincol+1; j <= maxcol; j++) {
-            ncount = *ccptr1++ + *ccptr2++ - *ccptr3++ - *ccptr4++;
-            if (*stateptr == 0) {
-                if (ncount >= minB && ncount <= maxB) {
-                    *stateptr = 1;
-                    population++;
-                    if (j < minx) minx = j;
-                    if (j > maxx) maxx = j;
-                    rowchanged = true;
-                }
-            } else {
-                if (ncount < minS || ncount > maxS) {
-                    *stateptr = 0;
-                    population--;
-                }
-                else {
-                    if (j < minx) minx = j;
-                    if (j > maxx) maxx = j;
-                    rowchanged = true;
-                }
-            }
-            stateptr++;
-        }
-        if (rowchanged) {
-            if (i < miny) miny = i;
-            if (i > maxy) maxy = i;
-            rowchanged = false;
-        }
+static void countrow1(const unsigned char* cells, const int* prev, int* counts,
+                      int width, int)
+{
+    // set counts[j] to prev[j] plus the number of state-1 cells in cells[0..j]
+    int rowcount = 0;
+    for (int j = 0; j < width; j++) {
+        if (cells[j] == 1) rowcount++;
+        counts[j] = prev[j] + rowcount;
     }
-    if (population == 0) empty_boundaries();
 }
 
 // -----------------------------------------------------------------------------
 
-void ltlalgo::faster_Moore_unbounded(int mincol, int minrow, int maxcol, int maxrow)
+static int rulerow1(unsigned char* cells, const int* a, const int* b,
+                    int width, int span, const int* limits, int& lo, int& hi)
 {
-    // use Adam P. Goucher's algorithm to calculate Moore neighborhood counts
-    // in an unbounded universe; note that we can safely assume there is at least
-    // a 2*range border of dead cells surrounding the pattern
-    
-    // temporarily expand the given limits
-    minrow -= range;
-    mincol -= range;
-    maxrow += range;
-    maxcol += range;
-    
-    int r2 = range * 2;
-    int minrowpr2 = minrow+r2;
-    int mincolpr2 = mincol+r2;
-    
-    // put zeros in top 2*range rows of colcounts
-    for (int i = minrow; i < minrowpr2; i++) {
-        int* ccptr = colcounts + i * outerwd + mincol;
-        for (int j = mincol; j <= maxcol; j++) {
-            *ccptr++ = 0;
-        }
-    }
+    // apply a two-state rule to cells[0..width-1], where the neighborhood count of
+    // cells[k] is a[k+span-1] - a[k-1] - b[k+span-1] + b[k-1] (and a[-1] = b[-1] = 0);
+    // return the change in population and set lo and hi to the first and last
+    // live cells (lo > hi if there are none)
+    int popdelta = 0;
+    lo = width;
+    hi = -1;
+    for (int k = 0; k < width; k++) {
+        int ncount = a[k+span-1] - b[k+span-1];
+        if (k > 0) ncount += b[k-1] - a[k-1];
+        int state = cells[k];
+        int newstate = rule2(state, ncount, limits);
+        cells[k] = (unsigned char)newstate;
+        popdelta += newstate - state;
+        if (newstate) {
+            if (lo == width) lo = k;
+            hi = k;
+        }
+    }
+    return popdelta;
+}
 
-    // put zeros in left 2*range columns of colcounts
-    for (int j = mincol; j < mincolpr2; j++) {
-        int* ccptr = colcounts + minrowpr2 * outerwd + j;
-        for (int i = minrowpr2; i <= maxrow; i++) {
-            *ccptr = 0;
-            ccptr += outerwd;
-        }
-    }
+#ifdef LTLVECTORS
 
-    unsigned char* cellptr = currgrid + minrowpr2 * outerwd + mincolpr2;
-    int* ccptr = colcounts + minrowpr2 * outerwd + mincolpr2;
-    int* prevptr = ccptr - outerwd;
-    int width = (maxcol - mincolpr2 + 1);
-    int nextrow = outerwd - width;
-    int rowcount = 0;
-    int j = 0;
+typedef int ltlints __attribute__((vector_size(32)));           // 8 counts
+typedef unsigned char ltlbytes __attribute__((vector_size(8)));  // 8 cells
+typedef signed char ltlmask __attribute__((vector_size(8)));     // 8 flags
+#define LTLINLINE inline __attribute__((always_inline))
 
-    for (int i = minrowpr2; i <= maxrow; i++) {
-        rowcount = 0;
-        for (j = mincolpr2; j <= maxcol; j++) {
-            if (*cellptr == 1) rowcount++;
-            *ccptr = *prevptr + rowcount;
-            cellptr++;
-            ccptr++;
-            prevptr++;
-        }
-        cellptr += nextrow;
-        ccptr += nextrow;
-        prevptr += nextrow;
-    }
+// -----------------------------------------------------------------------------
 
-    // restore given limits
-    minrow += range;
-    mincol += range;
-    maxrow -= range;
-    maxcol -= range;
+static LTLINLINE unsigned long long onebytes(unsigned long long w)
+{
+    // set each byte of w to 1 if it is 1, otherwise 0
+    unsigned long long t = w ^ LOWBYTES;
+    unsigned long long high = LOWBYTES * 0x80;
+    return (~(((t & ~high) + ~high) | t) & high) >> 7;
+}
 
-    // calculate final neighborhood counts using values in colcounts
-    // and update the corresponding cells in current grid
-    
-    int* colptr = colcounts + (minrow + range) * outerwd;
-    ccptr = colptr + mincol + range;
-    unsigned char* stateptr = currgrid + minrow*outerwd+mincol;
-    unsigned char state = *stateptr;
-    update_current_grid(state, *ccptr);
-    *stateptr = state;
-    if (state) {
-        if (mincol < minx) minx = mincol;
-        if (mincol > maxx) maxx = mincol;
-        if (minrow < miny) miny = minrow;
-        if (minrow > maxy) maxy = minrow;
-    }
+// -----------------------------------------------------------------------------
 
-    bool rowchanged = false;
-    int rangep1 = range + 1;
-    stateptr = currgrid + minrow*outerwd + mincol+1;
-    for (j = mincol+1; j <= maxcol; j++) {
-        // do i == minrow
-        int* ccptr1 = colptr + (j+range);
-        int* ccptr2 = colptr + (j-rangep1);
-        state = *stateptr;
-        update_current_grid(state, *ccptr1 - *ccptr2);
-        *stateptr++ = state;
-        if (state) {
-            if (j < minx) minx = j;
-            if (j > maxx) maxx = j;
-            rowchanged = true;
-        }
-    }
-    if (rowchanged) {
-        if (minrow < miny) miny = minrow;
-        if (minrow > maxy) maxy = minrow;
-    }
-
-    bool colchanged = false;
-    colptr = colcounts + mincol + range;
-    stateptr = currgrid + (minrow+1)*outerwd + mincol;
-    for (int i = minrow+1; i <= maxrow; i++) {
-        // do j == mincol
-        int* ccptr1 = colptr + (i+range) * outerwd;
-        int* ccptr2 = colptr + (i-rangep1) * outerwd;
-        state = *stateptr;
-        update_current_grid(state, *ccptr1 - *ccptr2);
-        *stateptr = state;
-        stateptr += outerwd;
-        if (state) {
-            if (i < miny) miny = i;
-            if (i > maxy) maxy = i;
-            colchanged = true;
-        }
-    }
-    if (colchanged) {
-        if (mincol < minx) minx = mincol;
-        if (mincol > maxx) maxx = mincol;
-    }
-    
-    rowchanged = false;
-    for (int i = minrow+1; i <= maxrow; i++) {
-        int* ipr = colcounts + (i+range) * outerwd;
-        int* imrm1 = colcounts + (i-rangep1) * outerwd;
-        stateptr = currgrid + i*outerwd + mincol+1;
-        for (j = mincol+1; j <= maxcol; j++) {
-            int jpr = j+range;
-            int jmrm1 = j-rangep1;
-            int* ccptr1 = ipr + jpr;
-            int* ccptr2 = imrm1 + jmrm1;
-            int* ccptr3 = ipr + jmrm1;
-            int* ccptr4 = imrm1 + jpr;
-            state = *stateptr;
-            update_current_grid(state, *ccptr1 + *ccptr2 - *ccptr3 - *ccptr4);
-            *stateptr++ = state;
-            if (state) {
-                if (j < minx) minx = j;
-                if (j > maxx) maxx = j;
-                rowchanged = true;
-            }
-        }
-        if (rowchanged) {
-            if (i < miny) miny = i;
-            if (i > maxy) maxy = i;
-            rowchanged = false;
-        }
+static LTLINLINE void countrow8(const unsigned char* cells, const int* prev, int* counts,
+                                int width, int multistate)
+{
+    // same as countrow1
+    int rowcount = 0;
+    int j = 0;
+    for ( ; j + 8 <= width; j += 8) {
+        unsigned long long w;
+        memcpy(&w, cells + j, 8);
+        if (multistate) w = onebytes(w);
+        ltlints v;
+        memcpy(&v, prev + j, sizeof(v));
+        v += rowcount;
+        if (w) {
+            // each byte of the product is the number of state-1 cells up to that byte
+            w *= LOWBYTES;
+            ltlbytes sums;
+            memcpy(&sums, &w, 8);
+            v += __builtin_convertvector(sums, ltlints);
+            rowcount += (int)(w >> 56);
+        }
+        memcpy(counts + j, &v, sizeof(v));
+    }
+    for ( ; j < width; j++) {
+        if (cells[j] == 1) rowcount++;
+        counts[j] = prev[j] + rowcount;
     }
 }
 
 // -----------------------------------------------------------------------------
 
-void ltlalgo::faster_Moore_unbounded2(int mincol, int minrow, int maxcol, int maxrow)
+static LTLINLINE int rulerow8(unsigned char* cells, const int* a, const int* b,
+                              int width, int span, const int* limits, int& lo, int& hi)
 {
-    // use Adam P. Goucher's algorithm to calculate Moore neighborhood counts
-    // in an unbounded universe; note that we can safely assume there is at least
-    // a 2*range border of dead cells surrounding the pattern
+    // same as rulerow1
+    int popdelta = 0;
+    lo = width;
+    hi = -1;
     
-    // temporarily expand the given limits
-    minrow -= range;
-    mincol -= range;
-    maxrow += range;
-    maxcol += range;
-    
-    int r2 = range * 2;
-    int minrowpr2 = minrow+r2;
-    int mincolpr2 = mincol+r2;
-    
-    // put zeros in top 2*range rows of colcounts
-    for (int i = minrow; i < minrowpr2; i++) {
-        int* ccptr = colcounts + i * outerwd + mincol;
-        for (int j = mincol; j <= maxcol; j++) {
-            *ccptr++ = 0;
-        }
-    }
+    // do the first cell
+    int state = cells[0];
+    int newstate = rule2(state, a[span-1] - b[span-1], limits);
+    cells[0] = (unsigned char)newstate;
+    popdelta += newstate - state;
+    if (newstate) lo = hi = 0;
+
+    const int* aspan = a + span - 1;
+    const int* bspan = b + span - 1;
+    int k = 1;
+    for ( ; k + 8 <= width; k += 8) {
+        ltlints ncount, t;
+        memcpy(&ncount, aspan + k, sizeof(ncount));
+        memcpy(&t, a + k - 1, sizeof(t));
+        ncount -= t;
+        memcpy(&t, bspan + k, sizeof(t));
+        ncount -= t;
+        memcpy(&t, b + k - 1, sizeof(t));
+        ncount += t;
+        ltlints born = (ncount >= limits[0]) & (ncount <= limits[1]);
+        ltlints survive = (ncount >= limits[2]) & (ncount <= limits[3]);
+        ltlmask bornmask = __builtin_convertvector(born, ltlmask);
+        ltlmask survivemask = __builtin_convertvector(survive, ltlmask);
+        unsigned long long w, bw, sw;
+        memcpy(&w, cells + k, 8);
+        memcpy(&bw, &bornmask, 8);
+        memcpy(&sw, &survivemask, 8);
+        unsigned long long alive = w * 255;
+        unsigned long long neww = ((bw & ~alive) | (sw & alive)) & LOWBYTES;
+        memcpy(cells + k, &neww, 8);
+        if (neww != w) popdelta += __builtin_popcountll(neww) - __builtin_popcountll(w);
+        if (neww) {
+            if (lo == width) lo = k + (__builtin_ctzll(neww) >> 3);
+            hi = k + ((63 - __builtin_clzll(neww)) >> 3);
+        }
+    }
+    for ( ; k < width; k++) {
+        state = cells[k];
+        newstate = rule2(state, aspan[k] - a[k-1] - bspan[k] + b[k-1], limits);
+        cells[k] = (unsigned char)newstate;
+        popdelta += newstate - state;
+        if (newstate) {
+            if (lo == width) lo = k;
+            hi = k;
+        }
+    }
+    return popdelta;
+}
 
-    // put zeros in left 2*range columns of colcounts
-    for (int j = mincol; j < mincolpr2; j++) {
-        int* ccptr = colcounts + minrowpr2 * outerwd + j;
-        for (int i = minrowpr2; i <= maxrow; i++) {
-            *ccptr = 0;
-            ccptr += outerwd;
-        }
-    }
+// -----------------------------------------------------------------------------
 
-    // calculate cumulative counts for each column and store in colcounts
+static void countrowvec(const unsigned char* cells, const int* prev, int* counts,
+                        int width, int multistate)
+{
+    countrow8(cells, prev, counts, width, multistate);
+}
 
-    unsigned char* cellptr = currgrid + minrowpr2 * outerwd + mincolpr2;
-    int* ccptr = colcounts + minrowpr2 * outerwd + mincolpr2;
-    int* prevptr = ccptr - outerwd;
-    int width = (maxcol - mincolpr2 + 1);
-    int nextrow = outerwd - width;
-    int rowcount = 0;
+static int rulerowvec(unsigned char* cells, const int* a, const int* b,
+                      int width, int span, const int* limits, int& lo, int& hi)
+{
+    return rulerow8(cells, a, b, width, span, limits, lo, hi);
+}
 
-    // compute 4 cell offset
-    int offset = (4 - ((g_uintptr_t)cellptr & 3)) & 3;
-    if (offset > width) offset = width;
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2")))
+static void countrowavx2(const unsigned char* cells, const int* prev, int* counts,
+                         int width, int multistate)
+{
+    countrow8(cells, prev, counts, width, multistate);
+}
 
-    // process in 4 cell chunks
-    int chunks = (width - offset) >> 2;
-    int remainder = (width - offset) - (chunks << 2);
-    int j = 0;
+__attribute__((target("avx2")))
+static int rulerowavx2(unsigned char* cells, const int* a, const int* b,
+                       int width, int span, const int* limits, int& lo, int& hi)
+{
+    return rulerow8(cells, a, b, width, span, limits, lo, hi);
+}
+#endif
 
-    // process cells in the first row
-
-    // process cells up to the first 4 cell chunk
-    for (j = 0; j < offset; j++) {
-        rowcount += *cellptr++;
-        *ccptr++ = rowcount;
-    }
-
-    // process any 4 cell chunks
-    unsigned int *lcellptr = (unsigned int*)cellptr;
-    for (j = 0; j < chunks; j++) {
-        if (*lcellptr++) {
-            rowcount += *cellptr++;
-            *ccptr++ = rowcount;
-            rowcount += *cellptr++;
-            *ccptr++ = rowcount;
-            rowcount += *cellptr++;
-            *ccptr++ = rowcount;
-            rowcount += *cellptr++;
-            *ccptr++ = rowcount;
-        } else {
-            *ccptr++ = rowcount;
-            *ccptr++ = rowcount;
-            *ccptr++ = rowcount;
-            *ccptr++ = rowcount;
-            cellptr += 4;
-        }
-    }
+#endif // LTLVECTORS
 
-    // process any remaining cells
-    for (j = 0; j < remainder; j++) {
-        rowcount += *cellptr++;
-        *ccptr++ = rowcount;
-    }
-    cellptr += nextrow;
-    ccptr += nextrow;
-    prevptr = ccptr - outerwd;
+// -----------------------------------------------------------------------------
 
-    // process the remaining rows of cells
+static void pick_kernels()
+{
+    if (ltlkernelname) return;
+    countrow = countrow1;
+    rulerow = rulerow1;
+    ltlkernelname = "scalar";
+#ifdef LTLVECTORS
+    countrow = countrowvec;
+    rulerow = rulerowvec;
+    ltlkernelname = "vector";
+    #if defined(__x86_64__) || defined(__i386__)
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            countrow = countrowavx2;
+            rulerow = rulerowavx2;
+            ltlkernelname = "AVX2";
+        }
+    #endif
+#endif
+}
 
-    for (int i = minrowpr2 + 1; i <= maxrow; i++) {
-        rowcount = 0;
+// -----------------------------------------------------------------------------
 
-        // compute 4 cell offset
-        offset = (4 - ((g_uintptr_t)cellptr & 3)) & 3;
-        if (offset > width) offset = width;
+void ltlalgo::faster_Moore(int mincol, int minrow, int maxcol, int maxrow)
+{
+    // use Adam P. Goucher's algorithm to calculate Moore neighborhood counts;
+    // note that currgrid is surrounded by a border that might contain live cells
+    // (the border is range+1 cells thick and the outermost cells are always dead),
+    // so the given region can be expanded by range
+    pick_kernels();
+    if ((int)zerocounts.size() < outerwd) zerocounts.assign(outerwd, 0);
+    int ccminrow = minrow - range;
+    int ccmaxrow = maxrow + range;
+    int ccmincol = mincol - range;
+    int ccmaxcol = maxcol + range;
+
+    // calculate cumulative counts for each column and store in colcounts;
+    // each band starts from zero...
+    int nbands = band_count(ccmaxrow - ccminrow + 1, ccmaxcol - ccmincol + 1);
+    run_bands(MOORE_COUNTS, nbands, ccminrow, ccmaxrow, ccmincol, ccmaxcol);
+    if (nbands > 1) {
+        // ...so add the final counts in the last row of each band to the next band;
+        // do the last rows here (in order) and then the other rows in parallel
+        int* ccgrid = colcounts + (currgrid - outergrid1);
+        int width = ccmaxcol - ccmincol + 1;
+        for (int i = 1; i < nbands; i++) {
+            int above = band_start(ccminrow, ccmaxrow, i, nbands) - 1;
+            int last = band_start(ccminrow, ccmaxrow, i + 1, nbands) - 1;
+            int* ccptr = ccgrid + last * outerwd + ccmincol;
+            int* carryptr = ccgrid + above * outerwd + ccmincol;
+            for (int j = 0; j < width; j++) ccptr[j] += carryptr[j];
+        }
+        run_bands(MOORE_CARRY, nbands, ccminrow, ccmaxrow, ccmincol, ccmaxcol, ccminrow);
+    }
 
-        // process in 4 cell chunks
-        chunks = (width - offset) >> 2;
-        remainder = (width - offset) - (chunks << 2);
+    // calculate final neighborhood counts using values in colcounts
+    // and update the corresponding cells in current grid
+    nbands = band_count(maxrow - minrow + 1, maxcol - mincol + 1);
+    run_bands(MOORE_ROWS, nbands, minrow, maxrow, mincol, maxcol, ccminrow);
+}
 
-        // process cells up to the first 4 cell chunk
-        for (j = 0; j < offset; j++) {
-            rowcount += *cellptr++;
-            *ccptr++ = *prevptr++ + rowcount;
-        }
-        lcellptr = (unsigned int*)cellptr;
-
-        // process any 4 cell chunks
-        for (j = 0; j < chunks; j++) {
-            // check if any of the cells are alive
-            if (*lcellptr++) {
-                rowcount += *cellptr++;
-                *ccptr++ = *prevptr++ + rowcount;
-                rowcount += *cellptr++;
-                *ccptr++ = *prevptr++ + rowcount;
-                rowcount += *cellptr++;
-                *ccptr++ = *prevptr++ + rowcount;
-                rowcount += *cellptr++;
-                *ccptr++ = *prevptr++ + rowcount;
-           } else {
-                *ccptr++ = *prevptr++ + rowcount;
-                *ccptr++ = *prevptr++ + rowcount;
-                *ccptr++ = *prevptr++ + rowcount;
-                *ccptr++ = *prevptr++ + rowcount;
-                cellptr += 4;
-            }
-        }
+// -----------------------------------------------------------------------------
 
-        // process any remaining cells
-        for (j = 0; j < remainder; j++) {
-            rowcount += *cellptr++;
-            *ccptr++ = *prevptr++ + rowcount;
-        }
-        // next row
-        cellptr += nextrow;
-        ccptr += nextrow;
-        prevptr += nextrow;
+void ltlalgo::Moore_counts(ltlband &band)
+{
+    // calculate cumulative counts for the rows in this band, starting from zero
+    int* ccgrid = colcounts + (currgrid - outergrid1);
+    int width = band.maxcol - band.mincol + 1;
+    const int* prevptr = &zerocounts[0];
+    for (int i = band.minrow; i <= band.maxrow; i++) {
+        int* ccptr = ccgrid + i * outerwd + band.mincol;
+        countrow(currgrid + i * outerwd + band.mincol, prevptr, ccptr, width, maxCellStates > 2);
+        prevptr = ccptr;
     }
+}
 
-    // restore given limits
-    minrow += range;
-    mincol += range;
-    maxrow -= range;
-    maxcol -= range;
+// -----------------------------------------------------------------------------
 
-    // calculate final neighborhood counts using values in colcounts
-    // and update the corresponding cells in current grid
-    
-    int* colptr = colcounts + (minrow + range) * outerwd;
-    ccptr = colptr + mincol + range;
-    unsigned char* stateptr = currgrid + minrow*outerwd+mincol;
-    int ncount = *ccptr;
-    if (*stateptr == 0) {
-        if (ncount >= minB && ncount <= maxB) {
-            *stateptr = 1;
-            population++;
-            minx = mincol;
-            maxx = mincol;
-            miny = minrow;
-            maxy = minrow;
-        }
-    } else {
-        if (ncount < minS || ncount > maxS) {
-            *stateptr = 0;
-            population--;
-        }
-        else {
-            minx = mincol;
-            maxx = maxcol;
-            miny = minrow;
-            maxy = maxrow;
-        }
+void ltlalgo::Moore_carry(ltlband &band)
+{
+    // add the final counts in the row above this band to all but its last row
+    // (band.rowoffset is the first row of the region so the first band is done)
+    if (band.minrow == band.rowoffset) return;
+    int* ccgrid = colcounts + (currgrid - outergrid1);
+    int width = band.maxcol - band.mincol + 1;
+    const int* carryptr = ccgrid + (band.minrow - 1) * outerwd + band.mincol;
+    for (int i = band.minrow; i < band.maxrow; i++) {
+        int* ccptr = ccgrid + i * outerwd + band.mincol;
+        for (int j = 0; j < width; j++) ccptr[j] += carryptr[j];
     }
+}
 
-    bool rowchanged = false;
-    int rangep1 = range + 1;
-    stateptr = currgrid + minrow*outerwd + mincol+1;
-    int* ccptr1 = colptr + (mincol+1 + range);
-    int* ccptr2 = colptr + (mincol+1 - rangep1);
-    for (j = mincol+1; j <= maxcol; j++) {
-        // do i == minrow
-        ncount = *ccptr1++ - *ccptr2++;
-        if (*stateptr == 0) {
-            if (ncount >= minB && ncount <= maxB) {
-                *stateptr = 1;
-                population++;
-                if (j < minx) minx = j;
-                if (j > maxx) maxx = j;
-                rowchanged = true;
-            }
-        } else {
-            if (ncount < minS || ncount > maxS) {
-                *stateptr = 0;
-                population--;
-            }
-            else {
-                if (j < minx) minx = j;
-                if (j > maxx) maxx = j;
-                rowchanged = true;
-            }
-        }
-        stateptr++;
-    }
-    if (rowchanged) {
-        if (minrow < miny) miny = minrow;
-        if (minrow > maxy) maxy = minrow;
-    }
-
-    bool colchanged = false;
-    colptr = colcounts + mincol + range;
-    stateptr = currgrid + (minrow+1)*outerwd + mincol;
-    ccptr1 = colptr + (minrow+1+range) * outerwd;
-    ccptr2 = colptr + (minrow+1-rangep1) * outerwd;
-    for (int i = minrow+1; i <= maxrow; i++) {
-        // do j == mincol
-        ncount = *ccptr1 - *ccptr2;
-        if (*stateptr == 0) {
-            if (ncount >= minB && ncount <= maxB) {
-                *stateptr = 1;
-                population++;
-                if (i < miny) miny = i;
-                if (i > maxy) maxy = i;
-                colchanged = true;
-            }
+// -----------------------------------------------------------------------------
+
+void ltlalgo::Moore_rows(ltlband &band)
+{
+    // the count for x,y is the total in the square from x-range,y-range to
+    // x+range,y+range, found from the cumulative counts at its corners
+    // (band.rowoffset is the first row of the counts; those above it are zero)
+    int* ccgrid = colcounts + (currgrid - outergrid1);
+    int span = 2 * range + 1;
+    int width = band.maxcol - band.mincol + 1;
+    int limits[4] = { minB, maxB, minS, maxS };
+    ltlstats& stats = band.stats;
+    for (int y = band.minrow; y <= band.maxrow; y++) {
+        const int* a = ccgrid + (y + range) * outerwd + band.mincol - range;
+        const int* b = &zerocounts[0];
+        if (y - range - 1 >= band.rowoffset) b = ccgrid + (y - range - 1) * outerwd + band.mincol - range;
+        unsigned char* cells = currgrid + y * outerwd + band.mincol;
+        int lo, hi;
+        if (maxCellStates == 2) {
+            stats.popdelta += rulerow(cells, a, b, width, span, limits, lo, hi);
         } else {
-            if (ncount < minS || ncount > maxS) {
-                *stateptr = 0;
-                population--;
-            }
-            else {
-                if (i < miny) miny = i;
-                if (i > maxy) maxy = i;
-                colchanged = true;
-            }
-        }
-        stateptr += outerwd;
-        ccptr1 += outerwd;
-        ccptr2 += outerwd;
-    }
-    if (colchanged) {
-        if (mincol < minx) minx = mincol;
-        if (mincol > maxx) maxx = mincol;
-    }
-    
-    rowchanged = false;
-    for (int i = minrow+1; i <= maxrow; i++) {
-        int* ipr = colcounts + (i+range) * outerwd;
-        int* imrm1 = colcounts + (i-rangep1) * outerwd;
-        int jpr = mincol+1+range;
-        int jmrm1 = mincol+1-rangep1;
-        ccptr1 = ipr + jpr;
-        ccptr2 = imrm1 + jmrm1;
-        int* ccptr3 = ipr + jmrm1;
-        int* ccptr4 = imrm1 + jpr;
-        stateptr = currgrid + i*outerwd + mincol+1;
-        for (j = mincol+1; j <= maxcol; j++) {
-            ncount = *ccptr1++ + *ccptr2++ - *ccptr3++ - *ccptr4++;
-            if (*stateptr == 0) {
-                if (ncount >= minB && ncount <= maxB) {
-                    *stateptr = 1;
-                    population++;
-                    if (j < minx) minx = j;
-                    if (j > maxx) maxx = j;
-                    rowchanged = true;
-                }
-            } else {
-                if (ncount < minS || ncount > maxS) {
-                    *stateptr = 0;
-                    population--;
-                }
-                else {
-                    if (j < minx) minx = j;
-                    if (j > maxx) maxx = j;
-                    rowchanged = true;
+            lo = width;
+            hi = -1;
+            for (int k = 0; k < width; k++) {
+                int ncount = a[k+span-1] - b[k+span-1];
+                if (k > 0) ncount += b[k-1] - a[k-1];
+                update_current_grid(cells[k], ncount, stats);
+                if (cells[k]) {
+                    if (lo == width) lo = k;
+                    hi = k;
                 }
             }
-            stateptr++;
         }
-        if (rowchanged) {
-            if (i < miny) miny = i;
-            if (i > maxy) maxy = i;
-            rowchanged = false;
+        if (lo <= hi) {
+            if (band.mincol + lo < stats.minx) stats.minx = band.mincol + lo;
+            if (band.mincol + hi > stats.maxx) stats.maxx = band.mincol + hi;
+            if (y < stats.miny) stats.miny = y;
+            if (y > stats.maxy) stats.maxy = y;
         }
     }
-    if (population == 0) empty_boundaries();
 }
 
 // -----------------------------------------------------------------------------
 
-void ltlalgo::fast_Moore(int mincol, int minrow, int maxcol, int maxrow)
+void ltlalgo::fast_Moore(int mincol, int minrow, int maxcol, int maxrow, ltlstats &stats)
 {
     if (range == 1) {
         for (int y = minrow; y <= maxrow; y++) {
@@ -1393,7 +1040,7 @@ void ltlalgo::fast_Moore(int mincol, int minrow, int maxcol, int maxrow)
                 if (*cellptr++ == 1) ncount++;
                 if (*cellptr++ == 1) ncount++;
                 if (*cellptr   == 1) ncount++;
-                update_next_grid(x, y, yoffset+x, ncount);
+                update_next_grid(x, y, yoffset+x, ncount, stats);
             }
         }
     } else {
@@ -1432,7 +1079,7 @@ void ltlalgo::fast_Moore(int mincol, int minrow, int maxcol, int maxrow)
             //   | | | | | | | |
             //   ---------------
             
-            update_next_grid(mincol, y, yoffset+mincol, ncount);
+            update_next_grid(mincol, y, yoffset+mincol, ncount, stats);
             
             // for the remaining cells in this row we only need to update
             // the count in the right column of the new neighborhood
@@ -1454,7 +1101,7 @@ void ltlalgo::fast_Moore(int mincol, int minrow, int maxcol, int maxrow)
                 }
                 colcount[rightcol] = rcount;
                 
-                update_next_grid(x, y, yoffset+x, ncount);
+                update_next_grid(x, y, yoffset+x, ncount, stats);
             }
         }
     
@@ -1463,7 +1110,7 @@ void ltlalgo::fast_Moore(int mincol, int minrow, int maxcol, int maxrow)
 
 // -----------------------------------------------------------------------------
 
-void ltlalgo::fast_Shaped(int mincol, int minrow, int maxcol, int maxrow)
+void ltlalgo::fast_Shaped(int mincol, int minrow, int maxcol, int maxrow, ltlstats &stats)
 {
      for (int y = minrow; y <= maxrow; y++) {
          int yoffset = y * outerwd;
@@ -1481,7 +1128,7 @@ void ltlalgo::fast_Shaped(int mincol, int minrow, int maxcol, int maxrow)
                  if (cellptr[i] == 1) ncount++ ;
          }
             
-         update_next_grid(mincol, y, yoffset+mincol, ncount);
+         update_next_grid(mincol, y, yoffset+mincol, ncount, stats);
          
          // for the remaining cells in this row we only need subtract
          // points in relevant rows and add points in other relevant
@@ -1497,7 +1144,7 @@ void ltlalgo::fast_Shaped(int mincol, int minrow, int maxcol, int maxrow)
                 if (cp[xprange] == 1)
                    ncount++ ;
              }
-             update_next_grid(x, y, yoffset+x, ncount);
+             update_next_grid(x, y, yoffset+x, ncount, stats);
          }
      }
 }
@@ -1548,7 +1195,7 @@ int ltlalgo::getcount(int i, int j)
 
 // -----------------------------------------------------------------------------
 
-void ltlalgo::faster_Neumann_bounded(int mincol, int minrow, int maxcol, int maxrow)
+void ltlalgo::faster_Neumann(int mincol, int minrow, int maxcol, int maxrow)
 {
     // use Dean Hickerson's algorithm (based on Adam P. Goucher's algorithm for the
     // Moore neighborhood) to calculate extended von Neumann neighborhood counts
@@ -1592,97 +1239,46 @@ void ltlalgo::faster_Neumann_bounded(int mincol, int minrow, int maxcol, int max
     mincol -= border;
 
     // calculate final neighborhood counts and update the corresponding cells in the grid
-    bool rowchanged = false;
-    for (int i = range; i < nrows-range; i++) {
-        int im1 = i - 1;
-        int ipr = i + range;
-        int iprm1 = ipr - 1;
-        int imrm1 = i - range - 1;
-        int imrm2 = imrm1 - 1;
-        int ipminrow = i + minrow;
-        unsigned char* stateptr = currgrid + ipminrow*outerwd + range + mincol;
-        for (int j = range; j < ncols-range; j++) {
-            int jpr = j + range;
-            int jmr = j - range;
-            int n = getcount(ipr,j)   - getcount(im1,jpr+1) - getcount(im1,jmr-1) + getcount(imrm2,j) +
-                    getcount(iprm1,j) - getcount(im1,jpr)   - getcount(im1,jmr)   + getcount(imrm1,j);
-            unsigned char state = *stateptr;
-            update_current_grid(state, n);
-            *stateptr++ = state;
-            if (state) {
-                int jpmincol = j + mincol;
-                if (jpmincol < minx) minx = jpmincol;
-                if (jpmincol > maxx) maxx = jpmincol;
-                rowchanged = true;
-            }
-        }
-        if (rowchanged) {
-            if (ipminrow < miny) miny = ipminrow;
-            if (ipminrow > maxy) maxy = ipminrow;
-            rowchanged = false;
-        }
-    }
+    int nbands = band_count(nrows - 2*range, ncols - 2*range);
+    run_bands(NEUMANN_ROWS, nbands, range, nrows-range-1, range, ncols-range-1, minrow, mincol);
 }
 
 // -----------------------------------------------------------------------------
 
-void ltlalgo::faster_Neumann_unbounded(int mincol, int minrow, int maxcol, int maxrow)
+void ltlalgo::Neumann_rows(ltlband &band)
 {
-    // use Dean Hickerson's algorithm (based on Adam P. Goucher's algorithm for the
-    // Moore neighborhood) to calculate extended von Neumann neighborhood counts
-    // in an unbounded universe; note that we can safely assume there is at least
-    // a 2*range border of dead cells surrounding the pattern
-    
-    // set variables used below and in getcount
-    nrows = maxrow - minrow + 1;
-    ncols = maxcol - mincol + 1;
-    ccht = nrows + (ncols-1)/2;
-    halfccwd = ncols/2;
-
-    // calculate cumulative counts in top left corner of colcounts
-    for (int i = 0; i < ccht; i++) {
-        int* Coffset = colcounts + i * outerwd;
-        unsigned char* Goffset = outergrid1 + (i + minrow) * outerwd;
-        int im1 = i - 1;
-        int im2 = im1 - 1;
-        for (int j = 0; j < ncols; j++) {
-            int* Cij = Coffset + j;
-            *Cij = getcount(im1,j-1) + getcount(im1,j+1) - getcount(im2,j);
-            if (i < nrows) {
-                unsigned char* Gij = Goffset + j + mincol;
-                if (*Gij == 1) *Cij += *Gij;
-            }
-        }
-    }
-
-    // calculate final neighborhood counts and update the corresponding cells in the grid
+    // calculate final neighborhood counts for rows minrow..maxrow and columns
+    // mincol..maxcol of the region used by getcount, and update the corresponding
+    // cells in the grid (band.rowoffset and band.coloffset give the grid position
+    // of the region's top left corner)
+    ltlstats& stats = band.stats;
     bool rowchanged = false;
-    for (int i = 0; i < nrows; i++) {
+    for (int i = band.minrow; i <= band.maxrow; i++) {
         int im1 = i - 1;
         int ipr = i + range;
         int iprm1 = ipr - 1;
         int imrm1 = i - range - 1;
         int imrm2 = imrm1 - 1;
-        int ipminrow = i + minrow;
-        unsigned char* stateptr = currgrid + ipminrow*outerwd + mincol;
-        for (int j = 0; j < ncols; j++) {
+        int ipminrow = i + band.rowoffset;
+        unsigned char* stateptr = currgrid + ipminrow*outerwd + band.mincol + band.coloffset;
+        for (int j = band.mincol; j <= band.maxcol; j++) {
             int jpr = j + range;
             int jmr = j - range;
             int n = getcount(ipr,j)   - getcount(im1,jpr+1) - getcount(im1,jmr-1) + getcount(imrm2,j) +
                     getcount(iprm1,j) - getcount(im1,jpr)   - getcount(im1,jmr)   + getcount(imrm1,j);
             unsigned char state = *stateptr;
-            update_current_grid(state, n);
+            update_current_grid(state, n, stats);
             *stateptr++ = state;
             if (state) {
-                int jpmincol = j + mincol;
-                if (jpmincol < minx) minx = jpmincol;
-                if (jpmincol > maxx) maxx = jpmincol;
+                int jpmincol = j + band.coloffset;
+                if (jpmincol < stats.minx) stats.minx = jpmincol;
+                if (jpmincol > stats.maxx) stats.maxx = jpmincol;
                 rowchanged = true;
             }
         }
         if (rowchanged) {
-            if (ipminrow < miny) miny = ipminrow;
-            if (ipminrow > maxy) maxy = ipminrow;
+            if (ipminrow < stats.miny) stats.miny = ipminrow;
+            if (ipminrow > stats.maxy) stats.maxy = ipminrow;
             rowchanged = false;
         }
     }
@@ -1690,7 +1286,7 @@ void ltlalgo::faster_Neumann_unbounded(int mincol, int minrow, int maxcol, int m
 
 // -----------------------------------------------------------------------------
 
-void ltlalgo::fast_Neumann(int mincol, int minrow, int maxcol, int maxrow)
+void ltlalgo::fast_Neumann(int mincol, int minrow, int maxcol, int maxrow, ltlstats &stats)
 {
     if (range == 1) {
         int outerwd2 = outerwd * 2;
@@ -1710,7 +1306,7 @@ void ltlalgo::fast_Neumann(int mincol, int minrow, int maxcol, int maxrow)
                 if (*--cellptr == 1) ncount++;
                 cellptr += outerwd2;
                 if (*cellptr   == 1) ncount++;
-                update_next_grid(x, y, yoffset+x, ncount);
+                update_next_grid(x, y, yoffset+x, ncount, stats);
             }
         }
     } else {
@@ -1745,7 +1341,7 @@ void ltlalgo::fast_Neumann(int mincol, int minrow, int maxcol, int maxrow)
                     xoffset--;          // range-1, ..., 2, 1, 0
                     rowptr += outerwd;
                 }
-                update_next_grid(x, y, yoffset+x, ncount);
+                update_next_grid(x, y, yoffset+x, ncount, stats);
             }
         }
     }
@@ -1753,6 +1349,31 @@ void ltlalgo::fast_Neumann(int mincol, int minrow, int maxcol, int maxrow)
 
 // -----------------------------------------------------------------------------
 
+void ltlalgo::do_region_gen(int mincol, int minrow, int maxcol, int maxrow)
+{
+    // reset minx,miny,maxx,maxy for first birth or survivor in nextgrid
+    empty_boundaries();
+    
+    int nbands = band_count(maxrow - minrow + 1, maxcol - mincol + 1);
+    if (ntype == 'M') {
+        if (colcounts) {
+            faster_Moore(mincol, minrow, maxcol, maxrow);
+        } else {
+            run_bands(FAST_MOORE, nbands, minrow, maxrow, mincol, maxcol);
+        }
+    } else if (ntype == 'N') {
+        if (colcounts) {
+            faster_Neumann(mincol, minrow, maxcol, maxrow);
+        } else {
+            run_bands(FAST_NEUMANN, nbands, minrow, maxrow, mincol, maxcol);
+        }
+    } else {
+        run_bands(FAST_SHAPED, nbands, minrow, maxrow, mincol, maxcol);
+    }
+}
+
+// -----------------------------------------------------------------------------
+
 void ltlalgo::do_bounded_gen()
 {
     // limit processing to rectangle where births/deaths can occur
@@ -1911,29 +1532,8 @@ void ltlalgo::do_bounded_gen()
         }
     }
     
-    // reset minx,miny,maxx,maxy for first birth or survivor in nextgrid
-    empty_boundaries();
-    
     // create next generation
-    if (ntype == 'M') {
-        if (colcounts) {
-            if (maxCellStates == 2) {
-                faster_Moore_bounded2(mincol, minrow, maxcol, maxrow);
-            } else {
-                faster_Moore_bounded(mincol, minrow, maxcol, maxrow);
-            }
-        } else {
-            fast_Moore(mincol, minrow, maxcol, maxrow);
-        }
-    } else if (ntype == 'N') {
-        if (colcounts) {
-            faster_Neumann_bounded(mincol, minrow, maxcol, maxrow);
-        } else {
-            fast_Neumann(mincol, minrow, maxcol, maxrow);
-        }
-    } else {
-        fast_Shaped(mincol, minrow, maxcol, maxrow);
-    }
+    do_region_gen(mincol, minrow, maxcol, maxrow);
 
     // if using one grid with a torus then clear border cells copied above
     if (colcounts && torus) {
@@ -2026,61 +1626,305 @@ void ltlalgo::do_bounded_gen()
 
 // -----------------------------------------------------------------------------
 
+// The unbounded universe is stored in square tiles of tilesize*tilesize cells,
+// and only tiles containing live cells are kept in the tiles map.  Because
+// range is never more than tilesize, the next generation of a tile depends only
+// on that tile and its 8 neighbors.  Each tile is calculated in a "window",
+// a small bounded universe (with the same rule) that is big enough to hold the
+// tile plus a border of range cells copied from the neighboring tiles, so all
+// the bounded code (and its use of multiple threads) is reused.
+
+struct ltltiletask : public lifetask {
+    ltlalgo* algo;
+    int tx, ty;                 // tile coordinates
+    ltltile tile;               // the tile's next generation
+    virtual void run() { algo->tiled_gen(*this); }
+};
+
+// -----------------------------------------------------------------------------
+
+static int tile_size(int range)
+{
+    // return a power of 2 that is at least 8 times range (so the halo copied
+    // from neighboring tiles is a small part of each window) but not too big
+    int size = 128;
+    while (size < 8 * range && size < 2048) size *= 2;
+    return size;
+}
+
+// -----------------------------------------------------------------------------
+
+ltltile* ltlalgo::find_tile(int tx, int ty)
+{
+    // return the given tile, or NULL if it doesn't exist (ie. it's empty)
+    std::map< std::pair<int,int>, ltltile >::iterator it = tiles.find(std::make_pair(ty, tx));
+    if (it == tiles.end()) return NULL;
+    return &it->second;
+}
+
+// -----------------------------------------------------------------------------
+
+ltltile& ltlalgo::get_tile(int tx, int ty)
+{
+    // return the given tile, creating an empty one if necessary
+    ltltile& tile = tiles[std::make_pair(ty, tx)];
+    if (tile.cells == NULL) {
+        tile.cells = new_tile_cells();
+        tile.population = 0;
+        tile.minx = INT_MAX;
+        tile.miny = INT_MAX;
+        tile.maxx = INT_MIN;
+        tile.maxy = INT_MIN;
+    }
+    return tile;
+}
+
+// -----------------------------------------------------------------------------
+
+unsigned char* ltlalgo::new_tile_cells()
+{
+    // return tilesize*tilesize dead cells, from the pool if possible
+    if (!freetiles.empty()) {
+        unsigned char* cells = freetiles.back();
+        freetiles.pop_back();
+        return cells;
+    }
+    unsigned char* cells = (unsigned char*) calloc(tilesize * tilesize, sizeof(unsigned char));
+    if (cells == NULL) lifefatal("Not enough memory for LtL tiles!");
+    return cells;
+}
+
+// -----------------------------------------------------------------------------
+
+void ltlalgo::clear_tiles()
+{
+    // free all tiles, including those in the pool
+    std::map< std::pair<int,int>, ltltile >::iterator it;
+    for (it = tiles.begin(); it != tiles.end(); it++) free(it->second.cells);
+    tiles.clear();
+    for (size_t i = 0; i < freetiles.size(); i++) free(freetiles[i]);
+    freetiles.clear();
+}
+
+// -----------------------------------------------------------------------------
+
+void ltlalgo::tile_edges(ltltile& tile)
+{
+    // shrink the tile's boundary to fit its live cells (it might not be
+    // minimal if the user deleted some cells)
+    int newminx = INT_MAX, newminy = INT_MAX, newmaxx = INT_MIN, newmaxy = INT_MIN;
+    for (int y = tile.miny; y <= tile.maxy; y++) {
+        unsigned char* row = tile.cells + y * tilesize;
+        for (int x = tile.minx; x <= tile.maxx; x++) {
+            if (row[x]) {
+                if (x < newminx) newminx = x;
+                if (x > newmaxx) newmaxx = x;
+                if (y < newminy) newminy = y;
+                newmaxy = y;
+            }
+        }
+    }
+    tile.minx = newminx;
+    tile.miny = newminy;
+    tile.maxx = newmaxx;
+    tile.maxy = newmaxy;
+}
+
+// -----------------------------------------------------------------------------
+
+ltlalgo* ltlalgo::get_window()
+{
+    // return an idle window, creating a new one if necessary
+    {
+        std::lock_guard<std::mutex> lock(windowlock);
+        if (!windows.empty()) {
+            ltlalgo* window = windows.back();
+            windows.pop_back();
+            return window;
+        }
+    }
+    int wd = tilesize + 2 * range;
+    char rule[MAXRULESIZE + 32];
+    sprintf(rule, "%s:P%d,%d", canonrule, wd, wd);
+    ltlalgo* window = new ltlalgo();
+    const char* err = window->setrule(rule);
+    if (err) lifefatal(err);
+    return window;
+}
+
+// -----------------------------------------------------------------------------
+
+void ltlalgo::put_window(ltlalgo* window)
+{
+    std::lock_guard<std::mutex> lock(windowlock);
+    windows.push_back(window);
+}
+
+// -----------------------------------------------------------------------------
+
+void ltlalgo::free_windows()
+{
+    // windows use the current rule so they must be deleted when it changes
+    for (size_t i = 0; i < windows.size(); i++) delete windows[i];
+    windows.clear();
+}
+
+// -----------------------------------------------------------------------------
+
+void ltlalgo::tiled_gen(ltltiletask &task)
+{
+    // calculate the next generation of the given tile in a window
+    ltlalgo* window = get_window();
+    int S = tilesize;
+    int wd = S + 2 * range;
+    int pop = 0;
+    int wminx = INT_MAX, wminy = INT_MAX, wmaxx = INT_MIN, wmaxy = INT_MIN;
+    
+    // copy the live cells of the tile and its neighbors into the window;
+    // the tile's cell 0,0 is at window cell range,range
+    for (int dy = -1; dy <= 1; dy++) {
+        for (int dx = -1; dx <= 1; dx++) {
+            ltltile* tile = find_tile(task.tx + dx, task.ty + dy);
+            if (tile == NULL) continue;
+            int xoff = range + dx * S;
+            int yoff = range + dy * S;
+            int x0 = tile->minx + xoff < 0 ? -xoff : tile->minx;
+            int y0 = tile->miny + yoff < 0 ? -yoff : tile->miny;
+            int x1 = tile->maxx + xoff >= wd ? wd - 1 - xoff : tile->maxx;
+            int y1 = tile->maxy + yoff >= wd ? wd - 1 - yoff : tile->maxy;
+            if (x0 > x1 || y0 > y1) continue;
+            int numcols = x1 - x0 + 1;
+            for (int y = y0; y <= y1; y++) {
+                memcpy(window->currgrid + (y + yoff) * window->outerwd + x0 + xoff,
+                       tile->cells + y * S + x0, numcols);
+            }
+            pop += tile->population;
+            if (x0 + xoff < wminx) wminx = x0 + xoff;
+            if (x1 + xoff > wmaxx) wmaxx = x1 + xoff;
+            if (y0 + yoff < wminy) wminy = y0 + yoff;
+            if (y1 + yoff > wmaxy) wmaxy = y1 + yoff;
+        }
+    }
+    ltltile* oldtile = find_tile(task.tx, task.ty);
+    int oldpop = oldtile ? oldtile->population : 0;
+    
+    // births and deaths can only occur within range of the loaded cells, and only
+    // those in the tile are needed; the window's population starts as an upper
+    // bound on the number of loaded cells (so it can't wrongly drop to 0) and
+    // then changes by the tile's births and deaths
+    int mincol = wminx - range < range ? range : wminx - range;
+    int minrow = wminy - range < range ? range : wminy - range;
+    int maxcol = wmaxx + range >= range + S ? range + S - 1 : wmaxx + range;
+    int maxrow = wmaxy + range >= range + S ? range + S - 1 : wmaxy + range;
+    window->population = pop;
+    if (mincol <= maxcol && minrow <= maxrow) window->do_region_gen(mincol, minrow, maxcol, maxrow);
+    
+    // the window's boundary now surrounds the live cells in the tile,
+    // so copy them into the new tile
+    ltltile& newtile = task.tile;
+    newtile.population = oldpop + window->population - pop;
+    if (newtile.population > 0) {
+        newtile.minx = window->minx - range;
+        newtile.miny = window->miny - range;
+        newtile.maxx = window->maxx - range;
+        newtile.maxy = window->maxy - range;
+        unsigned char* grid = window->outergrid2 ? window->nextgrid : window->currgrid;
+        int numcols = newtile.maxx - newtile.minx + 1;
+        for (int y = window->miny; y <= window->maxy; y++) {
+            memcpy(newtile.cells + (y - range) * S + newtile.minx,
+                   grid + y * window->outerwd + window->minx, numcols);
+        }
+    }
+    
+    // kill all the loaded cells and the cells that might have been born
+    int x0 = wminx < mincol ? wminx : mincol;
+    int y0 = wminy < minrow ? wminy : minrow;
+    int x1 = wmaxx > maxcol ? wmaxx : maxcol;
+    int y1 = wmaxy > maxrow ? wmaxy : maxrow;
+    for (int y = y0; y <= y1; y++) {
+        memset(window->currgrid + y * window->outerwd + x0, 0, x1 - x0 + 1);
+        if (window->outergrid2) memset(window->nextgrid + y * window->outerwd + x0, 0, x1 - x0 + 1);
+    }
+    window->population = 0;
+    window->empty_boundaries();
+    put_window(window);
+}
+
+// -----------------------------------------------------------------------------
+
 bool ltlalgo::do_unbounded_gen()
 {
-    int mincol = minx - range;
-    int minrow = miny - range;
-    int maxcol = maxx + range;
-    int maxrow = maxy + range;
-
-    if (mincol < range || maxcol > gwdm1-range || minrow < range || maxrow > ghtm1-range) {
-        // pattern boundary is too close to a grid edge so expand the universe in that
-        // direction, and possibly shrink the universe in the opposite direction        
-        int inc = MAXRANGE * 2;
-        int up    = minrow < range       ? inc : 0;
-        int down  = maxrow > ghtm1-range ? inc : 0;
-        int left  = mincol < range       ? inc : 0;
-        int right = maxcol > gwdm1-range ? inc : 0;
-        
-        // check for possible shrinkage (pattern might be a spaceship)
-        if (up > 0    && down == 0  && maxrow < ghtm1-range) down  = -(ghtm1-maxrow-range);
-        if (down > 0  && up == 0    && minrow > range)       up    = -(minrow-range);
-        if (left > 0  && right == 0 && maxcol < gwdm1-range) right = -(gwdm1-maxcol-range);
-        if (right > 0 && left == 0  && mincol > range)       left  = -(mincol-range);
+    int S = tilesize;
+    
+    // find the tiles that might contain live cells in the next generation:
+    // the live tiles and any neighbors within range of their live cells
+    vector< std::pair<int,int> > keys;
+    std::map< std::pair<int,int>, ltltile >::iterator it;
+    for (it = tiles.begin(); it != tiles.end(); it++) {
+        int ty = it->first.first;
+        int tx = it->first.second;
+        ltltile& tile = it->second;
         
-        const char* errmsg = resize_grids(up, down, left, right);
-        if (errmsg) {
-            lifewarning(errmsg);    // no need to check show_warning here
-            return false;           // stop generating
+        // stop generating if the pattern is about to grow beyond the editing limits
+        int left = tx * S + tile.minx - range;
+        int top = ty * S + tile.miny - range;
+        int right = tx * S + tile.maxx + range;
+        int bottom = ty * S + tile.maxy + range;
+        if (left < -CELLLIMIT || top < -CELLLIMIT || right > CELLLIMIT || bottom > CELLLIMIT) {
+            lifewarning("Sorry, but the pattern can't grow beyond the editing limits.");
+            return false;
         }
         
-        mincol = minx - range;
-        minrow = miny - range;
-        maxcol = maxx + range;
-        maxrow = maxy + range;
-    }
-        
-    // reset minx,miny,maxx,maxy for first birth or survivor in nextgrid
-    empty_boundaries();
-
-    if (ntype == 'M') {
-        if (colcounts) {
-            if (maxCellStates == 2) {
-                faster_Moore_unbounded2(mincol, minrow, maxcol, maxrow);
-            } else {
-                faster_Moore_unbounded(mincol, minrow, maxcol, maxrow);
+        int mindy = tile.miny < range ? -1 : 0;
+        int maxdy = tile.maxy + range >= S ? 1 : 0;
+        int mindx = tile.minx < range ? -1 : 0;
+        int maxdx = tile.maxx + range >= S ? 1 : 0;
+        for (int dy = mindy; dy <= maxdy; dy++) {
+            for (int dx = mindx; dx <= maxdx; dx++) {
+                keys.push_back(std::make_pair(ty + dy, tx + dx));
             }
-        } else {
-            fast_Moore(mincol, minrow, maxcol, maxrow);
         }
-    } else if (ntype == 'N') {
-        if (colcounts) {
-            faster_Neumann_unbounded(mincol, minrow, maxcol, maxrow);
+    }
+    std::sort(keys.begin(), keys.end());
+    keys.erase(std::unique(keys.begin(), keys.end()), keys.end());
+    
+    // calculate the new tiles, in parallel if possible
+    int ntasks = (int)keys.size();
+    vector<ltltiletask> tasks(ntasks);
+    vector<lifetask*> taskptrs(ntasks);
+    for (int i = 0; i < ntasks; i++) {
+        tasks[i].algo = this;
+        tasks[i].ty = keys[i].first;
+        tasks[i].tx = keys[i].second;
+        tasks[i].tile.cells = new_tile_cells();
+        taskptrs[i] = &tasks[i];
+    }
+    pick_kernels();     // before any windows use them
+    if (ntasks == 1 || lifethreads::getthreadcount() == 1) {
+        for (int i = 0; i < ntasks; i++) tiled_gen(tasks[i]);
+    } else {
+        lifethreads::runtasks(&taskptrs[0], ntasks);
+    }
+    
+    // replace the old tiles with the non-empty new ones
+    for (it = tiles.begin(); it != tiles.end(); it++) recycle_tile(it->second, S, freetiles);
+    tiles.clear();
+    population = 0;
+    for (int i = 0; i < ntasks; i++) {
+        ltltile& tile = tasks[i].tile;
+        if (tile.population > 0) {
+            tiles.insert(tiles.end(), std::make_pair(keys[i], tile));
+            population += tile.population;
         } else {
-            fast_Neumann(mincol, minrow, maxcol, maxrow);
+            freetiles.push_back(tile.cells);
         }
-    } else {
-        fast_Shaped(mincol, minrow, maxcol, maxrow);
+    }
+    
+    // don't let the pool get much bigger than the pattern
+    size_t maxfree = tiles.size() + 16;
+    while (freetiles.size() > maxfree) {
+        free(freetiles.back());
+        freetiles.pop_back();
     }
     return true;
 }
@@ -2099,7 +1943,7 @@ void ltlalgo::step()
             // calculate the next generation in nextgrid
             if (unbounded) {
                 if (!do_unbounded_gen()) {
-                    // failed to resize universe so stop generating
+                    // pattern reached the editing limits so stop generating
                     poller->setInterrupted();
                     return;
                 }
@@ -2138,6 +1982,25 @@ void ltlalgo::step()
 
 void ltlalgo::save_cells()
 {
+    if (unbounded) {
+        std::map< std::pair<int,int>, ltltile >::iterator it;
+        for (it = tiles.begin(); it != tiles.end(); it++) {
+            ltltile& tile = it->second;
+            int top = it->first.first * tilesize;
+            int left = it->first.second * tilesize;
+            for (int y = tile.miny; y <= tile.maxy; y++) {
+                unsigned char* row = tile.cells + y * tilesize;
+                for (int x = tile.minx; x <= tile.maxx; x++) {
+                    if (row[x]) {
+                        cell_list.push_back(x + left);
+                        cell_list.push_back(y + top);
+                        cell_list.push_back(row[x]);
+                    }
+                }
+            }
+        }
+        return;
+    }
     for (int y = miny; y <= maxy; y++) {
         int yoffset = y * outerwd;
         for (int x = minx; x <= maxx; x++) {
@@ -2160,8 +2023,8 @@ void ltlalgo::restore_cells()
         int x = cell_list[i];
         int y = cell_list[i+1];
         int s = cell_list[i+2];
-        // check if x,y is outside grid
-        if (x < gleft || x > gright || y < gtop || y > gbottom) {
+        // check if x,y is outside bounded grid
+        if (!unbounded && (x < gleft || x > gright || y < gtop || y > gbottom)) {
             // store clipped cells so that GUI code (eg. ClearOutsideGrid)
             // can remember them in case this rule change is undone
             clipped_cells.push_back(x);
@@ -2300,12 +2163,10 @@ const char *ltlalgo::setrule(const char *s)
             if (population > 0) {
                 save_cells();       // store the current pattern in cell_list
             }
-            // free the current grids and allocate new ones
-            free(outergrid1);
-            if (outergrid2) {
-                free(outergrid2);
-                outergrid2 = NULL;
-            }
+            // free the current grids (or tiles) and allocate new grids
+            free_grids();
+            clear_tiles();
+            unbounded = false;
             create_grids(newwd, newht);
             if (cell_list.size() > 0) {
                 // restore the pattern (if the new grid is smaller then any live cells
@@ -2322,66 +2183,33 @@ const char *ltlalgo::setrule(const char *s)
         gridht = ght;
 
     } else {
-        // no suffix given so use an unbounded universe
-        unbounded = true;
-        
-        // set unbounded grid dimensions used by GUI code
-        gridwd = 0;
-        gridht = 0;
-        
-        // check if previous universe was bounded
-        if (gwd < outerwd) {
-            // we could call resize_grids(-border,-border,-border,-border)
-            // to remove the outer border but there's a (slight) danger
-            // the call will fail due to lack of memory, so safer to use
-            // the current grids and just shift the pattern position
+        // no suffix given so use an unbounded universe; if the old universe
+        // is bounded or its tile size is wrong for the new range then move
+        // the pattern into new tiles
+        int newsize = tile_size(range);
+        if (!unbounded || newsize != tilesize) {
             if (population > 0) {
-                // shift pattern boundaries
-                minx += border;
-                maxx += border;
-                miny += border;
-                maxy += border;
+                save_cells();       // store the current pattern in cell_list
+            }
+            clear_tiles();
+            free_grids();
+            unbounded = true;
+            tilesize = newsize;
+            logtilesize = 0;
+            while ((1 << logtilesize) < tilesize) logtilesize++;
+            population = 0;
+            if (cell_list.size() > 0) {
+                restore_cells();
             }
-            currgrid = outergrid1;
-            nextgrid = outergrid2;
-            gwd = outerwd;
-            ght = outerht;
-            // set grid coordinates of cell at bottom right corner of grid
-            gwdm1 = gwd - 1;
-            ghtm1 = ght - 1;
-            // adjust cell coordinates of grid edges
-            gtop -= border;
-            gleft -= border;
-            gbottom = gtop + ghtm1;
-            gright = gleft + gwdm1;
-            // set bigint versions of grid edges (used by GUI code)
-            gridtop = gtop;
-            gridleft = gleft;
-            gridbottom = gbottom;
-            gridright = gright;
-        }
-
-        // reallocate colcounts if ntype has changed
-        if (ntype != oldtype) {
-            allocate_colcounts();
         }
         
-        if (colcounts == NULL && outergrid2 == NULL) {
-            // this can happen if previous rule used NM and was unbounded,
-            // and new rule uses NN and is unbounded and range <= SMALL_NN_RANGE
-            outergrid2 = (unsigned char*) calloc(outerbytes, sizeof(unsigned char));
-            if (outergrid2 == NULL) lifefatal("Not enough memory for nextgrid!");
-            nextgrid = outergrid2;
-        }
-
-        if (colcounts && outergrid2) {
-            // faster_* calls don't use outergrid2, so we deallocate it and
-            // reset it to NULL (also necessary for test in step() loop)
-            free(outergrid2);
-            outergrid2 = NULL;
-            nextgrid = NULL;
-        }
+        // set unbounded grid dimensions used by GUI code
+        gridwd = 0;
+        gridht = 0;
     }
+    
+    // windows are created with the current rule when they're next needed
+    free_windows();
 
     // set the number of cell states
     if (scount > 2) {
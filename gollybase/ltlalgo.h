@@ -9,6 +9,25 @@
 #include "lifealgo.h"
 #include "liferules.h"  // for MAXRULESIZE
 #include <vector>
+#include <map>
+#include <mutex>
+
+// births, deaths and the bounding box of the live cells found while
+// processing some rows of the grid (see ltlband in ltlalgo.cpp)
+struct ltlstats {
+    int popdelta;                       // change in population
+    int minx, miny, maxx, maxy;         // boundary of live cells
+};
+struct ltlband;
+struct ltltiletask;
+
+// an unbounded universe is kept in square tiles, and only the tiles
+// containing live cells are stored
+struct ltltile {
+    unsigned char* cells;               // tilesize*tilesize cells
+    int population;                     // number of non-zero cells
+    int minx, miny, maxx, maxy;         // boundary of live cells (within the tile)
+};
 
 class ltlalgo : public lifealgo {
 public:
@@ -18,6 +37,8 @@ public:
     virtual int setcell(int x, int y, int newstate);
     virtual int getcell(int x, int y);
     virtual int nextcell(int x, int y, int& v);
+    virtual void getcellruns(int top, int left, int bottom, int right,
+                             vector<cellspan>& spans);
     virtual void endofpattern();
     virtual void setIncrement(bigint inc) { increment = inc; }
     virtual void setIncrement(int inc) { increment = inc; }
@@ -56,11 +77,11 @@ private:
     vector<int> cell_list;              // used by save_cells and restore_cells
     bool show_warning;                  // flag used to avoid multiple warning dialogs
     int* colcounts;                     // cumulative column counts of state-1 cells
+    vector<int> zerocounts;             // a row of zero counts used by faster_Moore
     
     // bounded grids are surrounded by a border of cells (with thickness = range+1)
     // so we can calculate neighborhood counts without checking for edge conditions;
-    // note that in an unbounded universe outerwd = gwd, outerht = ght,
-    // currgrid = outergrid1, nextgrid = outergrid2
+    // note that in an unbounded universe these grids aren't used (they are NULL)
     
     int border;                         // border thickness in cells (depends on range)
     int outerwd, outerht;               // width and height of bounded grids (including border)
@@ -69,7 +90,15 @@ private:
     unsigned char* outergrid2;          // points to outerwd*outerht cells for next generation
     int *shape ;                        // for shaped neighborhoods, this is the shape
 
-    // these variables are used in getcount and faster_Neumann_*
+    // an unbounded universe is a map of tiles keyed by their (y,x) tile coordinates;
+    // cell x,y is in tile (y >> logtilesize, x >> logtilesize)
+    std::map< std::pair<int,int>, ltltile > tiles;
+    int tilesize, logtilesize;          // tile width and height, and its log2
+    vector<unsigned char*> freetiles;   // pool of unused tile cells
+    vector<ltlalgo*> windows;           // bounded universes used to calculate tiles
+    std::mutex windowlock;              // for taking windows from other threads
+    
+    // these variables are used in getcount and faster_Neumann
     int ccht;                           // height of colcounts array when ntype = N
     int halfccwd;                       // half width of colcounts array when ntype = N
     int nrows, ncols;                   // size of rectangle being processed
@@ -88,27 +117,51 @@ private:
     void empty_boundaries();            // set minx, miny, maxx, maxy when population is 0
     void save_cells();                  // save current pattern in cell_list
     void restore_cells();               // restore pattern from cell_list
+    void free_grids();                  // free the grids of a bounded universe
     void do_bounded_gen();              // calculate the next generation in a bounded universe
+    void do_region_gen(int mincol, int minrow, int maxcol, int maxrow);
+    // calculate the next generation of the given part of a bounded universe
     bool do_unbounded_gen();            // calculate the next generation in an unbounded universe
-    int getcount(int i, int j);         // used in faster_Neumann_*
+    int getcount(int i, int j);         // used in faster_Neumann
 
-    const char* resize_grids(int up, int down, int left, int right);
-    // try to resize an unbounded universe by the given amounts (possibly -ve);
-    // if it fails then return a suitable error message
+    void faster_Moore(int mincol, int minrow, int maxcol, int maxrow);
+    void faster_Neumann(int mincol, int minrow, int maxcol, int maxrow);
+    // these routines are called from do_bounded_gen to process a rectangular region of cells
+    
+    void fast_Moore(int mincol, int minrow, int maxcol, int maxrow, ltlstats &stats);
+    void fast_Neumann(int mincol, int minrow, int maxcol, int maxrow, ltlstats &stats);
+    void fast_Shaped(int mincol, int minrow, int maxcol, int maxrow, ltlstats &stats);
+    // as above, but called via run_bands to process some of the rows
+    
+    friend struct ltlband;
+    int band_count(int rows, int cols);
+    void run_bands(int kind, int nbands, int minrow, int maxrow, int mincol, int maxcol,
+                   int rowoffset = 0, int coloffset = 0);
+    void run_band(ltlband &band);
+    // split the rows of a region into bands which are processed by separate threads
+    // (one band is processed in the calling thread)
+    
+    void Moore_counts(ltlband &band);
+    void Moore_carry(ltlband &band);
+    void Moore_rows(ltlband &band);
+    void Neumann_rows(ltlband &band);
+    // the parts of faster_Moore and faster_Neumann that process one band
     
-    void fast_Moore(int mincol, int minrow, int maxcol, int maxrow);
-    void faster_Moore_bounded(int mincol, int minrow, int maxcol, int maxrow);
-    void faster_Moore_bounded2(int mincol, int minrow, int maxcol, int maxrow);
-    void faster_Moore_unbounded(int mincol, int minrow, int maxcol, int maxrow);
-    void faster_Moore_unbounded2(int mincol, int minrow, int maxcol, int maxrow);
-    void fast_Neumann(int mincol, int minrow, int maxcol, int maxrow);
-    void faster_Neumann_bounded(int mincol, int minrow, int maxcol, int maxrow);
-    void faster_Neumann_unbounded(int mincol, int minrow, int maxcol, int maxrow);
-    void fast_Shaped(int mincol, int minrow, int maxcol, int maxrow);
-    // these routines are called from do_*_gen to process a rectangular region of cells
+    friend struct ltltiletask;
+    ltltile* find_tile(int tx, int ty);
+    ltltile& get_tile(int tx, int ty);
+    unsigned char* new_tile_cells();
+    void clear_tiles();
+    void tile_edges(ltltile& tile);
+    void tiled_gen(ltltiletask &task);
+    ltlalgo* get_window();
+    void put_window(ltlalgo* window);
+    void free_windows();
+    void draw_tiles(viewport& view, liferender& renderer);
+    // used to store and calculate an unbounded universe in tiles
     
-    void update_current_grid(unsigned char &state, int ncount);
-    void update_next_grid(int x, int y, int xyoffset, int ncount);
+    void update_current_grid(unsigned char &state, int ncount, ltlstats &stats);
+    void update_next_grid(int x, int y, int xyoffset, int ncount, ltlstats &stats);
     // called from each of the fast* routines to set the state of the x,y cell
     // in nextgrid based on the given neighborhood count
 };
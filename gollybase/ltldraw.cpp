@@ -4,6 +4,8 @@
 #include "ltlalgo.h"
 #include "util.h"
 #include <string.h>     // for memset and memcpy
+#include <limits.h>     // for INT_MIN and INT_MAX
+#include <algorithm>    // for std::sort
 
 // -----------------------------------------------------------------------------
 
@@ -67,6 +69,8 @@ static void killpixels()
 
 void ltlalgo::draw(viewport &view, liferender &renderer)
 {
+    if (renderer.retained())
+        renderer.damage(0, 0, view.getwidth(), view.getheight());
     if (population == 0) return;
 
     if (!renderer.justState()) {
@@ -92,6 +96,11 @@ void ltlalgo::draw(viewport &view, liferender &renderer)
        }
     }
     
+    if (unbounded) {
+        draw_tiles(view, renderer);
+        return;
+    }
+    
     int mag, pmag;
     int vieww = view.getwidth();
     int viewh = view.getheight();
@@ -107,32 +116,20 @@ void ltlalgo::draw(viewport &view, liferender &renderer)
     pair<int,int> ltpxl = view.screenPosOf(gridleft, gridtop, this);
     
     if (renderer.justState() || pmag > 1) {
-        if (unbounded) {
-            // simply display the entire grid -- ie. no need to use pixbuf
-            int x = ltpxl.first;        // already multiplied by pmag
-            int y = ltpxl.second;       // ditto
-            int wd = gwd * pmag;
-            int ht = ght * pmag;
-            if (renderer.justState())
-               renderer.stateblit(x, y, wd, ht, currgrid) ;
-            else
-               renderer.pixblit(x, y, wd, ht, currgrid, pmag);
-        } else {
-            // the universe is bounded so we need to include the outer border
-            bigint outerleft = gridleft;
-            bigint outertop = gridtop;
-            outerleft -= border;
-            outertop -= border;
-            ltpxl = view.screenPosOf(outerleft, outertop, this);
-            int x = ltpxl.first;
-            int y = ltpxl.second;
-            int wd = outerwd * pmag;
-            int ht = outerht * pmag;
-            if (renderer.justState())
-               renderer.stateblit(x, y, wd, ht, outergrid1) ;
-            else
-               renderer.pixblit(x, y, wd, ht, outergrid1, pmag);
-        }
+        // include the outer border of the bounded grid
+        bigint outerleft = gridleft;
+        bigint outertop = gridtop;
+        outerleft -= border;
+        outertop -= border;
+        ltpxl = view.screenPosOf(outerleft, outertop, this);
+        int x = ltpxl.first;
+        int y = ltpxl.second;
+        int wd = outerwd * pmag;
+        int ht = outerht * pmag;
+        if (renderer.justState())
+           renderer.stateblit(x, y, wd, ht, outergrid1) ;
+        else
+           renderer.pixblit(x, y, wd, ht, outergrid1, pmag);
     } else {
         // pmag is 1 so first fill pixbuf with dead cells
         killpixels();
@@ -248,6 +245,167 @@ void ltlalgo::draw(viewport &view, liferender &renderer)
 
 // -----------------------------------------------------------------------------
 
+static int clamp_cell(const bigint& v, int limit)
+{
+    // return the given cell coordinate, or -limit or limit if it's outside them
+    if (v < bigint(-limit)) return -limit;
+    if (v > bigint(limit)) return limit;
+    return v.toint();
+}
+
+// a visible tile, drawn in one of the pmsize*pmsize pixbuf blocks that it overlaps
+struct tilepart {
+    int blockx, blocky;         // pixel position of the block in the view
+    int tx, ty;                 // tile coordinates
+    ltltile* tile;
+    bool operator<(const tilepart& p) const {
+        return blocky < p.blocky || (blocky == p.blocky && blockx < p.blockx);
+    }
+};
+
+// -----------------------------------------------------------------------------
+
+static int first_boundary(viewport &view, lifealgo* algo, int base, int mag, bool horizontal)
+{
+    // when zoomed out, return the smallest cell coordinate after base (but at
+    // most base+2^31) that is in a different pixel to base
+    long long lo = 1;
+    long long hi = mag < 31 ? (1LL << mag) : (1LL << 31);
+    int p0 = horizontal ? view.screenPosOf(base, 0, algo).first : view.screenPosOf(0, base, algo).second;
+    while (lo < hi) {
+        long long mid = (lo + hi) / 2;
+        int c = (int)(base + mid);
+        int p = horizontal ? view.screenPosOf(c, 0, algo).first : view.screenPosOf(0, c, algo).second;
+        if (p > p0) hi = mid; else lo = mid + 1;
+    }
+    return (int)(base + lo);
+}
+
+// -----------------------------------------------------------------------------
+
+// draw an unbounded universe, one tile at a time
+
+void ltlalgo::draw_tiles(viewport &view, liferender &renderer)
+{
+    int mag, pmag;
+    int vieww = view.getwidth();
+    int viewh = view.getheight();
+    if (view.getmag() > 0) {
+        pmag = 1 << view.getmag();
+        mag = 0;
+    } else {
+        pmag = 1;
+        mag = -view.getmag();
+    }
+    
+    // find the tiles that might be visible (the cells at the corners
+    // of the view are clamped to avoid overflow)
+    int limit = 1 << 30;
+    pair<bigint,bigint> lt = view.at(0, 0);
+    pair<bigint,bigint> rb = view.at(vieww - 1, viewh - 1);
+    if (lt.first > bigint(limit) || lt.second > bigint(limit) ||
+        rb.first < bigint(-limit) || rb.second < bigint(-limit)) return;
+    int mintx = clamp_cell(lt.first, limit) >> logtilesize;
+    int minty = clamp_cell(lt.second, limit) >> logtilesize;
+    int maxtx = clamp_cell(rb.first, limit) >> logtilesize;
+    int maxty = clamp_cell(rb.second, limit) >> logtilesize;
+    
+    if (renderer.justState() || pmag > 1) {
+        // simply display each visible tile -- ie. no need to use pixbuf
+        int wd = tilesize * pmag;
+        std::map< std::pair<int,int>, ltltile >::iterator it;
+        for (it = tiles.begin(); it != tiles.end(); it++) {
+            int ty = it->first.first;
+            int tx = it->first.second;
+            if (ty < minty || ty > maxty || tx < mintx || tx > maxtx) continue;
+            pair<int,int> ltpxl = view.screenPosOf(tx * tilesize, ty * tilesize, this);
+            int x = ltpxl.first;
+            int y = ltpxl.second;
+            if (x >= vieww || y >= viewh || x + wd <= 0 || y + wd <= 0) continue;
+            if (renderer.justState())
+               renderer.stateblit(x, y, wd, wd, it->second.cells) ;
+            else
+               renderer.pixblit(x, y, wd, wd, it->second.cells, pmag);
+        }
+        return;
+    }
+    
+    // pmag is 1 so each pixel shows 2^mag * 2^mag cells; a cell x,y (at or
+    // after the top left visible tile) is at pixel px + ((x - bx) >> mag) + 1,
+    // py + ((y - by) >> mag) + 1, where bx,by is the first cell after the
+    // top left tile's corner that is in a different pixel
+    int left = mintx * tilesize;
+    int top = minty * tilesize;
+    pair<int,int> ltpxl = view.screenPosOf(left, top, this);
+    int px = ltpxl.first + 1;
+    int py = ltpxl.second + 1;
+    int bx = first_boundary(view, this, left, mag, true);
+    int by = first_boundary(view, this, top, mag, false);
+    
+    // make a list of the visible parts of the tiles in each block
+    // (blocks are aligned to the view's top left corner)
+    vector<tilepart> parts;
+    std::map< std::pair<int,int>, ltltile >::iterator it;
+    for (it = tiles.begin(); it != tiles.end(); it++) {
+        int ty = it->first.first;
+        int tx = it->first.second;
+        if (ty < minty || ty > maxty || tx < mintx || tx > maxtx) continue;
+        ltltile& tile = it->second;
+        int x0 = px + (int)(((long long)tx * tilesize + tile.minx - bx) >> mag);
+        int y0 = py + (int)(((long long)ty * tilesize + tile.miny - by) >> mag);
+        int x1 = px + (int)(((long long)tx * tilesize + tile.maxx - bx) >> mag);
+        int y1 = py + (int)(((long long)ty * tilesize + tile.maxy - by) >> mag);
+        if (x0 >= vieww || y0 >= viewh || x1 < 0 || y1 < 0) continue;
+        tilepart part;
+        part.tx = tx;
+        part.ty = ty;
+        part.tile = &tile;
+        int bx0 = (x0 < 0 ? 0 : x0) & ~(pmsize - 1);
+        int by0 = (y0 < 0 ? 0 : y0) & ~(pmsize - 1);
+        for (part.blocky = by0; part.blocky <= y1 && part.blocky < viewh; part.blocky += pmsize) {
+            for (part.blockx = bx0; part.blockx <= x1 && part.blockx < vieww; part.blockx += pmsize) {
+                parts.push_back(part);
+            }
+        }
+    }
+    if (parts.empty()) return;
+    
+    // draw each block once all the tiles overlapping it are in pixbuf;
+    // when zoomed out, all non-zero cells are drawn using the state 1 color
+    std::sort(parts.begin(), parts.end());
+    killpixels();
+    unsigned int state1RGBA = cellRGBA[1];
+    for (size_t i = 0; i < parts.size(); i++) {
+        tilepart& part = parts[i];
+        ltltile& tile = *part.tile;
+        long long cellx = (long long)part.tx * tilesize - bx;
+        long long celly = (long long)part.ty * tilesize - by;
+        int xoff = px - part.blockx;
+        int yoff = py - part.blocky;
+        for (int y = tile.miny; y <= tile.maxy; y++) {
+            int j = yoff + (int)((celly + y) >> mag);
+            if (j < 0) continue;
+            if (j >= pmsize) break;
+            unsigned char* row = tile.cells + y * tilesize;
+            unsigned int* pixrow = pixRGBAbuf + j * pmsize;
+            for (int x = tile.minx; x <= tile.maxx; x++) {
+                if (row[x] == 0) continue;
+                int k = xoff + (int)((cellx + x) >> mag);
+                if (k < 0) continue;
+                if (k >= pmsize) break;
+                pixrow[k] = mag == 0 ? cellRGBA[row[x]] : state1RGBA;
+            }
+        }
+        if (i + 1 == parts.size() || parts[i+1].blockx != part.blockx || parts[i+1].blocky != part.blocky) {
+            // draw this block
+            renderer.pixblit(part.blockx, part.blocky, pmsize, pmsize, pixbuf, 1);
+            killpixels();
+        }
+    }
+}
+
+// -----------------------------------------------------------------------------
+
 void ltlalgo::findedges(bigint *ptop, bigint *pleft, bigint *pbottom, bigint *pright)
 {
     if (population == 0) {
@@ -260,6 +418,27 @@ void ltlalgo::findedges(bigint *ptop, bigint *pleft, bigint *pbottom, bigint *pr
         return;
     }
     
+    if (unbounded) {
+        // find the union of the minimal boundaries of all the tiles
+        int top = INT_MAX, left = INT_MAX, bottom = INT_MIN, right = INT_MIN;
+        std::map< std::pair<int,int>, ltltile >::iterator it;
+        for (it = tiles.begin(); it != tiles.end(); it++) {
+            ltltile& tile = it->second;
+            tile_edges(tile);
+            int tiletop = it->first.first * tilesize;
+            int tileleft = it->first.second * tilesize;
+            if (tiletop + tile.miny < top) top = tiletop + tile.miny;
+            if (tileleft + tile.minx < left) left = tileleft + tile.minx;
+            if (tiletop + tile.maxy > bottom) bottom = tiletop + tile.maxy;
+            if (tileleft + tile.maxx > right) right = tileleft + tile.maxx;
+        }
+        *ptop = top;
+        *pleft = left;
+        *pbottom = bottom;
+        *pright = right;
+        return;
+    }
+    
     // the code in ltlalgo.cpp maintains a boundary of live cells in
     // minx,miny,maxx,maxy but it might not be the minimal boundary
     // (eg. if user deleted some live cells)
@@ -0,0 +1,158 @@
+// This file is part of Golly.
+// See docs/License.html for the copyright notice.
+
+#include "margolusalgo.h"
+#include <string.h>
+#include <stdio.h>
+
+using namespace std ;
+
+static const char *DEFAULTRULE = "M0,8,4,3,2,5,9,7,1,6,10,11,12,13,14,15" ;
+const char* margolusalgo::DefaultRule() {
+   return DEFAULTRULE ;
+}
+
+/*
+ *   A cell's next state depends on the block it is in, and where that
+ *   is depends on the cell's position and the generation, neither of
+ *   which slowcalc() knows; the leaves only ever go through
+ *   slowcalcblock(), so this is never used.
+ */
+state margolusalgo::slowcalc(state, state, state, state, state c,
+                             state, state, state, state) {
+   return c ;
+}
+
+void margolusalgo::slowcalcblock(const state *in, int stride, state *out,
+                                 int n) {
+   // blocks start at cells with the parity of the generation, so
+   // within the window they start at column offx and row offy
+   int gen = calcphase >> 1 ;
+   int offx = gen ^ (calcphase & 1) ;
+   int offy = offx ^ 1 ;
+   const unsigned char *t = transition[gen] ;
+   for (int y=1; y<=n; y++) {
+      int by = y - ((y - offy) & 1) ;
+      const state *a = in + by * stride ;
+      const state *b = a + stride ;
+      for (int x=1; x<=n; x++) {
+         int bx = x - ((x - offx) & 1) ;
+         int blk = a[bx] | (a[bx+1] << 1) | (b[bx] << 2) | (b[bx+1] << 3) ;
+         *out++ = (t[blk] >> ((x - bx) + 2 * (y - by))) & 1 ;
+      }
+   }
+}
+
+/*
+ *   Rules are "M" and then the 16 block transitions separated by commas;
+ *   we also accept MCell's "MS,D" prefix and semicolons.  An empty block
+ *   has to stay empty, except in rules like Critters and Tron that swap
+ *   empty and full blocks.  We run those by inverting the pattern in odd
+ *   generations (as MCell and Margolus.lua do), which leaves the empty
+ *   block alone in both:  the even transition of i is then 15-T[i], and
+ *   the odd one is T[15-i].
+ */
+const char* margolusalgo::setrule(const char *s) {
+   const char *p = s ;
+   int blocknum[16] ;
+   int i = 0 ;
+   if (*p != 'M' && *p != 'm')
+      return "Margolus rule must start with M." ;
+   p++ ;
+   if ((p[0] == 'S' || p[0] == 's') && p[1] == ',')
+      p += 2 ;
+   if (*p == 'D' || *p == 'd')
+      p++ ;
+   while (i < 16) {
+      if (*p < '0' || *p > '9')
+         return "Margolus rule needs 16 numbers from 0 to 15." ;
+      int v = 0 ;
+      while (*p >= '0' && *p <= '9' && v <= 15)
+         v = 10 * v + *p++ - '0' ;
+      if (v > 15)
+         return "Margolus block numbers must be from 0 to 15." ;
+      blocknum[i++] = v ;
+      if (i < 16) {
+         if (*p != ',' && *p != ';')
+            return "Margolus rule needs 16 numbers from 0 to 15." ;
+         p++ ;
+      }
+   }
+   if (*p != 0 && *p != ':')
+      return "Margolus rule has extra characters after the 16 numbers." ;
+
+   int invert = (blocknum[0] == 15 && blocknum[15] == 0) ;
+   if (blocknum[0] != 0 && !invert)
+      return "Empty blocks must stay empty or swap with full blocks." ;
+
+   // check for rule suffix like ":T200,100" to specify a bounded universe
+   if (*p == ':') {
+      const char* err = setgridsize(p) ;
+      if (err) return err ;
+      if ((gridwd & 1) || (gridht & 1))
+         return "Margolus grid sizes must be even." ;
+   } else {
+      // universe is unbounded
+      gridwd = 0 ;
+      gridht = 0 ;
+   }
+
+   for (i=0; i<16; i++) {
+      if (invert) {
+         transition[0][i] = (unsigned char)(15 - blocknum[i]) ;
+         transition[1][i] = (unsigned char)blocknum[15 - i] ;
+      } else {
+         transition[0][i] = transition[1][i] = (unsigned char)blocknum[i] ;
+      }
+   }
+
+   // create the canonical rule
+   int len = sprintf(canonrule, "M%d", blocknum[0]) ;
+   for (i=1; i<16; i++)
+      len += sprintf(canonrule + len, ",%d", blocknum[i]) ;
+   canonrule[len] = 0 ;
+
+   maxCellStates = 2 ;
+   ghashbase::setrule(canonrule) ;
+   return 0 ;
+}
+
+const char* margolusalgo::getrule() {
+   static char rule[MAXRULESIZE] ;
+   strcpy(rule, canonrule) ;
+   if (gridwd > 0 || gridht > 0) {
+      // setgridsize() was successfully called above, so append suffix
+      int len = (int)strlen(rule) ;
+      const char* bounds = canonicalsuffix() ;
+      int i = 0 ;
+      while (bounds[i]) rule[len++] = bounds[i++] ;
+      rule[len] = 0 ;
+   }
+   return rule ;
+}
+
+static lifealgo *creator() { return new margolusalgo() ; }
+
+void margolusalgo::doInitializeAlgoInfo(staticAlgoInfo &ai) {
+   ghashbase::doInitializeAlgoInfo(ai) ;
+   ai.setAlgorithmName("Margolus") ;
+   ai.setAlgorithmCreator(&creator) ;
+   ai.minstates = 2 ;
+   ai.maxstates = 2 ;
+   // init default color scheme
+   ai.defgradient = false ;
+   ai.defr1 = ai.defg1 = ai.defb1 = 255 ;     // start color = white
+   ai.defr2 = ai.defg2 = ai.defb2 = 128 ;     // end color = gray
+   ai.defr[0] = ai.defg[0] = ai.defb[0] = 0 ;  // state 0 is black
+   ai.defr[1] = ai.defg[1] = 255 ;            // state 1 is yellow
+   ai.defb[1] = 0 ;
+}
+
+margolusalgo::margolusalgo() {
+   phased = 1 ;
+   maxCellStates = 2 ;
+   setrule(DEFAULTRULE) ;
+}
+
+margolusalgo::~margolusalgo() {
+}
@@ -0,0 +1,37 @@
+// This file is part of Golly.
+// See docs/License.html for the copyright notice.
+
+#ifndef MARGOLUSALGO_H
+#define MARGOLUSALGO_H
+#include "ghashbase.h"
+/**
+ *   Our Margolus algo class.  Rules like "M0,8,4,3,2,5,9,7,1,6,10,11,
+ *   12,13,14,15" (the Billiard Ball Machine) give the new contents of
+ *   each 2x2 block, numbered 1 for the top left cell, 2 for the top
+ *   right, 4 for the bottom left and 8 for the bottom right.  Blocks
+ *   have their top left cell at even coordinates in even generations
+ *   and at odd coordinates in odd generations.
+ */
+class margolusalgo : public ghashbase {
+public:
+   margolusalgo() ;
+   virtual ~margolusalgo() ;
+   virtual state slowcalc(state nw, state n, state ne, state w, state c,
+                          state e, state sw, state s, state se) ;
+   virtual void slowcalcblock(const state *in, int stride, state *out,
+                              int n) ;
+   virtual const char* setrule(const char* s) ;
+   virtual const char* getrule() ;
+   virtual const char* DefaultRule() ;
+   virtual int NumCellStates() { return 2 ; }
+   static void doInitializeAlgoInfo(staticAlgoInfo &) ;
+
+private:
+   char canonrule[MAXRULESIZE] ;      // canonical version of valid rule passed into setrule
+   // the block transitions for even and odd generations; they differ
+   // only for rules like Critters that turn empty blocks full, which
+   // we run with every other generation inverted
+   unsigned char transition[2][16] ;
+} ;
+
+#endif
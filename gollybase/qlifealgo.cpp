@@ -12,6 +12,8 @@
 #include <string.h>
 #include <limits.h>
 #include <iostream>
+#include <mutex>
+#include <unordered_map>
 using namespace std ;
 /*
  *   The ai array is used to figure out the index number of the bit set in
@@ -68,12 +70,40 @@ static int bricks, tiles, supertiles, rcc, dq, ds, rccs, dqs, dss ;
 #else
 #define STAT(a)
 #endif
+/*
+ *   The state of one multithreaded generation; see pardogen() below.
+ *   A frame is a supertile above the task level whose new flags wait
+ *   on the results of its subtiles.
+ */
+struct qlifeframe {
+   supertile *zis ;
+   int nchanging, up, shift ;
+} ;
+struct qlifetask : public lifetask {
+   qlifealgo *algo ;
+   supertile *p, *pu, *pf, *pfu ;
+   int lev, phase, frame, shift, wave, result ;
+   virtual void run() { algo->runtask(this) ; }
+} ;
+struct qlifeplan {
+   int phase, owner ;
+   vector<qlifeframe> frames ;
+   vector<qlifetask> tasks ;
+   unordered_map<supertile *, int> taskof ;
+   mutex allocmutex ;
+} ;
+/*
+ *   While a generation runs on threads, allocation takes a lock.
+ */
+#define ALLOCLOCK unique_lock<mutex> lk ; \
+                  if (plan) lk = unique_lock<mutex>(plan->allocmutex)
 /*
  *   If we need a new empty brick, we call this.  This structure is guaranteed
  *   to be all zeros.
  */
 brick *qlifealgo::newbrick() {
    brick *r ;
+   ALLOCLOCK ;
    if (bricklist == 0)
       bricklist = filllist(sizeof(brick)) ;
    r = (brick *)(bricklist) ;
@@ -88,6 +118,7 @@ brick *qlifealgo::newbrick() {
  */
 tile *qlifealgo::newtile() {
    tile *r ;
+   ALLOCLOCK ;
    if (tilelist == 0)
       tilelist = filllist(sizeof(tile)) ;
    r = (tile *)(tilelist) ;
@@ -103,6 +134,7 @@ tile *qlifealgo::newtile() {
  */
 supertile *qlifealgo::newsupertile(int lev) {
    supertile *r ;
+   ALLOCLOCK ;
    if (supertilelist == 0)
       supertilelist = filllist(sizeof(supertile)) ;
    r = (supertile *)supertilelist ;
@@ -198,6 +230,8 @@ qlifealgo::qlifealgo() {
       lifefatal("bad platform for this program") ;
    memused = 0 ;
    maxmemory = 0 ;
+   plan = 0 ;
+   brickkernel = brickborn = bricksurvive = 0 ;
    clearall() ;
 }
 /*
@@ -303,7 +337,8 @@ int qlifealgo::doquad01(supertile *zis, supertile *edge,
  *   Note that the parallel and corner have already been recomputed so
  *   their changing bits are shifted up 10 positions in c.
  */
-   poller->poll() ;
+   if (plan == 0 || lifethreads::threadindex() == plan->owner)
+      poller->poll() ;
    int changing = (zis->flags | (par->flags >> 19) |
                    (((edge->flags >> 18) | (cor->flags >> 27)) & 1)) & 0xff ;
    int x, b, nchanging = (zis->flags & 0x3ff00) << 10 ;
@@ -368,7 +403,8 @@ int qlifealgo::doquad01(supertile *zis, supertile *edge,
  */
 int qlifealgo::doquad10(supertile *zis, supertile *edge,
                         supertile *par, supertile *cor, int lev) {
-   poller->poll() ;
+   if (plan == 0 || lifethreads::threadindex() == plan->owner)
+      poller->poll() ;
    int changing = (zis->flags | (par->flags >> 19) |
                    (((edge->flags >> 18) | (cor->flags >> 27)) & 1)) & 0xff ;
    int x, b, nchanging = (zis->flags & 0x3ff00) << 10 ;
@@ -406,6 +442,482 @@ int qlifealgo::doquad10(supertile *zis, supertile *edge,
    zis->flags = nchanging | 0xf0000000 ;
    return upchanging(nchanging) ;
 }
+/*
+ *   Multithreaded generations.  The recursion above is not naturally
+ *   parallel:  each subtile reads the changing bits its neighbors past
+ *   it and parallel to it (below and to the right in phase 0->1, above
+ *   and to the left in phase 1->0) leave behind, so it must run after
+ *   them.  But a subtile reads nothing else outside itself, and writes
+ *   nothing outside itself.
+ *
+ *   So pardogen() first walks the supertiles above level parlevel in
+ *   exactly the order doquad01() or doquad10() would, working out which
+ *   subtiles change, allocating the empty ones that are needed and
+ *   shifting the old changing bits up just as the serial code does.
+ *   Each changing supertile at level parlevel becomes a task that
+ *   depends on the tasks (if any) for its three neighbors.  The tasks
+ *   then run in waves, a wave holding the tasks whose neighbors were
+ *   all done in earlier waves; across a region that is a diagonal
+ *   front sweeping from one corner to the other.  Finally the new
+ *   changing bits are folded back up the frames, deepest first.
+ *
+ *   Every read sees what it would have seen serially, so the result is
+ *   bit for bit that of dogen() on one thread.  Allocation takes a lock
+ *   while the tasks run, and only the thread that called step() polls.
+ */
+int qlifealgo::parlevel = 1 ;
+void qlifealgo::setParallelLevel(int lev) {
+   if (lev < 0)
+      lev = 0 ;
+   parlevel = lev ;
+}
+void qlifealgo::planquad(qlifeplan &pl, supertile *zis, supertile *edge,
+                supertile *par, supertile *cor, int lev, int up, int shift) {
+   poller->poll() ;
+   int changing = (zis->flags | (par->flags >> 19) |
+                   (((edge->flags >> 18) | (cor->flags >> 27)) & 1)) & 0xff ;
+   int f = (int)pl.frames.size() ;
+   qlifeframe fr ;
+   fr.zis = zis ;
+   fr.nchanging = (zis->flags & 0x3ff00) << 10 ;
+   fr.up = up ;
+   fr.shift = shift ;
+   pl.frames.push_back(fr) ;
+/*
+ *   Our neighbors only look at the shifted bits, so we can set them now;
+ *   the low bits are filled in once the tasks are done.
+ */
+   zis->flags = fr.nchanging | 0xf0000000 ;
+/*
+ *   The i'th subtile in walking order is x = 7-i in phase 0->1 and x = i
+ *   in phase 1->0; either way its bit in changing is 1<<i and its bits
+ *   go in nchanging at 7-i.
+ */
+   for (int i=0; changing; i++) {
+      int b = 1 << i ;
+      if ((changing & b) == 0)
+         continue ;
+      changing -= b ;
+      int x = (pl.phase ? i : 7 - i) ;
+      int xp = (pl.phase ? x - 1 : x + 1) ;
+      supertile *p = zis->d[x], *pu = par->d[x], *pf, *pfu ;
+      if (i == 0) {
+         pf = edge->d[7-x] ;
+         pfu = cor->d[7-x] ;
+      } else {
+         pf = zis->d[xp] ;
+         pfu = par->d[xp] ;
+      }
+      if (p == nullroots[lev-1])
+         p = zis->d[x] = (lev == 1 ? (supertile *)newtile() :
+                                                  newsupertile(lev-1)) ;
+      if (lev - 1 > parlevel) {
+         planquad(pl, p, pu, pf, pfu, lev-1, f, 7-i) ;
+         continue ;
+      }
+      qlifetask t ;
+      t.algo = this ;
+      t.p = p ;
+      t.pu = pu ;
+      t.pf = pf ;
+      t.pfu = pfu ;
+      t.lev = lev - 1 ;
+      t.phase = pl.phase ;
+      t.frame = f ;
+      t.shift = 7 - i ;
+      t.wave = 0 ;
+      t.result = 0 ;
+      supertile *nb[3] = { pu, pf, pfu } ;
+      for (int j=0; j<3; j++) {
+         unordered_map<supertile *, int>::iterator it = pl.taskof.find(nb[j]) ;
+         if (it != pl.taskof.end() && pl.tasks[it->second].wave >= t.wave)
+            t.wave = pl.tasks[it->second].wave + 1 ;
+      }
+      pl.taskof[p] = (int)pl.tasks.size() ;
+      pl.tasks.push_back(t) ;
+   }
+}
+void qlifealgo::runtask(qlifetask *t) {
+   if (t->lev == 0) {
+      if (t->phase)
+         t->result = p10((tile *)t->pfu, (tile *)t->pu,
+                         (tile *)t->pf, (tile *)t->p) ;
+      else
+         t->result = p01((tile *)t->p, (tile *)t->pf,
+                         (tile *)t->pu, (tile *)t->pfu) ;
+   } else {
+      if (t->phase)
+         t->result = doquad10(t->p, t->pu, t->pf, t->pfu, t->lev) ;
+      else
+         t->result = doquad01(t->p, t->pu, t->pf, t->pfu, t->lev) ;
+   }
+}
+void qlifealgo::pardogen(int phase) {
+   qlifeplan pl ;
+   pl.phase = phase ;
+   pl.owner = lifethreads::threadindex() ;
+   planquad(pl, root, nullroot, nullroot, nullroot, rootlev, -1, 0) ;
+   int ntasks = (int)pl.tasks.size() ;
+   int nwaves = 0 ;
+   for (int i=0; i<ntasks; i++)
+      if (pl.tasks[i].wave >= nwaves)
+         nwaves = pl.tasks[i].wave + 1 ;
+/*
+ *   Bucket the tasks by wave, keeping walking order within a wave.
+ */
+   vector<int> start(nwaves+1, 0) ;
+   for (int i=0; i<ntasks; i++)
+      start[pl.tasks[i].wave+1]++ ;
+   for (int w=0; w<nwaves; w++)
+      start[w+1] += start[w] ;
+   vector<lifetask *> order(ntasks) ;
+   vector<int> fill(start.begin(), start.end()-1) ;
+   for (int i=0; i<ntasks; i++)
+      order[fill[pl.tasks[i].wave]++] = &pl.tasks[i] ;
+   plan = &pl ;
+   for (int w=0; w<nwaves; w++)
+      lifethreads::runtasks(&order[start[w]], start[w+1] - start[w]) ;
+   plan = 0 ;
+   for (int i=0; i<ntasks; i++)
+      pl.frames[pl.tasks[i].frame].nchanging |=
+                                        pl.tasks[i].result << pl.tasks[i].shift ;
+   for (int f=(int)pl.frames.size()-1; f>=0; f--) {
+      qlifeframe &fr = pl.frames[f] ;
+      fr.zis->flags = fr.nchanging | 0xf0000000 ;
+      if (fr.up >= 0)
+         pl.frames[fr.up].nchanging |= upchanging(fr.nchanging) << fr.shift ;
+   }
+}
+/*
+ *   For outer-totalistic Moore rules there is a second way to compute a
+ *   brick:  all eight slices at once with bit-sliced logic, one slice to
+ *   a 32-bit lane of a 256-bit vector.  Within a slice the three-cell
+ *   sums along the rows come from shifting the slice against its
+ *   neighbor along the brick, the rows are then moved up a nibble at a
+ *   time (pulling in the rows of the next brick) and added with full
+ *   adders to give the nine-cell sum as four bit planes, and the rule
+ *   is a sum of products over those planes.  Phase 0->1 looks right and
+ *   down, and phase 1->0 left and up.
+ *
+ *   We use the compiler's vector extensions so the same source serves
+ *   AVX2 (chosen at run time if the processor has it), SSE2 and NEON;
+ *   elsewhere, or for rules the kernel cannot do, we use the table.
+ *   Since the kernel does all eight slices, p01() and p10() only call
+ *   it when enough of them need recomputing.
+ */
+#if defined(__GNUC__) && (defined(__x86_64__) || \
+                          (defined(__i386__) && defined(__SSE2__)) || \
+                          defined(__ARM_NEON))
+#define BRICKKERNEL
+typedef unsigned int brickvec __attribute__((vector_size(32))) ;
+#define BRICKINLINE inline __attribute__((always_inline))
+/*
+ *   Vectors go in and out of these by reference; passing them by value
+ *   changes the calling convention with and without AVX, and gcc warns.
+ */
+static BRICKINLINE void bv_load(brickvec &r, const unsigned int *p) {
+   memcpy(&r, p, sizeof(r)) ;
+}
+/*
+ *   The slices (h0, h1 the three-cell sums, m the middle cell) shifted
+ *   one column against the next slice e along the brick.
+ */
+static BRICKINLINE void bv_rowsums(const brickvec &x, const brickvec &e,
+                       int fwd, brickvec &h0, brickvec &h1, brickvec &m) {
+   brickvec c2 ;
+   if (fwd) {
+      m = ((x << 1) & 0xeeeeeeee) | ((e >> 3) & 0x11111111) ;
+      c2 = ((x << 2) & 0xcccccccc) | ((e >> 2) & 0x33333333) ;
+   } else {
+      m = ((x >> 1) & 0x77777777) | ((e << 3) & 0x88888888) ;
+      c2 = ((x >> 2) & 0x33333333) | ((e << 2) & 0xcccccccc) ;
+   }
+   brickvec xm = x ^ m ;
+   h0 = xm ^ c2 ;
+   h1 = (x & m) | (xm & c2) ;
+}
+// rows of x moved n up (fwd) or down, pulling rows in from y
+static BRICKINLINE void bv_rows(brickvec &r, const brickvec &x,
+                                const brickvec &y, int fwd, int n) {
+   if (fwd)
+      r = (x << (4 * n)) | (y >> (32 - 4 * n)) ;
+   else
+      r = (x >> (4 * n)) | (y << (32 - 4 * n)) ;
+}
+/*
+ *   One generation of the eight slices at x, with e the slice past the
+ *   last, and y and ye the same for the brick below (fwd) or above.
+ */
+static BRICKINLINE void brickgen(const unsigned int *x, unsigned int e,
+                                 const unsigned int *y, unsigned int ye,
+                                 int fwd, int born, int survive,
+                                 unsigned int *out) {
+   brickvec bx, by, bxe, bye ;
+   bv_load(bx, x) ;
+   bv_load(by, y) ;
+   if (fwd) {
+      bv_load(bxe, x + 1) ;
+      bv_load(bye, y + 1) ;
+      bxe[7] = e ;
+      bye[7] = ye ;
+   } else {
+      bv_load(bxe, x - 1) ;
+      bv_load(bye, y - 1) ;
+      bxe[0] = e ;
+      bye[0] = ye ;
+   }
+   brickvec n0, n1, nm, y0, y1, ym, h0, h1, d0, d1, c ;
+   bv_rowsums(bx, bxe, fwd, n0, n1, nm) ;
+   bv_rowsums(by, bye, fwd, y0, y1, ym) ;
+   bv_rows(h0, n0, y0, fwd, 1) ;
+   bv_rows(h1, n1, y1, fwd, 1) ;
+   bv_rows(d0, n0, y0, fwd, 2) ;
+   bv_rows(d1, n1, y1, fwd, 2) ;
+   bv_rows(c, nm, ym, fwd, 1) ;
+   brickvec t0 = n0 ^ h0 ;
+   brickvec s0 = t0 ^ d0 ;
+   brickvec c0 = (n0 & h0) | (t0 & d0) ;
+   brickvec t1 = n1 ^ h1 ;
+   brickvec a1 = t1 ^ d1 ;
+   brickvec c1 = (n1 & h1) | (t1 & d1) ;
+   brickvec s1 = a1 ^ c0 ;
+   brickvec c2 = a1 & c0 ;
+   brickvec s2 = c1 ^ c2 ;
+   brickvec s3 = c1 & c2 ;
+   brickvec hi[3], lo[4] ;
+   hi[0] = ~(s2 | s3) ;
+   hi[1] = s2 & ~s3 ;
+   hi[2] = s3 ;
+   lo[0] = ~(s1 | s0) ;
+   lo[1] = s0 & ~s1 ;
+   lo[2] = s1 & ~s0 ;
+   lo[3] = s1 & s0 ;
+   brickvec zero = bx ^ bx, b = zero, v = zero ;
+   for (int g=0; g<3; g++) {
+      int bm = (born >> (4 * g)) & 15 ;
+      int sm = (survive >> (4 * g)) & 15 ;
+      if (bm) {
+         brickvec m = zero ;
+         for (int j=0; j<4; j++)
+            if ((bm >> j) & 1)
+               m |= lo[j] ;
+         b |= hi[g] & m ;
+      }
+      if (sm) {
+         brickvec m = zero ;
+         for (int j=0; j<4; j++)
+            if ((sm >> j) & 1)
+               m |= lo[j] ;
+         v |= hi[g] & m ;
+      }
+   }
+   brickvec r = (b & ~c) | (v & c) ;
+   memcpy(out, &r, sizeof(r)) ;
+}
+static void brick01(const unsigned int *x, unsigned int e,
+                    const unsigned int *y, unsigned int ye,
+                    int born, int survive, unsigned int *out) {
+   brickgen(x, e, y, ye, 1, born, survive, out) ;
+}
+static void brick10(const unsigned int *x, unsigned int e,
+                    const unsigned int *y, unsigned int ye,
+                    int born, int survive, unsigned int *out) {
+   brickgen(x, e, y, ye, 0, born, survive, out) ;
+}
+#if defined(__x86_64__) || defined(__i386__)
+__attribute__((target("avx2")))
+static void brick01avx2(const unsigned int *x, unsigned int e,
+                        const unsigned int *y, unsigned int ye,
+                        int born, int survive, unsigned int *out) {
+   brickgen(x, e, y, ye, 1, born, survive, out) ;
+}
+__attribute__((target("avx2")))
+static void brick10avx2(const unsigned int *x, unsigned int e,
+                        const unsigned int *y, unsigned int ye,
+                        int born, int survive, unsigned int *out) {
+   brickgen(x, e, y, ye, 0, born, survive, out) ;
+}
+#endif
+typedef void (*brickfunc)(const unsigned int *, unsigned int,
+                          const unsigned int *, unsigned int,
+                          int, int, unsigned int *) ;
+static brickfunc brickfunc01, brickfunc10 ;
+static const char *brickkernelname ;
+static void pickbrickkernel() {
+   if (brickkernelname)
+      return ;
+   brickfunc01 = brick01 ;
+   brickfunc10 = brick10 ;
+#if defined(__x86_64__) || defined(__i386__)
+   brickkernelname = "SSE2" ;
+   __builtin_cpu_init() ;
+   if (__builtin_cpu_supports("avx2")) {
+      brickfunc01 = brick01avx2 ;
+      brickfunc10 = brick10avx2 ;
+      brickkernelname = "AVX2" ;
+   }
+#else
+   brickkernelname = "NEON" ;
+#endif
+}
+#endif
+/*
+ *   The kernel is used if rule0 is an outer-totalistic Moore rule
+ *   without B0 and we have one for this machine.
+ */
+void qlifealgo::setbrickrule() {
+   brickkernel = 0 ;
+   if (qliferules.alternate_rules ||
+       !liferules::mooresums(qliferules.rule0, brickborn, bricksurvive)) {
+      brickborn = bricksurvive = 0 ;
+      return ;
+   }
+#ifdef BRICKKERNEL
+   if ((brickborn & 1) == 0) {
+      pickbrickkernel() ;
+      brickkernel = 1 ;
+   }
+#endif
+}
+/*
+ *   What p01() and p10() compute with the table for all eight slices,
+ *   with the same arguments as the kernel.
+ */
+static void bricktable01(const char *ruletable, const unsigned int *x,
+                         unsigned int e, const unsigned int *y,
+                         unsigned int ye, unsigned int *out) {
+   for (int j=0; j<8; j++) {
+      unsigned int zisdata = x[j] ;
+      unsigned int underdata = (zisdata << 8) + (y[j] >> 24) ;
+      unsigned int traildata = (j == 7 ? e : x[j+1]) ;
+      unsigned int trailunderdata = (traildata << 8) +
+                                    ((j == 7 ? ye : y[j+1]) >> 24) ;
+      unsigned int otherdata = ((zisdata << 2) & 0xcccccccc) +
+                               ((traildata >> 2) & 0x33333333) ;
+      unsigned int otherunderdata = ((underdata << 2) & 0xcccccccc) +
+                                    ((trailunderdata >> 2) & 0x33333333) ;
+      out[j] = (ruletable[zisdata >> 16] << 26) +
+               (ruletable[underdata >> 16] << 18) +
+               (ruletable[zisdata & 0xffff] << 10) +
+               (ruletable[underdata & 0xffff] << 2) +
+               (ruletable[otherdata >> 16] << 24) +
+               (ruletable[otherunderdata >> 16] << 16) +
+               (ruletable[otherdata & 0xffff] << 8) +
+                ruletable[otherunderdata & 0xffff] ;
+   }
+}
+static void bricktable10(const char *ruletable, const unsigned int *x,
+                         unsigned int e, const unsigned int *y,
+                         unsigned int ye, unsigned int *out) {
+   for (int j=0; j<8; j++) {
+      unsigned int zisdata = x[j] ;
+      unsigned int overdata = (zisdata >> 8) + (y[j] << 24) ;
+      unsigned int traildata = (j == 0 ? e : x[j-1]) ;
+      unsigned int trailoverdata = (traildata >> 8) +
+                                   ((j == 0 ? ye : y[j-1]) << 24) ;
+      unsigned int otherdata = ((zisdata >> 2) & 0x33333333) +
+                               ((traildata << 2) & 0xcccccccc) ;
+      unsigned int otheroverdata = ((overdata >> 2) & 0x33333333) +
+                                   ((trailoverdata << 2) & 0xcccccccc) ;
+      out[j] = (ruletable[otheroverdata >> 16] << 26) +
+               (ruletable[otherdata >> 16] << 18) +
+               (ruletable[otheroverdata & 0xffff] << 10) +
+               (ruletable[otherdata & 0xffff] << 2) +
+               (ruletable[overdata >> 16] << 24) +
+               (ruletable[zisdata >> 16] << 16) +
+               (ruletable[overdata & 0xffff] << 8) +
+                ruletable[zisdata & 0xffff] ;
+   }
+}
+/*
+ *   Check the kernel against the table on count random bricks of all
+ *   densities in both phases, then time the two on the same bricks.
+ *   Returns the number of results that differ.
+ */
+#ifdef BRICKKERNEL
+static volatile unsigned int bricksink ;
+static void brickrandom(unsigned int *d, int n, unsigned int &seed, int density) {
+   for (int i=0; i<n; i++) {
+      unsigned int w = 0 ;
+      for (int k=0; k<32; k++) {
+         seed = seed * 1103515245 + 12345 ;
+         w = (w << 1) | (((seed >> 16) & 15) < (unsigned int)density) ;
+      }
+      d[i] = w ;
+   }
+}
+#endif
+int qlifealgo::brickcheck(int count) {
+   if (!brickkernel) {
+      lifestatus("No brick kernel for this rule on this machine.") ;
+      return 0 ;
+   }
+#ifdef BRICKKERNEL
+/*
+ *   A brick's slices go in d[1..8] with the one past them in d[9] (or
+ *   d[0] going the other way), and the neighboring brick in d[11..18]
+ *   with d[19] or d[10].
+ */
+   const int POOL = 256 ;
+   vector<unsigned int> pool(POOL * 20) ;
+   unsigned int seed = 1 ;
+   int bad = 0 ;
+   for (int n=0; n<count; n++) {
+      unsigned int d[20], a[8], b[8] ;
+      brickrandom(d, 20, seed, 1 + n % 15) ;
+      brickfunc01(d+1, d[9], d+11, d[19], brickborn, bricksurvive, a) ;
+      bricktable01(ruletable, d+1, d[9], d+11, d[19], b) ;
+      bad += (memcmp(a, b, sizeof(a)) != 0) ;
+      brickfunc10(d+1, d[0], d+11, d[10], brickborn, bricksurvive, a) ;
+      bricktable10(ruletable, d+1, d[0], d+11, d[10], b) ;
+      bad += (memcmp(a, b, sizeof(a)) != 0) ;
+      if (n < POOL)
+         memcpy(&pool[n * 20], d, sizeof(d)) ;
+   }
+   int npool = (count < POOL ? count : POOL) ;
+   double rate[2][2] ;
+   unsigned int sink = 0 ;
+   for (int phase=0; phase<2; phase++)
+      for (int kern=0; kern<2; kern++) {
+         double start = gollySecondCount() ;
+         for (int n=0; n<count; n++) {
+            const unsigned int *d = &pool[(n % npool) * 20] ;
+            unsigned int out[8] ;
+            if (phase == 0) {
+               if (kern)
+                  brickfunc01(d+1, d[9], d+11, d[19], brickborn,
+                              bricksurvive, out) ;
+               else
+                  bricktable01(ruletable, d+1, d[9], d+11, d[19], out) ;
+            } else {
+               if (kern)
+                  brickfunc10(d+1, d[0], d+11, d[10], brickborn,
+                              bricksurvive, out) ;
+               else
+                  bricktable10(ruletable, d+1, d[0], d+11, d[10], out) ;
+            }
+            sink += out[n & 7] ;
+         }
+         rate[phase][kern] = count * 1e-6 /
+                                  (gollySecondCount() - start + 1e-9) ;
+      }
+   bricksink = sink ;   // so the timing loops are not optimized away
+   char buf[200] ;
+   snprintf(buf, sizeof(buf),
+      "%s kernel %.3g/%.3g M bricks/s (0->1/1->0), table %.3g/%.3g; "
+      "%d of %d differ", brickkernelname, rate[0][1], rate[1][1],
+      rate[0][0], rate[1][0], bad, 2 * count) ;
+   lifestatus(buf) ;
+   return bad ;
+#else
+   return 0 ;
+#endif
+}
+/*
+ *   The kernel needs this many slices of a brick to recompute before it
+ *   beats the table.
+ */
+const int BRICKKERNELMIN = 3 ;
 /*
  *   This is our monster subroutine that, with its mirror below, accounts for
  *   about 90% of the runtime.  It handles recomputation for a 32x32 tile.
@@ -441,6 +953,32 @@ int qlifealgo::p01(tile *p, tile *pr, tile *pd, tile *prd) {
          p->flags |= 1 << i ;
          if (b == emptybrick)
             p->b[i] = b = newbrick() ;
+#ifdef BRICKKERNEL
+/*
+ *   If enough slices need it, the kernel computes the whole brick and we
+ *   just track the changes as below.
+ */
+         if (brickkernel && bc[recomp] >= BRICKKERNELMIN) {
+            unsigned int nv[8] ;
+            brickfunc01(b->d, rb->d[0], db->d, rdb->d[0],
+                        brickborn, bricksurvive, nv) ;
+            for (j=7; ; j--) {
+               int delta = 0 ;
+               if (recomp & 1) {
+                  delta = (b->d[j + 8] ^ nv[j]) | deltaforward ;
+                  b->d[j + 8] = nv[j] ;
+               }
+               maska = cdelta | (delta & 0x33333333) ;
+               maskb = maska | -maska ;
+               maskprev = (maskprev << 1) |
+                          ((maskb >> 9) & 0x400000) | (maskb & 0x80) ;
+               if (recomp == 0)
+                  break ;
+               cdelta = delta ;
+               recomp >>= 1 ;
+            }
+         } else {
+#endif
 /*
  *   If we need to recompute the end slice, now is a good time to get the
  *   right neighbor's data.
@@ -520,6 +1058,9 @@ int qlifealgo::p01(tile *p, tile *pr, tile *pd, tile *prd) {
             recomp >>= 1 ;
             j-- ;
          }
+#ifdef BRICKKERNEL
+         }
+#endif
 /*
  *   Finally done with that brick!  Update our changing for the next
  *   call to p10, and or-in any changes to the lower two rows that we saw
@@ -566,6 +1107,28 @@ int qlifealgo::p10(tile *plu, tile *pu, tile *pl, tile *p) {
          p->flags |= 1 << i ;
          if (b == emptybrick)
             p->b[i] = b = newbrick() ;
+#ifdef BRICKKERNEL
+         if (brickkernel && bc[recomp] >= BRICKKERNELMIN) {
+            unsigned int nv[8] ;
+            brickfunc10(b->d + 8, lb->d[15], ub->d + 8, lub->d[15],
+                        brickborn, bricksurvive, nv) ;
+            for (j=0; ; j++) {
+               int delta = 0 ;
+               if (recomp & 1) {
+                  delta = (b->d[j] ^ nv[j]) | deltaforward ;
+                  b->d[j] = nv[j] ;
+               }
+               maska = cdelta | (delta & 0xcccccccc) ;
+               maskprev = (maskprev << 1) |
+                          (((maska | - maska) >> 9) & 0x400000) |
+                          ((((maska >> 24) | 0x100) - 1) & 0x100) ;
+               if (recomp == 0)
+                  break ;
+               cdelta = delta ;
+               recomp >>= 1 ;
+            }
+         } else {
+#endif
          if (recomp & 1) {
             j = 0 ;
             traildata = lb->d[15] ;
@@ -616,6 +1179,9 @@ int qlifealgo::p10(tile *plu, tile *pu, tile *pl, tile *p) {
             recomp >>= 1 ;
             j++ ;
          }
+#ifdef BRICKKERNEL
+         }
+#endif
          p->c[i+1] =
            (short)(((p->c[i+1] & 0x100) << 1) | (maskprev >> (14 + j))) ;
          p->c[i] |= (maskprev >> j) & 0x1ff ;
@@ -705,23 +1271,13 @@ void qlifealgo::markglobalchange() {
    deltaforward = 0xffffffff ;
 }
 /*
- *   This subroutine sets a bit at a particular location.
- *
- *   We walk down the tree to the particular bit, setting changing flags as
- *   we go.
+ *   Walk down the tree to the tile holding a cell, setting changing
+ *   flags as we go and allocating what is missing.  The coordinates
+ *   have already been flipped and shifted for the generation.
  */
-int qlifealgo::setcell(int x, int y, int newstate) {
-   if (newstate & ~1)
-      return -1 ;
-   y = - y ;
+tile *qlifealgo::touchtile(int x, int y, int odd) {
    supertile *b ;
-   tile *p ;
    int lev ;
-   int odd = generation.odd() ;
-   if (odd) {
-      x-- ;
-      y-- ;
-   }
    while (x < min || x > max || y < min || y > max)
       uproot() ;
    int xdel = (x >> 5) - minlow32 ;
@@ -762,9 +1318,27 @@ int qlifealgo::setcell(int x, int y, int newstate) {
       lev -= 1 ;
       b = b->d[i] ;
    }
+   return (tile *)b ;
+}
+/*
+ *   This subroutine sets a bit at a particular location.
+ *
+ *   We walk down the tree to the particular bit, setting changing flags as
+ *   we go.
+ */
+int qlifealgo::setcell(int x, int y, int newstate) {
+   if (newstate & ~1)
+      return -1 ;
+   y = - y ;
+   tile *p ;
+   int odd = generation.odd() ;
+   if (odd) {
+      x-- ;
+      y-- ;
+   }
+   p = touchtile(x, y, odd) ;
    x &= 31 ;
    y &= 31 ;
-   p = (tile *)b ;
    if (p->b[(y >> 3) & 0x3] == emptybrick)
       p->b[(y >> 3) & 0x3] = newbrick() ;
    if (odd) {
@@ -795,6 +1369,73 @@ int qlifealgo::setcell(int x, int y, int newstate) {
    deltaforward = 0xffffffff ;
    return 0 ;
 }
+/*
+ *   Set a row of cells a tile at a time, walking down the tree once or
+ *   twice per tile rather than once per cell.  The flags set on the way
+ *   down depend on whether a cell is on the edge of a tile or supertile,
+ *   and only the leftmost or rightmost cell set within a tile can be, so
+ *   walking down for those two covers all the others.
+ */
+int qlifealgo::setcellrow(int y, const cellrun *runs, int nruns) {
+   y = - y ;
+   int odd = generation.odd() ;
+   if (odd)
+      y-- ;
+   int yb = (y >> 3) & 0x3 ;
+   int sh = 31 - (y & 7) * 4 ;
+   int r = 0, done = 0 ;    // cells of runs[r] already set
+   while (r < nruns) {
+      int tx = (runs[r].x - odd + done) >> 5 ;
+      int lo = 0, hi = 0, cells = 0 ;
+      unsigned int set[8] = { 0, 0, 0, 0, 0, 0, 0, 0 } ;
+      unsigned int clr[8] = { 0, 0, 0, 0, 0, 0, 0, 0 } ;
+      int mor = 0 ;
+      for (; r < nruns; r++, done = 0) {
+         if (runs[r].state & ~1)
+            return -1 ;
+         int x = runs[r].x - odd + done ;
+         if (done < runs[r].n && (x >> 5) != tx)
+            break ;
+         int len = 32 - (x & 31) ;
+         if (len > runs[r].n - done)
+            len = runs[r].n - done ;
+         if (len <= 0)
+            continue ;
+         unsigned int *bits = (runs[r].state ? set : clr) ;
+         for (int i=x; i<x+len; i++) {
+            bits[(i >> 2) & 0x7] |= 1U << (sh - (i & 3)) ;
+            if (odd)
+               mor |= ((i & 2) ? 3 : 1) << ((i >> 2) & 0x7) ;
+            else
+               mor |= ((i & 2) ? 1 : 3) << (7 - ((i >> 2) & 0x7)) ;
+         }
+         if (cells == 0 || x < lo)
+            lo = x ;
+         if (cells == 0 || x + len - 1 > hi)
+            hi = x + len - 1 ;
+         cells += len ;
+         done += len ;
+         if (done < runs[r].n)
+            break ;
+      }
+      if (cells == 0)
+         continue ;
+      tile *p = touchtile(lo, y, odd) ;
+      if (hi != lo)
+         touchtile(hi, y, odd) ;
+      if (p->b[yb] == emptybrick)
+         p->b[yb] = newbrick() ;
+      unsigned int *d = p->b[yb]->d + (odd ? 8 : 0) ;
+      for (int i=0; i<8; i++)
+         d[i] = (d[i] | set[i]) & ~clr[i] ;
+      p->c[yb + 1] |= mor ;
+      p->flags = -1 ;
+      if (odd ? (y & 6) == 6 : (y & 6) == 0)
+         p->c[odd ? yb + 2 : yb] |= mor ;
+   }
+   deltaforward = 0xffffffff ;
+   return 0 ;
+}
 /*
  *   This subroutine gets a bit at a particular location.
  */
@@ -925,6 +1566,113 @@ int qlifealgo::nextcell(int x, int y, supertile *n, int lev) {
    }
    return -1 ;
 }
+/*
+ *   Runs of live cells in a rectangle.  Rather than calling nextcell for
+ *   every run (which walks down from the root each time) we carry a band
+ *   of supertiles that share the same rows:  odd levels widen the band
+ *   to their eight children, even levels split it into eight sub-bands
+ *   which we visit from the top (highest y) down, so the runs come out
+ *   in row order.  Positions are tile indices from minlow32, kept in 64
+ *   bits since a deep tree spans more than an int.  Unlike nextcell we
+ *   never uproot; the parts of the rectangle outside the tree are empty.
+ */
+struct qcellband {
+   supertile *n ;
+   G_INT64 x ;     // tile index of the left edge
+} ;
+static inline G_INT64 qtilewd(int lev) {
+   return (G_INT64)1 << (3 * ((lev + 1) >> 1)) ;
+}
+static inline G_INT64 qtileht(int lev) {
+   return (G_INT64)1 << (3 * (lev >> 1)) ;
+}
+/*
+ *   r holds the rectangle in internal coordinates:  xlo, xhi, ylo, yhi.
+ */
+void qlifealgo::bandruns(const vector<qcellband> &band, G_INT64 ylo, int lev,
+                         G_INT64 *r, vector<cellspan> &spans) {
+   if (lev == 0) {
+      int add = (generation.odd() ? 8 : 0) ;
+      for (int row=31; row>=0; row--) {
+         G_INT64 y = (ylo + minlow32) * 32 + row ;
+         if (y < r[2] || y > r[3])
+            continue ;
+         int uy = (int)(- y - (add ? 1 : 0)) ;
+         int sh = (7 - (row & 7)) * 4 ;
+         for (int j=0; j<(int)band.size(); j++) {
+            brick *br = ((tile *)band[j].n)->b[(row >> 3) & 3] ;
+            if (br == emptybrick)
+               continue ;
+            G_INT64 x0 = (band[j].x + minlow32) * 32 ;
+            for (int i=0; i<8; i++) {
+               int t = (br->d[i+add] >> sh) & 15 ;
+               if (t == 0)
+                  continue ;
+               for (int k=0; k<4; k++) {
+                  G_INT64 x = x0 + 4 * i + k ;
+                  if ((t & (8 >> k)) == 0 || x < r[0] || x > r[1])
+                     continue ;
+                  int ux = (int)(x + (add ? 1 : 0)) ;
+                  if (!spans.empty() && spans.back().y == uy &&
+                      spans.back().x + spans.back().n == ux) {
+                     spans.back().n++ ;
+                  } else {
+                     cellspan s = { ux, uy, 1, 1 } ;
+                     spans.push_back(s) ;
+                  }
+               }
+            }
+         }
+      }
+      return ;
+   }
+   vector<qcellband> sub ;
+   supertile *z = nullroots[lev-1] ;
+   if (lev & 1) {
+      G_INT64 w = qtilewd(lev-1) ;
+      for (int j=0; j<(int)band.size(); j++)
+         for (int i=0; i<8; i++) {
+            G_INT64 x = band[j].x + i * w ;
+            if (band[j].n->d[i] == z || (x + minlow32) * 32 > r[1] ||
+                (x + w + minlow32) * 32 - 1 < r[0])
+               continue ;
+            qcellband b = { band[j].n->d[i], x } ;
+            sub.push_back(b) ;
+         }
+      if (!sub.empty())
+         bandruns(sub, ylo, lev-1, r, spans) ;
+      return ;
+   }
+   G_INT64 h = qtileht(lev-1) ;
+   for (int i=7; i>=0; i--) {
+      G_INT64 y = ylo + i * h ;
+      if ((y + minlow32) * 32 > r[3] || (y + h + minlow32) * 32 - 1 < r[2])
+         continue ;
+      sub.clear() ;
+      for (int j=0; j<(int)band.size(); j++)
+         if (band[j].n->d[i] != z) {
+            qcellband b = { band[j].n->d[i], band[j].x } ;
+            sub.push_back(b) ;
+         }
+      if (!sub.empty())
+         bandruns(sub, y, lev-1, r, spans) ;
+   }
+}
+void qlifealgo::getcellruns(int top, int left, int bottom, int right,
+                            vector<cellspan> &spans) {
+   if (root == nullroot || top > bottom || left > right)
+      return ;
+   G_INT64 odd = generation.odd() ;
+   G_INT64 r[4] ;
+   r[0] = left - odd ;
+   r[1] = right - odd ;
+   r[2] = - (G_INT64)bottom - odd ;
+   r[3] = - (G_INT64)top - odd ;
+   vector<qcellband> band ;
+   qcellband b = { root, 0 } ;
+   band.push_back(b) ;
+   bandruns(band, 0, rootlev, r, spans) ;
+}
 /*
  *   This subroutine calculates the population count of the universe.  It
  *   uses dirty bits number 1 and 2 of supertiles.
@@ -1124,7 +1872,9 @@ void qlifealgo::dogen() {
       while (uproot_needed())
          uproot() ;
    }
-   if (generation.odd())
+   if (lifethreads::getthreadcount() > 1 && rootlev > parlevel)
+      pardogen(generation.odd()) ;
+   else if (generation.odd())
       doquad10(root, nullroot, nullroot, nullroot, rootlev) ;
    else
       doquad01(root, nullroot, nullroot, nullroot, rootlev) ;
@@ -1206,6 +1956,7 @@ const char *qlifealgo::setrule(const char *s) {
    
    // ruletable is set in step(), but play safe
    ruletable = qliferules.rule0 ;
+   setbrickrule() ;
    
    if (qliferules.isHexagonal())
       grid_type = HEX_GRID;
@@ -9,6 +9,9 @@
 #include "lifealgo.h"
 #include "liferules.h"
 #include <vector>
+struct qlifeplan ;
+struct qlifetask ;
+struct qcellband ;
 /*
  *   The smallest unit of the universe is the `slice', which is a
  *   4 (horizontal) by 8 (vertical) chunk of the world.  Each slice
@@ -192,8 +195,11 @@ public:
    virtual ~qlifealgo() ;
    virtual void clearall() ;
    virtual int setcell(int x, int y, int newstate) ;
+   virtual int setcellrow(int y, const cellrun *runs, int nruns) ;
    virtual int getcell(int x, int y) ;
    virtual int nextcell(int x, int y, int &v) ;
+   virtual void getcellruns(int top, int left, int bottom, int right,
+                            vector<cellspan> &spans) ;
    // call after setcell/clearcell calls
    virtual void endofpattern() {
      // AKT: unnecessary (and prevents shrinking selection while generating)
@@ -221,19 +227,39 @@ public:
    virtual const char *writeNativeFormat(std::ostream &, char *) {
       return "No native format for qlifealgo yet." ;
    }
+   virtual void getstats(lifestats &s) {
+      lifealgo::getstats(s) ;
+      s.memory = (double)usedmemory ;
+   }
    static void doInitializeAlgoInfo(staticAlgoInfo &) ;
+   /*
+    *   Supertiles at this level are handed to threads as separate tasks
+    *   when the pool in util.h has more than one thread; 0 means tiles.
+    */
+   static void setParallelLevel(int lev) ;
+   void runtask(qlifetask *t) ;
+   /*
+    *   Compare the bit-sliced brick kernel with the table on random
+    *   bricks and time both; returns the number of mismatches.
+    */
+   int brickcheck(int count) ;
 private:
    linkedmem *filllist(int size) ;
    brick *newbrick() ;
    tile *newtile() ;
    supertile *newsupertile(int lev) ;
    void uproot() ;
+   tile *touchtile(int x, int y, int odd) ;
    int doquad01(supertile *zis, supertile *edge,
                 supertile *par, supertile *cor, int lev) ;
    int doquad10(supertile *zis, supertile *edge,
                 supertile *par, supertile *cor, int lev) ;
    int p01(tile *p, tile *pr, tile *pd, tile *prd) ;
    int p10(tile *plu, tile *pu, tile *pl, tile *p) ;
+   void setbrickrule() ;
+   void pardogen(int phase) ;
+   void planquad(qlifeplan &pl, supertile *zis, supertile *edge,
+                 supertile *par, supertile *cor, int lev, int up, int shift) ;
    G_INT64 find_set_bits(supertile *p, int lev, int gm1) ;
    int isEmpty(supertile *p, int lev, int gm1) ;
    supertile *mdelete(supertile *p, int lev) ;
@@ -245,6 +271,8 @@ private:
    void BlitCells(supertile *p, int xoff, int yoff, int wd, int ht, int lev) ;
    void ShrinkCells(supertile *p, int xoff, int yoff, int wd, int ht, int lev) ;
    int nextcell(int x, int y, supertile *n, int lev) ;
+   void bandruns(const vector<qcellband> &band, G_INT64 ylo, int lev,
+                 G_INT64 *r, vector<cellspan> &spans) ;
    void fill_ll(int d) ;
    int lowsub(vector<supertile*> &src, vector<supertile*> &dst, int lev) ;
    int highsub(vector<supertile*> &src, vector<supertile*> &dst, int lev) ;
@@ -277,5 +305,8 @@ private:
    int llbits, llsize ;
    char *llxb, *llyb ;
    liferules qliferules ;
+   int brickkernel, brickborn, bricksurvive ;
+   qlifeplan *plan ;   // nonzero while a generation runs on threads
+   static int parlevel ;
 } ;
 #endif
@@ -450,6 +450,8 @@ void qlifealgo::fill_ll(int d) {
 void qlifealgo::draw(viewport &viewarg, liferender &renderarg) {
    memset(bigbuf, 0, sizeof(ibigbuf)) ;
    renderer = &renderarg ;
+   if (renderer->retained())
+      renderer->damage(0, 0, viewarg.getwidth(), viewarg.getheight()) ;
 
    if (!renderer->justState()) {
       // AKT: get cell colors and alpha values for dead and live pixels
@@ -19,11 +19,9 @@
 bool getedges = false;              // find pattern edges?
 bigint top, left, bottom, right;    // the pattern edges
 
-#ifdef __APPLE__
-#define BUFFSIZE 4096      // 4K is best for Mac OS X
-#else
-#define BUFFSIZE 8192      // 8K is best for Windows and other platforms???
-#endif
+// big reads let the line splitting below run over long stretches of
+// the buffer; huge patterns are hundreds of megabytes
+#define BUFFSIZE (1 << 20)
 
 #ifdef ZLIB
 gzFile zinstream ;
@@ -36,60 +34,67 @@ int buffpos, bytesread, prevchar;
 
 long filesize;             // length of file in bytes
 
-// use buffered getchar instead of slow fgetc
-// don't override the "getchar" name which is likely to be a macro
-int mgetchar() {
-   if (buffpos == BUFFSIZE) {
-      double filepos;
-      #ifdef ZLIB
-         bytesread = gzread(zinstream, filebuff, BUFFSIZE);
-         #if ZLIB_VERNUM >= 0x1240
-            // gzoffset is only available in zlib 1.2.4 or later
-            filepos = gzoffset(zinstream);
-         #else
-            // use an approximation of file position if file is compressed
-            filepos = gztell(zinstream);
-            if (filepos > 0 && gzdirect(zinstream) == 0) filepos /= 4;
-         #endif
+// refill filebuff once it has all been used
+static void fillbuff() {
+   double filepos;
+   #ifdef ZLIB
+      bytesread = gzread(zinstream, filebuff, BUFFSIZE);
+      #if ZLIB_VERNUM >= 0x1240
+         // gzoffset is only available in zlib 1.2.4 or later
+         filepos = gzoffset(zinstream);
       #else
-         bytesread = fread(filebuff, 1, BUFFSIZE, pattfile);
-         filepos = ftell(pattfile);
+         // use an approximation of file position if file is compressed
+         filepos = gztell(zinstream);
+         if (filepos > 0 && gzdirect(zinstream) == 0) filepos /= 4;
       #endif
-      buffpos = 0;
-      lifeabortprogress(filepos / filesize, "");
-   }
-   if (buffpos >= bytesread) return EOF;
-   return filebuff[buffpos++];
+   #else
+      bytesread = fread(filebuff, 1, BUFFSIZE, pattfile);
+      filepos = ftell(pattfile);
+   #endif
+   buffpos = 0;
+   lifeabortprogress(filepos / filesize, "");
 }
 
-// use getline instead of fgets so we can handle DOS/Mac/Unix line endings
+// use getline instead of fgets so we can handle DOS/Mac/Unix line endings;
+// rather than going a char at a time we copy up to the next CR or LF,
+// which memchr finds quickly
 char *getline(char *line, int maxlinelen) {
    int i = 0;
    while (i < maxlinelen) {
-      int ch = mgetchar();
+      if (buffpos == BUFFSIZE) fillbuff();
       if (isaborted()) return NULL;
-      switch (ch) {
-         case CR:
-            prevchar = CR;
-            line[i] = 0;
-            return line;
-         case LF:
-            if (prevchar != CR) {
-               prevchar = LF;
-               line[i] = 0;
-               return line;
-            }
-            // if CR+LF (DOS) then ignore the LF
-            break;
-         case EOF:
-            if (i == 0) return NULL;
-            line[i] = 0;
-            return line;
-         default:
-            prevchar = ch;
-            line[i++] = (char) ch;
-            break;
+      if (buffpos >= bytesread) {
+         // EOF
+         if (i == 0) return NULL;
+         line[i] = 0;
+         return line;
+      }
+      char *p = filebuff + buffpos;
+      int avail = bytesread - buffpos;
+      if (avail > maxlinelen - i) avail = maxlinelen - i;
+      char *eol = (char *)memchr(p, LF, avail);
+      int n = (eol ? (int)(eol - p) : avail);
+      eol = (char *)memchr(p, CR, n);
+      if (eol) n = (int)(eol - p);
+      if (n > 0) {
+         memcpy(line + i, p, n);
+         i += n;
+         buffpos += n;
+         prevchar = p[n-1];
       }
+      if (n == avail) continue;
+      buffpos++;
+      if (p[n] == CR) {
+         prevchar = CR;
+         line[i] = 0;
+         return line;
+      }
+      if (prevchar != CR) {
+         prevchar = LF;
+         line[i] = 0;
+         return line;
+      }
+      // if CR+LF (DOS) then ignore the LF
    }
    line[i] = 0;      // silently truncate long line
    return line;
@@ -163,11 +168,25 @@ void ParseXRLELine(char *line, int *xoff, int *yoff, bool *sawpos, bigint &gen)
    }
 }
 
+/*
+ *   Set the runs of cells gathered for one row of an RLE pattern.
+ */
+static const char *flushrow(lifealgo &imp, int y, vector<cellrun> &row) {
+   if (row.empty())
+      return 0 ;
+   int err = imp.setcellrow(y, &row[0], (int)row.size()) ;
+   row.clear() ;
+   if (err < 0)
+      return "Cell state out of range for this algorithm" ;
+   return 0 ;
+}
+
 /*
  *   Read an RLE pattern into given life algorithm implementation.
  */
 const char *readrle(lifealgo &imp, char *line) {
    int n=0, x=0, y=0 ;
+   vector<cellrun> row ;
    char *p ;
    char *ruleptr;
    const char *errmsg;
@@ -266,10 +285,12 @@ const char *readrle(lifealgo &imp, char *line) {
                if (c == 'b' || c == '.') {
                   x += n ;
                } else if (c == '$') {
+                  if ((errmsg = flushrow(imp, yoff + y, row)) != 0)
+                     return errmsg ;
                   x = 0 ;
                   y += n ;
                } else if (c == '!') {
-                  return 0;
+                  return flushrow(imp, yoff + y, row) ;
                } else if (('o' <= c && c <= 'y') || ('A' <= c && c <= 'X')) {
                   int state = -1 ;
                   if (c == 'o')
@@ -290,16 +311,18 @@ const char *readrle(lifealgo &imp, char *line) {
                         p-- ;
                      }
                   }
-                  // write run of cells to grid checking cells are within any bounded grid
+                  // add run of cells to row checking cells are within any bounded grid
                   if (ght == 0 || y < ght) {
-                     while (n-- > 0) {
-                        if (gwd == 0 || x < gwd) {  
-                           if (imp.setcell(xoff + x, yoff + y, state) < 0)
-                              return "Cell state out of range for this algorithm" ;
-                        }
-                        x++;
-                     }
+                     cellrun run ;
+                     run.x = xoff + x ;
+                     run.n = n ;
+                     run.state = state ;
+                     if (gwd > 0 && x + n > gwd)
+                        run.n = (x < gwd ? gwd - x : 0) ;
+                     if (run.n > 0)
+                        row.push_back(run) ;
                   }
+                  x += n ;
                }
                n = 0 ;
             }
@@ -307,7 +330,7 @@ const char *readrle(lifealgo &imp, char *line) {
       }
    } while (getline(line, LINESIZE));
 
-   return 0;
+   return flushrow(imp, yoff + y, row);
 }
 
 /*
@@ -18,10 +18,10 @@ int ruleloaderalgo::NumCellStates()
         return LocalRuleTree->NumCellStates();
 }
 
-static FILE* OpenRuleFile(std::string& rulename, const char* dir)
+static FILE* OpenRuleFile(std::string& rulename, const char* dir, std::string& path)
 {
-    // try to open rulename.rule in given dir
-    std::string path = dir;
+    // try to open rulename.rule in given dir and set path
+    path = dir;
     int istart = (int)path.size();
     path += rulename + ".rule";
     // change "dangerous" characters to underscores
@@ -72,7 +72,7 @@ void ruleloaderalgo::SetAlgoVariables(RuleTypes ruletype)
     ghashbase::setrule("not used");
 }
 
-const char* ruleloaderalgo::LoadTableOrTree(FILE* rulefile, const char* rule)
+const char* ruleloaderalgo::LoadTableOrTree(FILE* rulefile, const char* rule, const std::string& path)
 {
     const char *err;
     const int MAX_LINE_LEN = 4096;
@@ -85,7 +85,7 @@ const char* ruleloaderalgo::LoadTableOrTree(FILE* rulefile, const char* rule)
     while (lr.fgets(line_buffer,MAX_LINE_LEN) != 0) {
         lineno++;
         if (strcmp(line_buffer, "@TABLE") == 0) {
-            err = LocalRuleTable->LoadTable(rulefile, lineno, '@', rule);
+            err = LocalRuleTable->LoadTable(rulefile, lineno, '@', rule, path.c_str());
             // err is the result of setrule(rule)
             if (err == NULL) {
                 SetAlgoVariables(TABLE);
@@ -132,20 +132,21 @@ const char* ruleloaderalgo::setrule(const char* s)
     
     // look for .rule file in user's rules dir then in Golly's rules dir
     bool inuser = true;
-    FILE* rulefile = OpenRuleFile(rulename, lifegetuserrules());
+    std::string path;
+    FILE* rulefile = OpenRuleFile(rulename, lifegetuserrules(), path);
     if (!rulefile) {
         inuser = false;
-        rulefile = OpenRuleFile(rulename, lifegetrulesdir());
+        rulefile = OpenRuleFile(rulename, lifegetrulesdir(), path);
     }
     if (rulefile) {
-        err = LoadTableOrTree(rulefile, s);
+        err = LoadTableOrTree(rulefile, s, path);
         if (inuser && err && (strcmp(err, noTABLEorTREE) == 0)) {
             // if .rule file was found in user's rules dir but had no
             // @TABLE or @TREE section then we look in Golly's rules dir
             // (this lets user override the colors/icons in a supplied .rule
             // file without having to copy the entire file)
-            rulefile = OpenRuleFile(rulename, lifegetrulesdir());
-            if (rulefile) err = LoadTableOrTree(rulefile, s);
+            rulefile = OpenRuleFile(rulename, lifegetrulesdir(), path);
+            if (rulefile) err = LoadTableOrTree(rulefile, s, path);
         }
         return err;
     }
@@ -209,6 +210,16 @@ state ruleloaderalgo::slowcalc(state nw, state n, state ne, state w, state c,
         return LocalRuleTree->slowcalc(nw, n, ne, w, c, e, sw, s, se);
 }
 
+void ruleloaderalgo::slowcalcblock(const state *in, int stride, state *out,
+                                   int n)
+{
+    // one call per block to the table or tree's own kernel
+    if (rule_type == TABLE)
+        LocalRuleTable->slowcalcblock(in, stride, out, n);
+    else // rule_type == TREE
+        LocalRuleTree->slowcalcblock(in, stride, out, n);
+}
+
 static lifealgo* creator()
 {
     return new ruleloaderalgo();
@@ -6,6 +6,7 @@
 #include "ghashbase.h"
 #include "ruletable_algo.h"
 #include "ruletreealgo.h"
+#include <string>
 /**
  *   This algorithm loads rule data from external files.
  */
@@ -17,6 +18,8 @@ public:
     virtual ~ruleloaderalgo();
     virtual state slowcalc(state nw, state n, state ne, state w, state c,
                            state e, state sw, state s, state se);
+    virtual void slowcalcblock(const state *in, int stride, state *out,
+                               int n);
     virtual const char* setrule(const char* s);
     virtual const char* getrule();
     virtual const char* DefaultRule();
@@ -31,7 +34,7 @@ protected:
     enum RuleTypes {TABLE, TREE} rule_type;
     
     void SetAlgoVariables(RuleTypes ruletype);
-    const char* LoadTableOrTree(FILE* rulefile, const char* rule);
+    const char* LoadTableOrTree(FILE* rulefile, const char* rule, const std::string& path);
 };
 
 extern const char* noTABLEorTREE;
@@ -29,13 +29,16 @@ bool ruletable_algo::IsDefaultRule(const char* rulename)
 static FILE* static_rulefile = NULL;
 static int static_lineno = 0;
 static char static_endchar = 0;
+static const char* static_rulepath = NULL;
 
-const char* ruletable_algo::LoadTable(FILE* rulefile, int lineno, char endchar, const char* s)
+const char* ruletable_algo::LoadTable(FILE* rulefile, int lineno, char endchar, const char* s,
+                                      const char* path)
 {
     // set static vars so LoadRuleTable() will load table data from .rule file
     static_rulefile = rulefile;
     static_lineno = lineno;
     static_endchar = endchar;
+    static_rulepath = path;
     
     const char* err = setrule(s);   // calls LoadRuleTable
     
@@ -43,6 +46,7 @@ const char* ruletable_algo::LoadTable(FILE* rulefile, int lineno, char endchar,
     static_rulefile = NULL;
     static_lineno = 0;
     static_endchar = 0;
+    static_rulepath = NULL;
     
     return err;
 }
@@ -539,6 +543,12 @@ string ruletable_algo::LoadRuleTable(string rule)
    this->neighborhood = neighborhood;
    this->n_states = n_states;
    PackTransitions(symmetries,n_inputs,transition_table);
+   if (isDefaultRule)
+      CompileTransitions("");
+   else if (static_rulefile)
+      CompileTransitions(static_rulepath ? static_rulepath : "");
+   else
+      CompileTransitions(full_filename);
 
    return string(""); // success
 }
@@ -671,6 +681,241 @@ void ruletable_algo::PackTransition(const vector< vector<state> > & inputs,
     }
 }
 
+// The compiled table for a .rule or .table file is saved in the user's
+// rules folder, wherever the rule itself came from, in a file named
+// after it with "cache" added; nothing is saved if there is no user
+// rules folder.  It starts with this line and then holds the hash of
+// the packed table it came from, so a cache that no longer matches its
+// table is simply rebuilt.
+static const char compiled_magic[] = "Golly compiled rule table 1\n";
+// compile to a dense table if it has at most this many entries
+static const unsigned int MAX_DENSE = 1 << 20;
+// give up on the decision tree if it gets bigger than this
+static const size_t MAX_TREE = 1 << 24;
+
+unsigned long long ruletable_algo::TransitionsHash()
+{
+    // FNV-1a over everything the compiled table depends on
+    unsigned long long h = 0xcbf29ce484222325ULL;
+    const unsigned long long prime = 0x100000001b3ULL;
+    h = (h ^ this->n_states) * prime;
+    h = (h ^ (unsigned int)this->neighborhood) * prime;
+    h = (h ^ (unsigned long long)this->output.size()) * prime;
+    for(unsigned int i=0;i<this->output.size();i++)
+        h = (h ^ this->output[i]) * prime;
+    for(unsigned int iNbor=0;iNbor<this->lut.size();iNbor++)
+        for(unsigned int iState=0;iState<this->n_states;iState++)
+            for(unsigned int iRuleC=0;iRuleC<this->n_compressed_rules;iRuleC++)
+                h = (h ^ this->lut[iNbor][iState][iRuleC]) * prime;
+    return h;
+}
+
+// Returns the tree entry for the given input onwards, given the rules
+// that match all the inputs before it; c is the center cell if that has
+// been seen (it is input 0).  The first candidate rule is the one that
+// wins, so once it matches anything from here on the output is known.
+int ruletable_algo::CompileNode(unsigned int level, const vector<TBits>& candidates, state c)
+{
+    const unsigned int n_bits = (unsigned int)(sizeof(TBits)*8);
+    if (level > 0) {
+        unsigned int iRuleC = 0;
+        while (iRuleC < this->n_compressed_rules && candidates[iRuleC] == 0)
+            iRuleC++;
+        if (iRuleC == this->n_compressed_rules)
+            return ~(int)c; // no rule matches: no change
+        unsigned int iBit = 0;
+        while (!(candidates[iRuleC] & ((TBits)1 << iBit)))
+            iBit++;
+        unsigned int iRule = iRuleC*n_bits + iBit;
+        if (this->wild_from[iRule] <= level)
+            return ~(int)this->output[iRule];
+    }
+    // (we only get here with level < n_inputs, since every rule matches
+    // anything after the last input)
+    vector<TBits> key(candidates);
+    key.push_back(level);
+    key.push_back(c);
+    map< vector<TBits>, int >::iterator found = this->compile_memo.find(key);
+    if (found != this->compile_memo.end())
+        return found->second;
+    vector<int> node(this->n_states);
+    vector<TBits> next(this->n_compressed_rules);
+    bool same = true;
+    for(unsigned int iState=0;iState<this->n_states && !this->compile_failed;iState++)
+    {
+        for(unsigned int iRuleC=0;iRuleC<this->n_compressed_rules;iRuleC++)
+            next[iRuleC] = candidates[iRuleC] & this->lut[level][iState][iRuleC];
+        node[iState] = CompileNode(level+1, next, level == 0 ? (state)iState : c);
+        if (node[iState] != node[0])
+            same = false;
+    }
+    int r;
+    if (this->compile_failed)
+        return 0;
+    if (same && node[0] < 0) {
+        // every value of this input gives the same output
+        r = node[0];
+    } else {
+        map< vector<int>, int >::iterator it = this->compile_nodes.find(node);
+        if (it != this->compile_nodes.end()) {
+            r = it->second;
+        } else {
+            r = (int)this->compiled_tree.size();
+            this->compiled_tree.insert(this->compiled_tree.end(), node.begin(), node.end());
+            this->compile_nodes[node] = r;
+            if (this->compiled_tree.size() > MAX_TREE)
+                this->compile_failed = true;
+        }
+    }
+    this->compile_memo[key] = r;
+    return r;
+}
+
+bool ruletable_algo::ReadCompiled(const string& filename, unsigned long long hash)
+{
+    FILE *f = fopen(filename.c_str(), "rb");
+    if (!f)
+        return false;
+    char magic[sizeof(compiled_magic)];
+    unsigned long long filehash;
+    int dense, root;
+    unsigned int size;
+    bool ok = fread(magic, 1, sizeof(compiled_magic)-1, f) == sizeof(compiled_magic)-1 &&
+              memcmp(magic, compiled_magic, sizeof(compiled_magic)-1) == 0 &&
+              fread(&filehash, sizeof(filehash), 1, f) == 1 && filehash == hash &&
+              fread(&dense, sizeof(dense), 1, f) == 1 &&
+              fread(&root, sizeof(root), 1, f) == 1 &&
+              fread(&size, sizeof(size), 1, f) == 1 && size > 0 && size <= MAX_TREE + 256;
+    if (ok && dense) {
+        unsigned long long n_dense = 1;
+        for(unsigned int i=0;i<this->lut.size() && n_dense<=MAX_DENSE;i++)
+            n_dense *= this->n_states;
+        ok = size == n_dense;
+    }
+    if (ok && dense) {
+        this->compiled_dense.resize(size);
+        ok = fread(&this->compiled_dense[0], sizeof(state), size, f) == size;
+        for(unsigned int i=0;ok && i<size;i++)
+            ok = this->compiled_dense[i] < this->n_states;
+    } else if (ok) {
+        this->compiled_tree.resize(size);
+        ok = fread(&this->compiled_tree[0], sizeof(int), size, f) == size;
+        // make sure every entry leads somewhere sensible
+        ok = ok && (root < 0 ? ~root < (int)this->n_states : root + this->n_states <= size);
+        for(unsigned int i=0;ok && i<size;i++) {
+            int e = this->compiled_tree[i];
+            ok = e < 0 ? ~e < (int)this->n_states : e + this->n_states <= size;
+        }
+        this->compiled_root = root;
+    }
+    fclose(f);
+    if (!ok) {
+        this->compiled_dense.clear();
+        this->compiled_tree.clear();
+    }
+    return ok;
+}
+
+void ruletable_algo::WriteCompiled(const string& filename, unsigned long long hash)
+{
+    FILE *f = fopen(filename.c_str(), "wb");
+    if (!f)
+        return; // no matter; we'll just compile it again next time
+    int dense = this->compiled_dense.empty() ? 0 : 1;
+    unsigned int size = (unsigned int)(dense ? this->compiled_dense.size() : this->compiled_tree.size());
+    bool ok = fwrite(compiled_magic, 1, sizeof(compiled_magic)-1, f) == sizeof(compiled_magic)-1 &&
+              fwrite(&hash, sizeof(hash), 1, f) == 1 &&
+              fwrite(&dense, sizeof(dense), 1, f) == 1 &&
+              fwrite(&this->compiled_root, sizeof(this->compiled_root), 1, f) == 1 &&
+              fwrite(&size, sizeof(size), 1, f) == 1;
+    if (ok && dense)
+        ok = fwrite(&this->compiled_dense[0], sizeof(state), size, f) == size;
+    else if (ok)
+        ok = fwrite(&this->compiled_tree[0], sizeof(int), size, f) == size;
+    if (fclose(f) != 0 || !ok)
+        remove(filename.c_str());
+}
+
+// Turns the packed table into a dense table or a decision tree, or
+// reads the result from the cache if that was made from the same table.
+// The cache for Rules/Codd.rule is Codd.rulecache in the user's rules
+// folder, since Golly's own Rules folder is often read-only; without a
+// user's rules folder nothing is cached.
+void ruletable_algo::CompileTransitions(const string& rulepath)
+{
+    const unsigned int n_bits = (unsigned int)(sizeof(TBits)*8);
+    unsigned int n_inputs = (unsigned int)this->lut.size();
+    this->compiled_dense.clear();
+    this->compiled_tree.clear();
+    this->compiled_root = 0;
+
+    unsigned long long hash = TransitionsHash();
+    string cachefile;
+    const char* userrules = lifegetuserrules();
+    if (!rulepath.empty() && userrules && userrules[0]) {
+        size_t slash = rulepath.find_last_of("/\\");
+        cachefile = string(userrules) + rulepath.substr(slash == string::npos ? 0 : slash + 1) + "cache";
+        if (ReadCompiled(cachefile, hash))
+            return;
+    }
+
+    // find the input from which each rule matches any state
+    this->wild_from.assign(this->output.size(), 0);
+    for(unsigned int iRule=0;iRule<this->output.size();iRule++)
+    {
+        TBits mask = (TBits)1 << (iRule % n_bits);
+        unsigned int iRuleC = iRule / n_bits;
+        unsigned int from = n_inputs;
+        while (from > 0) {
+            unsigned int iState = 0;
+            while (iState < this->n_states && (this->lut[from-1][iState][iRuleC] & mask))
+                iState++;
+            if (iState < this->n_states)
+                break;
+            from--;
+        }
+        this->wild_from[iRule] = from;
+    }
+
+    // every rule is a candidate before we look at any input; the bits
+    // past the last rule are never set in lut so they can be too
+    vector<TBits> all(this->n_compressed_rules, ~(TBits)0);
+    this->compile_failed = false;
+    this->compiled_root = CompileNode(0, all, 0);
+    this->compile_memo.clear();
+    this->compile_nodes.clear();
+    this->wild_from.clear();
+    if (this->compile_failed) {
+        this->compiled_tree.clear();
+        return;
+    }
+
+    // flatten the tree into a dense table if that is small enough
+    unsigned long long n_dense = 1;
+    for(unsigned int i=0;i<n_inputs && n_dense<=MAX_DENSE;i++)
+        n_dense *= this->n_states;
+    if (n_dense <= MAX_DENSE) {
+        this->compiled_dense.resize((size_t)n_dense);
+        for(unsigned int index=0;index<n_dense;index++)
+        {
+            unsigned int digits = index, divisor = (unsigned int)n_dense;
+            int at = this->compiled_root;
+            for(unsigned int i=0;i<n_inputs && at>=0;i++)
+            {
+                divisor /= this->n_states;
+                at = this->compiled_tree[at + digits / divisor];
+                digits %= divisor;
+            }
+            this->compiled_dense[index] = (state)~at;
+        }
+        this->compiled_tree.clear();
+        this->compiled_root = 0;
+    }
+
+    if (!cachefile.empty())
+        WriteCompiled(cachefile, hash);
+}
+
 const char* ruletable_algo::getrule() {
    return this->current_rule.c_str();
 }
@@ -680,7 +925,8 @@ const char* ruletable_algo::DefaultRule() {
 }
 
 ruletable_algo::ruletable_algo()
-   : n_states(8), neighborhood(vonNeumann), n_compressed_rules(0)
+   : n_states(8), neighborhood(vonNeumann), n_compressed_rules(0), compiled_root(0),
+     compile_failed(false)
 {
    maxCellStates = n_states;
 }
@@ -692,6 +938,49 @@ ruletable_algo::~ruletable_algo()
 // --- the update function ---
 state ruletable_algo::slowcalc(state nw, state n, state ne, state w, state c, state e,
                         state sw, state s, state se) 
+{
+   // the inputs in lut order
+   state in[9];
+   int n_inputs;
+   switch (this->neighborhood) {
+      default:
+      case vonNeumann:
+         in[0] = c; in[1] = n; in[2] = e; in[3] = s; in[4] = w;
+         n_inputs = 5;
+         break;
+      case Moore:
+         in[0] = c; in[1] = n; in[2] = ne; in[3] = e; in[4] = se;
+         in[5] = s; in[6] = sw; in[7] = w; in[8] = nw;
+         n_inputs = 9;
+         break;
+      case hexagonal:
+         in[0] = c; in[1] = n; in[2] = e; in[3] = se; in[4] = s;
+         in[5] = w; in[6] = nw;
+         n_inputs = 7;
+         break;
+      case oneDimensional:
+         in[0] = c; in[1] = w; in[2] = e;
+         n_inputs = 3;
+         break;
+   }
+   if (!this->compiled_dense.empty()) {
+      unsigned int index = in[0];
+      for (int i=1; i<n_inputs; i++)
+         index = index * this->n_states + in[i];
+      return this->compiled_dense[index];
+   }
+   if (!this->compiled_tree.empty()) {
+      int at = this->compiled_root;
+      for (int i=0; i<n_inputs && at>=0; i++)
+         at = this->compiled_tree[at + in[i]];
+      return (state)~at;
+   }
+   return MatchTransitions(nw, n, ne, w, c, e, sw, s, se);
+}
+
+// the packed table itself, for when it couldn't be compiled
+state ruletable_algo::MatchTransitions(state nw, state n, state ne, state w, state c, state e,
+                                       state sw, state s, state se) 
 {
    TBits is_match = 0;  // AKT: explicitly initialized to avoid gcc warning
 
@@ -804,6 +1093,12 @@ state ruletable_algo::slowcalc(state nw, state n, state ne, state w, state c, st
    return c; // default: no change
 }
 
+void ruletable_algo::slowcalcblock(const state *in, int stride, state *out,
+                                   int n)
+{
+   ghashcalcblock(this, in, stride, out, n);
+}
+
 static lifealgo *creator() { return new ruletable_algo(); }
 
 void ruletable_algo::doInitializeAlgoInfo(staticAlgoInfo &ai) 
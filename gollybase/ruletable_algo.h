@@ -7,6 +7,7 @@
 #include <string>
 #include <vector>
 #include <utility>
+#include <map>
 /**
  *   An algo that takes a rule table.
  */
@@ -18,6 +19,8 @@ public:
    virtual ~ruletable_algo() ;
    virtual state slowcalc(state nw, state n, state ne, state w, state c,
                           state e, state sw, state s, state se) ;
+   virtual void slowcalcblock(const state *in, int stride, state *out,
+                              int n) ;
    virtual const char* setrule(const char* s) ;
    virtual const char* getrule() ;
    virtual const char* DefaultRule() ;
@@ -26,7 +29,8 @@ public:
 
    // these two methods are needed for RuleLoader algo
    bool IsDefaultRule(const char* rulename);
-   const char* LoadTable(FILE* rulefile, int lineno, char endchar, const char* s);
+   const char* LoadTable(FILE* rulefile, int lineno, char endchar, const char* s,
+                         const char* path);
 
 protected:
 
@@ -34,7 +38,9 @@ protected:
    void PackTransitions(const std::string& symmetries, int n_inputs, 
                         const std::vector< std::pair< std::vector< std::vector<state> >, state> > & transition_table);
    void PackTransition(const std::vector< std::vector<state> > & inputs, state output);
-                        
+   state MatchTransitions(state nw, state n, state ne, state w, state c,
+                          state e, state sw, state s, state se);
+
 protected:
 
    std::string current_rule;
@@ -49,5 +55,27 @@ protected:
    unsigned int n_compressed_rules;
    std::vector<state> output; // state output[n_rules];
 
+   // The compiled table.  If there are few enough neighborhoods we keep
+   // the output for every one of them in compiled_dense, indexed by the
+   // inputs in lut order as the digits of a base n_states number.
+   // Otherwise compiled_tree is a decision tree over the inputs in the
+   // same order: a node is n_states entries, one per value of its
+   // input, each either the offset of the node for the next input or
+   // the one's complement of the output.  If neither is set (the tree
+   // got too big) slowcalc falls back to MatchTransitions.
+   std::vector<state> compiled_dense;
+   std::vector<int> compiled_tree;
+   int compiled_root;
+   std::vector<unsigned int> wild_from; // first input from which each rule matches anything
+   std::map< std::vector<TBits>, int > compile_memo;
+   std::map< std::vector<int>, int > compile_nodes;
+   bool compile_failed;
+
+   void CompileTransitions(const std::string& rulepath);
+   unsigned long long TransitionsHash();
+   int CompileNode(unsigned int level, const std::vector<TBits>& candidates, state c);
+   bool ReadCompiled(const std::string& filename, unsigned long long hash);
+   void WriteCompiled(const std::string& filename, unsigned long long hash);
+
 };
 #endif
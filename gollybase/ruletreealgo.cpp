@@ -259,6 +259,11 @@ state ruletreealgo::slowcalc(state nw, state n, state ne, state w, state c, stat
      return b[a[a[a[a[a[a[a[a[base+nw]+ne]+sw]+se]+n]+w]+e]+s]+c] ;
 }
 
+void ruletreealgo::slowcalcblock(const state *in, int stride, state *out,
+                                 int n) {
+   ghashcalcblock(this, in, stride, out, n) ;
+}
+
 static lifealgo *creator() { return new ruletreealgo() ; }
 
 void ruletreealgo::doInitializeAlgoInfo(staticAlgoInfo &ai) {
@@ -4,6 +4,13 @@
 #include "util.h"
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+#include <deque>
+#include <vector>
 
 #ifdef _WIN32
 #include <windows.h>
@@ -243,9 +250,283 @@ void hperf::reportStep(hperf &mark, hperf &ratemark, double newGen, int verbose)
           "PERF gps %g nps %g fps %g depth %g half %g npg %g nodes %g",
           genspersec, nodeCount/elapsed, fps, 1+depthDelta/nodeCount, halfFrac,
           nodespergen, nodeCount) ;
+      if (tasks > mark.tasks)
+         sprintf(perfstatusline+strlen(perfstatusline),
+                 " threads %d tasks %g", lifethreads::getthreadcount(),
+                 tasks - mark.tasks) ;
       lifestatus(perfstatusline) ;
    }
    genval = newGen ;
    mark = *this ;
    ratemark = *this ;
 }
+void gcpausehist::clear() {
+   count = 0 ;
+   total = 0 ;
+   longest = 0 ;
+   for (int i=0; i<GCPAUSEBUCKETS; i++)
+      buckets[i] = 0 ;
+}
+void gcpausehist::stop() {
+   double t = gollySecondCount() - startTime ;
+   double us = 1e6 * t ;
+   int i = 0 ;
+   while (i < GCPAUSEBUCKETS - 1 && us > (double)(1 << i))
+      i++ ;
+   buckets[i]++ ;
+   count++ ;
+   total += t ;
+   if (t > longest)
+      longest = t ;
+}
+/*
+ *   Append the histogram to a status line as pairs of bucket limit (in
+ *   microseconds) and count, skipping empty buckets.
+ */
+void gcpausehist::report(char *buf, int buflen) {
+   int len = (int)strlen(buf) ;
+   if (count == 0 || len + 40 > buflen)
+      return ;
+   len += sprintf(buf+len, " pauses(us)") ;
+   for (int i=0; i<GCPAUSEBUCKETS; i++)
+      if (buckets[i] && len + 40 < buflen)
+         len += sprintf(buf+len, " %u:%g", 1u << i, buckets[i]) ;
+   sprintf(buf+len, " max %g", 1e6 * longest) ;
+}
+/*
+ *   We over-allocate by a line, and keep what calloc gave us just
+ *   below the aligned block so we can free it.
+ */
+void *linecalloc(size_t bytes) {
+   char *raw = (char *)calloc(bytes + 64, 1) ;
+   if (raw == 0)
+      return 0 ;
+   char *p = raw + 64 - ((size_t)raw & 63) ;
+   ((char **)p)[-1] = raw ;
+   return p ;
+}
+void linefree(void *p) {
+   if (p)
+      free(((char **)p)[-1]) ;
+}
+
+/*
+ *   The worker pool.  Every thread has its own deque of tasks, with its
+ *   own mutex: a batch goes on the back of the submitting thread's
+ *   deque, that thread takes tasks back off the back (newest first,
+ *   so nested batches finish before the work that made them), and
+ *   threads with nothing of their own steal from the front of the
+ *   others' deques (oldest first, usually the biggest pieces).
+ *   QuickLife's tasks take about a microsecond each, so one lock taken
+ *   by every thread for every task would soon be the bottleneck.
+ *   Threads not owned by the pool share deque 0.  Threads that find
+ *   no work, or are waiting for a batch that others are finishing,
+ *   sleep on one condition variable, which is only signalled when
+ *   somebody is asleep on it.  The pool state is allocated once and
+ *   never freed, so that exit() with idle workers still parked does
+ *   not run destructors on busy objects.
+ */
+struct taskbatch {
+   std::atomic<int> pending ;
+   int exclusive ;
+} ;
+struct queuedtask {
+   lifetask *task ;
+   taskbatch *batch ;
+} ;
+struct taskqueue {
+   std::mutex mutex ;
+   std::deque<queuedtask> tasks ;
+   std::atomic<int> size ;          // so thieves can skip empty ones
+} ;
+struct poolstate {
+   std::mutex mutex ;               // for sleeping and waking
+   std::condition_variable cv ;
+   std::vector<taskqueue *> queues ;
+   std::vector<std::thread *> threads ;
+   std::atomic<int> queued ;        // tasks in all the deques
+   std::atomic<int> sleepers ;
+   int stop ;
+} ;
+static poolstate *pool ;
+static int poolsize = 1 ;
+static thread_local int mythreadindex = 0 ;
+static thread_local int inexclusive = 0 ;
+static void runone(lifetask *task, int exclusive) {
+   int was = inexclusive ;
+   if (exclusive)
+      inexclusive = 1 ;
+   task->run() ;
+   inexclusive = was ;
+}
+/*
+ *   Tasks are counted in queued (and size) under their deque's mutex,
+ *   both when they are pushed and when they are taken, so the counts
+ *   never go negative.
+ */
+static int takeback(taskqueue *q, queuedtask &qt) {
+   std::lock_guard<std::mutex> lk(q->mutex) ;
+   if (q->tasks.empty())
+      return 0 ;
+   qt = q->tasks.back() ;
+   q->tasks.pop_back() ;
+   q->size-- ;
+   pool->queued-- ;
+   return 1 ;
+}
+static int takefront(taskqueue *q, queuedtask &qt) {
+   std::lock_guard<std::mutex> lk(q->mutex) ;
+   if (q->tasks.empty())
+      return 0 ;
+   qt = q->tasks.front() ;
+   q->tasks.pop_front() ;
+   q->size-- ;
+   pool->queued-- ;
+   return 1 ;
+}
+static int findtask(int index, queuedtask &qt) {
+   if (pool->queued == 0)
+      return 0 ;
+   int n = (int)pool->queues.size() ;
+   taskqueue *mine = pool->queues[index] ;
+   if (mine->size > 0 && takeback(mine, qt))
+      return 1 ;
+   for (int i=1; i<n; i++) {
+      taskqueue *q = pool->queues[(index + i) % n] ;
+      if (q->size > 0 && takefront(q, qt))
+         return 1 ;
+   }
+   return 0 ;
+}
+/*
+ *   A sleeper counts itself in sleepers before it looks at what it is
+ *   waiting for, and whoever changes that looks at sleepers after
+ *   changing it, so one of them always sees the other.  New tasks
+ *   wake one sleeper each (any sleeper that wakes to find queued
+ *   tasks goes looking for them); a finished batch wakes them all,
+ *   since we can't tell which of them is its submitter.
+ */
+static void wakesleepers(int ntasks) {
+   int n = pool->sleepers ;
+   if (n == 0)
+      return ;
+   std::lock_guard<std::mutex> lk(pool->mutex) ;
+   if (ntasks == 0 || ntasks >= n) {
+      pool->cv.notify_all() ;
+   } else {
+      for (int i=0; i<ntasks; i++)
+         pool->cv.notify_one() ;
+   }
+}
+static void runqueued(queuedtask &qt) {
+   runone(qt.task, qt.batch->exclusive) ;
+   // the batch may be gone as soon as pending is zero
+   if (--qt.batch->pending == 0)
+      wakesleepers(0) ;
+}
+static void poolworker(int index) {
+   mythreadindex = index ;
+   for (;;) {
+      queuedtask qt ;
+      if (findtask(index, qt)) {
+         runqueued(qt) ;
+         continue ;
+      }
+      std::unique_lock<std::mutex> lk(pool->mutex) ;
+      pool->sleepers++ ;
+      while (!pool->stop && pool->queued == 0)
+         pool->cv.wait(lk) ;
+      pool->sleepers-- ;
+      if (pool->stop)
+         return ;
+   }
+}
+/**
+ *   Change the number of threads.  This must not be called while
+ *   any calculation is using the pool.
+ */
+void lifethreads::setthreadcount(int n) {
+   if (n < 1)
+      n = 1 ;
+   if (n > MAX_THREADS)
+      n = MAX_THREADS ;
+   if (n == poolsize)
+      return ;
+   if (pool == 0) {
+      pool = new poolstate ;
+      pool->queued = 0 ;
+      pool->sleepers = 0 ;
+      pool->stop = 0 ;
+   }
+   {
+      std::lock_guard<std::mutex> lk(pool->mutex) ;
+      pool->stop = 1 ;
+   }
+   pool->cv.notify_all() ;
+   for (size_t i=0; i<pool->threads.size(); i++) {
+      pool->threads[i]->join() ;
+      delete pool->threads[i] ;
+   }
+   pool->threads.clear() ;
+   pool->stop = 0 ;
+   poolsize = n ;
+   while ((int)pool->queues.size() < n) {
+      taskqueue *q = new taskqueue ;
+      q->size = 0 ;
+      pool->queues.push_back(q) ;
+   }
+   while ((int)pool->queues.size() > n) {
+      delete pool->queues.back() ;
+      pool->queues.pop_back() ;
+   }
+   for (int i=1; i<n; i++)
+      pool->threads.push_back(new std::thread(poolworker, i)) ;
+}
+int lifethreads::getthreadcount() {
+   return inexclusive ? 1 : poolsize ;
+}
+int lifethreads::threadindex() {
+   return mythreadindex ;
+}
+static void runbatch(lifetask **tasks, int ntasks, int exclusive) {
+   if (lifethreads::getthreadcount() <= 1 || ntasks <= 1) {
+      for (int i=0; i<ntasks; i++)
+         runone(tasks[i], exclusive) ;
+      return ;
+   }
+   taskbatch batch ;
+   batch.pending = ntasks ;
+   batch.exclusive = exclusive ;
+   int index = mythreadindex ;
+   taskqueue *q = pool->queues[index] ;
+   {
+      std::lock_guard<std::mutex> lk(q->mutex) ;
+      for (int i=0; i<ntasks; i++) {
+         queuedtask qt ;
+         qt.task = tasks[i] ;
+         qt.batch = &batch ;
+         q->tasks.push_back(qt) ;
+      }
+      q->size += ntasks ;
+      pool->queued += ntasks ;
+   }
+   wakesleepers(ntasks) ;
+   while (batch.pending > 0) {
+      queuedtask qt ;
+      if (findtask(index, qt)) {
+         runqueued(qt) ;
+         continue ;
+      }
+      std::unique_lock<std::mutex> lk(pool->mutex) ;
+      pool->sleepers++ ;
+      while (batch.pending > 0 && pool->queued == 0)
+         pool->cv.wait(lk) ;
+      pool->sleepers-- ;
+   }
+}
+void lifethreads::runtasks(lifetask **tasks, int ntasks) {
+   runbatch(tasks, ntasks, 0) ;
+}
+void lifethreads::runexclusive(lifetask **tasks, int ntasks) {
+   runbatch(tasks, ntasks, 1) ;
+}
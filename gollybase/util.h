@@ -81,6 +81,7 @@ struct hperf {
       genval = 0 ;
       frames = 0 ;
       halfNodes = 0 ;
+      tasks = 0 ;
    }
    void report(hperf&, int verbose) ;
    void reportStep(hperf&, hperf&, double genval, int verbose) ;
@@ -103,10 +104,130 @@ struct hperf {
    double frames ;
    double nodesCalculated ;
    double halfNodes ;
+   double tasks ;
    double depthSum ;
    double timeStamp ;
    double genval ;
    static int reportMask ;
    static double reportInterval ;
 } ;
+/*
+ *   Garbage collection pause times.  Bucket i counts the pauses that
+ *   took at most 2**i microseconds (and more than half that), so the
+ *   shape of the latency distribution survives, not just the total.
+ *   A pause is any stretch of collector work that the calculation had
+ *   to wait for, whether a full collection or one incremental slice.
+ */
+const int GCPAUSEBUCKETS = 32 ;
+struct gcpausehist {
+   void clear() ;
+   void start() { startTime = gollySecondCount() ; }
+   void stop() ;
+   void report(char *buf, int buflen) ;
+   double count ;
+   double total ;
+   double longest ;
+   double buckets[GCPAUSEBUCKETS] ;
+   double startTime ;
+} ;
+/*
+ *   Open addressing for the hashed algorithms.  The table is an array
+ *   of groups, each a cache line holding a word of tags followed by as
+ *   many slots (up to eight) as fit.  Each tag byte is zero for an
+ *   empty slot, one for a slot whose entry was removed, and otherwise
+ *   0x80 plus seven bits of the entry's hash.  A lookup checks all the
+ *   tags of a group at once with a few word operations and only looks
+ *   at the entries whose tag matches, so it usually touches just the
+ *   one line besides the entry itself.  Probing goes on to the next
+ *   group until one with an empty slot is found; removed entries keep
+ *   a tag so they do not cut a probe sequence short.  Tag bytes past
+ *   the last slot of a group stay zero, so tests for empty or free
+ *   slots must be masked with tagsused().
+ */
+typedef unsigned long long hashtagword ;
+const unsigned int HASHTAGDEAD = 1 ;
+const hashtagword HASHTAGLOW = 0x0101010101010101ULL ;
+const hashtagword HASHTAGHIGH = 0x8080808080808080ULL ;
+inline unsigned int hashtag(unsigned long long h) {
+   return 0x80 | (unsigned int)((h * 0x9e3779b97f4a7c15ULL) >> 57) ;
+}
+// high bit set in each byte of the result where t has a zero byte
+inline hashtagword tagzero(hashtagword t) {
+   return ~(((t & ~HASHTAGHIGH) + ~HASHTAGHIGH) | t | ~HASHTAGHIGH) ;
+}
+inline hashtagword tagmatch(hashtagword t, unsigned int tag) {
+   return tagzero(t ^ (HASHTAGLOW * tag)) ;
+}
+inline hashtagword tagfull(hashtagword t) {
+   return t & HASHTAGHIGH ;
+}
+inline hashtagword tagfree(hashtagword t) {
+   return ~t & HASHTAGHIGH ;
+}
+// every full slot becomes a removed one
+inline hashtagword tagkill(hashtagword t) {
+   return ((t >> 7) | t) & HASHTAGLOW ;
+}
+inline unsigned int tagat(hashtagword t, int i) {
+   return (unsigned int)(t >> (8 * i)) & 255 ;
+}
+inline hashtagword tagsused(int slots) {
+   return HASHTAGHIGH >> (8 * (8 - slots)) ;
+}
+inline hashtagword tagset(hashtagword t, int i, unsigned int tag) {
+   return (t & ~((hashtagword)255 << (8 * i))) | ((hashtagword)tag << (8 * i)) ;
+}
+// index of the lowest byte flagged in a nonzero result of the above
+#ifdef __GNUC__
+inline int tagindex(hashtagword m) {
+   return __builtin_ctzll(m) >> 3 ;
+}
+#else
+inline int tagindex(hashtagword m) {
+   int i = 0 ;
+   while ((m & 0x80) == 0) {
+      m >>= 8 ;
+      i++ ;
+   }
+   return i ;
+}
+#endif
+/*
+ *   Zeroed memory aligned to a cache line, for the tables above.
+ */
+void *linecalloc(size_t bytes) ;
+void linefree(void *p) ;
+/**
+ *   A small process-wide pool of worker threads, shared by every
+ *   algorithm that can split a calculation into independent pieces.
+ *   The thread count includes the calling thread, so the default of
+ *   one means everything runs serially with no threads created.
+ *
+ *   runtasks() queues a batch of tasks and returns only when all of
+ *   them have completed.  While it waits the calling thread runs
+ *   queued tasks itself (its own newest first, while idle threads
+ *   steal the oldest), so a task may itself call runtasks() without
+ *   deadlock.
+ *   threadindex() is 0 for any thread not owned by the pool and
+ *   1..getthreadcount()-1 for the workers.
+ *
+ *   runexclusive() is for tasks that are whole calculations of their
+ *   own, such as stepping several independent universes side by side.
+ *   Inside such a task getthreadcount() is 1, so the algorithm keeps
+ *   to the one thread instead of splitting its work into the pool.
+ */
+class lifetask {
+public:
+   virtual ~lifetask() {}
+   virtual void run() = 0 ;
+} ;
+class lifethreads {
+public:
+   static void setthreadcount(int n) ;
+   static int getthreadcount() ;
+   static int threadindex() ;
+   static void runtasks(lifetask **tasks, int ntasks) ;
+   static void runexclusive(lifetask **tasks, int ntasks) ;
+} ;
+const int MAX_THREADS = 64 ;
 #endif
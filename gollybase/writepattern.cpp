@@ -142,14 +142,25 @@ const char *writerle(std::ostream &os, char *comments, lifealgo &imp,
       double accumcount = 0;
       int currcount = 0;
       int v = 0 ;
+      // fetch the live cells a band of rows at a time, which is much
+      // faster than a nextcell call per cell but keeps memory bounded
+      const int bandrows = 64 ;
+      vector<cellspan> spans ;
+      size_t i = 0 ;
       for ( cy=top; cy<=bottom; cy++ ) {
+         if (((cy - top) % bandrows) == 0) {
+            spans.clear() ;
+            i = 0 ;
+            int bandbottom = bottom - cy < bandrows ? bottom : cy + bandrows - 1 ;
+            imp.getcellruns(cy, left, bandbottom, right, spans) ;
+         }
          // set lastchar to anything except 'o' or 'b'
          laststate = WRLE_NONE ;
          currcount++;
-         for ( cx=left; cx<=right; cx++ ) {
-            int skip = imp.nextcell(cx, cy, v);
-            if (skip + cx > right)
-               skip = -1;           // pretend we found no more live cells
+         cx = left;
+         for ( ; i<spans.size() && spans[i].y==cy; i++ ) {
+            int skip = spans[i].x - cx;
+            v = spans[i].state ;
             if (skip > 0) {
                // have exactly "skip" dead cells here
                if (laststate == 0) {
@@ -163,27 +174,23 @@ const char *writerle(std::ostream &os, char *comments, lifealgo &imp,
                   brun = skip;
                }
             }
-            if (skip >= 0) {
-               // found next live cell in this row
-               cx += skip;
-               if (laststate == v) {
-                  orun++;
-               } else {
-                  if (dollrun > 0)
-                     // output current run of $ chars
-                     AddRun(os, WRLE_NEWLINE, multistate, dollrun, linelen);
-                  if (brun > 0)
-                     // output current run of dead cells
-                     AddRun(os, 0, multistate, brun, linelen);
-                  if (orun > 0)
-                     AddRun(os, laststate, multistate, orun, linelen) ;
-                  laststate = v ;
-                  orun = 1;
-               }
-               currcount++;
+            // found next run of live cells in this row
+            if (laststate == v) {
+               orun += spans[i].n;
             } else {
-               cx = right + 1;  // done this row
+               if (dollrun > 0)
+                  // output current run of $ chars
+                  AddRun(os, WRLE_NEWLINE, multistate, dollrun, linelen);
+               if (brun > 0)
+                  // output current run of dead cells
+                  AddRun(os, 0, multistate, brun, linelen);
+               if (orun > 0)
+                  AddRun(os, laststate, multistate, orun, linelen) ;
+               laststate = v ;
+               orun = spans[i].n;
             }
+            cx = spans[i].x + spans[i].n;
+            currcount += spans[i].n;
             if (currcount > 1024) {
                char msg[128];
                accumcount += currcount;
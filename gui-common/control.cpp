@@ -326,6 +326,31 @@ void RestorePattern(bigint& gen, const char* filename,
 
 // -----------------------------------------------------------------------------
 
+void RestoreSnapshot(int snapshot, bigint& gen,
+                     bigint& x, bigint& y, int mag, int base, int expo)
+{
+    // called to undo/redo a generating change whose pattern is still
+    // held in memory by the current universe (see UndoRedo::TakeSnapshot)
+    if (!currlayer->algo->restoresnapshot(snapshot)) {
+        // should never happen, but best to clear the pattern and set the expected gen count
+        CreateUniverse();
+        currlayer->algo->setGeneration(gen);
+        Warning("Could not restore pattern from snapshot!");
+    }
+
+    // restore step size and set increment
+    currlayer->currbase = base;
+    currlayer->currexpo = expo;
+    SetGenIncrement();
+
+    // restore position and scale, if allowed
+    if (restoreview) currlayer->view->setpositionmag(x, y, mag);
+
+    UpdatePatternAndStatus();
+}
+
+// -----------------------------------------------------------------------------
+
 const char* ChangeGenCount(const char* genstring, bool inundoredo)
 {
     // disallow alphabetic chars in genstring
@@ -484,7 +509,7 @@ void StopGenerating()
 void NextGeneration(bool useinc)
 {
     lifealgo* curralgo = currlayer->algo;
-    bool boundedgrid = curralgo->unbounded && (curralgo->gridwd > 0 || curralgo->gridht > 0);
+    bool boundedgrid = curralgo->needsbordercells();
 
     if (generating) {
         // we were called via timer so StartGenerating has already checked
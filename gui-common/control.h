@@ -21,6 +21,8 @@ void NextGeneration(bool useinc);
 void ResetPattern(bool resetundo = true);
 void RestorePattern(bigint& gen, const char* filename,
                     bigint& x, bigint& y, int mag, int base, int expo);
+void RestoreSnapshot(int snapshot, bigint& gen,
+                     bigint& x, bigint& y, int mag, int base, int expo);
 void SetMinimumStepExponent();
 void SetStepExponent(int newexpo);
 void SetGenIncrement();
@@ -119,12 +119,13 @@ void NewPattern(const char* title)
     currlayer->currbase = algoinfo[currlayer->algtype]->defbase;
     currlayer->currexpo = 0;
 
+    // clear all undo/redo history (before CreateUniverse deletes the old universe
+    // so the history needn't save its snapshots)
+    currlayer->undoredo->ClearUndoRedo();
+
     // create new, empty universe of same type and using same rule
     CreateUniverse();
 
-    // clear all undo/redo history
-    currlayer->undoredo->ClearUndoRedo();
-
     // possibly clear selection
     currlayer->currsel.Deselect();
 
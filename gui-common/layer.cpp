@@ -1996,9 +1996,10 @@ Layer::~Layer()
         }
 
     } else {
-        // this layer is not a clone, so delete universe and undo/redo history
-        delete algo;
+        // this layer is not a clone, so delete undo/redo history and universe
+        // (in that order so the history needn't save its snapshots)
         delete undoredo;
+        delete algo;
 
         // delete tempstart file if it exists
         if (FileExists(tempstart)) RemoveFile(tempstart);
@@ -271,7 +271,7 @@ void Selection::Advance()
     bool savecells = allowundo && !currlayer->stayclean;
     //!!! if (savecells && inscript) SavePendingChanges();
 
-    bool boundedgrid = currlayer->algo->unbounded && (currlayer->algo->gridwd > 0 || currlayer->algo->gridht > 0);
+    bool boundedgrid = currlayer->algo->needsbordercells();
 
     // check if selection encloses entire pattern;
     // can't do this if qlife because it uses gen parity to decide which bits to draw;
@@ -409,7 +409,7 @@ void Selection::AdvanceOutside()
     bool savecells = allowundo && !currlayer->stayclean;
     //!!! if (savecells && inscript) SavePendingChanges();
 
-    bool boundedgrid = currlayer->algo->unbounded && (currlayer->algo->gridwd > 0 || currlayer->algo->gridht > 0);
+    bool boundedgrid = currlayer->algo->needsbordercells();
 
     // check if selection is completely outside pattern edges;
     // can't do this if qlife because it uses gen parity to decide which bits to draw;
@@ -1252,12 +1252,16 @@ void Selection::CopyToClipboard(bool cut)
 
     lifealgo* curralgo = currlayer->algo;
     int multistate = curralgo->NumCellStates() > 2;
+    // get all the live cells in one pass rather than calling nextcell for each one
+    vector<cellspan> spans;
+    curralgo->getcellruns(itop, ileft, ibottom, iright, spans);
+    size_t i = 0;
     for ( cy=itop; cy<=ibottom; cy++ ) {
         laststate = WRLE_NONE;
-        for ( cx=ileft; cx<=iright; cx++ ) {
-            int skip = curralgo->nextcell(cx, cy, v);
-            if (skip + cx > iright)
-                skip = -1;           // pretend we found no more live cells
+        cx = ileft;
+        for ( ; i<spans.size() && spans[i].y==cy; i++ ) {
+            int skip = spans[i].x - cx;
+            v = spans[i].state;
             if (skip > 0) {
                 // have exactly "skip" empty cells here
                 if (laststate == 0) {
@@ -1271,32 +1275,31 @@ void Selection::CopyToClipboard(bool cut)
                     brun = skip;
                 }
             }
-            if (skip >= 0) {
-                // found next live cell
-                cx += skip;
-                livecount++;
-                if (cut) {
-                    curralgo->setcell(cx, cy, 0);
-                    if (savecells) currlayer->undoredo->SaveCellChange(cx, cy, v, 0);
-                }
-                if (laststate == v) {
-                    orun++;
-                } else {
-                    if (dollrun > 0)
-                        // output current run of $ chars
-                        AddRun(WRLE_NEWLINE, multistate, dollrun, linelen, chptr);
-                    if (brun > 0)
-                        // output current run of dead cells
-                        AddRun(0, multistate, brun, linelen, chptr);
-                    if (orun > 0)
-                        // output current run of other live cells
-                        AddRun(laststate, multistate, orun, linelen, chptr);
-                    laststate = v;
-                    orun = 1;
+            // found next run of live cells
+            cx = spans[i].x;
+            livecount += spans[i].n;
+            if (cut) {
+                for (int x = cx; x < cx + spans[i].n; x++) {
+                    curralgo->setcell(x, cy, 0);
+                    if (savecells) currlayer->undoredo->SaveCellChange(x, cy, v, 0);
                 }
+            }
+            if (laststate == v) {
+                orun += spans[i].n;
             } else {
-                cx = iright + 1;     // done this row
+                if (dollrun > 0)
+                    // output current run of $ chars
+                    AddRun(WRLE_NEWLINE, multistate, dollrun, linelen, chptr);
+                if (brun > 0)
+                    // output current run of dead cells
+                    AddRun(0, multistate, brun, linelen, chptr);
+                if (orun > 0)
+                    // output current run of other live cells
+                    AddRun(laststate, multistate, orun, linelen, chptr);
+                laststate = v;
+                orun = spans[i].n;
             }
+            cx += spans[i].n;
             cntr++;
             if ((cntr % 4096) == 0) {
                 double prog = ((cy - itop) * (double)(iright - ileft + 1) +
@@ -15,6 +15,8 @@
 #include "file.h"           // for SetPatternTitle
 #include "undo.h"
 
+#include <fstream>          // for std::ofstream
+
 // -----------------------------------------------------------------------------
 
 const char* lack_of_memory = "Due to lack of memory, some changes can't be undone!";
@@ -29,6 +31,13 @@ const char* dupe4_prefix = "g4_";
 const char* dupe5_prefix = "g5_";
 const char* dupe6_prefix = "g6_";
 
+// snapshots of generated patterns held in memory by a hashing universe
+// share nearly all their nodes, but they do stop the universe freeing
+// nodes only old patterns use, so we keep at most this many (and far
+// fewer if the universe is short of memory); the rest go to temporary files
+const int maxsnapshots = 32;
+const int minsnapshots = 4;
+
 // -----------------------------------------------------------------------------
 
 // the next two classes are needed because Golly allows multiple starting points
@@ -205,6 +214,9 @@ public:
     void ChangeCells(bool undo);
     // change cell states using cellinfo
 
+    void SaveSnapshots();
+    // save any snapshots in temporary files
+
     change_type changeid;                   // specifies the type of change
     bool olddirty;                          // layer's dirty state before change
     bool newdirty;                          // layer's dirty state after change
@@ -219,6 +231,8 @@ public:
     // genchange info
     bool scriptgen;                         // gen change was done by script?
     std::string oldfile, newfile;           // old and new pattern files
+    int oldsnap, newsnap;                   // or old and new snapshots
+    lifealgo* snapalgo;                     // universe holding the snapshots
     bigint oldgen, newgen;                  // old and new generation counts
     bigint oldx, oldy, newx, newy;          // old and new positions
     int oldmag, newmag;                     // old and new scales
@@ -262,6 +276,9 @@ ChangeNode::ChangeNode(change_type id)
     cellcount = 0;
     oldfile.clear();
     newfile.clear();
+    oldsnap = 0;
+    newsnap = 0;
+    snapalgo = NULL;
     oldtempstart.clear();
     newtempstart.clear();
     oldstartfile.clear();
@@ -287,6 +304,12 @@ ChangeNode::~ChangeNode()
         RemoveFile(newfile);
     }
 
+    // let the universe free any nodes used only by our snapshots
+    if (snapalgo) {
+        if (oldsnap) snapalgo->dropsnapshot(oldsnap);
+        if (newsnap) snapalgo->dropsnapshot(newsnap);
+    }
+
     if (delete_all_temps) {
         // we're in ClearUndoRedo so it's safe to delete oldtempstart/newtempstart/oldstartfile/newstartfile
         // if they are in tempdir and not being used to store the current layer's starting pattern
@@ -344,6 +367,37 @@ void ChangeNode::ChangeCells(bool undo)
 
 // -----------------------------------------------------------------------------
 
+static std::string SaveSnapshot(lifealgo* algo, int snapshot, const char* prefix)
+{
+    // write given snapshot to a new temporary file and return its path
+    std::string tempfile = CreateTempFileName(prefix);
+    std::ofstream os(tempfile.c_str(), std::ios::out | std::ios::binary);
+    const char* err = algo->writesnapshot(snapshot, os);
+    if (!err && !os) err = "Failed to save snapshot in temporary file!";
+    if (err) Warning(err);
+    return tempfile;
+}
+
+// -----------------------------------------------------------------------------
+
+void ChangeNode::SaveSnapshots()
+{
+    if (snapalgo == NULL) return;
+    if (oldsnap) {
+        oldfile = SaveSnapshot(snapalgo, oldsnap, genchange_prefix);
+        snapalgo->dropsnapshot(oldsnap);
+        oldsnap = 0;
+    }
+    if (newsnap) {
+        newfile = SaveSnapshot(snapalgo, newsnap, genchange_prefix);
+        snapalgo->dropsnapshot(newsnap);
+        newsnap = 0;
+    }
+    snapalgo = NULL;
+}
+
+// -----------------------------------------------------------------------------
+
 bool ChangeNode::DoChange(bool undo)
 {
     switch (changeid) {
@@ -388,14 +442,22 @@ bool ChangeNode::DoChange(bool undo)
             currlayer->startfile = oldstartfile;
             if (undo) {
                 currlayer->currsel = oldsel;
-                RestorePattern(oldgen, oldfile.c_str(), oldx, oldy, oldmag, oldbase, oldexpo);
+                if (oldsnap) {
+                    RestoreSnapshot(oldsnap, oldgen, oldx, oldy, oldmag, oldbase, oldexpo);
+                } else {
+                    RestorePattern(oldgen, oldfile.c_str(), oldx, oldy, oldmag, oldbase, oldexpo);
+                }
             } else {
                 if (startinfo) {
                     // restore starting info for use by ResetPattern
                     startinfo->Restore();
                 }
                 currlayer->currsel = newsel;
-                RestorePattern(newgen, newfile.c_str(), newx, newy, newmag, newbase, newexpo);
+                if (newsnap) {
+                    RestoreSnapshot(newsnap, newgen, newx, newy, newmag, newbase, newexpo);
+                } else {
+                    RestorePattern(newgen, newfile.c_str(), newx, newy, newmag, newbase, newexpo);
+                }
             }
             break;
 
@@ -493,6 +555,8 @@ UndoRedo::UndoRedo()
     savegenchanges = false;       // no script gen changes are pending
     doingscriptchanges = false;   // not undoing/redoing script changes
     prevfile.clear();             // play safe for ClearUndoRedo
+    prevsnap = 0;                 // ditto
+    snapalgo = NULL;              // no snapshots yet
     startcount = 0;               // unfinished RememberGenStart calls
 
     // need to remember if script has created a new layer (not a clone)
@@ -504,6 +568,7 @@ UndoRedo::UndoRedo()
 UndoRedo::~UndoRedo()
 {
     ClearUndoRedo();
+    if (snapalgo) snapalgo->setsnapshotkeeper(NULL);
 }
 
 // -----------------------------------------------------------------------------
@@ -740,6 +805,76 @@ void UndoRedo::SaveCurrentPattern(const char* tempfile)
 
 // -----------------------------------------------------------------------------
 
+int UndoRedo::TakeSnapshot()
+{
+    // a snapshot is much faster than writing a file and shares its memory
+    // with the current pattern, but all our snapshots must be in one universe
+    // (releasing forgets snapalgo when that universe is deleted)
+    lifealgo* algo = currlayer->algo;
+    if (snapalgo && snapalgo != algo) return 0;
+
+    int snapshot = algo->takesnapshot();
+    if (snapshot) {
+        snapalgo = algo;
+        algo->setsnapshotkeeper(this);
+    }
+    return snapshot;
+}
+
+// -----------------------------------------------------------------------------
+
+void UndoRedo::EvictSnapshots()
+{
+    if (snapalgo == NULL) return;
+
+    // if the universe is using most of its memory then keep just enough
+    // snapshots for undoing/redoing the last few generating changes
+    int limit = maxsnapshots;
+    lifestats stats;
+    snapalgo->getstats(stats);
+    if (stats.memory > 0.75 * 1048576.0 * snapalgo->getMaxMemory()) limit = minsnapshots;
+
+    // save the oldest changes in files first, then the furthest redoable changes
+    std::list<ChangeNode*>::reverse_iterator node;
+    node = undolist.rbegin();
+    while (snapalgo->getsnapshotcount() > limit && node != undolist.rend()) {
+        (*node)->SaveSnapshots();
+        node++;
+    }
+    node = redolist.rbegin();
+    while (snapalgo->getsnapshotcount() > limit && node != redolist.rend()) {
+        (*node)->SaveSnapshots();
+        node++;
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+void UndoRedo::releasing(lifealgo* algo)
+{
+    if (algo != snapalgo) return;
+
+    // the universe is about to be deleted (eg. by ResetPattern or ChangeAlgorithm)
+    // so save every snapshot we still need in a temporary file
+    std::list<ChangeNode*>::iterator node;
+    for (node = undolist.begin(); node != undolist.end(); node++) {
+        (*node)->SaveSnapshots();
+    }
+    for (node = redolist.begin(); node != redolist.end(); node++) {
+        (*node)->SaveSnapshots();
+    }
+    if (prevsnap) {
+        prevfile = SaveSnapshot(algo, prevsnap, genchange_prefix);
+        algo->dropsnapshot(prevsnap);
+        prevsnap = 0;
+    }
+
+    algo->setsnapshotkeeper(NULL);
+    snapalgo = NULL;
+}
+
+// -----------------------------------------------------------------------------
+
 void UndoRedo::RememberGenStart()
 {
     startcount++;
@@ -769,6 +904,12 @@ void UndoRedo::RememberGenStart()
         // we can just reset to starting pattern
         prevfile.clear();
     } else {
+        // if the universe can hold the starting pattern in memory then that's
+        // much faster than saving it in a file
+        prevfile.clear();
+        prevsnap = TakeSnapshot();
+        if (prevsnap) return;
+
         // save starting pattern in a unique temporary file
         prevfile = CreateTempFileName(genchange_prefix);
 
@@ -811,22 +952,31 @@ void UndoRedo::RememberGenFinish()
 
     // generation count might not have changed (can happen in Linux app and iOS Golly)
     if (prevgen == currlayer->algo->getGeneration()) {
-        // delete prevfile created by RememberGenStart
+        // delete prevfile (or snapshot) created by RememberGenStart
         if (!prevfile.empty() && FileExists(prevfile)) {
             RemoveFile(prevfile);
         }
         prevfile.clear();
+        if (prevsnap) {
+            snapalgo->dropsnapshot(prevsnap);
+            prevsnap = 0;
+        }
         return;
     }
 
     std::string fpath;
+    int fsnap = 0;
     if (currlayer->algo->getGeneration() == currlayer->startgen) {
         // this can happen if script called reset() so just use starting pattern
         fpath.clear();
     } else {
-        // save finishing pattern in a unique temporary file
-        fpath = CreateTempFileName(genchange_prefix);
-        SaveCurrentPattern(fpath.c_str());
+        // remember finishing pattern in memory if possible,
+        // otherwise save it in a unique temporary file
+        fsnap = TakeSnapshot();
+        if (fsnap == 0) {
+            fpath = CreateTempFileName(genchange_prefix);
+            SaveCurrentPattern(fpath.c_str());
+        }
     }
 
     ClearRedoHistory();
@@ -840,6 +990,9 @@ void UndoRedo::RememberGenFinish()
     change->newgen = currlayer->algo->getGeneration();
     change->oldfile = prevfile;
     change->newfile = fpath;
+    change->oldsnap = prevsnap;
+    change->newsnap = fsnap;
+    if (prevsnap || fsnap) change->snapalgo = snapalgo;
     change->oldx = prevx;
     change->oldy = prevy;
     change->newx = currlayer->view->x;
@@ -865,8 +1018,10 @@ void UndoRedo::RememberGenFinish()
 
     // prevfile has been saved in change->oldfile (~ChangeNode will delete it)
     prevfile.clear();
+    prevsnap = 0;
 
     undolist.push_front(change);
+    EvictSnapshots();
 }
 
 // -----------------------------------------------------------------------------
@@ -886,6 +1041,7 @@ void UndoRedo::AddGenChange()
     prevbase = currlayer->startbase;
     prevexpo = currlayer->startexpo;
     prevfile.clear();
+    prevsnap = 0;
 
     // pretend RememberGenStart was called
     startcount = 1;
@@ -1328,6 +1484,10 @@ void UndoRedo::ClearUndoRedo()
             RemoveFile(prevfile);
         }
         prevfile.clear();
+        if (prevsnap) {
+            snapalgo->dropsnapshot(prevsnap);
+            prevsnap = 0;
+        }
         startcount = 0;
     }
     
@@ -1358,6 +1518,17 @@ bool CopyTempFiles(ChangeNode* srcnode, ChangeNode* destnode, const char* tempst
     // temporary file names in the destnode and copy such files
     bool allcopied = true;
 
+    // destnode's layer has its own universe so it needs files for any snapshots
+    destnode->oldsnap = 0;
+    destnode->newsnap = 0;
+    destnode->snapalgo = NULL;
+    if (srcnode->oldsnap) {
+        destnode->oldfile = SaveSnapshot(srcnode->snapalgo, srcnode->oldsnap, dupe1_prefix);
+    }
+    if (srcnode->newsnap) {
+        destnode->newfile = SaveSnapshot(srcnode->snapalgo, srcnode->newsnap, dupe2_prefix);
+    }
+
     if ( !srcnode->oldfile.empty() && FileExists(srcnode->oldfile) ) {
         destnode->oldfile = CreateTempFileName(dupe1_prefix);
         if ( !CopyFile(srcnode->oldfile, destnode->oldfile) )
@@ -1461,6 +1632,13 @@ void UndoRedo::DuplicateHistory(Layer* oldlayer, Layer* newlayer)
         }
     }
 
+    // the new layer has its own universe so save any snapshot in a file
+    prevsnap = 0;
+    snapalgo = NULL;
+    if (history->prevsnap) {
+        prevfile = SaveSnapshot(history->snapalgo, history->prevsnap, genchange_prefix);
+    }
+
     // do a deep copy of dynamically allocated data
     cellarray = NULL;
     if (numchanges > 0 && history->cellarray) {
@@ -23,7 +23,7 @@ typedef struct {
     int newstate;       // new state
 } cell_change;          // stores a single cell change
 
-class UndoRedo {
+class UndoRedo : public snapshotkeeper {
 public:
     UndoRedo();
     ~UndoRedo();
@@ -110,6 +110,10 @@ public:
 
     void ClearUndoRedo();         // clear all undo/redo history
 
+    void releasing(lifealgo* algo);
+    // the universe holding our snapshots is about to be deleted,
+    // so save them in temporary files
+
 private:
     std::list<ChangeNode*> undolist;    // list of undoable changes
     std::list<ChangeNode*> redolist;    // list of redoable changes
@@ -120,6 +124,8 @@ private:
     bool badalloc;                // malloc/realloc failed?
 
     std::string prevfile;         // for saving pattern at start of gen change
+    int prevsnap;                 // or snapshot of pattern (if prevfile is empty)
+    lifealgo* snapalgo;           // universe holding our snapshots (or NULL)
     bigint prevgen;               // generation count at start of gen change
     bigint prevx, prevy;          // viewport position at start of gen change
     int prevmag;                  // scale at start of gen change
@@ -133,6 +139,13 @@ private:
 
     void SaveCurrentPattern(const char* tempfile);
     // save current pattern to given temporary file
+
+    int TakeSnapshot();
+    // return a snapshot of the current pattern held in memory by the universe,
+    // or 0 if it can't take one (only the hashing algos can)
+
+    void EvictSnapshots();
+    // save the oldest snapshots in temporary files if we hold too many
 };
 
 #endif
@@ -11,6 +11,18 @@ PYTHON = python3
 # Uncomment the next line to enable Golly to run perl scripts.
 # ENABLE_PERL = 1
 
+# Uncomment the next line to halve the memory used by each HashLife node
+# (HashLife is then limited to about 4 billion nodes, or 100GB):
+# COMPACT_NODES = 1
+
+# Uncomment the next line so HashLife nodes remember their population and
+# bounding box (16 more bytes a node, but pattern size queries stay cheap):
+# NODE_META = 1
+
+# Uncomment the next line to use AVX2 in the HashLife leaf kernel
+# (the built program will then only run on CPUs with AVX2):
+# ENABLE_AVX2 = 1
+
 # Uncomment the next line to allow Golly to play sounds:
 # ENABLE_SOUND = 1
 # Change the next line to specify where you installed IrrKLang
@@ -14,7 +14,8 @@
 #include "lifealgo.h"
 #include "qlifealgo.h"
 #include "hlifealgo.h"
-#include "util.h"           // for linereader
+#include "lifepoll.h"       // for lifeworker
+#include "util.h"           // for linereader, lifetask
 
 #include "wxgolly.h"        // for wxGetApp, statusptr, viewptr, bigview
 #include "wxutils.h"        // for BeginProgress, GetString, etc
@@ -271,6 +272,31 @@ void MainFrame::RestorePattern(bigint& gen, const wxString& filename,
 
 // -----------------------------------------------------------------------------
 
+void MainFrame::RestoreSnapshot(int snapshot, bigint& gen,
+                                bigint& x, bigint& y, int mag, int base, int expo)
+{
+    // called to undo/redo a generating change whose pattern is still
+    // held in memory by the current universe (see UndoRedo::TakeSnapshot)
+    if (!currlayer->algo->restoresnapshot(snapshot)) {
+        // should never happen, but best to clear the pattern and set the expected gen count
+        CreateUniverse();
+        currlayer->algo->setGeneration(gen);
+        Warning(_("Could not restore pattern from snapshot!"));
+    }
+    
+    // restore step size and set increment
+    currlayer->currbase = base;
+    currlayer->currexpo = expo;
+    SetGenIncrement();
+    
+    // restore position and scale, if allowed
+    if (restoreview) viewptr->SetPosMag(x, y, mag);
+    
+    UpdatePatternAndStatus();
+}
+
+// -----------------------------------------------------------------------------
+
 const char* MainFrame::ChangeGenCount(const char* genstring, bool inundoredo)
 {
     // disallow alphabetic chars in genstring
@@ -539,6 +565,103 @@ void MainFrame::SetBaseStep()
 
 // -----------------------------------------------------------------------------
 
+// if syncgens is true then every other layer with its own universe generates
+// along with the current layer, each on its own thread (see gentask)
+
+class layerpoll : public lifepoll
+{
+public:
+    // stop like wxpoller does, and share its interrupted flag
+    virtual int checkevents() {
+        wxGetApp().Stepper()->park();
+        return wxGetApp().Poller()->isInterrupted();
+    }
+};
+
+static Layer* genlayers[MAX_LAYERS];        // other layers being generated
+static layerpoll genpollers[MAX_LAYERS];    // their pollers while generating
+static int numgenlayers = 0;                // number of genlayers
+
+static void StartOtherLayers()
+{
+    numgenlayers = 0;
+    if (!syncgens || numlayers < 2) return;
+    
+    Layer* savelayer = currlayer;
+    for (int i = 0; i < numlayers; i++) {
+        Layer* layer = GetLayer(i);
+        // skip clones of layers already being generated
+        bool generated = layer->algo == savelayer->algo;
+        for (int j = 0; j < numgenlayers; j++) {
+            if (genlayers[j]->algo == layer->algo) generated = true;
+        }
+        if (generated || layer->algo->isEmpty() || layer->algo->getframecount() > 0) continue;
+        
+        // save the starting pattern and undo info just as if this layer
+        // was the one being generated
+        currlayer = layer;
+        bool saved = mainptr->SaveStartingPattern();
+        if (saved && allowundo) currlayer->undoredo->RememberGenStart();
+        currlayer = savelayer;
+        if (!saved) continue;
+        
+        // each universe needs its own poller because they are all stepped at once
+        genpollers[numgenlayers].resetInterrupted();
+        layer->algo->setpoll(&genpollers[numgenlayers]);
+        genlayers[numgenlayers++] = layer;
+    }
+}
+
+static void FinishOtherLayers()
+{
+    Layer* savelayer = currlayer;
+    for (int i = 0; i < numgenlayers; i++) {
+        currlayer = genlayers[i];
+        currlayer->algo->setpoll(wxGetApp().Poller());
+        mainptr->SetGenIncrement();     // restore this layer's own step size
+        if (allowundo) currlayer->undoredo->RememberGenFinish();
+    }
+    currlayer = savelayer;
+    numgenlayers = 0;
+}
+
+// steps one layer's pattern by the given increment; like StepPattern, this is
+// called on the stepper thread (or one of lifethreads) so mustn't touch windows
+
+static bool StepLayer(lifealgo* algo, lifepoll* poller, const bigint& inc)
+{
+    if (algo->needsbordercells()) {
+        // bounded grid, so step by 1 (see StepPattern)
+        algo->setIncrement(1);
+        bigint count = inc;
+        while (count > 0) {
+            if (poller->checkevents()) return false;
+            if (!algo->CreateBorderCells()) return false;
+            algo->step();
+            if (!algo->DeleteBorderCells()) return false;
+            count -= 1;
+        }
+    } else {
+        if (poller->checkevents()) return false;
+        algo->setIncrement(inc);
+        algo->step();
+    }
+    return true;
+}
+
+class layertask : public lifetask {
+public:
+    virtual void run() {
+        ok = algo ? StepLayer(algo, poller, inc) : mainptr->StepPattern();
+    }
+    lifealgo* algo;     // NULL for the current layer
+    lifepoll* poller;
+    bigint inc;
+    bool ok;
+};
+
+// -----------------------------------------------------------------------------
+
 void MainFrame::DisplayPattern()
 {
     // this routine is similar to UpdatePatternAndStatus() but if tiled windows
@@ -547,7 +670,7 @@ void MainFrame::DisplayPattern()
     
     if (IsIconized()) return;
     
-    if (tilelayers && numlayers > 1 && !syncviews && currlayer->cloneid == 0) {
+    if (tilelayers && numlayers > 1 && !syncviews && currlayer->cloneid == 0 && numgenlayers == 0) {
         // only update the current tile
         viewptr->Refresh(false);
     } else {
@@ -568,10 +691,13 @@ void MainFrame::DisplayPattern()
 
 // -----------------------------------------------------------------------------
 
+// StepPattern is called on the stepper thread while generating (see OnGenTimer)
+// so it must not touch any windows; ShowStep does that on the main thread
+
 bool MainFrame::StepPattern()
 {
     lifealgo* curralgo = currlayer->algo;
-    if (curralgo->unbounded && (curralgo->gridwd > 0 || curralgo->gridht > 0)) {
+    if (curralgo->needsbordercells()) {
         // bounded grid, so temporarily set the increment to 1 so we can call
         // CreateBorderCells() and DeleteBorderCells() around each step()
         int savebase = currlayer->currbase;
@@ -607,6 +733,13 @@ bool MainFrame::StepPattern()
         if (curralgo->isrecording()) curralgo->extendtimeline();
     }
     
+    return true;
+}
+
+// -----------------------------------------------------------------------------
+
+bool MainFrame::ShowStep()
+{
     if (currlayer->autofit) viewptr->FitInView(0);
     
     if (!IsIconized()) DisplayPattern();
@@ -804,6 +937,9 @@ void MainFrame::StartGenerating()
         return;
     }
     
+    // do this before RememberGenStart so the Undo item is for the current layer
+    StartOtherLayers();
+    
     // no need to test inscript or currlayer->stayclean
     if (allowundo && !currlayer->algo->isrecording()) currlayer->undoredo->RememberGenStart();
 
@@ -837,6 +973,7 @@ void MainFrame::FinishUp()
     }
     
     // note that we must call RememberGenFinish BEFORE processing any pending command
+    FinishOtherLayers();
     if (allowundo && !currlayer->algo->isrecording()) currlayer->undoredo->RememberGenFinish();
     
     // stop recording any timeline before processing any pending command
@@ -859,9 +996,42 @@ void MainFrame::FinishUp()
 
 // -----------------------------------------------------------------------------
 
+// steps the current pattern on the stepper thread
+
+class gentask : public lifetask {
+public:
+    virtual void run() {
+        if (numgenlayers == 0) {
+            ok = mainptr->StepPattern();
+            return;
+        }
+        // step the current layer and the other layers side by side,
+        // all by the current layer's increment
+        bigint inc = currlayer->algo->getIncrement();
+        layertask tasks[MAX_LAYERS];
+        lifetask* taskptrs[MAX_LAYERS];
+        tasks[0].algo = NULL;
+        taskptrs[0] = &tasks[0];
+        for (int i = 0; i < numgenlayers; i++) {
+            tasks[i+1].algo = genlayers[i]->algo;
+            tasks[i+1].poller = &genpollers[i];
+            tasks[i+1].inc = inc;
+            taskptrs[i+1] = &tasks[i+1];
+        }
+        wxGetApp().Stepper()->runtasks(taskptrs, numgenlayers + 1);
+        ok = tasks[0].ok;
+    }
+    bool ok;
+};
+
+static gentask genstep;
+static bool stepping = false;   // genstep was started and OnGenTimer hasn't seen it finish
+
 void MainFrame::StopGenerating()
 {
-    if (gentimer->IsRunning()) gentimer->Stop();
+    // if the stepper is busy then gentimer must keep running so that
+    // OnGenTimer can wait for step() to finish and then call FinishUp
+    if (gentimer->IsRunning() && !stepping) gentimer->Stop();
     generating = false;
     wxGetApp().PollerInterrupt();
     lifealgo::setVerbose(0);
@@ -871,8 +1041,9 @@ void MainFrame::StopGenerating()
     endgen = currlayer->algo->getGeneration().todouble();
 
     if (insideYield > 0) {
-        // we're currently in the event poller somewhere inside step(), so we must let
-        // step() complete and only call FinishUp after StepPattern has finished
+        // we're currently in the event poller somewhere inside step(), or step() is
+        // running on the stepper thread, so we must let step() complete and only call
+        // FinishUp after OnGenTimer has seen StepPattern finish
     } else {
         FinishUp();
     }
@@ -889,7 +1060,31 @@ void MainFrame::OnGenTimer(wxTimerEvent& WXUNUSED(event))
     if (in_timer) return;
     in_timer = true;
     
-    if (!StepPattern()) {
+    if (!stepping) {
+        if (generating) {
+            // start the first step; insideYield stays > 0 until it has finished
+            // so the rest of the GUI treats the pattern as being inside step()
+            stepping = true;
+            insideYield++;
+            wxGetApp().Stepper()->start(&genstep);
+        } else {
+            // this tick was queued before gentimer was stopped
+            gentimer->Stop();
+        }
+        in_timer = false;
+        return;
+    }
+    
+    if (wxGetApp().Stepper()->busy()) {
+        // keep handling events until step() has finished
+        in_timer = false;
+        return;
+    }
+    stepping = false;
+    insideYield--;
+    if (!generating) gentimer->Stop();
+    
+    if (!genstep.ok || !ShowStep()) {
         if (generating) {
             // call StopGenerating() to stop gentimer
             Stop();
@@ -926,8 +1121,13 @@ void MainFrame::OnGenTimer(wxTimerEvent& WXUNUSED(event))
     }
     
     if (!generating) {
-        // StopGenerating() was called while in Yield()
+        // StopGenerating() was called while in Yield() or while the stepper was busy
         FinishUp();
+    } else {
+        // start the next step now rather than waiting for the next tick
+        stepping = true;
+        insideYield++;
+        wxGetApp().Stepper()->start(&genstep);
     }
     
     in_timer = false;
@@ -1051,7 +1251,7 @@ void MainFrame::NextGeneration(bool useinc)
         viewptr->CheckCursor(infront);
     }
     
-    bool boundedgrid = curralgo->unbounded && (curralgo->gridwd > 0 || curralgo->gridht > 0);
+    bool boundedgrid = curralgo->needsbordercells();
     
     if (useinc) {
         // step by current increment
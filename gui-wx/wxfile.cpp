@@ -20,6 +20,7 @@
 #include "hlifealgo.h"
 #include "readpattern.h"   // for readpattern
 #include "writepattern.h"  // for writepattern, pattern_format
+#include "util.h"          // for lifethreads
 
 #include "wxgolly.h"       // for wxGetApp, statusptr, viewptr, bigview
 #include "wxutils.h"       // for Warning
@@ -144,15 +145,16 @@ void MainFrame::NewPattern(const wxString& title)
     currlayer->currbase = algoinfo[currlayer->algtype]->defbase;
     currlayer->currexpo = 0;
     
+    // clear all undo/redo history (before CreateUniverse deletes the old universe
+    // so the history needn't save its snapshots)
+    currlayer->undoredo->ClearUndoRedo();
+    
     // create new, empty universe of same type and using same rule
     CreateUniverse();
     
     // reset timing info used in DisplayTimingInfo
     endtime = begintime = 0;
     
-    // clear all undo/redo history
-    currlayer->undoredo->ClearUndoRedo();
-    
     if (newremovesel) currlayer->currsel.Deselect();
     if (newcurs) currlayer->curs = newcurs;
     viewptr->SetPosMag(bigint::zero, bigint::zero, newmag);
@@ -1887,6 +1889,11 @@ void MainFrame::ShowPrefsDialog(const wxString& page)
         // if mindelay/maxdelay changed then may need to change minexpo and currexpo
         UpdateStepExponent();
         
+        // numthreads might have changed; the thread pool can't be resized
+        // while a step is in progress (eg. a script opened this dialog),
+        // in which case the new setting takes effect when Golly restarts
+        if (insideYield == 0) lifethreads::setthreadcount(numthreads);
+        
         // maximum memory might have changed
         for (int i = 0; i < numlayers; i++) {
             Layer* layer = GetLayer(i);
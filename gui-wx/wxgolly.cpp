@@ -62,29 +62,51 @@ double scalefactor = 1.0;       // main window's scale factor (2.0 on Retina dis
 class wx_errors : public lifeerrors
 {
 public:
+    // when step() runs on the stepper thread we can't touch any windows,
+    // so messages are passed to the main thread and progress dialogs are
+    // not shown (the user can still stop generating)
+    
     virtual void fatal(const char* s) {
-        Fatal(wxString(s,wxConvLocal));
+        wxString msg(s,wxConvLocal);
+        if (lifeworker::isworker()) {
+            wxGetApp().CallAfter([msg] { Fatal(msg); });
+            wxGetApp().Stepper()->park(1);      // never returns
+        }
+        Fatal(msg);
     }
     
     virtual void warning(const char* s) {
-        Warning(wxString(s,wxConvLocal));
+        wxString msg(s,wxConvLocal);
+        if (lifeworker::isworker()) {
+            wxGetApp().CallAfter([msg] { Warning(msg); });
+        } else {
+            Warning(msg);
+        }
     }
     
     virtual void status(const char* s) {
-        statusptr->DisplayMessage(wxString(s,wxConvLocal));
+        wxString msg(s,wxConvLocal);
+        if (lifeworker::isworker()) {
+            wxGetApp().CallAfter([msg] { statusptr->DisplayMessage(msg); });
+        } else {
+            statusptr->DisplayMessage(msg);
+        }
     }
     
     virtual void beginprogress(const char* s) {
-        BeginProgress(wxString(s,wxConvLocal));
         // init flag for isaborted() calls in non-wx modules
         aborted = false;
+        if (lifeworker::isworker()) return;
+        BeginProgress(wxString(s,wxConvLocal));
     }
     
     virtual bool abortprogress(double f, const char* s) {
+        if (lifeworker::isworker()) return false;
         return AbortProgress(f, wxString(s,wxConvLocal));
     }
     
     virtual void endprogress() {
+        if (lifeworker::isworker()) return;
         EndProgress();
     }
     
@@ -130,6 +152,13 @@ public:
 
 int wx_poll::checkevents()
 {
+    if (lifeworker::isworker()) {
+        // step() is running on the stepper thread; stop here if the main
+        // thread wants to handle an event (see GollyApp::CallEventHandler)
+        wxGetApp().Stepper()->park();
+        return isInterrupted();
+    }
+    
     // avoid calling Yield too often
     long t = stopwatch->Time();
     if (t > nextcheck) {
@@ -147,6 +176,10 @@ int wx_poll::checkevents()
 
 void wx_poll::updatePop()
 {
+    if (lifeworker::isworker()) {
+        wxGetApp().CallAfter([this] { updatePop(); });
+        return;
+    }
     if (showstatus && !mainptr->IsIconized()) {
         statusptr->Refresh(false);
     }
@@ -173,6 +206,58 @@ void GollyApp::PollerInterrupt()
 
 // -----------------------------------------------------------------------------
 
+lifeworker stepper;    // create instance
+
+lifeworker* GollyApp::Stepper()
+{
+    return &stepper;
+}
+
+// return true if a handler for the given event might look at or change the
+// pattern; the others only use the GUI's own state so they can run while the
+// stepper carries on (mouse moves and idle events arrive many times a second
+// and would otherwise keep stopping it)
+
+static bool UsesPattern(const wxEvent& event)
+{
+    wxEventType type = event.GetEventType();
+    if (type == wxEVT_TIMER) {
+        // OnGenTimer only collects a finished step
+        return event.GetId() != ID_GENTIMER;
+    }
+    if (type == wxEVT_MOTION) {
+        // dragging the mouse can draw cells or change the selection
+        const wxMouseEvent& mouse = (const wxMouseEvent&)event;
+        return mouse.ButtonIsDown(wxMOUSE_BTN_ANY) || (viewptr &&
+               (viewptr->drawingcells || viewptr->selectingcells || viewptr->movingview));
+    }
+    return type != wxEVT_IDLE &&
+           type != wxEVT_UPDATE_UI &&
+           type != wxEVT_ENTER_WINDOW &&
+           type != wxEVT_LEAVE_WINDOW &&
+           type != wxEVT_SET_CURSOR &&
+           type != wxEVT_SET_FOCUS &&
+           type != wxEVT_KILL_FOCUS &&
+           type != wxEVT_ERASE_BACKGROUND;
+}
+
+void GollyApp::CallEventHandler(wxEvtHandler* handler, wxEventFunctor& functor,
+                                wxEvent& event) const
+{
+    // while generating, step() runs on the stepper thread (see OnGenTimer);
+    // a handler that uses the pattern (including any paint handler) stops the
+    // stepper at its next poll, which is where handlers used to be called via
+    // Yield, and lets it go again as soon as the handler returns
+    int paused = 0;
+    if (UsesPattern(event)) {
+        paused = stepper.pause();
+    }
+    wxApp::CallEventHandler(handler, functor, event);
+    if (paused) stepper.resume();
+}
+
+// -----------------------------------------------------------------------------
+
 void SetAppDirectory(const char* argv0)
 {
 #ifdef __WXMSW__
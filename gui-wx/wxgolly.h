@@ -6,6 +6,7 @@
 
 // need some forward declarations
 class lifepoll;
+class lifeworker;
 class MainFrame;
 class PatternView;
 class StatusBar;
@@ -31,6 +32,13 @@ public:
     lifepoll* Poller();
     void PollerReset();
     void PollerInterrupt();
+    
+    // worker thread that steps the current pattern while generating
+    lifeworker* Stepper();
+    
+    // handlers only run while the worker is stopped at a poll point
+    virtual void CallEventHandler(wxEvtHandler* handler, wxEventFunctor& functor,
+                                  wxEvent& event) const;
 };
 
 DECLARE_APP(GollyApp)            // so other files can use wxGetApp
@@ -43,7 +51,7 @@ extern PatternView* viewptr;     // current viewport window (possibly a tile)
 extern PatternView* bigview;     // big viewport window (encloses all tiles)
 extern StatusBar* statusptr;     // status bar window
 extern wxStopWatch* stopwatch;   // global stopwatch (started in OnInit)
-extern int insideYield;          // if > 0 then processing an event via Yield()
+extern int insideYield;          // if > 0 then step() is in progress (via Yield or Stepper)
 extern double scalefactor;       // main window's scale factor (2.0 on Retina displays, 1.0 otherwise)
 
 #endif
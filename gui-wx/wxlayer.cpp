@@ -1733,6 +1733,16 @@ void ToggleSyncCursors()
 
 // -----------------------------------------------------------------------------
 
+void ToggleSyncGenerating()
+{
+    // if generating then the change takes effect the next time it starts
+    syncgens = !syncgens;
+    
+    mainptr->UpdateUserInterface();
+}
+
+// -----------------------------------------------------------------------------
+
 void ToggleStackLayers()
 {
     stacklayers = !stacklayers;
@@ -2954,9 +2964,10 @@ Layer::~Layer()
         }
         
     } else {
-        // this layer is not a clone, so delete universe and undo/redo history
-        delete algo;
+        // this layer is not a clone, so delete undo/redo history and universe
+        // (in that order so the history needn't save its snapshots)
         delete undoredo;
+        delete algo;
         
         // delete tempstart file if it exists
         if (wxFileExists(tempstart)) wxRemoveFile(tempstart);
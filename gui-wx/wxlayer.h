@@ -175,6 +175,10 @@ void ToggleSyncCursors();
 // Toggle the synccursors flag.  When true, every layer uses the same
 // cursor as the current layer.
 
+void ToggleSyncGenerating();
+// Toggle the syncgens flag.  When true, every layer with its own universe
+// generates along with the current layer (see StartGenerating).
+
 void ToggleStackLayers();
 // Toggle the stacklayers flag.  When true, the rendering code displays
 // all layers using the same scale and location as the current layer.
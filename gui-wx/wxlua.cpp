@@ -270,28 +270,18 @@ static const char* ExtractCellArray(lua_State* L, lifealgo* universe, bool shift
         int ileft = left.toint();
         int ibottom = bottom.toint();
         int iright = right.toint();
-        int cx, cy;
-        int v = 0;
         int arraylen = 0;
-        for ( cy=itop; cy<=ibottom; cy++ ) {
-            for ( cx=ileft; cx<=iright; cx++ ) {
-                int skip = universe->nextcell(cx, cy, v);
-                if (skip >= 0) {
-                    // found next live cell in this row
-                    cx += skip;
-                    if (shift) {
-                        // shift cells so that top left cell of bounding box is at 0,0
-                        lua_pushinteger(L, cx - ileft); lua_rawseti(L, -2, ++arraylen);
-                        lua_pushinteger(L, cy - itop ); lua_rawseti(L, -2, ++arraylen);
-                    } else {
-                        lua_pushinteger(L, cx); lua_rawseti(L, -2, ++arraylen);
-                        lua_pushinteger(L, cy); lua_rawseti(L, -2, ++arraylen);
-                    }
-                    if (multistate) {
-                        lua_pushinteger(L, v); lua_rawseti(L, -2, ++arraylen);
-                    }
-                } else {
-                    cx = iright;  // done this row
+        // shift cells so that top left cell of bounding box is at 0,0
+        int dx = shift ? ileft : 0;
+        int dy = shift ? itop : 0;
+        vector<cellspan> spans;
+        universe->getcellruns(itop, ileft, ibottom, iright, spans);
+        for ( size_t i=0; i<spans.size(); i++ ) {
+            for ( int cx=spans[i].x; cx<spans[i].x+spans[i].n; cx++ ) {
+                lua_pushinteger(L, cx - dx); lua_rawseti(L, -2, ++arraylen);
+                lua_pushinteger(L, spans[i].y - dy); lua_rawseti(L, -2, ++arraylen);
+                if (multistate) {
+                    lua_pushinteger(L, spans[i].state); lua_rawseti(L, -2, ++arraylen);
                 }
             }
         }
@@ -889,7 +879,7 @@ static int g_evolve(lua_State* L)
     
     // advance pattern by ngens
     mainptr->generating = true;
-    if (tempalgo->unbounded && (tempalgo->gridwd > 0 || tempalgo->gridht > 0)) {
+    if (tempalgo->needsbordercells()) {
         // a bounded grid must use an increment of 1 so we can call
         // CreateBorderCells and DeleteBorderCells around each step()
         tempalgo->setIncrement(1);
@@ -1109,25 +1099,16 @@ static int g_getcells(lua_State* L)
         
         int iright = ileft + wd - 1;
         int ibottom = itop + ht - 1;
-        int cx, cy;
-        int v = 0;
         lifealgo* curralgo = currlayer->algo;
         bool multistate = curralgo->NumCellStates() > 2;
-        for ( cy=itop; cy<=ibottom; cy++ ) {
-            for ( cx=ileft; cx<=iright; cx++ ) {
-                int skip = curralgo->nextcell(cx, cy, v);
-                if (skip >= 0) {
-                    // found next live cell in this row
-                    cx += skip;
-                    if (cx <= iright) {
-                        lua_pushinteger(L, cx); lua_rawseti(L, -2, ++arraylen);
-                        lua_pushinteger(L, cy); lua_rawseti(L, -2, ++arraylen);
-                        if (multistate) {
-                            lua_pushinteger(L, v); lua_rawseti(L, -2, ++arraylen);
-                        }
-                    }
-                } else {
-                    cx = iright;  // done this row
+        vector<cellspan> spans;
+        curralgo->getcellruns(itop, ileft, ibottom, iright, spans);
+        for ( size_t i=0; i<spans.size(); i++ ) {
+            for ( int cx=spans[i].x; cx<spans[i].x+spans[i].n; cx++ ) {
+                lua_pushinteger(L, cx); lua_rawseti(L, -2, ++arraylen);
+                lua_pushinteger(L, spans[i].y); lua_rawseti(L, -2, ++arraylen);
+                if (multistate) {
+                    lua_pushinteger(L, spans[i].state); lua_rawseti(L, -2, ++arraylen);
                 }
             }
         }
@@ -1350,24 +1331,16 @@ static int g_getclip(lua_State* L)
         // extract cells from templayer
         lifealgo* tempalgo = templayer->algo;
         bool multistate = tempalgo->NumCellStates() > 2;
-        int cx, cy;
-        int v = 0;
-        for ( cy=itop; cy<=ibottom; cy++ ) {
-            for ( cx=ileft; cx<=iright; cx++ ) {
-                int skip = tempalgo->nextcell(cx, cy, v);
-                if (skip >= 0) {
-                    // found next live cell in this row
-                    cx += skip;
+        vector<cellspan> spans;
+        tempalgo->getcellruns(itop, ileft, ibottom, iright, spans);
+        for ( size_t i=0; i<spans.size(); i++ ) {
+            for ( int cx=spans[i].x; cx<spans[i].x+spans[i].n; cx++ ) {
+                // shift cells so that top left cell of bounding box is at 0,0
+                lua_pushinteger(L, cx - ileft); lua_rawseti(L, -2, ++arraylen);
+                lua_pushinteger(L, spans[i].y - itop); lua_rawseti(L, -2, ++arraylen);
 
-                    // shift cells so that top left cell of bounding box is at 0,0
-                    lua_pushinteger(L, cx - ileft); lua_rawseti(L, -2, ++arraylen);
-                    lua_pushinteger(L, cy - itop ); lua_rawseti(L, -2, ++arraylen);
-
-                    if (multistate) {
-                        lua_pushinteger(L, v); lua_rawseti(L, -2, ++arraylen);
-                    }
-                } else {
-                    cx = iright;  // done this row
+                if (multistate) {
+                    lua_pushinteger(L, spans[i].state); lua_rawseti(L, -2, ++arraylen);
                 }
             }
         }
@@ -726,6 +726,7 @@ void MainFrame::UpdateMenuItems()
         mbar->Enable(ID_SET_COLORS,   active && !inscript);
         mbar->Enable(ID_SYNC_VIEW,    active);
         mbar->Enable(ID_SYNC_CURS,    active);
+        mbar->Enable(ID_SYNC_GENS,    active);
         mbar->Enable(ID_STACK,        active);
         mbar->Enable(ID_TILE,         active);
         for (int i = 0; i < numlayers; i++)
@@ -774,6 +775,7 @@ void MainFrame::UpdateMenuItems()
         mbar->Check(ID_SCALE_32,      viewptr->GetMag() == 5);
         mbar->Check(ID_SYNC_VIEW,     syncviews);
         mbar->Check(ID_SYNC_CURS,     synccursors);
+        mbar->Check(ID_SYNC_GENS,     syncgens);
         mbar->Check(ID_STACK,         stacklayers);
         mbar->Check(ID_TILE,          tilelayers);
         mbar->Check(ID_SHOW_OVERLAY,  showoverlay);
@@ -1442,6 +1444,7 @@ void MainFrame::OnMenu(wxCommandEvent& event)
         case ID_SET_COLORS:     SetLayerColors(); break;
         case ID_SYNC_VIEW:      ToggleSyncViews(); break;
         case ID_SYNC_CURS:      ToggleSyncCursors(); break;
+        case ID_SYNC_GENS:      ToggleSyncGenerating(); break;
         case ID_STACK:          ToggleStackLayers(); break;
         case ID_TILE:           ToggleTileLayers(); break;
             
@@ -1894,9 +1897,10 @@ void MainFrame::OnClose(wxCloseEvent& event)
     if (event.CanVeto()) {
         if (inscript || generating) Stop();
         
-        // if insideYield > 0 then we might have been called from
-        // StepPattern in OnGenTimer, so we need to call OnClose again via
-        // OnIdle until insideYield is 0 and OnGenTimer has finished
+        // if insideYield > 0 then we might have been called from inside
+        // step(), or step() is still running on the stepper thread, so we need
+        // to call OnClose again via OnIdle until insideYield is 0 and
+        // OnGenTimer has finished
         if (insideYield > 0) {
             call_close = true;
             event.Veto();
@@ -2319,6 +2323,7 @@ void MainFrame::CreateMenus()
     layerMenu->AppendSeparator();
     layerMenu->AppendCheckItem(ID_SYNC_VIEW,     _("Synchronize Views") + GetAccelerator(DO_SYNCVIEWS));
     layerMenu->AppendCheckItem(ID_SYNC_CURS,     _("Synchronize Cursors") + GetAccelerator(DO_SYNCCURS));
+    layerMenu->AppendCheckItem(ID_SYNC_GENS,     _("Synchronize Generating") + GetAccelerator(DO_SYNCGENS));
     layerMenu->AppendSeparator();
     layerMenu->AppendCheckItem(ID_STACK,         _("Stack Layers") + GetAccelerator(DO_STACK));
     layerMenu->AppendCheckItem(ID_TILE,          _("Tile Layers") + GetAccelerator(DO_TILE));
@@ -2504,6 +2509,7 @@ void MainFrame::UpdateMenuAccelerators()
         SetAccelerator(mbar, ID_SET_COLORS,      DO_SETCOLORS);
         SetAccelerator(mbar, ID_SYNC_VIEW,       DO_SYNCVIEWS);
         SetAccelerator(mbar, ID_SYNC_CURS,       DO_SYNCCURS);
+        SetAccelerator(mbar, ID_SYNC_GENS,       DO_SYNCGENS);
         SetAccelerator(mbar, ID_STACK,           DO_STACK);
         SetAccelerator(mbar, ID_TILE,            DO_TILE);
     }
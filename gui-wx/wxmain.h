@@ -75,6 +75,8 @@ public:
     void ToggleAllowUndo();
     void RestorePattern(bigint& gen, const wxString& filename,
                         bigint& x, bigint& y, int mag, int base, int expo);
+    void RestoreSnapshot(int snapshot, bigint& gen,
+                         bigint& x, bigint& y, int mag, int base, int expo);
     
     // prefs functions
     void SetRandomFillPercentage();
@@ -100,6 +102,7 @@ public:
     void SetStepExponent(int newexpo);
     void SetGenIncrement();
     bool SaveStartingPattern();
+    bool StepPattern();             // called on the stepper thread while generating
     void ResetPattern(bool resetundo = true);
     void SetGeneration();
     const char* ChangeGenCount(const char* genstring, bool inundoredo = false);
@@ -199,7 +202,7 @@ private:
     
     // control functions
     void DisplayPattern();
-    bool StepPattern();
+    bool ShowStep();
     
     // miscellaneous functions
     void CreateMenus();
@@ -357,6 +360,7 @@ enum {
     ID_SET_COLORS,
     ID_SYNC_VIEW,
     ID_SYNC_CURS,
+    ID_SYNC_GENS,
     ID_STACK,
     ID_TILE,
     ID_LAYER0,
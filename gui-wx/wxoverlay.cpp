@@ -787,7 +787,6 @@ Overlay::Overlay()
     showhistory = 0;
     fadehistory = false;
     modN = NULL;
-    modNN = NULL;
     xyz = NULL;
     xaxis = NULL;
     yaxis = NULL;
@@ -8536,9 +8535,7 @@ const char *Overlay::Do3DSetGridSize(lua_State *L, const int n, int *nresults) {
 
     // resize tables
     if (!grid3d.SetSize(NNN)) return OverlayError("could not allocate grid3d");
-    if (!count1.SetSize(NNN)) return OverlayError("could not allocate count1");
-    if (!count2.SetSize(NNN)) return OverlayError("could not allocate count2");
-    if (!next3d.SetSize(NNN)) return OverlayError("could not allocate next3d");
+    if (!engine3d.setsize(N)) return OverlayError("could not allocate engine3d");
     if (!paste3d.SetSize(NNN)) return OverlayError("could not allocate paste3d");
     if (!select3d.SetSize(NNN)) return OverlayError("could not allocate select3d");
     if (!active3d.SetSize(NNN)) return OverlayError("could not allocate active3d");
@@ -8635,6 +8632,12 @@ const char *Overlay::Do3DSetRule(lua_State *L, const int n, int *nresults) {
         if (!valid) return OverlayError("births element is out of range");
     }
 
+    // pass the rule on to the 3D engine (in the same order as ruletypes)
+    static const life3drule enginerules[] = {
+        moore3d, face3d, corner3d, edge3d, hexahedral3d, busyboxes3d, busyboxeswrap3d
+    };
+    engine3d.setrule(enginerules[ruletype], survivals, births);
+
     return error;
 }
 
@@ -8645,10 +8648,6 @@ void Overlay::FreeDivTable() {
         free(modN);
         modN = NULL;
     }
-    if (modNN) {
-        free(modNN);
-        modNN = NULL;
-    }
     if (xyz) {
         free(xyz);
         xyz = NULL;
@@ -8669,11 +8668,10 @@ bool Overlay::CreateDivTable() {
 
     // allocate new table
     modN     = (int*)malloc(NNN * sizeof(*modN));
-    modNN    = (int*)malloc(NNN * sizeof(*modNN));
     xyz      = (unsigned int*)malloc(NNN * sizeof(*xyz));
 
     // check allocation succeeded
-    if (modN == NULL || modNN == NULL || xyz == NULL) {
+    if (modN == NULL || xyz == NULL) {
         FreeDivTable();
         return false;
     }
@@ -8681,7 +8679,6 @@ bool Overlay::CreateDivTable() {
     // populate table
     for (int i = 0; i < NNN; i++) {
         modN[i]  = i % N;
-        modNN[i] = i % NN;
     }
     for (int i = 0; i < NNN; i++) {
         xyz[i] = (modN[i] << 16) | (modN[i / N] << 8) | i / NN;
@@ -8772,196 +8769,35 @@ void Overlay::UpdateBoundingBox() {
 
 // -----------------------------------------------------------------------------
 
-int Overlay::CreateResultsFromC1(lua_State *L, const bool laststep) {
-    // create results for BusyBoxes
-    if (laststep) {
-        lua_newtable(L);
-    }
-    next3d.Clear();
-
-    // clear axes
-    ClearAxisFlags();
-
-    int numkeys;
-    const int *count1keys = count1.GetKeys(&numkeys);
-    const unsigned char *count1values = count1.GetValues();
-
-    if (laststep) {
-        // on the last step update the return grid
-        for (int i = 0; i < numkeys; i++) {
-            const int k = count1keys[i];
-            if (count1values[k]) {
-                // create a live cell in next grid
-                lua_pushnumber(L, 1);
-                lua_rawseti(L, -2, k);
-                next3d.SetTo1(k);
-                const unsigned int loc = xyz[k];
-                xaxis[loc >> 16] = 1;
-                yaxis[(loc >> 8) & 0xff] = 1;
-                zaxis[loc & 0xff] = 1;
-            }
-        }
-    } else {
-        for (int i = 0; i < numkeys; i++) {
-            const int k = count1keys[i];
-            if (count1values[k]) {
-                // create a live cell in next grid
-                next3d.SetTo1(k);
-                const unsigned int loc = xyz[k];
-                xaxis[loc >> 16] = 1;
-                yaxis[(loc >> 8) & 0xff] = 1;
-                zaxis[loc & 0xff] = 1;
-            }
-        }
-    }
-    grid3d.Copy(next3d);
-    UpdateBoundingBox();
-
-    // return the population
-    return next3d.GetNumKeys();
-}
-
-// -----------------------------------------------------------------------------
-
-int Overlay::CreateResultsFromC1G3(lua_State *L, const bool laststep) {
-    // create results for Moore
-    if (laststep) {
-        lua_newtable(L);
-    }
-    next3d.Clear();
-    int numkeys;
-    const int *count1keys = count1.GetKeys(&numkeys);
-    const unsigned char *count1values = count1.GetValues();
-    const unsigned char *grid3dvalues = grid3d.GetValues();
-
-    // clear axes
-    ClearAxisFlags();
-
-    if (laststep) {
-        // on the last step update the return grid
-        for (int i = 0; i < numkeys; i++) {
-            const int k = count1keys[i];
-            const unsigned char v = count1values[k];
-            const unsigned char src = grid3dvalues[k];
-            if ((src && survivals[v - 1]) || (births[v] && !src)) {
-                // create a live cell in next grid
-                lua_pushnumber(L, 1);
-                lua_rawseti(L, -2, k);
-                next3d.SetTo1(k);
-                const unsigned int loc = xyz[k];
-                xaxis[loc >> 16] = 1;
-                yaxis[(loc >> 8) & 0xff] = 1;
-                zaxis[loc & 0xff] = 1;
-            }
-        }
-    } else {
-        for (int i = 0; i < numkeys; i++) {
-            const int k = count1keys[i];
-            const unsigned char v = count1values[k];
-            const unsigned char src = grid3dvalues[k];
-            if ((src && survivals[v - 1]) || (births[v] && !src)) {
-                // create a live cell in next grid
-                next3d.SetTo1(k);
-                const unsigned int loc = xyz[k];
-                xaxis[loc >> 16] = 1;
-                yaxis[(loc >> 8) & 0xff] = 1;
-                zaxis[loc & 0xff] = 1;
-            }
-        }
+void Overlay::UpdateGridFromEngine() {
+    // copy the live cells from the 3D engine into the source grid
+    engine3d.getcells(live3d);
+    grid3d.Clear();
+    const int numkeys = (int)live3d.size();
+    for (int i = 0; i < numkeys; i++) {
+        grid3d.SetTo1(live3d[i]);
     }
-    grid3d.Copy(next3d);
-    UpdateBoundingBox();
-
-    // return the population
-    return next3d.GetNumKeys();
 }
 
 // -----------------------------------------------------------------------------
 
-int Overlay::CreateResultsFromC1C2(lua_State *L, const bool laststep) {
-    // create results for Face, Corner, Edge or Hexahedral
-    if (laststep) {
-        lua_newtable(L);
+void Overlay::CreateResultsFromEngine(lua_State *L, const int newpop) {
+    // create the return grid from the live cells
+    const int numkeys = (int)live3d.size();
+    lua_createtable(L, 0, numkeys);
+    for (int i = 0; i < numkeys; i++) {
+        lua_pushnumber(L, 1);
+        lua_rawseti(L, -2, live3d[i]);
     }
-    next3d.Clear();
 
-    // clear axes
-    ClearAxisFlags();
-
-    // use count1 and survivals to put live cells in grid
-    int numkeys;
-    const int *count1keys = count1.GetKeys(&numkeys);
-    const unsigned char *count1values = count1.GetValues();
-
-    if (laststep) {
-        // on the last step update the return grid
-        for (int i = 0; i < numkeys; i++) {
-            const int k = count1keys[i];
-            const unsigned char v = count1values[k];
-            if (survivals[v]) {
-                // create a live cell in next grid
-                lua_pushnumber(L, 1);
-                lua_rawseti(L, -2, k);
-                next3d.SetValue(k, 1);
-                const unsigned int loc = xyz[k];
-                xaxis[loc >> 16] = 1;
-                yaxis[(loc >> 8) & 0xff] = 1;
-                zaxis[loc & 0xff] = 1;
-            }
-        }
-    } else {
-        for (int i = 0; i < numkeys; i++) {
-            const int k = count1keys[i];
-            const unsigned char v = count1values[k];
-            if (survivals[v]) {
-                // create a live cell in next grid
-                next3d.SetValue(k, 1);
-                const unsigned int loc = xyz[k];
-                xaxis[loc >> 16] = 1;
-                yaxis[(loc >> 8) & 0xff] = 1;
-                zaxis[loc & 0xff] = 1;
-            }
-        }
-    }
-
-    // use count2 and births to put live cells in grid
-    const int *count2keys = count2.GetKeys(&numkeys);
-    const unsigned char *count2values = count2.GetValues();
-
-    if (laststep) {
-        for (int i = 0; i < numkeys; i++) {
-            const int k = count2keys[i];
-            const unsigned char v = count2values[k];
-            if (births[v]) {
-                // create a live cell in next grid
-                lua_pushnumber(L, 1);
-                lua_rawseti(L, -2, k);
-                next3d.SetValue(k, 1);
-                const unsigned int loc = xyz[k];
-                xaxis[loc >> 16] = 1;
-                yaxis[(loc >> 8) & 0xff] = 1;
-                zaxis[loc & 0xff] = 1;
-            }
-        }
-    } else {
-        for (int i = 0; i < numkeys; i++) {
-            const int k = count2keys[i];
-            const unsigned char v = count2values[k];
-            if (births[v]) {
-                // create a live cell in next grid
-                next3d.SetValue(k, 1);
-                const unsigned int loc = xyz[k];
-                xaxis[loc >> 16] = 1;
-                yaxis[(loc >> 8) & 0xff] = 1;
-                zaxis[loc & 0xff] = 1;
-            }
+    // update the bounding box
+    if (newpop > 0) {
+        const int Nm1 = gridsize - 1;
+        engine3d.getbounds(minx, maxx, miny, maxy, minz, maxz);
+        if (minx == 0 || miny == 0 || minz == 0 || maxx == Nm1 || maxy == Nm1 || maxz == Nm1) {
+            liveedge = true;
         }
     }
-    grid3d.Copy(next3d);
-    UpdateBoundingBox();
-
-    // return the population
-    return next3d.GetNumKeys();
 }
 
 // -----------------------------------------------------------------------------
@@ -8969,8 +8805,12 @@ int Overlay::CreateResultsFromC1C2(lua_State *L, const bool laststep) {
 void Overlay::PopulateAxis() {
     if (gridsize == 0) return;
 
+    // nextgen3d no longer keeps the axis flags up to date
+    ClearAxisFlags();
+
     int numkeys;
     const int *grid3dkeys = grid3d.GetKeys(&numkeys);
+    if (numkeys == 0) return;
     for (int i = 0; i < numkeys; i++) {
         int k = grid3dkeys[i];
         const unsigned int loc = xyz[k];
@@ -9191,59 +9031,34 @@ const char *Overlay::Do3DNextGen(lua_State *L, const int n, int *nresults) {
     // check div table exists
     if (modN == NULL) if (!CreateDivTable()) return OverlayError("could not allocate div table");
 
+    // BusyBoxes needs an even grid size
+    if ((ruletype == bb || ruletype == bbw) && (gridsize & 1) == 1) {
+        return OverlayError("grid size must be even for BusyBoxes");
+    }
+
+    // load the source grid into the 3D engine (which always wraps,
+    // so the liveedge flag is no longer needed to choose an algo)
+    int numkeys;
+    const int *grid3dkeys = grid3d.GetKeys(&numkeys);
+    engine3d.clearall();
+    for (int i = 0; i < numkeys; i++) {
+        engine3d.setcell(grid3dkeys[i]);
+    }
+    engine3d.endofpattern();
+
     // process each step
     int lastgen = gencount - (gencount % stepsize) + stepsize;
     int newpop = 0;
-    bool laststep = false;
 
     while (gencount < lastgen) {
-        // set the laststep flag
-        if (gencount == lastgen - 1) laststep = true;
-
-        // clear the intermediate counts
-        count1.ClearKeys();
-        if (!(ruletype == bb || ruletype == bbw)) {
-            count2.ClearKeys();
-        }
-
-        // call the appropriate algorithm
-        switch (ruletype) {
-            case moore:
-                Do3DNextGenMoore();
-                newpop = CreateResultsFromC1G3(L, laststep);
-                break;
-            case face:
-                Do3DNextGenFace();
-                newpop = CreateResultsFromC1C2(L, laststep);
-                break;
-            case corner:
-                Do3DNextGenCorner();
-                newpop = CreateResultsFromC1C2(L, laststep);
-                break;
-            case edge:
-                Do3DNextGenEdge();
-                newpop = CreateResultsFromC1C2(L, laststep);
-                break;
-            case hexahedral:
-                Do3DNextGenHexahedral();
-                newpop = CreateResultsFromC1C2(L, laststep);
-                break;
-            case bb:
-                if ((gridsize & 1) == 1) return OverlayError("grid size must be even for BusyBoxes");
-                Do3DNextGenBB(true, gencount);
-                newpop = CreateResultsFromC1(L, laststep);
-                break;
-            case bbw:
-                if ((gridsize & 1) == 1) return OverlayError("grid size must be even for BusyBoxes");
-                Do3DNextGenBB(false, gencount);
-                newpop = CreateResultsFromC1(L, laststep);
-                break;
-            default:
-                return OverlayError("illegal rule specified");
-        }
+        engine3d.step(gencount);
+        newpop = engine3d.getpopulation();
 
         // update history if required
-        if (showhistory > 0) UpdateHistoryFromLive();
+        if (showhistory > 0) {
+            UpdateGridFromEngine();
+            UpdateHistoryFromLive();
+        }
 
         // next step
         gencount++;
@@ -9252,6 +9067,10 @@ const char *Overlay::Do3DNextGen(lua_State *L, const int n, int *nresults) {
         if (newpop == 0) break;
     }
 
+    // copy the live cells back into the source grid and create the results
+    if (showhistory == 0) UpdateGridFromEngine();
+    CreateResultsFromEngine(L, newpop);
+
     // return the population
     lua_pushinteger(L, newpop);
 
@@ -9273,638 +9092,6 @@ const char *Overlay::Do3DNextGen(lua_State *L, const int n, int *nresults) {
 
 // -----------------------------------------------------------------------------
 
-void Overlay::Do3DNextGenBB(const bool mirror, const int gencount) {
-    // the algorithm used below is a slightly modified (and corrected!)
-    // version of the kernel code in Ready's Salt 3D example
-    // (see Patterns/CellularAutomata/Salt/salt3D_circular330.vti);
-    // it uses a rule based on 28 cells in a 7x7 neighborhood for each live cell
-
-    // swap site locations
-    static const int swap1[] = { 1,  1};
-    static const int swap2[] = {-1,  1};
-    static const int swap3[] = {-1, -1};
-    static const int swap4[] = { 1, -1};
-
-    // activator locations
-    static const int act5[]  = { 2, -1};
-    static const int act6[]  = { 2,  1};
-    static const int act7[]  = { 1,  2};
-    static const int act8[]  = {-1,  2};
-    static const int act9[]  = {-2,  1};
-    static const int act10[] = {-2, -1};
-    static const int act11[] = {-1, -2};
-    static const int act12[] = { 1, -2};
-
-    // inhibitor locations
-    static const int inhib13[] = {-2, -3};
-    static const int inhib14[] = { 0, -3};
-    static const int inhib15[] = { 2, -3};
-    static const int inhib16[] = {-3, -2};
-    static const int inhib17[] = { 3, -2};
-    static const int inhib18[] = { 0, -1};
-    static const int inhib19[] = {-3,  0};
-    static const int inhib20[] = {-1,  0};
-    static const int inhib21[] = { 1,  0};
-    static const int inhib22[] = { 3,  0};
-    static const int inhib23[] = { 0,  1};
-    static const int inhib24[] = {-3,  2};
-    static const int inhib25[] = { 3,  2};
-    static const int inhib26[] = {-2,  3};
-    static const int inhib27[] = { 0,  3};
-    static const int inhib28[] = { 2,  3};
-
-    static const int *coords[] = {
-        // 1 to 4 are the coordinates for the 4 potential swap sites:
-        swap1, swap2, swap3, swap4,
-        // 5 to 12 are activators:
-        act5, act6, act7, act8, act9, act10, act11, act12,
-        // 13 to 28 are inhibitors:
-        inhib13, inhib14, inhib15, inhib16, inhib17, inhib18,
-        inhib19, inhib20, inhib21, inhib22, inhib23, inhib24,
-        inhib25, inhib26, inhib27, inhib28
-    };
-
-    // numbers are indices into the coords array
-    static const int actidx1[] = {4,  7};
-    static const int actidx2[] = {6,  9};
-    static const int actidx3[] = {8, 11};
-    static const int actidx4[] = {5, 10};
-    static const int *activators[] = {actidx1, actidx2, actidx3, actidx4};
-
-    static const int inhibidx1[] = {17, 24, 21, 26, 19, 27, 6,  9,  8, 11,  5, 10};
-    static const int inhibidx2[] = {17, 23, 18, 26, 20, 25, 4,  7,  8, 11,  5, 10};
-    static const int inhibidx3[] = {15, 22, 13, 18, 12, 20, 4,  7,  6,  9,  5, 10};
-    static const int inhibidx4[] = {19, 14, 13, 21, 16, 22, 4,  7,  6,  9,  8, 11};
-    static const int *inhibitors[] = {inhibidx1, inhibidx2, inhibidx3, inhibidx4};
-
-    int numkeys;
-    const int phase = gencount % 6;
-    const int N = gridsize;
-    const int NN = N * N;
-    const int *grid3dkeys = grid3d.GetKeys(&numkeys);
-    const unsigned char *grid3dvalues = grid3d.GetValues();
-
-    // apply rule
-    unsigned char val[28];
-    for (int i = 0; i < numkeys; i++) {
-        const int k = grid3dkeys[i];
-        const unsigned int loc = xyz[k];
-        int x = loc >> 16;
-        int y = (loc >> 8) & 0xff;
-        int z = loc & 0xff;
-        if (((x + y + z) & 1) == (phase & 1)) {
-            // this live cell has the right parity so get values for its 28 neighbors
-            int sx, sy, sz;
-            int j = 0;
-            const int *coordsj;
-            if (phase == 0 || phase == 3) {
-                const int Nz = N * z;
-                // use XY plane
-                x += N;
-                y += N;
-                while (j < 28) {
-                    // compute the next two values
-                    coordsj = coords[j];
-                    sx = modN[x + coordsj[0]];
-                    sy = modN[y + coordsj[1]];
-                    val[j++] = grid3dvalues[sx + N * (sy + Nz)];
-                    coordsj = coords[j];
-                    sx = modN[x + coordsj[0]];
-                    sy = modN[y + coordsj[1]];
-                    val[j++] = grid3dvalues[sx + N * (sy + Nz)];
-                }
-            } else {
-                if (phase == 1 || phase == 4) {
-                    // use YZ plane
-                    y += N;
-                    z += N;
-                    while (j < 28) {
-                        // compute the next two values
-                        coordsj = coords[j];
-                        sy = modN[y + coordsj[0]];
-                        sz = modN[z + coordsj[1]];
-                        val[j++] = grid3dvalues[x + N * (sy + N * sz)];
-                        coordsj = coords[j];
-                        sy = modN[y + coordsj[0]];
-                        sz = modN[z + coordsj[1]];
-                        val[j++] = grid3dvalues[x + N * (sy + N * sz)];
-                    }
-                } else {
-                    // phase == 2 or 5 so use XZ plane
-                    x += N;
-                    z += N;
-                    const int Ny = N * y;
-                    while (j < 28) {
-                        // compute the next two values
-                        coordsj = coords[j];
-                        sx = modN[x + coordsj[0]];
-                        sz = modN[z + coordsj[1]];
-                        val[j++] = grid3dvalues[sx + Ny + NN * sz];
-                        coordsj = coords[j];
-                        sx = modN[x + coordsj[0]];
-                        sz = modN[z + coordsj[1]];
-                        val[j++] = grid3dvalues[sx + Ny + NN * sz];
-                    }
-                }
-            }
-
-            // find the potential swaps
-            int numswaps = 0;
-            int swapi = 0;
-            for (j = 0; j <= 3; j++) {
-                const int *activatorsj = activators[j];
-                const int *inhibitorsj = inhibitors[j];
-                // if either activator is a live cell then the swap is possible,
-                // but if any inhibitor is a live cell then the swap is forbidden
-                if ((val[activatorsj[0]] || val[activatorsj[1]])
-                    && ! (val[inhibitorsj[0]] || val[inhibitorsj[1]] ||
-                             val[inhibitorsj[2]] || val[inhibitorsj[3]] ||
-                             val[inhibitorsj[4]] || val[inhibitorsj[5]] ||
-                             val[inhibitorsj[6]] || val[inhibitorsj[7]] ||
-                             val[inhibitorsj[8]] || val[inhibitorsj[9]] ||
-                             val[inhibitorsj[10]] || val[inhibitorsj[11]])) {
-                    numswaps++;
-                    if (numswaps > 1) break;
-                    swapi = j;   // index of swap location in coords array (0..3)
-                }
-            }
-
-            // if only one swap, and only to an empty cell, then do it
-            if (numswaps == 1 && ! val[swapi]) {
-                // calculate the swap position
-                int newx, newy, newz;
-                if (phase == 0 || phase == 3) {
-                    // use XY plane
-                    newx = x - N + coords[swapi][0];
-                    newy = y - N + coords[swapi][1];
-                    newz = z;
-                } else {
-                    if (phase == 1 || phase == 4) {
-                        // use YZ plane
-                        newx = x;
-                        newy = y - N + coords[swapi][0];
-                        newz = z - N + coords[swapi][1];
-                    } else {
-                        // phase == 2 or 5 so use XZ plane
-                        newx = x - N + coords[swapi][0];
-                        newy = y;
-                        newz = z - N + coords[swapi][1];
-                    }
-                }
-                // if using mirror mode then don't wrap
-                if (mirror &&
-                    (newx < 0 || newx >= N ||
-                     newy < 0 || newy >= N ||
-                     newz < 0 || newz >= N)) {
-                    // swap position is outside grid so don't do it
-                    count1.SetTo1(k);
-                } else {
-                    // do the swap, wrapping if necessary
-                    newx = modN[newx + N];
-                    newy = modN[newy + N];
-                    newz = modN[newz + N];
-                    count1.SetTo1(newx + N * (newy + N * newz));
-                }
-            } else {
-                // don't swap this live cell
-                count1.SetTo1(k);
-            }
-        } else {
-            // live cell with wrong parity
-            count1.SetTo1(k);
-        }
-    }
-}
-
-// -----------------------------------------------------------------------------
-
-void Overlay::Do3DNextGenFace() {
-    int numkeys;
-    const int N = gridsize;
-    const int NN = N * N;
-
-    // check whether to use wrap
-    if (liveedge) {
-        // use wrap version
-        const int *grid3dkeys = grid3d.GetKeys(&numkeys);
-        const unsigned char *grid3dvalues = grid3d.GetValues();
-        for (int i = 0; i < numkeys; i++) {
-            const int k = grid3dkeys[i];
-            const unsigned int loc = xyz[k];
-            const int x = loc >> 16;
-            const int y = (loc >> 8) & 0xff;
-            const int z = loc & 0xff;
-            count1.SetValue(k, 0);
-            const int Ny = N * y;
-            const int NNz = NN * z;
-            const int NypNNz = Ny + NNz;
-            const int xpNNz = x + NNz;
-            const int xpNy = x + Ny;
-
-            // calculate the positions of the 6 cells next to each face of this cell
-            const int xp1 = modN[x + 1] + NypNNz;
-            const int xm1 = modN[x - 1 + N] + NypNNz;
-            const int yp1 = N * modN[y + 1] + xpNNz;
-            const int ym1 = N * modN[y - 1 + N] + xpNNz;
-            const int zp1 = NN * modN[z + 1] + xpNy;
-            const int zm1 = NN * modN[z - 1 + N] + xpNy;
-
-            if (grid3dvalues[xp1]) { count1.AddToValue(k, 1); } else { count2.AddToValue(xp1, 1); }
-            if (grid3dvalues[xm1]) { count1.AddToValue(k, 1); } else { count2.AddToValue(xm1, 1); }
-            if (grid3dvalues[yp1]) { count1.AddToValue(k, 1); } else { count2.AddToValue(yp1, 1); }
-            if (grid3dvalues[ym1]) { count1.AddToValue(k, 1); } else { count2.AddToValue(ym1, 1); }
-            if (grid3dvalues[zp1]) { count1.AddToValue(k, 1); } else { count2.AddToValue(zp1, 1); }
-            if (grid3dvalues[zm1]) { count1.AddToValue(k, 1); } else { count2.AddToValue(zm1, 1); }
-        }
-    } else {
-        // use no wrap version
-        const int *grid3dkeys = grid3d.GetKeys(&numkeys);
-        const unsigned char *grid3dvalues = grid3d.GetValues();
-        for (int i = 0; i < numkeys; i++) {
-            const int k = grid3dkeys[i];
-            count1.SetValue(k, 0);
-
-            // calculate the positions of the 6 cells next to each face of this cell
-            const int xp1 = k + 1;
-            const int xm1 = k - 1;
-            const int yp1 = k + N;
-            const int ym1 = k - N;
-            const int zp1 = k + NN;
-            const int zm1 = k - NN;
-
-            if (grid3dvalues[xp1]) { count1.AddToValue(k, 1); } else { count2.AddToValue(xp1, 1); }
-            if (grid3dvalues[xm1]) { count1.AddToValue(k, 1); } else { count2.AddToValue(xm1, 1); }
-            if (grid3dvalues[yp1]) { count1.AddToValue(k, 1); } else { count2.AddToValue(yp1, 1); }
-            if (grid3dvalues[ym1]) { count1.AddToValue(k, 1); } else { count2.AddToValue(ym1, 1); }
-            if (grid3dvalues[zp1]) { count1.AddToValue(k, 1); } else { count2.AddToValue(zp1, 1); }
-            if (grid3dvalues[zm1]) { count1.AddToValue(k, 1); } else { count2.AddToValue(zm1, 1); }
-        }
-    }
-}
-
-// -----------------------------------------------------------------------------
-
-void Overlay::Do3DNextGenCorner() {
-    int numkeys;
-    const int N = gridsize;
-    const int NN = N * N;
-
-    // check whether to use wrap
-    if (liveedge) {
-        // use wrap version
-        const int *grid3dkeys = grid3d.GetKeys(&numkeys);
-        const unsigned char *grid3dvalues = grid3d.GetValues();
-        for (int i = 0; i < numkeys; i++) {
-            const int k = grid3dkeys[i];
-            const unsigned int loc = xyz[k];
-            const int x = loc >> 16;
-            const int y = (loc >> 8) & 0xff;
-            const int z = loc & 0xff;
-            count1.SetValue(k, 0);
-
-            const int xp1 = modN[x + 1];
-            const int xm1 = modN[x - 1 + N];
-            const int yp1 = N * modN[y + 1];
-            const int ym1 = N * modN[y - 1 + N];
-            const int zp1 = NN * modN[z + 1];
-            const int zm1 = NN * modN[z - 1 + N];
-
-            // calculate the positions of the 8 cells cells touching each corner of this cell
-            const int ppp = xp1 + yp1 + zp1;
-            const int mmm = xm1 + ym1 + zm1;
-            const int ppm = xp1 + yp1 + zm1;
-            const int mmp = xm1 + ym1 + zp1;
-            const int mpp = xm1 + yp1 + zp1;
-            const int pmm = xp1 + ym1 + zm1;
-            const int pmp = xp1 + ym1 + zp1;
-            const int mpm = xm1 + yp1 + zm1;
-
-            if (grid3dvalues[ppp]) { count1.AddToValue(k, 1); } else { count2.AddToValue(ppp, 1); }
-            if (grid3dvalues[mmm]) { count1.AddToValue(k, 1); } else { count2.AddToValue(mmm, 1); }
-            if (grid3dvalues[ppm]) { count1.AddToValue(k, 1); } else { count2.AddToValue(ppm, 1); }
-            if (grid3dvalues[mmp]) { count1.AddToValue(k, 1); } else { count2.AddToValue(mmp, 1); }
-            if (grid3dvalues[mpp]) { count1.AddToValue(k, 1); } else { count2.AddToValue(mpp, 1); }
-            if (grid3dvalues[pmm]) { count1.AddToValue(k, 1); } else { count2.AddToValue(pmm, 1); }
-            if (grid3dvalues[pmp]) { count1.AddToValue(k, 1); } else { count2.AddToValue(pmp, 1); }
-            if (grid3dvalues[mpm]) { count1.AddToValue(k, 1); } else { count2.AddToValue(mpm, 1); }
-        }
-    } else {
-        // use no wrap version
-        const int *grid3dkeys = grid3d.GetKeys(&numkeys);
-        const unsigned char *grid3dvalues = grid3d.GetValues();
-        for (int i = 0; i < numkeys; i++) {
-            const int k = grid3dkeys[i];
-            count1.SetValue(k, 0);
-
-            // calculate the positions of the 8 cells cells touching each corner of this cell
-            const int ppp = k + 1 + N + NN;
-            const int mmm = k - 1 - N - NN;
-            const int ppm = k + 1 + N - NN;
-            const int mmp = k - 1 - N + NN;
-            const int mpp = k - 1 + N + NN;
-            const int pmm = k + 1 - N - NN;
-            const int pmp = k + 1 - N + NN;
-            const int mpm = k - 1 + N - NN;
-
-            if (grid3dvalues[ppp]) { count1.AddToValue(k, 1); } else { count2.AddToValue(ppp, 1); }
-            if (grid3dvalues[mmm]) { count1.AddToValue(k, 1); } else { count2.AddToValue(mmm, 1); }
-            if (grid3dvalues[ppm]) { count1.AddToValue(k, 1); } else { count2.AddToValue(ppm, 1); }
-            if (grid3dvalues[mmp]) { count1.AddToValue(k, 1); } else { count2.AddToValue(mmp, 1); }
-            if (grid3dvalues[mpp]) { count1.AddToValue(k, 1); } else { count2.AddToValue(mpp, 1); }
-            if (grid3dvalues[pmm]) { count1.AddToValue(k, 1); } else { count2.AddToValue(pmm, 1); }
-            if (grid3dvalues[pmp]) { count1.AddToValue(k, 1); } else { count2.AddToValue(pmp, 1); }
-            if (grid3dvalues[mpm]) { count1.AddToValue(k, 1); } else { count2.AddToValue(mpm, 1); }
-        }
-    }
-}
-
-// -----------------------------------------------------------------------------
-
-void Overlay::Do3DNextGenEdge() {
-    int numkeys;
-    const int N = gridsize;
-    const int NN = N * N;
-
-    // check whether to use wrap
-    if (liveedge) {
-        // use wrap version
-        const int *grid3dkeys = grid3d.GetKeys(&numkeys);
-        const unsigned char *grid3dvalues = grid3d.GetValues();
-        for (int i = 0; i < numkeys; i++) {
-            const int k = grid3dkeys[i];
-            const unsigned int loc = xyz[k];
-            const int x = loc >> 16;
-            const int y = (loc >> 8) & 0xff;
-            const int z = loc & 0xff;
-            count1.SetValue(k, 0);
-
-            const int xp1 = modN[x + 1];
-            const int xm1 = modN[x - 1 + N];
-            const int yp1 = N * modN[y + 1];
-            const int ym1 = N * modN[y - 1 + N];
-            const int zp1 = NN * modN[z + 1];
-            const int zm1 = NN * modN[z - 1 + N];
-            const int Ny = N * y;
-            const int NNz = NN * z;
-
-            // calculate the positions of the 12 cells next to each edge of this cell
-            const int xpp = x + yp1 + zp1;
-            const int xmm = x + ym1 + zm1;
-            const int xpm = x + yp1 + zm1;
-            const int xmp = x + ym1 + zp1;
-
-            const int pyp = xp1 + Ny + zp1;
-            const int mym = xm1 + Ny + zm1;
-            const int pym = xp1 + Ny + zm1;
-            const int myp = xm1 + Ny + zp1;
-
-            const int ppz = xp1 + yp1 + NNz;
-            const int mmz = xm1 + ym1 + NNz;
-            const int pmz = xp1 + ym1 + NNz;
-            const int mpz = xm1 + yp1 + NNz;
-
-            if (grid3dvalues[xpp]) { count1.AddToValue(k, 1); } else { count2.AddToValue(xpp, 1); }
-            if (grid3dvalues[xmm]) { count1.AddToValue(k, 1); } else { count2.AddToValue(xmm, 1); }
-            if (grid3dvalues[xpm]) { count1.AddToValue(k, 1); } else { count2.AddToValue(xpm, 1); }
-            if (grid3dvalues[xmp]) { count1.AddToValue(k, 1); } else { count2.AddToValue(xmp, 1); }
-
-            if (grid3dvalues[pyp]) { count1.AddToValue(k, 1); } else { count2.AddToValue(pyp, 1); }
-            if (grid3dvalues[mym]) { count1.AddToValue(k, 1); } else { count2.AddToValue(mym, 1); }
-            if (grid3dvalues[pym]) { count1.AddToValue(k, 1); } else { count2.AddToValue(pym, 1); }
-            if (grid3dvalues[myp]) { count1.AddToValue(k, 1); } else { count2.AddToValue(myp, 1); }
-
-            if (grid3dvalues[ppz]) { count1.AddToValue(k, 1); } else { count2.AddToValue(ppz, 1); }
-            if (grid3dvalues[mmz]) { count1.AddToValue(k, 1); } else { count2.AddToValue(mmz, 1); }
-            if (grid3dvalues[pmz]) { count1.AddToValue(k, 1); } else { count2.AddToValue(pmz, 1); }
-            if (grid3dvalues[mpz]) { count1.AddToValue(k, 1); } else { count2.AddToValue(mpz, 1); }
-        }
-    } else {
-        // use no wrap version
-        const int *grid3dkeys = grid3d.GetKeys(&numkeys);
-        const unsigned char *grid3dvalues = grid3d.GetValues();
-        for (int i = 0; i < numkeys; i++) {
-            const int k = grid3dkeys[i];
-            count1.SetValue(k, 0);
-
-            // calculate the positions of the 12 cells next to each edge of this cell
-            const int xpp = k + N + NN;
-            const int xmm = k - N - NN;
-            const int xpm = k + N - NN;
-            const int xmp = k - N + NN;
-
-            const int pyp = k + 1 + NN;
-            const int mym = k - 1 - NN;
-            const int pym = k + 1 - NN;
-            const int myp = k - 1 + NN;
-
-            const int ppz = k + 1 + N;
-            const int mmz = k - 1 - N;
-            const int pmz = k + 1 - N;
-            const int mpz = k - 1 + N;
-
-            if (grid3dvalues[xpp]) { count1.AddToValue(k, 1); } else { count2.AddToValue(xpp, 1); }
-            if (grid3dvalues[xmm]) { count1.AddToValue(k, 1); } else { count2.AddToValue(xmm, 1); }
-            if (grid3dvalues[xpm]) { count1.AddToValue(k, 1); } else { count2.AddToValue(xpm, 1); }
-            if (grid3dvalues[xmp]) { count1.AddToValue(k, 1); } else { count2.AddToValue(xmp, 1); }
-
-            if (grid3dvalues[pyp]) { count1.AddToValue(k, 1); } else { count2.AddToValue(pyp, 1); }
-            if (grid3dvalues[mym]) { count1.AddToValue(k, 1); } else { count2.AddToValue(mym, 1); }
-            if (grid3dvalues[pym]) { count1.AddToValue(k, 1); } else { count2.AddToValue(pym, 1); }
-            if (grid3dvalues[myp]) { count1.AddToValue(k, 1); } else { count2.AddToValue(myp, 1); }
-
-            if (grid3dvalues[ppz]) { count1.AddToValue(k, 1); } else { count2.AddToValue(ppz, 1); }
-            if (grid3dvalues[mmz]) { count1.AddToValue(k, 1); } else { count2.AddToValue(mmz, 1); }
-            if (grid3dvalues[pmz]) { count1.AddToValue(k, 1); } else { count2.AddToValue(pmz, 1); }
-            if (grid3dvalues[mpz]) { count1.AddToValue(k, 1); } else { count2.AddToValue(mpz, 1); }
-        }
-    }
-}
-
-// -----------------------------------------------------------------------------
-
-void Overlay::Do3DNextGenHexahedral() {
-    int numkeys;
-    const int N = gridsize;
-    const int NN = N * N;
-
-    // check whether to use wrap
-    if (liveedge) {
-        // use wrap version
-        const int *grid3dkeys = grid3d.GetKeys(&numkeys);
-        const unsigned char *grid3dvalues = grid3d.GetValues();
-        for (int i = 0; i < numkeys; i++) {
-            const int k = grid3dkeys[i];
-            const unsigned int loc = xyz[k];
-            const int x = loc >> 16;
-            const int y = (loc >> 8) & 0xff;
-            const int z = loc & 0xff;
-            count1.SetValue(k, 0);
-
-            const int xp1 = modN[x + 1];
-            const int xm1 = modN[x - 1 + N];
-            const int yp1 = N * modN[y + 1];
-            const int ym1 = N * modN[y - 1 + N];
-            const int zp1 = NN * modN[z + 1];
-            const int zm1 = NN * modN[z - 1 + N];
-            const int Ny = N * y;
-            const int NNz = NN * z;
-
-            // calculate the positions of the 12 neighboring cells (using the top offsets given
-            // on page 872 in http://www.complex-systems.com/pdf/01-5-1.pdf)
-            const int xym = x + Ny + zm1;
-            const int xyp = x + Ny + zp1;
-            const int xpm = x + yp1 + zm1;
-            const int xpz = x + yp1 + NNz;
-            const int xmp = x + ym1 + zp1;
-            const int xmz = x + ym1 + NNz;
-            const int pym = xp1 + Ny + zm1;
-            const int pyz = xp1 + Ny + NNz;
-            const int myp = xm1 + Ny + zp1;
-            const int myz = xm1 + Ny + NNz;
-            const int pmz = xp1 + ym1 + NNz;
-            const int mpz = xm1 + yp1 + NNz;
-
-            if (grid3dvalues[xym]) { count1.AddToValue(k, 1); } else { count2.AddToValue(xym, 1); }
-            if (grid3dvalues[xyp]) { count1.AddToValue(k, 1); } else { count2.AddToValue(xyp, 1); }
-            if (grid3dvalues[xpm]) { count1.AddToValue(k, 1); } else { count2.AddToValue(xpm, 1); }
-            if (grid3dvalues[xpz]) { count1.AddToValue(k, 1); } else { count2.AddToValue(xpz, 1); }
-
-            if (grid3dvalues[xmp]) { count1.AddToValue(k, 1); } else { count2.AddToValue(xmp, 1); }
-            if (grid3dvalues[xmz]) { count1.AddToValue(k, 1); } else { count2.AddToValue(xmz, 1); }
-            if (grid3dvalues[pym]) { count1.AddToValue(k, 1); } else { count2.AddToValue(pym, 1); }
-            if (grid3dvalues[pyz]) { count1.AddToValue(k, 1); } else { count2.AddToValue(pyz, 1); }
-
-            if (grid3dvalues[myp]) { count1.AddToValue(k, 1); } else { count2.AddToValue(myp, 1); }
-            if (grid3dvalues[myz]) { count1.AddToValue(k, 1); } else { count2.AddToValue(myz, 1); }
-            if (grid3dvalues[pmz]) { count1.AddToValue(k, 1); } else { count2.AddToValue(pmz, 1); }
-            if (grid3dvalues[mpz]) { count1.AddToValue(k, 1); } else { count2.AddToValue(mpz, 1); }
-        }
-    } else {
-        // use no wrap version
-        const int *grid3dkeys = grid3d.GetKeys(&numkeys);
-        const unsigned char *grid3dvalues = grid3d.GetValues();
-        for (int i = 0; i < numkeys; i++) {
-            const int k = grid3dkeys[i];
-            count1.SetValue(k, 0);
-
-            // calculate the positions of the 12 neighboring cells (using the top offsets given
-            // on page 872 in http://www.complex-systems.com/pdf/01-5-1.pdf)
-            const int xym = k - NN;
-            const int xyp = k + NN;
-            const int xpm = k + N - NN;
-            const int xpz = k + N;
-            const int xmp = k - N + NN;
-            const int xmz = k - N;
-            const int pym = k + 1 - NN;
-            const int pyz = k + 1;
-            const int myp = k - 1 + NN;
-            const int myz = k - 1;
-            const int pmz = k + 1 - N;
-            const int mpz = k - 1 + N;
-
-            if (grid3dvalues[xym]) { count1.AddToValue(k, 1); } else { count2.AddToValue(xym, 1); }
-            if (grid3dvalues[xyp]) { count1.AddToValue(k, 1); } else { count2.AddToValue(xyp, 1); }
-            if (grid3dvalues[xpm]) { count1.AddToValue(k, 1); } else { count2.AddToValue(xpm, 1); }
-            if (grid3dvalues[xpz]) { count1.AddToValue(k, 1); } else { count2.AddToValue(xpz, 1); }
-
-            if (grid3dvalues[xmp]) { count1.AddToValue(k, 1); } else { count2.AddToValue(xmp, 1); }
-            if (grid3dvalues[xmz]) { count1.AddToValue(k, 1); } else { count2.AddToValue(xmz, 1); }
-            if (grid3dvalues[pym]) { count1.AddToValue(k, 1); } else { count2.AddToValue(pym, 1); }
-            if (grid3dvalues[pyz]) { count1.AddToValue(k, 1); } else { count2.AddToValue(pyz, 1); }
-
-            if (grid3dvalues[myp]) { count1.AddToValue(k, 1); } else { count2.AddToValue(myp, 1); }
-            if (grid3dvalues[myz]) { count1.AddToValue(k, 1); } else { count2.AddToValue(myz, 1); }
-            if (grid3dvalues[pmz]) { count1.AddToValue(k, 1); } else { count2.AddToValue(pmz, 1); }
-            if (grid3dvalues[mpz]) { count1.AddToValue(k, 1); } else { count2.AddToValue(mpz, 1); }
-        }
-    }
-}
-
-// -----------------------------------------------------------------------------
-
-void Overlay::Do3DNextGenMoore() {
-    int numkeys;
-    const int *count1keys = NULL;
-    const unsigned char *count1values = NULL;
-    const int N = gridsize;
-    const int NN = N * N;
-    const int NNN = NN * N;
-
-    // check whether to use wrap
-    if (liveedge) {
-        // use wrap version
-        const int *grid3dkeys = grid3d.GetKeys(&numkeys);
-        const int NNmN = NN - N;
-        for (int i = 0; i < numkeys; i++) {
-            const int k = grid3dkeys[i];
-            const int y = modNN[k];
-            count1.AddToValue(k, 1);
-            count1.AddToValue(k + (y >= NNmN ? -NNmN: N), 1);
-            count1.AddToValue(k + (y < N ? NNmN : -N), 1);
-        }
-
-        // get keys and values in count1
-        count1keys = count1.GetKeys(&numkeys);
-        count1values = count1.GetValues();
-        const int Nm1 = N - 1;
-        for (int i = 0; i < numkeys; i++) {
-            const int k = count1keys[i];
-            const unsigned char v = count1values[k];
-            const int x = modN[k];
-            count2.AddToValue(k, v);
-            count2.AddToValue(k + (x == Nm1 ? -Nm1 : 1), v);
-            count2.AddToValue(k + (x == 0 ? Nm1 : -1), v);
-        }
-
-        // get keys and values in count2
-        const int *count2keys = count2.GetKeys(&numkeys);
-        const unsigned char *count2values = count2.GetValues();
-        const int NNNmNN = NNN - NN;
-        count1.ClearKeys();
-        for (int i = 0; i < numkeys; i++) {
-            const int k = count2keys[i];
-            const unsigned char v = count2values[k];
-            count1.AddToValue(k, v);
-            count1.AddToValue(k >= NNNmNN ? k - NNNmNN : k + NN, v);
-            count1.AddToValue(k < NN ? k + NNNmNN : k - NN, v);
-        }
-    } else {
-        // use nowrap version
-        const int *grid3dkeys = grid3d.GetKeys(&numkeys);
-        for (int i = 0; i < numkeys; i++) {
-            const int k = grid3dkeys[i];
-            count1.AddToValue(k, 1);
-            count1.AddToValue(k + N, 1);
-            count1.AddToValue(k - N, 1);
-        }
-
-        // get keys and values in count1
-        count1keys = count1.GetKeys(&numkeys);
-        count1values = count1.GetValues();
-        for (int i = 0; i < numkeys; i++) {
-            const int k = count1keys[i];
-            const unsigned char v = count1values[k];
-            count2.AddToValue(k, v);
-            count2.AddToValue(k + 1, v);
-            count2.AddToValue(k - 1, v);
-        }
-
-        // get keys and values in count2
-        const int *count2keys = count2.GetKeys(&numkeys);
-        const unsigned char *count2values = count2.GetValues();
-        count1.ClearKeys();
-        for (int i = 0; i < numkeys; i++) {
-            const int k = count2keys[i];
-            const unsigned char v = count2values[k];
-            count1.AddToValue(k, v);
-            count1.AddToValue(k + NN, v);
-            count1.AddToValue(k - NN, v);
-        }
-    }
-}
-
-// -----------------------------------------------------------------------------
-
 const char *Overlay::DoOverlayCommand(const char *cmd)
 {
     // determine which command to run
@@ -20,6 +20,8 @@ using namespace irrklang;
 
 #include "lua.hpp"
 
+#include "life3d.h"                 // for life3d
+
 // The overlay is a scriptable graphics layer that is (optionally) drawn
 // on top of Golly's current layer.  See Help/overlay.html for details.
 
@@ -718,34 +720,12 @@ private:
     // Updates the clips needed for rendering the cells based on
     // the cell type, algo and edit mode.
 
-    int CreateResultsFromC1C2(lua_State *L, const bool laststep);
-    // Creates the Lua grid result for the 3D Moore algo.
-
-    int CreateResultsFromC1G3(lua_State *L, const bool laststep);
-    // Creates the Lua grid result for the 3D Face, Corner,
-    // Edge and Hexahedral algos.
-
-    int CreateResultsFromC1(lua_State *L, const bool laststep);
-    // Creates the Lua grid result for the 3D BusyBoxes algo.
-
-    void Do3DNextGenMoore();
-    // Computes the next generation using the 3D Moore algo.
-
-    void Do3DNextGenFace();
-    // Computes the next generation using the 3D Face algo.
-
-    void Do3DNextGenCorner();
-    // Computes the next generation using the 3D Corner algo.
-
-    void Do3DNextGenEdge();
-    // Computes the next generation using the 3D Edge algo.
-
-    void Do3DNextGenHexahedral();
-    // Computes the next generation using the 3D Hexahedral algo.
+    void UpdateGridFromEngine();
+    // Copies the live cells from the 3D engine into the source grid.
 
-    void Do3DNextGenBB(const bool mirror, const int gencount);
-    // Computes the next generation using the 3D BusyBoxes algo
-    // (standard and wrap).
+    void CreateResultsFromEngine(lua_State *L, const int newpop);
+    // Creates the Lua grid result from the live cells and updates
+    // the bounding box from the 3D engine.
 
     bool CreateDivTable();
     // Creates the divide and modulus lookup table.
@@ -787,9 +767,8 @@ private:
     typedef enum { moore, face, corner, edge, hexahedral, bb, bbw } ruletypes;
     ruletypes ruletype;             // current 3D algo
     Table grid3d;                   // source grid
-    Table count1;                   // intermediate counts
-    Table count2;                   // intermediate counts
-    Table next3d;                   // next grid used when stepsize > 1
+    life3d engine3d;                // computes the next generation of grid3d
+    std::vector<int> live3d;        // live cells from engine3d
     Table paste3d;                  // grid of paste cells
     Table select3d;                 // grid of selected cells
     Table active3d;                 // grid of active cells
@@ -816,7 +795,7 @@ private:
     int toolbarht;                  // toolbar height
     int showhistory;                // cell history longevity: 0 off, >0 on
     bool fadehistory;               // whether to fade history cells
-    int *modN, *modNN;              // lookup tables for fast divide and mod operations
+    int *modN;                      // lookup table for fast mod operations
     unsigned int *xyz;              // lookup table for offset to grid coordinate mapping
     char *xaxis, *yaxis, *zaxis;    // flags for live cells on each axis used for fast bounding box
 
@@ -500,27 +500,17 @@ static const char* ExtractCellArray(AV* outarray, lifealgo* universe, bool shift
         int ileft = left.toint();
         int ibottom = bottom.toint();
         int iright = right.toint();
-        int cx, cy;
-        int v = 0;
         int cntr = 0;
-        for ( cy=itop; cy<=ibottom; cy++ ) {
-            for ( cx=ileft; cx<=iright; cx++ ) {
-                int skip = universe->nextcell(cx, cy, v);
-                if (skip >= 0) {
-                    // found next live cell in this row
-                    cx += skip;
-                    if (shift) {
-                        // shift cells so that top left cell of bounding box is at 0,0
-                        av_push(outarray, newSViv(cx - ileft));
-                        av_push(outarray, newSViv(cy - itop));
-                    } else {
-                        av_push(outarray, newSViv(cx));
-                        av_push(outarray, newSViv(cy));
-                    }
-                    if (multistate) av_push(outarray, newSViv(v));
-                } else {
-                    cx = iright;  // done this row
-                }
+        // shift cells so that top left cell of bounding box is at 0,0
+        int dx = shift ? ileft : 0;
+        int dy = shift ? itop : 0;
+        vector<cellspan> spans;
+        universe->getcellruns(itop, ileft, ibottom, iright, spans);
+        for ( size_t i=0; i<spans.size(); i++ ) {
+            for ( int cx=spans[i].x; cx<spans[i].x+spans[i].n; cx++ ) {
+                av_push(outarray, newSViv(cx - dx));
+                av_push(outarray, newSViv(spans[i].y - dy));
+                if (multistate) av_push(outarray, newSViv(spans[i].state));
                 cntr++;
                 if ((cntr % 4096) == 0 && PerlScriptAborted()) return NULL;
             }
@@ -1251,7 +1241,7 @@ XS(pl_evolve)
     
     // advance pattern by ngens
     mainptr->generating = true;
-    if (tempalgo->unbounded && (tempalgo->gridwd > 0 || tempalgo->gridht > 0)) {
+    if (tempalgo->needsbordercells()) {
         // a bounded grid must use an increment of 1 so we can call
         // CreateBorderCells and DeleteBorderCells around each step()
         tempalgo->setIncrement(1);
@@ -1490,25 +1480,16 @@ XS(pl_getcells)
         if (err) PERL_ERROR(err);
         int right = x + wd - 1;
         int bottom = y + ht - 1;
-        int cx, cy;
-        int v = 0;
         int cntr = 0;
         lifealgo* curralgo = currlayer->algo;
         bool multistate = curralgo->NumCellStates() > 2;
-        for ( cy=y; cy<=bottom; cy++ ) {
-            for ( cx=x; cx<=right; cx++ ) {
-                int skip = curralgo->nextcell(cx, cy, v);
-                if (skip >= 0) {
-                    // found next live cell in this row so add coords to outarray
-                    cx += skip;
-                    if (cx <= right) {
-                        av_push(outarray, newSViv(cx));
-                        av_push(outarray, newSViv(cy));
-                        if (multistate) av_push(outarray, newSViv(v));
-                    }
-                } else {
-                    cx = right;  // done this row
-                }
+        vector<cellspan> spans;
+        curralgo->getcellruns(y, x, bottom, right, spans);
+        for ( size_t i=0; i<spans.size(); i++ ) {
+            for ( int cx=spans[i].x; cx<spans[i].x+spans[i].n; cx++ ) {
+                av_push(outarray, newSViv(cx));
+                av_push(outarray, newSViv(spans[i].y));
+                if (multistate) av_push(outarray, newSViv(spans[i].state));
                 cntr++;
                 if ((cntr % 4096) == 0) RETURN_IF_ABORTED;
             }
@@ -1665,22 +1646,15 @@ XS(pl_getclip)
         // extract cells from templayer
         lifealgo* tempalgo = templayer->algo;
         bool multistate = tempalgo->NumCellStates() > 2;
-        int cx, cy;
         int cntr = 0;
-        int v = 0;
-        for ( cy=itop; cy<=ibottom; cy++ ) {
-            for ( cx=ileft; cx<=iright; cx++ ) {
-                int skip = tempalgo->nextcell(cx, cy, v);
-                if (skip >= 0) {
-                    // found next live cell in this row
-                    cx += skip;
-                    // shift cells so that top left cell of bounding box is at 0,0
-                    av_push(outarray, newSViv(cx - ileft));
-                    av_push(outarray, newSViv(cy - itop));
-                    if (multistate) av_push(outarray, newSViv(v));
-                } else {
-                    cx = iright;  // done this row
-                }
+        vector<cellspan> spans;
+        tempalgo->getcellruns(itop, ileft, ibottom, iright, spans);
+        for ( size_t i=0; i<spans.size(); i++ ) {
+            for ( int cx=spans[i].x; cx<spans[i].x+spans[i].n; cx++ ) {
+                // shift cells so that top left cell of bounding box is at 0,0
+                av_push(outarray, newSViv(cx - ileft));
+                av_push(outarray, newSViv(spans[i].y - itop));
+                if (multistate) av_push(outarray, newSViv(spans[i].state));
                 cntr++;
                 if ((cntr % 4096) == 0 && PerlScriptAborted()) {
                     delete templayer;
@@ -20,7 +20,9 @@
 
 #include "lifealgo.h"
 #include "viewport.h"       // for MAX_MAG
-#include "util.h"           // for linereader
+#include "util.h"           // for linereader, lifethreads
+#include "hlifealgo.h"      // for hlifealgo::setIncrementalGC
+#include "ghashbase.h"      // for ghashbase::setIncrementalGC
 
 #include "wxgolly.h"        // for wxGetApp, mainptr, viewptr
 #include "wxmain.h"         // for ID_*, mainptr->...
@@ -128,6 +130,8 @@ bool restoreview = true;         // should reset/undo restore view?
 int controlspos = 1;             // position of translucent controls (1 is top left corner)
 int canchangerule = 0;           // if > 0 then paste can change rule
 int randomfill = 50;             // random fill percentage (1..100)
+int numthreads = 1;              // threads used by algorithms that can split work (1..MAX_THREADS)
+bool incrementalgc = false;      // collect hash memory in small slices?
 int opacity = 50;                // percentage opacity of live cells in overlays (1..100)
 int tileborder = 3;              // thickness of tiled window borders
 int mingridmag = 2;              // minimum mag to draw grid lines
@@ -137,6 +141,7 @@ bool mathcoords = false;         // show Y values increasing upwards?
 bool cellborders = true;         // should zoomed cells have borders?
 bool syncviews = false;          // synchronize viewports?
 bool synccursors = true;         // synchronize cursors?
+bool syncgens = false;           // synchronize generating?
 bool stacklayers = false;        // stack all layers?
 bool tilelayers = false;         // tile all layers?
 bool askonnew = true;            // ask to save changes before creating new pattern?
@@ -630,6 +635,7 @@ const char* GetActionName(action_id action)
         case DO_NAMELAYER:      return "Name Layer...";
         case DO_SYNCVIEWS:      return "Synchronize Views";
         case DO_SYNCCURS:       return "Synchronize Cursors";
+        case DO_SYNCGENS:       return "Synchronize Generating";
         case DO_STACK:          return "Stack Layers";
         case DO_TILE:           return "Tile Layers";
         // Help menu
@@ -1476,6 +1482,8 @@ void SavePrefs()
     fprintf(f, "controls_pos=%d (0..4)\n", controlspos);
     fprintf(f, "can_change_rule=%d (0..2)\n", canchangerule);
     fprintf(f, "random_fill=%d (1..100)\n", randomfill);
+    fprintf(f, "num_threads=%d (1..%d)\n", numthreads, MAX_THREADS);
+    fprintf(f, "incremental_gc=%d\n", incrementalgc ? 1 : 0);
     fprintf(f, "min_delay=%d (0..%d millisecs)\n", mindelay, MAX_DELAY);
     fprintf(f, "max_delay=%d (0..%d millisecs)\n", maxdelay, MAX_DELAY);
     fprintf(f, "auto_fit=%d\n", currlayer->autofit ? 1 : 0);
@@ -1541,6 +1549,7 @@ void SavePrefs()
 
     fprintf(f, "sync_views=%d\n", syncviews ? 1 : 0);
     fprintf(f, "sync_cursors=%d\n", synccursors ? 1 : 0);
+    fprintf(f, "sync_gens=%d\n", syncgens ? 1 : 0);
     fprintf(f, "stack_layers=%d\n", stacklayers ? 1 : 0);
     fprintf(f, "tile_layers=%d\n", tilelayers ? 1 : 0);
     fprintf(f, "tile_border=%d (1..10)\n", tileborder);
@@ -1962,6 +1971,17 @@ void GetPrefs()
             if (randomfill < 1) randomfill = 1;
             if (randomfill > 100) randomfill = 100;
 
+        } else if (strcmp(keyword, "num_threads") == 0) {
+            sscanf(value, "%d", &numthreads);
+            if (numthreads < 1) numthreads = 1;
+            if (numthreads > MAX_THREADS) numthreads = MAX_THREADS;
+            lifethreads::setthreadcount(numthreads);
+
+        } else if (strcmp(keyword, "incremental_gc") == 0) {
+            incrementalgc = value[0] == '1';
+            hlifealgo::setIncrementalGC(incrementalgc);
+            ghashbase::setIncrementalGC(incrementalgc);
+
         } else if (strcmp(keyword, "q_base_step") == 0) {     // deprecated
             int base;
             sscanf(value, "%d", &base);
@@ -2165,6 +2185,9 @@ void GetPrefs()
         } else if (strcmp(keyword, "sync_cursors") == 0) {
             synccursors = value[0] == '1';
 
+        } else if (strcmp(keyword, "sync_gens") == 0) {
+            syncgens = value[0] == '1';
+
         } else if (strcmp(keyword, "stack_layers") == 0) {
             stacklayers = value[0] == '1';
 
@@ -2681,6 +2704,7 @@ enum {
     PREF_STEP_NOTE,
     PREF_MIN_DELAY,
     PREF_MAX_DELAY,
+    PREF_NUM_THREADS,
     PREF_RULES_BUTT,
     PREF_RULES_BOX,
     // View prefs
@@ -3033,15 +3057,18 @@ void PrefsDialog::OnSpinCtrlChar(wxKeyEvent& event)
             wxSpinCtrl* s2 = (wxSpinCtrl*) FindWindowById(PREF_BASE_STEP);
             wxSpinCtrl* s3 = (wxSpinCtrl*) FindWindowById(PREF_MIN_DELAY);
             wxSpinCtrl* s4 = (wxSpinCtrl*) FindWindowById(PREF_MAX_DELAY);
+            wxSpinCtrl* s5 = (wxSpinCtrl*) FindWindowById(PREF_NUM_THREADS);
             wxTextCtrl* t1 = s1->GetText();
             wxTextCtrl* t2 = s2->GetText();
             wxTextCtrl* t3 = s3->GetText();
             wxTextCtrl* t4 = s4->GetText();
+            wxTextCtrl* t5 = s5->GetText();
             wxWindow* focus = FindFocus();
             if ( focus == t1 ) { s2->SetFocus(); s2->SetSelection(ALL_TEXT); }
             if ( focus == t2 ) { s3->SetFocus(); s3->SetSelection(ALL_TEXT); }
             if ( focus == t3 ) { s4->SetFocus(); s4->SetSelection(ALL_TEXT); }
-            if ( focus == t4 ) { s1->SetFocus(); s1->SetSelection(ALL_TEXT); }
+            if ( focus == t4 ) { s5->SetFocus(); s5->SetSelection(ALL_TEXT); }
+            if ( focus == t5 ) { s1->SetFocus(); s1->SetSelection(ALL_TEXT); }
         } else if ( currpage == VIEW_PAGE ) {
             wxSpinCtrl* s1 = (wxSpinCtrl*) FindWindowById(PREF_BOLD_SPACING);
             wxSpinCtrl* s2 = (wxSpinCtrl*) FindWindowById(PREF_SENSITIVITY);
@@ -3581,6 +3608,18 @@ wxPanel* PrefsDialog::CreateControlPrefs(wxWindow* parent)
     hbox4->Add(new wxStaticText(panel, wxID_STATIC, _("millisecs")),
                0, wxALIGN_CENTER_VERTICAL, 0);
 
+    // num_threads
+
+    wxBoxSizer* hbox5 = new wxBoxSizer(wxHORIZONTAL);
+    hbox5->Add(new wxStaticText(panel, wxID_STATIC, _("Threads:")),
+               0, wxALIGN_CENTER_VERTICAL, 0);
+    wxSpinCtrl* spin5 = new MySpinCtrl(panel, PREF_NUM_THREADS, wxEmptyString,
+                                       wxDefaultPosition, wxSize(80, wxDefaultCoord));
+    hbox5->Add(spin5, 0, wxLEFT | wxRIGHT | wxALIGN_CENTER_VERTICAL, SPINGAP);
+    hbox5->Add(new wxStaticText(panel, wxID_STATIC,
+                                _("(more than the number of CPU cores won't help)")),
+               0, wxALIGN_CENTER_VERTICAL, 0);
+
     // user_rules
 
     wxButton* rulesbutt = new wxButton(panel, PREF_RULES_BUTT, _("Your Rules..."));
@@ -3609,6 +3648,10 @@ wxPanel* PrefsDialog::CreateControlPrefs(wxWindow* parent)
     vbox->AddSpacer(S2VGAP);
     vbox->Add(hbox4, 0, wxLEFT | wxRIGHT, LRGAP);
 
+    vbox->AddSpacer(5);
+    vbox->AddSpacer(GROUPGAP);
+    vbox->Add(hbox5, 0, wxLEFT | wxRIGHT, LRGAP);
+
     vbox->AddSpacer(15);
     vbox->AddSpacer(GROUPGAP);
     vbox->Add(hrbox, 0, wxLEFT | wxRIGHT, LRGAP);
@@ -3624,6 +3667,7 @@ wxPanel* PrefsDialog::CreateControlPrefs(wxWindow* parent)
     spin2->SetValue(algoinfo[algopos1]->defbase);
     spin3->SetRange(0, MAX_DELAY);           spin3->SetValue(mindelay);
     spin4->SetRange(0, MAX_DELAY);           spin4->SetValue(maxdelay);
+    spin5->SetRange(1, MAX_THREADS);         spin5->SetValue(numthreads);
     spin1->SetFocus();
     spin1->SetSelection(ALL_TEXT);
     algomenu->SetSelection(algopos1);
@@ -4667,6 +4711,8 @@ bool PrefsDialog::ValidatePage()
             return false;
         if ( BadSpinVal(PREF_MAX_DELAY, 0, MAX_DELAY, _("Maximum delay")) )
             return false;
+        if ( BadSpinVal(PREF_NUM_THREADS, 1, MAX_THREADS, _("Number of threads")) )
+            return false;
 
     } else if (currpage == VIEW_PAGE) {
         if ( BadSpinVal(PREF_BOLD_SPACING, 2, MAX_SPACING, _("Spacing of bold grid lines")) )
@@ -4760,6 +4806,7 @@ bool PrefsDialog::TransferDataFromWindow()
     }
     mindelay = GetSpinVal(PREF_MIN_DELAY);
     maxdelay = GetSpinVal(PREF_MAX_DELAY);
+    numthreads = GetSpinVal(PREF_NUM_THREADS);
     userrules = newuserrules;
 
     // VIEW_PAGE
@@ -87,6 +87,8 @@ extern bool allowbeep;           // okay to play beep sound?
 extern int controlspos;          // position of translucent controls
 extern int canchangerule;        // if > 0 then paste can change rule
 extern int randomfill;           // random fill percentage
+extern int numthreads;           // threads used by algorithms that can split work
+extern bool incrementalgc;       // collect hash memory in small slices?
 extern int opacity;              // percentage opacity of live cells in overlays
 extern int tileborder;           // width of tiled window borders
 extern int mingridmag;           // minimum mag to draw grid lines
@@ -96,6 +98,7 @@ extern bool mathcoords;          // show Y values increasing upwards?
 extern bool cellborders;         // should zoomed cells have borders?
 extern bool syncviews;           // synchronize viewports?
 extern bool synccursors;         // synchronize cursors?
+extern bool syncgens;            // synchronize generating?
 extern bool stacklayers;         // stack all layers?
 extern bool tilelayers;          // tile all layers?
 extern bool askonnew;            // ask to save changes before creating new pattern?
@@ -249,6 +252,7 @@ typedef enum {
     DO_STARTSTOP,                 // start/stop generating
     DO_RECORD,                    // start/stop recording
     DO_SYNCCURS,                  // synchronize cursors
+    DO_SYNCGENS,                  // synchronize generating
     DO_SYNCVIEWS,                 // synchronize views
     DO_TILE,                      // tile layers
     DO_UNDO,                      // undo
@@ -418,25 +418,16 @@ static bool ExtractCellList(PyObject* list, lifealgo* universe, bool shift = fal
         int ileft = left.toint();
         int ibottom = bottom.toint();
         int iright = right.toint();
-        int cx, cy;
-        int v = 0;
         int cntr = 0;
-        for ( cy=itop; cy<=ibottom; cy++ ) {
-            for ( cx=ileft; cx<=iright; cx++ ) {
-                int skip = universe->nextcell(cx, cy, v);
-                if (skip >= 0) {
-                    // found next live cell in this row
-                    cx += skip;
-                    if (shift) {
-                        // shift cells so that top left cell of bounding box is at 0,0
-                        AddTwoInts(list, cx - ileft, cy - itop);
-                    } else {
-                        AddTwoInts(list, cx, cy);
-                    }
-                    if (multistate) AddState(list, v);
-                } else {
-                    cx = iright;  // done this row
-                }
+        // shift cells so that top left cell of bounding box is at 0,0
+        int dx = shift ? ileft : 0;
+        int dy = shift ? itop : 0;
+        vector<cellspan> spans;
+        universe->getcellruns(itop, ileft, ibottom, iright, spans);
+        for ( size_t i=0; i<spans.size(); i++ ) {
+            for ( int cx=spans[i].x; cx<spans[i].x+spans[i].n; cx++ ) {
+                AddTwoInts(list, cx - dx, spans[i].y - dy);
+                if (multistate) AddState(list, spans[i].state);
                 cntr++;
                 if ((cntr % 4096) == 0 && PythonScriptAborted()) return false;
             }
@@ -1127,7 +1118,7 @@ static PyObject* py_evolve(PyObject* self, PyObject* args)
     
     // advance pattern by ngens
     mainptr->generating = true;
-    if (tempalgo->unbounded && (tempalgo->gridwd > 0 || tempalgo->gridht > 0)) {
+    if (tempalgo->needsbordercells()) {
         // a bounded grid must use an increment of 1 so we can call
         // CreateBorderCells and DeleteBorderCells around each step()
         tempalgo->setIncrement(1);
@@ -1372,24 +1363,15 @@ static PyObject* py_getcells(PyObject* self, PyObject* args)
         }
         int iright = ileft + wd - 1;
         int ibottom = itop + ht - 1;
-        int cx, cy;
-        int v = 0;
         int cntr = 0;
         lifealgo* curralgo = currlayer->algo;
         bool multistate = curralgo->NumCellStates() > 2;
-        for ( cy=itop; cy<=ibottom; cy++ ) {
-            for ( cx=ileft; cx<=iright; cx++ ) {
-                int skip = curralgo->nextcell(cx, cy, v);
-                if (skip >= 0) {
-                    // found next live cell in this row
-                    cx += skip;
-                    if (cx <= iright) {
-                        AddTwoInts(outlist, cx, cy);
-                        if (multistate) AddState(outlist, v);
-                    }
-                } else {
-                    cx = iright;  // done this row
-                }
+        vector<cellspan> spans;
+        curralgo->getcellruns(itop, ileft, ibottom, iright, spans);
+        for ( size_t i=0; i<spans.size(); i++ ) {
+            for ( int cx=spans[i].x; cx<spans[i].x+spans[i].n; cx++ ) {
+                AddTwoInts(outlist, cx, spans[i].y);
+                if (multistate) AddState(outlist, spans[i].state);
                 cntr++;
                 if ((cntr % 4096) == 0 && PythonScriptAborted()) {
                     Py_DecRef(outlist);
@@ -1545,21 +1527,14 @@ static PyObject* py_getclip(PyObject* self, PyObject* args)
         // extract cells from templayer
         lifealgo* tempalgo = templayer->algo;
         bool multistate = tempalgo->NumCellStates() > 2;
-        int cx, cy;
         int cntr = 0;
-        int v = 0;
-        for ( cy=itop; cy<=ibottom; cy++ ) {
-            for ( cx=ileft; cx<=iright; cx++ ) {
-                int skip = tempalgo->nextcell(cx, cy, v);
-                if (skip >= 0) {
-                    // found next live cell in this row
-                    cx += skip;
-                    // shift cells so that top left cell of bounding box is at 0,0
-                    AddTwoInts(outlist, cx - ileft, cy - itop);
-                    if (multistate) AddState(outlist, v);
-                } else {
-                    cx = iright;  // done this row
-                }
+        vector<cellspan> spans;
+        tempalgo->getcellruns(itop, ileft, ibottom, iright, spans);
+        for ( size_t i=0; i<spans.size(); i++ ) {
+            for ( int cx=spans[i].x; cx<spans[i].x+spans[i].n; cx++ ) {
+                // shift cells so that top left cell of bounding box is at 0,0
+                AddTwoInts(outlist, cx - ileft, spans[i].y - itop);
+                if (multistate) AddState(outlist, spans[i].state);
                 cntr++;
                 if ((cntr % 4096) == 0 && PythonScriptAborted()) {
                     delete templayer;
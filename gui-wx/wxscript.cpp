@@ -569,27 +569,18 @@ int GSF_hash(int x, int y, int wd, int ht)
     int hash = 31415962;
     int right = x + wd - 1;
     int bottom = y + ht - 1;
-    int cx, cy;
-    int v = 0;
     lifealgo* curralgo = currlayer->algo;
     bool multistate = curralgo->NumCellStates() > 2;
     
-    for ( cy=y; cy<=bottom; cy++ ) {
-        int yshift = cy - y;
-        for ( cx=x; cx<=right; cx++ ) {
-            int skip = curralgo->nextcell(cx, cy, v);
-            if (skip >= 0) {
-                // found next live cell in this row (v is >= 1 if multistate)
-                cx += skip;
-                if (cx <= right) {
-                    // need to use a good hash function for patterns like AlienCounter.rle
-                    hash = (hash * 1000003) ^ yshift;
-                    hash = (hash * 1000003) ^ (cx - x);
-                    if (multistate) hash = (hash * 1000003) ^ v;
-                }
-            } else {
-                cx = right;  // done this row
-            }
+    vector<cellspan> spans;
+    curralgo->getcellruns(y, x, bottom, right, spans);
+    for ( size_t i=0; i<spans.size(); i++ ) {
+        int yshift = spans[i].y - y;
+        for ( int cx=spans[i].x; cx<spans[i].x+spans[i].n; cx++ ) {
+            // need to use a good hash function for patterns like AlienCounter.rle
+            hash = (hash * 1000003) ^ yshift;
+            hash = (hash * 1000003) ^ (cx - x);
+            if (multistate) hash = (hash * 1000003) ^ spans[i].state;
         }
     }
     
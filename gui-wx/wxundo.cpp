@@ -23,6 +23,15 @@
 #include "wxprefs.h"       // for allowundo, GetAccelerator, etc
 #include "wxundo.h"
 
+#include <fstream>         // for std::ofstream
+
+#ifdef __WXMAC__
+    // convert path to decomposed UTF8 so fopen will work
+    #define FILEPATH path.fn_str()
+#else
+    #define FILEPATH path.mb_str(wxConvLocal)
+#endif
+
 // -----------------------------------------------------------------------------
 
 const wxString lack_of_memory = _("Due to lack of memory, some changes can't be undone!");
@@ -39,6 +48,13 @@ const wxString dupe4_prefix = wxT("g4_");
 const wxString dupe5_prefix = wxT("g5_");
 const wxString dupe6_prefix = wxT("g6_");
 
+// snapshots of generated patterns held in memory by a hashing universe
+// share nearly all their nodes, but they do stop the universe freeing
+// nodes only old patterns use, so we keep at most this many (and far
+// fewer if the universe is short of memory); the rest go to temporary files
+const int maxsnapshots = 32;
+const int minsnapshots = 4;
+
 // -----------------------------------------------------------------------------
 
 // the next two classes are needed because Golly allows multiple starting points
@@ -215,6 +231,9 @@ public:
     void ChangeCells(bool undo);
     // change cell states using cellinfo
     
+    void SaveSnapshots();
+    // save any snapshots in temporary files
+    
     change_type changeid;                   // specifies the type of change
     wxString suffix;                        // action string for Undo/Redo item
     bool olddirty;                          // layer's dirty state before change
@@ -230,6 +249,8 @@ public:
     // genchange info
     bool scriptgen;                         // gen change was done by script?
     wxString oldfile, newfile;              // old and new pattern files
+    int oldsnap, newsnap;                   // or old and new snapshots
+    lifealgo* snapalgo;                     // universe holding the snapshots
     bigint oldgen, newgen;                  // old and new generation counts
     bigint oldx, oldy, newx, newy;          // old and new positions
     int oldmag, newmag;                     // old and new scales
@@ -274,6 +295,9 @@ ChangeNode::ChangeNode(change_type id)
     cellcount = 0;
     oldfile = wxEmptyString;
     newfile = wxEmptyString;
+    oldsnap = 0;
+    newsnap = 0;
+    snapalgo = NULL;
     oldtempstart = wxEmptyString;
     newtempstart = wxEmptyString;
     oldstartfile = wxEmptyString;
@@ -298,6 +322,12 @@ ChangeNode::~ChangeNode()
     if (!newfile.IsEmpty() && wxFileExists(newfile)) {
         wxRemoveFile(newfile);
     }
+    
+    // let the universe free any nodes used only by our snapshots
+    if (snapalgo) {
+        if (oldsnap) snapalgo->dropsnapshot(oldsnap);
+        if (newsnap) snapalgo->dropsnapshot(newsnap);
+    }
 
     if (delete_all_temps) {
         // we're in ClearUndoRedo so it's safe to delete oldtempstart/newtempstart/oldstartfile/newstartfile
@@ -360,6 +390,37 @@ void ChangeNode::ChangeCells(bool undo)
 
 // -----------------------------------------------------------------------------
 
+static wxString SaveSnapshot(lifealgo* algo, int snapshot, const wxString& prefix)
+{
+    // write given snapshot to a new temporary file and return its path
+    wxString path = wxFileName::CreateTempFileName(tempdir + prefix);
+    std::ofstream os(FILEPATH, std::ios::out | std::ios::binary);
+    const char* err = algo->writesnapshot(snapshot, os);
+    if (!err && !os) err = "Failed to save snapshot in temporary file!";
+    if (err) Warning(wxString(err,wxConvLocal));
+    return path;
+}
+
+// -----------------------------------------------------------------------------
+
+void ChangeNode::SaveSnapshots()
+{
+    if (snapalgo == NULL) return;
+    if (oldsnap) {
+        oldfile = SaveSnapshot(snapalgo, oldsnap, genchange_prefix);
+        snapalgo->dropsnapshot(oldsnap);
+        oldsnap = 0;
+    }
+    if (newsnap) {
+        newfile = SaveSnapshot(snapalgo, newsnap, genchange_prefix);
+        snapalgo->dropsnapshot(newsnap);
+        newsnap = 0;
+    }
+    snapalgo = NULL;
+}
+
+// -----------------------------------------------------------------------------
+
 bool ChangeNode::DoChange(bool undo)
 {
     switch (changeid) {
@@ -418,11 +479,19 @@ bool ChangeNode::DoChange(bool undo)
             if (undo) {
                 currlayer->tempstart = oldtempstart;    // in case script called reset()
                 currlayer->currsel = oldsel;
-                mainptr->RestorePattern(oldgen, oldfile, oldx, oldy, oldmag, oldbase, oldexpo);
+                if (oldsnap) {
+                    mainptr->RestoreSnapshot(oldsnap, oldgen, oldx, oldy, oldmag, oldbase, oldexpo);
+                } else {
+                    mainptr->RestorePattern(oldgen, oldfile, oldx, oldy, oldmag, oldbase, oldexpo);
+                }
             } else {
                 currlayer->tempstart = newtempstart;    // in case script called reset()
                 currlayer->currsel = newsel;
-                mainptr->RestorePattern(newgen, newfile, newx, newy, newmag, newbase, newexpo);
+                if (newsnap) {
+                    mainptr->RestoreSnapshot(newsnap, newgen, newx, newy, newmag, newbase, newexpo);
+                } else {
+                    mainptr->RestorePattern(newgen, newfile, newx, newy, newmag, newbase, newexpo);
+                }
             }
             break;
             
@@ -532,6 +601,8 @@ UndoRedo::UndoRedo()
     savegenchanges = false;       // no script gen changes are pending
     doingscriptchanges = false;   // not undoing/redoing script changes
     prevfile = wxEmptyString;     // play safe for ClearUndoRedo
+    prevsnap = 0;                 // ditto
+    snapalgo = NULL;              // no snapshots yet
     startcount = 0;               // unfinished RememberGenStart calls
     
     // need to remember if script has created a new layer (not a clone)
@@ -543,6 +614,7 @@ UndoRedo::UndoRedo()
 UndoRedo::~UndoRedo()
 {
     ClearUndoRedo();
+    if (snapalgo) snapalgo->setsnapshotkeeper(NULL);
 }
 
 // -----------------------------------------------------------------------------
@@ -791,6 +863,76 @@ void UndoRedo::SaveCurrentPattern(const wxString& tempfile)
 
 // -----------------------------------------------------------------------------
 
+int UndoRedo::TakeSnapshot()
+{
+    // a snapshot is much faster than writing a file and shares its memory
+    // with the current pattern, but all our snapshots must be in one universe
+    // (releasing forgets snapalgo when that universe is deleted)
+    lifealgo* algo = currlayer->algo;
+    if (snapalgo && snapalgo != algo) return 0;
+    
+    int snapshot = algo->takesnapshot();
+    if (snapshot) {
+        snapalgo = algo;
+        algo->setsnapshotkeeper(this);
+    }
+    return snapshot;
+}
+
+// -----------------------------------------------------------------------------
+
+void UndoRedo::EvictSnapshots()
+{
+    if (snapalgo == NULL) return;
+    
+    // if the universe is using most of its memory then keep just enough
+    // snapshots for undoing/redoing the last few generating changes
+    int limit = maxsnapshots;
+    lifestats stats;
+    snapalgo->getstats(stats);
+    if (stats.memory > 0.75 * 1048576.0 * snapalgo->getMaxMemory()) limit = minsnapshots;
+    
+    // save the oldest changes in files first, then the furthest redoable changes
+    wxList::compatibility_iterator node;
+    node = undolist.GetLast();
+    while (snapalgo->getsnapshotcount() > limit && node) {
+        ((ChangeNode*) node->GetData())->SaveSnapshots();
+        node = node->GetPrevious();
+    }
+    node = redolist.GetLast();
+    while (snapalgo->getsnapshotcount() > limit && node) {
+        ((ChangeNode*) node->GetData())->SaveSnapshots();
+        node = node->GetPrevious();
+    }
+}
+
+// -----------------------------------------------------------------------------
+
+void UndoRedo::releasing(lifealgo* algo)
+{
+    if (algo != snapalgo) return;
+    
+    // the universe is about to be deleted (eg. by ResetPattern or ChangeAlgorithm)
+    // so save every snapshot we still need in a temporary file
+    wxList::compatibility_iterator node;
+    for (node = undolist.GetFirst(); node; node = node->GetNext()) {
+        ((ChangeNode*) node->GetData())->SaveSnapshots();
+    }
+    for (node = redolist.GetFirst(); node; node = node->GetNext()) {
+        ((ChangeNode*) node->GetData())->SaveSnapshots();
+    }
+    if (prevsnap) {
+        prevfile = SaveSnapshot(algo, prevsnap, genchange_prefix);
+        algo->dropsnapshot(prevsnap);
+        prevsnap = 0;
+    }
+    
+    algo->setsnapshotkeeper(NULL);
+    snapalgo = NULL;
+}
+
+// -----------------------------------------------------------------------------
+
 void UndoRedo::RememberGenStart()
 {
     startcount++;
@@ -825,6 +967,12 @@ void UndoRedo::RememberGenStart()
         // we can just reset to starting pattern
         prevfile = wxEmptyString;
     } else {
+        // if the universe can hold the current pattern in memory then that's
+        // much faster than saving it in a file
+        prevfile = wxEmptyString;
+        prevsnap = TakeSnapshot();
+        if (prevsnap) return;
+        
         // save current pattern in a unique temporary file
         prevfile = wxFileName::CreateTempFileName(tempdir + genchange_prefix);
         
@@ -867,11 +1015,15 @@ void UndoRedo::RememberGenFinish()
     
     // generation count might not have changed (can happen in Linux app)
     if (prevgen == currlayer->algo->getGeneration()) {
-        // delete prevfile created by RememberGenStart
+        // delete prevfile (or snapshot) created by RememberGenStart
         if (!prevfile.IsEmpty() && wxFileExists(prevfile)) {
             wxRemoveFile(prevfile);
         }
         prevfile = wxEmptyString;
+        if (prevsnap) {
+            snapalgo->dropsnapshot(prevsnap);
+            prevsnap = 0;
+        }
         return;
     }
 
@@ -879,6 +1031,7 @@ void UndoRedo::RememberGenFinish()
     wxString oldtempstart = currlayer->tempstart;
     
     wxString fpath;
+    int fsnap = 0;
     if (currlayer->algo->getGeneration() == currlayer->startgen) {
         // script called reset() so just use starting pattern
         fpath = wxEmptyString;
@@ -888,9 +1041,13 @@ void UndoRedo::RememberGenFinish()
         currlayer->tempstart = wxFileName::CreateTempFileName(tempdir + wxT("gr_"));
 
     } else {
-        // save finishing pattern in a unique temporary file
-        fpath = wxFileName::CreateTempFileName(tempdir + genchange_prefix);
-        SaveCurrentPattern(fpath);
+        // remember finishing pattern in memory if possible,
+        // otherwise save it in a unique temporary file
+        fsnap = TakeSnapshot();
+        if (fsnap == 0) {
+            fpath = wxFileName::CreateTempFileName(tempdir + genchange_prefix);
+            SaveCurrentPattern(fpath);
+        }
     }
     
     // clear the redo history
@@ -907,6 +1064,9 @@ void UndoRedo::RememberGenFinish()
     change->newgen = currlayer->algo->getGeneration();
     change->oldfile = prevfile;
     change->newfile = fpath;
+    change->oldsnap = prevsnap;
+    change->newsnap = fsnap;
+    if (prevsnap || fsnap) change->snapalgo = snapalgo;
     change->oldx = prevx;
     change->oldy = prevy;
     viewptr->GetPos(change->newx, change->newy);
@@ -933,8 +1093,10 @@ void UndoRedo::RememberGenFinish()
     
     // prevfile has been saved in change->oldfile (~ChangeNode will delete it)
     prevfile = wxEmptyString;
+    prevsnap = 0;
     
     undolist.Insert(change);
+    EvictSnapshots();
     
     // update Undo item in Edit menu
     UpdateUndoItem(change->suffix);
@@ -957,6 +1119,7 @@ void UndoRedo::AddGenChange()
     prevbase = currlayer->startbase;
     prevexpo = currlayer->startexpo;
     prevfile = wxEmptyString;
+    prevsnap = 0;
     
     // pretend RememberGenStart was called
     startcount = 1;
@@ -1557,6 +1720,10 @@ void UndoRedo::ClearUndoRedo()
             wxRemoveFile(prevfile);
         }
         prevfile = wxEmptyString;
+        if (prevsnap) {
+            snapalgo->dropsnapshot(prevsnap);
+            prevsnap = 0;
+        }
         startcount = 0;
     }
     
@@ -1590,6 +1757,17 @@ bool CopyTempFiles(ChangeNode* srcnode, ChangeNode* destnode, const wxString& te
     // temporary file names in the destnode and copy each file
     bool allcopied = true;
     
+    // destnode's layer has its own universe so it needs files for any snapshots
+    destnode->oldsnap = 0;
+    destnode->newsnap = 0;
+    destnode->snapalgo = NULL;
+    if (srcnode->oldsnap) {
+        destnode->oldfile = SaveSnapshot(srcnode->snapalgo, srcnode->oldsnap, dupe1_prefix);
+    }
+    if (srcnode->newsnap) {
+        destnode->newfile = SaveSnapshot(srcnode->snapalgo, srcnode->newsnap, dupe2_prefix);
+    }
+    
     if ( !srcnode->oldfile.IsEmpty() && wxFileExists(srcnode->oldfile) ) {
         destnode->oldfile = wxFileName::CreateTempFileName(tempdir + dupe1_prefix);
         if ( !wxCopyFile(srcnode->oldfile, destnode->oldfile, true) )
@@ -1693,6 +1871,13 @@ void UndoRedo::DuplicateHistory(Layer* oldlayer, Layer* newlayer)
         }
     }
     
+    // the new layer has its own universe so save any snapshot in a file
+    prevsnap = 0;
+    snapalgo = NULL;
+    if (history->prevsnap) {
+        prevfile = SaveSnapshot(history->snapalgo, history->prevsnap, genchange_prefix);
+    }
+    
     // do a deep copy of dynamically allocated data
     cellarray = NULL;
     if (numchanges > 0 && history->cellarray) {
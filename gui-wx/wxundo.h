@@ -9,6 +9,7 @@
 class Layer;            // need this because wxlayer.h includes wxundo.h
 #include "wxlayer.h"    // for Layer class
 #include "wxalgos.h"    // for algo_type
+#include "lifealgo.h"   // for snapshotkeeper
 
 // This module implements unlimited undo/redo:
 
@@ -19,7 +20,7 @@ typedef struct {
     int newstate;       // new state
 } cell_change;          // stores a single cell change
 
-class UndoRedo {
+class UndoRedo : public snapshotkeeper {
 public:
     UndoRedo();
     ~UndoRedo();
@@ -107,6 +108,10 @@ public:
     void UpdateUndoRedoItems();   // update Undo/Redo items in Edit menu
     void ClearUndoRedo();         // clear all undo/redo history
     
+    void releasing(lifealgo* algo);
+    // the universe holding our snapshots is about to be deleted,
+    // so save them in temporary files
+    
 private:
     wxList undolist;              // list of undoable changes
     wxList redolist;              // list of redoable changes
@@ -117,6 +122,8 @@ private:
     bool badalloc;                // malloc/realloc failed?
     
     wxString prevfile;            // for saving pattern at start of gen change
+    int prevsnap;                 // or snapshot of pattern (if prevfile is empty)
+    lifealgo* snapalgo;           // universe holding our snapshots (or NULL)
     bigint prevgen;               // generation count at start of gen change
     bigint prevx, prevy;          // viewport position at start of gen change
     int prevmag;                  // scale at start of gen change
@@ -128,6 +135,13 @@ private:
     void SaveCurrentPattern(const wxString& tempfile);
     // save current pattern to given temporary file
     
+    int TakeSnapshot();
+    // return a snapshot of the current pattern held in memory by the universe,
+    // or 0 if it can't take one (only the hashing algos can)
+    
+    void EvictSnapshots();
+    // save the oldest snapshots in temporary files if we hold too many
+    
     void UpdateUndoItem(const wxString& action);
     void UpdateRedoItem(const wxString& action);
     // update the Undo/Redo items in the Edit menu
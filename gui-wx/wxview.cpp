@@ -1790,6 +1790,7 @@ void PatternView::ProcessKey(int key, int modifiers)
         case DO_SETCOLORS:   if (!inscript && !busy) SetLayerColors(); break;
         case DO_SYNCVIEWS:   if (!inscript) ToggleSyncViews(); break;
         case DO_SYNCCURS:    if (!inscript) ToggleSyncCursors(); break;
+        case DO_SYNCGENS:    if (!inscript) ToggleSyncGenerating(); break;
         case DO_STACK:       if (!inscript) ToggleStackLayers(); break;
         case DO_TILE:        if (!inscript) ToggleTileLayers(); break;
             